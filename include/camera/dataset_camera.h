@@ -0,0 +1,132 @@
+#pragma once
+#include "camera/camera_interface.h"
+#include "core/frame.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ar_slam {
+
+    /**
+     * @brief Replays a recorded image sequence as a camera, for repeatable runs on
+     * real imagery.
+     *
+     * open() takes config.device_path as a dataset directory or its list file,
+     * in either common layout:
+     *   - TUM RGB-D: rgb.txt, lines of "<seconds> <image path>";
+     *   - EuRoC MAV: mav0/cam0/data.csv, lines of "<nanoseconds>,<file name>"
+     *     with the images in the data/ directory beside it.
+     * Lines starting with '#' are comments; frames are served in timestamp order.
+     *
+     * Decoding is kept off the caller's path: a pool of threads reads and
+     * decodes the frames ahead of the read position into a bounded ring, and
+     * grab_frame() only waits if it catches up with them (decode_wait_ms()
+     * says how long it did). Frames are served either paced by their
+     * timestamps, as a live camera would deliver them, or as fast as they are
+     * taken, and the same sequence always yields the same frames in the same
+     * order whatever the thread timing. seek() moves the read position;
+     * frames already decoded for the old position are discarded.
+     *
+     * One thread consumes; open(), close() and seek() are called from it too.
+     */
+    class DatasetCamera : public CameraInterface {
+    public:
+        enum class Pacing {
+            kRealTime,          ///< Each frame released at its timestamp (scaled by speed).
+            kAsFastAsPossible,  ///< Each frame released as soon as it is decoded.
+        };
+
+        struct Options {
+            Pacing pacing = Pacing::kRealTime;
+            double speed = 1.0;           ///< Playback rate for kRealTime.
+            unsigned decode_threads = 2;  ///< Prefetching decoder threads.
+            std::size_t prefetch = 8;     ///< Frames decoded ahead (the ring size).
+            int imread_flags = cv::IMREAD_UNCHANGED;  ///< E.g. IMREAD_GRAYSCALE for the tracker.
+        };
+
+        /// One frame of the sequence.
+        struct Entry {
+            double timestamp = 0;  ///< Seconds, on the dataset's clock.
+            std::string path;      ///< Image file.
+        };
+
+        DatasetCamera();
+        explicit DatasetCamera(const Options& options);
+        ~DatasetCamera() override;
+
+        DatasetCamera(const DatasetCamera&) = delete;
+        DatasetCamera& operator=(const DatasetCamera&) = delete;
+
+        /// Load the sequence at config.device_path and start prefetching from its start.
+        bool open(const CameraConfig& config) override;
+        void close() override;
+        bool is_open() const override { return !workers_.empty(); }
+
+        /**
+         * @brief Hand out the frame at the read position and advance.
+         *
+         * Frames that fail to decode are logged and skipped.
+         * @return False at the end of the sequence.
+         */
+        bool grab_frame(cv::Mat& frame) override;
+
+        /// As above, with the frame's dataset timestamp as a Frame time.
+        bool grab_frame(cv::Mat& frame, Frame::Timestamp& timestamp);
+
+        /// Nominal frame rate of the sequence.
+        double get_fps() const override { return fps_; }
+
+        /// Move the read position to frame @p index; false (and no move) past the end.
+        bool seek(std::size_t index);
+        /// Move to the first frame at or after @p seconds on the dataset's clock.
+        bool seek_time(double seconds);
+
+        std::size_t frame_count() const { return entries_.size(); }
+        std::size_t position() const { return position_; }  ///< Next frame served.
+        const std::vector<Entry>& entries() const { return entries_; }
+
+        double decode_wait_ms() const { return decode_wait_ms_; }  ///< Since open().
+        std::size_t decode_failures() const { return failures_; }
+
+        /**
+         * @brief Parse a TUM list, an EuRoC CSV or a directory holding either.
+         * @return False if @p path is neither or lists no frames.
+         */
+        static bool load_index(const std::string& path, std::vector<Entry>& entries);
+
+    private:
+        struct Slot {
+            std::size_t index = SIZE_MAX;  // Frame decoded (or being decoded) into it
+            bool ready = false;
+            cv::Mat image;
+        };
+
+        void decode_loop();
+        void restart(std::size_t index);  // Requires mutex_
+
+        Options options_;
+        std::vector<Entry> entries_;
+        double fps_ = 0;
+
+        std::mutex mutex_;
+        std::condition_variable work_;   // A slot was freed, or stop
+        std::condition_variable ready_;  // A frame was decoded
+        std::vector<Slot> ring_;
+        std::size_t position_ = 0;     // Next frame handed out
+        std::size_t next_decode_ = 0;  // Next frame a decoder takes
+        uint64_t generation_ = 0;      // Bumped by seek(); older decodes are dropped
+        bool stop_ = false;
+        std::vector<std::thread> workers_;
+
+        // Consumer side
+        std::chrono::steady_clock::time_point pace_start_{};
+        double pace_origin_ = 0;  // Dataset time released at pace_start_
+        double decode_wait_ms_ = 0;
+        std::size_t failures_ = 0;
+    };
+
+}  // namespace ar_slam
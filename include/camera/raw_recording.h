@@ -0,0 +1,191 @@
+#pragma once
+#include "core/frame.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ar_slam {
+
+    namespace raw_recording_detail {
+
+        constexpr uint32_t kFileVersion = 1;
+        constexpr uint64_t kPageSize = 4096;        ///< Every frame record starts on a page.
+        constexpr uint64_t kRecordHeaderSize = 64;  ///< Pixels follow on the next cache line.
+
+        inline uint64_t page_align(uint64_t n) {
+            return (n + kPageSize - 1) / kPageSize * kPageSize;
+        }
+
+        /// Little-endian file header, padded to a page; frame records follow.
+        struct FileHeader {
+            char magic[4];  // "ARRW"
+            uint32_t version;
+            uint32_t page_size;
+            uint32_t reserved0;
+            uint64_t reserved[5];
+            uint64_t checksum;  // Of the 56 bytes above.
+        };
+        static_assert(sizeof(FileHeader) == 64, "FileHeader is part of the file format");
+
+        /// Head of one frame record; the pixels follow at kRecordHeaderSize.
+        struct FrameRecord {
+            char magic[4];  // "ARFR"
+            uint32_t pixel_format;  // Frame::PixelFormat
+            int64_t timestamp_ns;   // Frame::Timestamp since its clock's epoch.
+            uint64_t sequence;      // Position of the frame in the file.
+            int32_t rows;
+            int32_t cols;
+            int32_t type;  // cv::Mat type.
+            uint32_t reserved0;
+            uint64_t step;      // Bytes per row.
+            uint64_t size;      // Pixel bytes, step * rows.
+            uint64_t checksum;  // Of the record head with this field zeroed.
+        };
+        static_assert(sizeof(FrameRecord) == kRecordHeaderSize,
+                      "FrameRecord is part of the file format");
+
+        /// One row of the index written by RawRecorder::close().
+        struct IndexEntry {
+            int64_t timestamp_ns;
+            uint64_t offset;  // Of the frame record; a multiple of kPageSize.
+            uint32_t pixel_format;
+            int32_t rows;
+            int32_t cols;
+            int32_t type;
+            uint64_t step;
+            uint64_t sequence;
+        };
+        static_assert(sizeof(IndexEntry) == 48, "IndexEntry is part of the file format");
+
+        /// The last 64 bytes of a closed recording; the index starts on a page.
+        struct IndexTrailer {
+            char magic[4];  // "ARIX"
+            uint32_t reserved0;
+            uint64_t index_offset;
+            uint64_t count;
+            uint64_t index_checksum;  // Of the count index entries.
+            uint64_t reserved[3];
+            uint64_t checksum;  // Of the 56 bytes above.
+        };
+        static_assert(sizeof(IndexTrailer) == 64, "IndexTrailer is part of the file format");
+
+    }  // namespace raw_recording_detail
+
+    /// One frame of a raw recording, as indexed.
+    struct RecordedFrame {
+        Frame::Timestamp timestamp;
+        Frame::PixelFormat format = Frame::PixelFormat::kGray;
+        uint64_t sequence = 0;
+        uint64_t offset = 0;  ///< Of the record in the file; the pixels are 64 bytes on.
+        int rows = 0;
+        int cols = 0;
+        int type = 0;
+        std::size_t step = 0;
+    };
+
+    /**
+     * @brief Appends captured frames, undecoded, to a raw recording file.
+     *
+     * The file is a header page followed by one record per frame, each
+     * starting on a page boundary: a 64-byte head (timestamp, pixel format,
+     * geometry, checksum) and then the pixel rows exactly as captured, so a
+     * frame reads back as a cv::Mat header onto the mapped file with nothing
+     * to decode. close() appends an index of every record (timestamp, offset,
+     * format) and a trailer pointing at it; a file whose recorder never
+     * reached close() is still readable, by scanning the records.
+     *
+     * Single-threaded: RecordingCamera calls it from its writer thread.
+     */
+    class RawRecorder {
+    public:
+        RawRecorder() = default;
+        ~RawRecorder() { close(); }
+
+        RawRecorder(const RawRecorder&) = delete;
+        RawRecorder& operator=(const RawRecorder&) = delete;
+
+        /// Create @p path (replacing any file there) and write the file header.
+        bool open(const std::string& path);
+
+        /**
+         * @brief Append @p image as the next frame.
+         * @return False (and nothing indexed) if the write failed; the partial
+         *         record is cut off, so later frames still line up.
+         */
+        bool write(const cv::Mat& image, Frame::PixelFormat format,
+                   const Frame::Timestamp& timestamp);
+
+        /// Write the index and trailer and close the file; false if that failed.
+        bool close();
+
+        bool is_open() const { return fd_ >= 0; }
+        std::size_t frames() const { return index_.size(); }
+        uint64_t bytes_written() const { return offset_; }
+
+    private:
+        bool write_fully(const void* data, std::size_t size);
+        bool pad_to_page();
+
+        int fd_ = -1;
+        uint64_t offset_ = 0;
+        std::string path_;
+        std::vector<raw_recording_detail::IndexEntry> index_;
+    };
+
+    /**
+     * @brief A raw recording mapped into memory, its frames used in place.
+     *
+     * open() maps the file and reads the index from its trailer; without one
+     * (the recorder did not close) it walks the record chain instead and
+     * stops at the first torn or corrupt record, which truncated() reports.
+     * image() is a cv::Mat header onto the mapping: no copy and no decode.
+     * The mapping is private and writable, so drawing on an image changes
+     * only this process's copy of the page, never the file.
+     *
+     * The mapping is reference-counted: mapping() keeps it alive after
+     * close() for as long as anything (a Frame, say) holds it.
+     */
+    class RawRecording {
+    public:
+        RawRecording() = default;
+        ~RawRecording() { close(); }
+
+        RawRecording(const RawRecording&) = delete;
+        RawRecording& operator=(const RawRecording&) = delete;
+
+        /// Map @p path; false if it is missing, corrupt or not a raw recording.
+        bool open(const std::string& path);
+        /// Release this reference to the mapping; images not held elsewhere become invalid.
+        void close();
+        bool is_open() const { return mapping_ != nullptr; }
+
+        const std::vector<RecordedFrame>& frames() const { return frames_; }
+
+        /// Frame @p i as a header onto the mapping.
+        cv::Mat image(std::size_t i) const;
+
+        /// The mapping, for holders of images that must outlive close().
+        const std::shared_ptr<void>& mapping() const { return mapping_; }
+
+        /// True if the frames came from the index, false if from a scan.
+        bool indexed() const { return indexed_; }
+        /// True if a scan found bytes after the last complete record.
+        bool truncated() const { return truncated_; }
+
+        /// Ask the kernel to read frames [first, first + count) in ahead of use.
+        void prefetch(std::size_t first, std::size_t count) const;
+
+    private:
+        bool read_index();
+        void scan_records();
+
+        std::shared_ptr<void> mapping_;
+        std::size_t mapping_size_ = 0;
+        std::vector<RecordedFrame> frames_;
+        bool indexed_ = false;
+        bool truncated_ = false;
+    };
+
+}  // namespace ar_slam
@@ -0,0 +1,81 @@
+#pragma once
+#include "camera/camera_interface.h"
+#include "camera/raw_recording.h"
+#include "core/frame.h"
+#include <cstddef>
+
+namespace ar_slam {
+
+    /**
+     * @brief Replays a raw recording (see RecordingCamera) with no decode work.
+     *
+     * open() takes config.device_path as the recording file and maps it;
+     * grab_frame() hands out a cv::Mat header onto the next frame's pixels in
+     * the mapping, so a frame costs a pointer bump plus whatever page faults
+     * the read-ahead has not already absorbed. Frames are served as fast as
+     * they are taken, which puts the SLAM core, not capture or decoding, on
+     * the clock: the way to benchmark it in isolation at hundreds of frames
+     * per second on real imagery.
+     *
+     * Images from grab_frame() stay valid until close(); next_frame() returns
+     * Frames that hold the mapping themselves and so may outlive it. Each
+     * frame keeps the pixel format and capture time it was recorded with.
+     *
+     * One thread consumes; open(), close() and seek() are called from it too.
+     */
+    class RawReplayCamera : public CameraInterface {
+    public:
+        struct Options {
+            bool loop = false;          ///< Start over at the end instead of ending.
+            std::size_t readahead = 4;  ///< Frames the kernel is asked to read ahead.
+        };
+
+        RawReplayCamera();
+        explicit RawReplayCamera(const Options& options);
+        ~RawReplayCamera() override { close(); }
+
+        RawReplayCamera(const RawReplayCamera&) = delete;
+        RawReplayCamera& operator=(const RawReplayCamera&) = delete;
+
+        /// Map the recording at config.device_path; false if it holds no frames.
+        bool open(const CameraConfig& config) override;
+        void close() override;
+        bool is_open() const override { return recording_.is_open(); }
+
+        /**
+         * @brief Point @p frame at the frame at the read position and advance.
+         * @return False at the end of the recording (unless looping).
+         */
+        bool grab_frame(cv::Mat& frame) override;
+
+        /// As above, with the frame's recorded capture time.
+        bool grab_frame(cv::Mat& frame, Frame::Timestamp& timestamp);
+
+        /**
+         * @brief The next frame as a Frame borrowing the mapping, built in
+         *        @p pool if given.
+         * @return nullptr at the end of the recording, or when @p pool is full.
+         */
+        Frame::Ptr next_frame(SharedPool<Frame>* pool = nullptr);
+
+        /// Nominal frame rate of the recording.
+        double get_fps() const override { return fps_; }
+
+        /// Move the read position to frame @p index; false (and no move) past the end.
+        bool seek(std::size_t index);
+
+        std::size_t frame_count() const { return recording_.frames().size(); }
+        std::size_t position() const { return position_; }  ///< Next frame served.
+        const RawRecording& recording() const { return recording_; }
+
+    private:
+        /// Index of the frame to serve, advancing the position; false at the end.
+        bool advance(std::size_t& index);
+
+        Options options_;
+        RawRecording recording_;
+        std::size_t position_ = 0;
+        double fps_ = 0;
+    };
+
+}  // namespace ar_slam
@@ -0,0 +1,89 @@
+#pragma once
+#include "camera/camera_interface.h"
+#include "camera/raw_recording.h"
+#include "core/frame.h"
+#include "core/spsc_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ar_slam {
+
+    /**
+     * @brief Decorator that records every frame of another camera to a raw
+     * recording while passing it through.
+     *
+     * A session recorded this way replays with RawReplayCamera exactly as it
+     * was captured, which makes a performance problem seen live repeatable.
+     * The capture path pays one image copy into a recycled buffer; the file
+     * writes happen on a writer thread fed by a lock-free SpscQueue. If the
+     * disk falls behind, frames are dropped from the recording (and counted)
+     * rather than stalling capture. close() writes out the frames still
+     * queued, then the index.
+     *
+     * Frames are stored as the source delivers them: CV_8UC1 as gray, CV_8UC3
+     * as BGR and CV_8UC2 as YUYV. Wrap it in a ThreadedCamera to record every
+     * frame the source produces rather than every frame the consumer takes.
+     *
+     * One thread consumes; open() and close() are called from that thread too.
+     */
+    class RecordingCamera : public CameraInterface {
+    public:
+        /// @param queue_frames Frames that may wait for the writer before drops start.
+        RecordingCamera(CameraInterface::Ptr source, std::string path,
+                        std::size_t queue_frames = 8);
+        ~RecordingCamera() override;
+
+        RecordingCamera(const RecordingCamera&) = delete;
+        RecordingCamera& operator=(const RecordingCamera&) = delete;
+
+        /// Open the source and create the recording (replacing any file there).
+        bool open(const CameraConfig& config) override;
+        /// Finish the recording and close the source.
+        void close() override;
+        bool is_open() const override { return writer_.joinable(); }
+
+        /// Grab from the source and queue a copy of the frame for the recording.
+        bool grab_frame(cv::Mat& frame) override;
+
+        /// As above, also reporting the capture time stored with the frame.
+        bool grab_frame(cv::Mat& frame, Frame::Timestamp& captured);
+
+        double get_fps() const override { return source_->get_fps(); }
+
+        const std::string& path() const { return path_; }
+
+        // Statistics since open()
+        uint64_t frames_recorded() const { return recorded_.load(std::memory_order_relaxed); }
+        /// Frames left out of the recording: the queue was full or the write failed.
+        uint64_t frames_dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        struct Packet {
+            cv::Mat image;
+            Frame::PixelFormat format = Frame::PixelFormat::kGray;
+            Frame::Timestamp captured;
+        };
+
+        void run();
+
+        CameraInterface::Ptr source_;
+        std::string path_;
+        RawRecorder recorder_;  // Used by the writer thread only while it runs
+        SpscQueue<Packet> queue_;
+        Packet staging_;  // Recycled through the queue
+        std::thread writer_;
+
+        std::mutex wake_mutex_;
+        std::condition_variable wake_;
+        std::atomic<bool> stop_{false};
+
+        std::atomic<uint64_t> recorded_{0};
+        std::atomic<uint64_t> dropped_{0};
+    };
+
+}  // namespace ar_slam
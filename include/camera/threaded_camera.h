@@ -0,0 +1,102 @@
+#pragma once
+#include "camera/camera_interface.h"
+#include "core/frame.h"
+#include "core/triple_buffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace ar_slam {
+
+    /**
+     * @brief Decorator that captures from another camera on its own thread.
+     *
+     * Grabbing in the processing loop adds capture time to every iteration,
+     * and when processing falls behind, frames wait in the driver and the
+     * tracker works on stale images. Here a capture thread grabs from the
+     * source as fast as it delivers and publishes each frame into a lock-free
+     * TripleBuffer; grab_frame() takes the newest one. Frames the consumer was
+     * too slow for are overwritten and counted as dropped, and the time from
+     * capture to hand-over is measured.
+     *
+     * Images circulate without copies: grab_frame() swaps the newest image
+     * into the caller's cv::Mat and the caller's previous image goes back to
+     * the ring to be captured into again. The caller must therefore not keep
+     * other headers onto an image across the next grab_frame().
+     *
+     * One thread consumes; open() and close() are called from that thread too.
+     */
+    class ThreadedCamera : public CameraInterface {
+    public:
+        struct Options {
+            int timeout_ms = 1000;  ///< Longest grab_frame() wait for a new frame.
+            int failure_limit = 5;  ///< Consecutive failed grabs that end the stream.
+        };
+
+        explicit ThreadedCamera(CameraInterface::Ptr source);
+        ThreadedCamera(CameraInterface::Ptr source, const Options& options);
+        ~ThreadedCamera() override;
+
+        ThreadedCamera(const ThreadedCamera&) = delete;
+        ThreadedCamera& operator=(const ThreadedCamera&) = delete;
+
+        /// Open the source and start capturing.
+        bool open(const CameraConfig& config) override;
+        /// Stop capturing (waiting for a grab in progress) and close the source.
+        void close() override;
+        bool is_open() const override { return thread_.joinable(); }
+
+        /**
+         * @brief Swap the newest frame not yet taken into @p frame, waiting for one.
+         * @return False on timeout, or once the source has ended and every frame
+         *         it delivered has been taken.
+         */
+        bool grab_frame(cv::Mat& frame) override;
+
+        /// As above, also reporting when the frame was captured.
+        bool grab_frame(cv::Mat& frame, Frame::Timestamp& captured);
+
+        /// Rate at which the capture thread receives frames.
+        double get_fps() const override { return fps_.load(std::memory_order_relaxed); }
+
+        // Statistics since open()
+        uint64_t frames_captured() const { return captured_.load(std::memory_order_relaxed); }
+        uint64_t frames_dropped() const { return dropped_.load(std::memory_order_relaxed); }
+        uint64_t frames_delivered() const { return delivered_; }
+        double latency_ms() const { return latency_ms_; }  ///< Capture to hand-over, last frame.
+        double mean_latency_ms() const {
+            return delivered_ == 0 ? 0.0 : latency_total_ms_ / delivered_;
+        }
+
+    private:
+        struct Slot {
+            cv::Mat image;
+            Frame::Timestamp captured;
+        };
+
+        void run();
+        void notify();
+
+        CameraInterface::Ptr source_;
+        Options options_;
+        TripleBuffer<Slot> buffer_;
+        std::thread thread_;
+
+        // Wakes a consumer waiting for a frame; frames themselves never pass a lock.
+        std::mutex wait_mutex_;
+        std::condition_variable frame_ready_;
+
+        // Written by the capture thread
+        std::atomic<uint64_t> captured_{0};
+        std::atomic<uint64_t> dropped_{0};
+        std::atomic<double> fps_{0};
+
+        // Written by the consumer
+        uint64_t delivered_ = 0;
+        double latency_ms_ = 0;
+        double latency_total_ms_ = 0;
+    };
+
+}  // namespace ar_slam
@@ -1,45 +1,138 @@
 #pragma once
 #include "camera/camera_interface.h"
+#include "core/frame.h"
+#include "core/shared_pool.h"
 #include <linux/videodev2.h>
+#include <sys/types.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace ar_slam {
 
-    class V4L2Camera : public CameraInterface {
-    private:
-        int fd_ = -1;
+    /**
+     * @brief The system calls V4L2Camera makes.
+     *
+     * The default implementation forwards each one to the kernel. Tests
+     * substitute an in-process fake device that answers the ioctls and maps
+     * its own memory, so capture can be exercised without /dev/video*.
+     * Failures return -1 (MAP_FAILED for mmap) with errno set, as the real
+     * calls do.
+     */
+    class V4L2Io {
+    public:
+        virtual ~V4L2Io() = default;
+
+        virtual int open(const char* path, int flags);
+        virtual int close(int fd);
+        virtual int ioctl(int fd, unsigned long request, void* arg);
+        virtual void* mmap(std::size_t length, int fd, off_t offset);
+        virtual int munmap(void* start, std::size_t length);
+
+        /// Wait up to @p timeout_ms for a filled buffer: > 0 ready, 0 timed out, < 0 error.
+        virtual int poll(int fd, int timeout_ms);
+    };
 
-        struct Buffer {
-            void* start;
-            size_t length;
+    /**
+     * @brief Video4Linux2 capture that hands frames to the tracker without copying.
+     *
+     * open() negotiates the format and frame rate, then streams into a ring of
+     * buffers, either driver-allocated and mapped into the process (MMAP) or
+     * page-aligned buffers allocated here that the driver fills (USERPTR).
+     *
+     * capture() dequeues the next filled buffer and returns a cv::Mat header
+     * over it together with a reference that keeps the buffer out of the
+     * driver's queue; capture_frame() wraps that header straight into a Frame.
+     * When the last holder of the buffer is released (on any thread), the
+     * buffer is queued back to the driver. For GREY and NV12 no pixel is
+     * copied between the driver and the tracker, and YUYV/UYVY cost one
+     * strided luma pass; colour is converted only if a frame is asked for it.
+     *
+     * Every buffer held downstream is one fewer the driver can fill, so the
+     * buffer count bounds how many frames may be alive at once: with all of
+     * them held, capture() fails at once rather than waiting. Buffers still
+     * held when the camera is closed stay valid and are unmapped when the
+     * last one is released.
+     */
+    class V4L2Camera : public CameraInterface {
+    public:
+        enum class IoMethod {
+            kMmap,     ///< Driver-allocated buffers mapped into the process.
+            kUserPtr,  ///< Page-aligned buffers allocated here and filled by the driver.
         };
 
-        std::vector<Buffer> buffers_;
-        v4l2_format format_;
+        struct Options {
+            IoMethod io = IoMethod::kMmap;
+            unsigned buffer_count = 4;                  ///< Requested; the driver may adjust it.
+            uint32_t pixel_format = V4L2_PIX_FMT_GREY;  ///< Requested; the driver may substitute.
+            int timeout_ms = 1000;  ///< Longest wait for a filled buffer.
+        };
 
-        // Performance tracking
-        std::chrono::steady_clock::time_point last_frame_time_;
-        double measured_fps_ = 0;
+        /// One dequeued buffer, viewed in place.
+        struct Capture {
+            /// Header over the buffer: CV_8UC1 for GREY and NV12 (height * 3 / 2
+            /// rows), CV_8UC2 for YUYV and UYVY.
+            cv::Mat image;
+            std::shared_ptr<const void> buffer;  ///< Keeps the buffer dequeued while held.
+            Frame::Timestamp timestamp;          ///< Driver capture time.
+            uint32_t sequence = 0;               ///< Driver frame counter; gaps are drops.
+        };
 
-    public:
-        V4L2Camera() = default;
+        V4L2Camera();
+        explicit V4L2Camera(const Options& options, std::shared_ptr<V4L2Io> io = nullptr);
         ~V4L2Camera() override;
 
+        V4L2Camera(const V4L2Camera&) = delete;
+        V4L2Camera& operator=(const V4L2Camera&) = delete;
+
         bool open(const CameraConfig& config) override;
         void close() override;
-        bool is_open() const override { return fd_ >= 0; }
+        bool is_open() const override { return stream_ != nullptr; }
 
+        /// Copy the next frame into @p frame (8-bit gray or BGR); the buffer is requeued at once.
         bool grab_frame(cv::Mat& frame) override;
         double get_fps() const override { return measured_fps_; }
 
+        /**
+         * @brief Dequeue the next filled buffer without copying it.
+         * @return False on timeout or a driver error, or at once if every buffer
+         *         is still held downstream.
+         */
+        bool capture(Capture& out);
+
+        /**
+         * @brief capture() wrapped into a Frame, from @p pool if one is given.
+         * @return nullptr where capture() fails or the pool is exhausted.
+         */
+        Frame::Ptr capture_frame(SharedPool<Frame>* pool = nullptr);
+
+        // Negotiated stream (valid while open)
+        uint32_t pixel_format() const { return format_.fmt.pix.pixelformat; }
+        int width() const { return static_cast<int>(format_.fmt.pix.width); }
+        int height() const { return static_cast<int>(format_.fmt.pix.height); }
+        std::size_t stride() const { return format_.fmt.pix.bytesperline; }
+        std::size_t buffer_count() const;
+        std::size_t buffers_held() const;  ///< Dequeued and not yet released.
+
     private:
+        struct Stream;
+
         bool init_device();
         bool init_mmap();
+        bool init_userptr();
         bool start_capture();
-        bool stop_capture();
-        void uninit_device();
+        void update_fps(const Frame::Timestamp& timestamp);
+
+        Options options_;
+        std::shared_ptr<V4L2Io> io_;
+        std::shared_ptr<Stream> stream_;  // Shared with the buffers handed out
+        v4l2_format format_{};
 
-        bool xioctl(int request, void* arg);
+        // Performance tracking
+        Frame::Timestamp last_frame_time_{};
+        double measured_fps_ = 0;
     };
 
-}  // namespace ar_slam
\ No newline at end of file
+}  // namespace ar_slam
@@ -0,0 +1,31 @@
+#pragma once
+#include "camera/camera_interface.h"
+
+namespace ar_slam {
+
+    /**
+     * @brief CameraInterface over cv::VideoCapture, so any source OpenCV can
+     * read (webcams on every platform, video files) can be decorated like the
+     * native cameras.
+     *
+     * A device_path under /dev/ (the default) means camera device_id; any
+     * other path is opened as a file or stream URL.
+     */
+    class VideoCaptureCamera : public CameraInterface {
+    public:
+        ~VideoCaptureCamera() override { close(); }
+
+        bool open(const CameraConfig& config) override;
+        void close() override;
+        bool is_open() const override { return capture_.isOpened(); }
+
+        /// Decode the next frame into @p frame (BGR); false at the end of a file.
+        bool grab_frame(cv::Mat& frame) override;
+        double get_fps() const override { return fps_; }
+
+    private:
+        cv::VideoCapture capture_;
+        double fps_ = 0;  // As reported by the backend.
+    };
+
+}  // namespace ar_slam
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/frame.h"
+#include "core/incremental_mapper.h"
+#include "core/spsc_queue.h"
+
+namespace ar_slam {
+
+    /**
+     * @brief Cloud entries written by one map version, linked to the version before.
+     *
+     * Entries are absolute: indices[k] takes points[k], and an index at the
+     * cloud's current size appends. Applying the deltas a reader missed, oldest
+     * first, brings its copy up to date whatever it had seen in between.
+     */
+    struct CloudDelta {
+        uint64_t map_version = 0;  ///< Version the cloud reaches with this delta applied.
+        std::size_t size = 0;      ///< Cloud size at that version.
+        std::vector<std::size_t> indices;
+        std::vector<cv::Point3f> points;
+        std::shared_ptr<const CloudDelta> previous;  ///< Older delta, or nullptr at the base.
+    };
+
+    /// Immutable view of the mapper's state, published after every processed packet.
+    struct MapSnapshot {
+        uint64_t sequence = 0;         ///< Packets processed when this was published.
+        uint64_t map_version = 0;      ///< Bumps whenever the cloud changed.
+        Frame::Timestamp timestamp{};  ///< Capture time of the packet it reflects.
+        bool has_cloud = false;        ///< True once a reconstruction succeeded.
+        double parallax = 0.0;         ///< Median parallax on that packet (px).
+        std::size_t keyframes = 0;     ///< Keyframes in the persistent map.
+        int loop_closures = 0;         ///< Loop corrections applied to the map.
+        std::size_t cloud_size = 0;    ///< Map landmarks at map_version.
+
+        /// Map landmarks (world frame) at base_version; shared, never mutated.
+        std::shared_ptr<const std::vector<cv::Point3f>> cloud_base;
+        uint64_t base_version = 0;
+        /// Changes from base_version up to map_version, newest first (nullptr: none).
+        std::shared_ptr<const CloudDelta> cloud_delta;
+
+        /// Newest keyframes' descriptors for the tracker's Relocalizer (shared, immutable).
+        std::shared_ptr<const RelocalizationMap> places;
+
+        /**
+         * @brief Bring a reader's copy of the map landmarks up to map_version.
+         * @param cloud   The copy, at @p version; updated in place.
+         * @param version The map_version @p cloud reflects (0 for an empty copy).
+         * @param changed If given, receives the indices written (possibly repeated).
+         * @return true if @p cloud was reloaded from the base instead, so every
+         *         entry may have changed (and @p changed is left empty).
+         */
+        bool update_cloud(std::vector<cv::Point3f>& cloud, uint64_t& version,
+                          std::vector<std::size_t>* changed = nullptr) const;
+    };
+
+    /**
+     * @brief Runs IncrementalMapper on its own thread, fed by the tracking loop.
+     *
+     * The tracking thread calls submit() with each frame's (track ids, points,
+     * timestamp) packet; the packet goes into a bounded lock-free SPSC queue and
+     * submit() returns immediately, even while the mapper is inside essential-matrix
+     * RANSAC or bundle adjustment. If the queue is full the packet is dropped and
+     * counted rather than waited on.
+     *
+     * Results are published as a double-buffered MapSnapshot: the mapper thread
+     * fills the back buffer and swaps it in atomically, and readers hold on to
+     * whichever snapshot they loaded for as long as they need it. A back buffer a
+     * reader still holds is never overwritten (a fresh one is allocated instead).
+     * The landmark cloud is not copied into every snapshot: snapshots share an
+     * immutable base copy plus a chain of CloudDeltas, and readers mirror it with
+     * MapSnapshot::update_cloud(). The base is re-taken only once the chain has
+     * grown long or carries a good fraction of the cloud.
+     *
+     * When the mapper falls behind, the coalescing policy decides what happens to
+     * the backlog: kLatest (default) drops every stale packet in favour of the
+     * newest, which is safe because the mapper matches by track id against its
+     * reference keyframe rather than frame to frame; kNone processes every packet.
+     *
+     * With Config::map_path set, the session is persisted on the mapping thread:
+     * an existing file is loaded at construction (and published as the first
+     * snapshot, so the tracker can relocalize against it straight away), and
+     * the map is appended to the file every Config::save_every keyframes and
+     * once more on destruction.
+     */
+    class AsyncMapper {
+    public:
+        enum class Coalesce {
+            kNone,    ///< Process every queued packet in order.
+            kLatest,  ///< Skip to the newest queued packet when behind.
+        };
+
+        struct Config {
+            std::size_t queue_capacity = 8;     ///< Packets buffered before dropping.
+            Coalesce coalesce = Coalesce::kLatest;
+            IncrementalMapper::Config mapper;
+            std::string map_path;         ///< Map file to resume and stream into (empty: none).
+            std::size_t save_every = 10;  ///< Keyframes between appended map segments.
+        };
+
+        /// Construct with default settings.
+        explicit AsyncMapper(const cv::Matx33d& K);
+
+        /// Construct with explicit settings.
+        AsyncMapper(const cv::Matx33d& K, const Config& config);
+
+        /// Stops the mapping thread (pending packets are discarded) and appends the map.
+        ~AsyncMapper();
+
+        AsyncMapper(const AsyncMapper&) = delete;
+        AsyncMapper& operator=(const AsyncMapper&) = delete;
+
+        /**
+         * @brief Hand one frame's tracks to the mapper. Never waits on mapping work.
+         *
+         * A full queue is detected before anything is copied. The wake mutex is taken
+         * only when the worker is idle, and the worker never holds it while mapping.
+         * @param image Grayscale frame, for keyframe descriptors. Copied into a recycled
+         *              buffer, so it may be a borrowed capture buffer the caller
+         *              releases as soon as submit() returns.
+         * @return false if the queue was full and the packet was dropped.
+         */
+        bool submit(const std::vector<int>& track_ids,
+                    const std::vector<cv::Point2f>& points,
+                    const Frame::Timestamp& timestamp,
+                    const cv::Mat& image = cv::Mat());
+
+        /// Same, for tracks held in per-frame (FrameArena) storage.
+        bool submit(const std::pmr::vector<int>& track_ids,
+                    const std::pmr::vector<cv::Point2f>& points,
+                    const Frame::Timestamp& timestamp,
+                    const cv::Mat& image = cv::Mat());
+
+        /// Latest published state; safe to call from any thread.
+        std::shared_ptr<const MapSnapshot> snapshot() const;
+
+        /// Block until every packet submitted so far has been processed or coalesced.
+        void flush();
+
+        uint64_t submitted() const { return submitted_.load(std::memory_order_relaxed); }
+        uint64_t processed() const { return processed_.load(std::memory_order_relaxed); }
+        uint64_t coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+        uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        struct Packet {
+            std::vector<int> track_ids;
+            std::vector<cv::Point2f> points;
+            Frame::Timestamp timestamp{};
+            cv::Mat image;
+        };
+
+        bool submit(const int* track_ids, std::size_t num_tracks,
+                    const cv::Point2f* points, std::size_t num_points,
+                    const Frame::Timestamp& timestamp, const cv::Mat& image);
+        void run();
+        void publish(const Packet& packet, bool map_changed, uint64_t sequence);
+        void publish_cloud();
+        void open_map();
+        void save_map(bool force);
+
+        Config config_;
+        IncrementalMapper mapper_;  // Touched only by the mapping thread.
+        MapWriter writer_;          // Likewise; open while the session is persisted.
+        std::size_t saved_keyframes_ = 0;
+        SpscQueue<Packet> queue_;
+        Packet staging_;  // Producer-side buffer recycled through the queue.
+
+        std::shared_ptr<const MapSnapshot> front_;  // Accessed with std::atomic_load/store.
+        std::shared_ptr<MapSnapshot> back_;
+        uint64_t map_version_ = 0;
+
+        // Cloud as published; mapping thread only.
+        std::shared_ptr<const std::vector<cv::Point3f>> cloud_base_;
+        uint64_t base_version_ = 0;
+        std::shared_ptr<const CloudDelta> cloud_delta_;
+        std::size_t chain_length_ = 0;  // Deltas since the base
+        std::size_t chain_points_ = 0;  // Entries they carry
+
+        std::atomic<uint64_t> submitted_{0};
+        std::atomic<uint64_t> processed_{0};
+        std::atomic<uint64_t> coalesced_{0};
+        std::atomic<uint64_t> dropped_{0};
+        std::atomic<uint64_t> consumed_{0};  // processed + coalesced, for flush().
+
+        std::mutex wake_mutex_;
+        std::condition_variable wake_;     // Worker: a packet arrived, or stop.
+        std::condition_variable flushed_;  // flush(): packets were consumed.
+        std::atomic<bool> sleeping_{false};  // Worker waits on wake_; submit() must notify.
+        std::atomic<bool> stop_{false};
+        std::thread worker_;
+    };
+
+}  // namespace ar_slam
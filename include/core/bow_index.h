@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "core/vocabulary.h"
+
+namespace ar_slam {
+
+    /// One result of a BowIndex query.
+    struct BowMatch {
+        int keyframe = -1;
+        double score = 0.0;  ///< L1 similarity in [0, 1] (see Vocabulary::score()).
+    };
+
+    /**
+     * @brief Inverted index from visual words to the keyframes containing them.
+     *
+     * add() stores a keyframe's BowVector and appends the keyframe to the posting
+     * list of every word it contains. query() walks only the posting lists of the
+     * query's words, accumulating the L1 similarity term by term, so its cost is
+     * the number of (word, keyframe) co-occurrences rather than the number of
+     * keyframes: with a large vocabulary most words are rare and the lists stay
+     * short even with tens of thousands of keyframes.
+     *
+     * Scores accumulate in a dense per-keyframe array that is reused between
+     * queries (only the touched entries are reset), so a query does not allocate
+     * once warm. Not thread-safe: add() and query() must not run concurrently.
+     */
+    class BowIndex {
+    public:
+        /// Size the posting lists for a vocabulary with @p word_count words.
+        explicit BowIndex(uint32_t word_count = 0) : postings_(word_count) {}
+
+        /// Index @p bow under @p keyframe (ids need not be dense).
+        void add(int keyframe, const BowVector& bow) {
+            const uint32_t slot = static_cast<uint32_t>(keyframes_.size());
+            keyframes_.push_back(keyframe);
+            vectors_.push_back(bow);
+            slot_.emplace(keyframe, slot);
+            scores_.push_back(0.0);
+            for (const BowEntry& e : bow) {
+                if (e.word >= postings_.size()) {
+                    postings_.resize(e.word + 1);
+                }
+                postings_[e.word].push_back({slot, e.weight});
+            }
+        }
+
+        /// Stored vector of @p keyframe, or nullptr.
+        const BowVector* vector(int keyframe) const {
+            auto it = slot_.find(keyframe);
+            return it == slot_.end() ? nullptr : &vectors_[it->second];
+        }
+
+        /**
+         * @brief The @p k keyframes most similar to @p bow for which @p accept(id) holds.
+         * @param out Reused: filled best first.
+         */
+        template <typename Accept>
+        void query(const BowVector& bow, std::size_t k, Accept accept, std::vector<BowMatch>& out) {
+            out.clear();
+            touched_.clear();
+            for (const BowEntry& q : bow) {
+                if (q.word >= postings_.size()) {
+                    continue;
+                }
+                for (const Posting& p : postings_[q.word]) {
+                    if (scores_[p.slot] == 0.0) {
+                        touched_.push_back(p.slot);
+                    }
+                    // |a| + |b| - |a - b| per shared word (see Vocabulary::score()).
+                    scores_[p.slot] += q.weight + p.weight - std::fabs(q.weight - p.weight);
+                }
+            }
+
+            for (uint32_t slot : touched_) {
+                const double score = 0.5 * scores_[slot];
+                scores_[slot] = 0.0;
+                if (score > 0.0 && accept(keyframes_[slot])) {
+                    out.push_back({keyframes_[slot], score});
+                }
+            }
+            const std::size_t n = std::min(k, out.size());
+            std::partial_sort(out.begin(), out.begin() + n, out.end(),
+                              [](const BowMatch& a, const BowMatch& b) {
+                                  return a.score > b.score ||
+                                         (a.score == b.score && a.keyframe < b.keyframe);
+                              });
+            out.resize(n);
+        }
+
+        /// The @p k keyframes most similar to @p bow.
+        std::vector<BowMatch> query(const BowVector& bow, std::size_t k) {
+            std::vector<BowMatch> out;
+            query(bow, k, [](int) { return true; }, out);
+            return out;
+        }
+
+        std::size_t size() const { return keyframes_.size(); }
+        bool empty() const { return keyframes_.empty(); }
+
+        void clear() {
+            for (auto& list : postings_) {
+                list.clear();
+            }
+            keyframes_.clear();
+            vectors_.clear();
+            slot_.clear();
+            scores_.clear();
+        }
+
+    private:
+        struct Posting {
+            uint32_t slot;  // Index into keyframes_ / vectors_.
+            float weight;   // The keyframe's weight for this word.
+        };
+
+        std::vector<std::vector<Posting>> postings_;  // Indexed by word id.
+        std::vector<int> keyframes_;
+        std::vector<BowVector> vectors_;
+        std::unordered_map<int, uint32_t> slot_;
+        std::vector<double> scores_;     // Query accumulator, all zero between queries.
+        std::vector<uint32_t> touched_;  // Slots with a non-zero accumulator.
+    };
+
+}  // namespace ar_slam
@@ -0,0 +1,469 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "core/geometry.h"
+
+/**
+ * @file bundle_adjustment.h
+ * @brief Dependency-free sparse Levenberg-Marquardt bundle adjustment.
+ *
+ * Jointly refines camera poses and 3D points by minimising robustified pixel
+ * reprojection error. The solver exploits the usual bundle-adjustment sparsity:
+ *   - analytic Jacobians per observation (6 pose + 3 point parameters);
+ *   - the point blocks of the normal equations are 3x3 block-diagonal, so they
+ *     are eliminated in closed form (Schur complement);
+ *   - the remaining reduced camera system is small (6 x free cameras) and is
+ *     solved densely with a Cholesky factorisation.
+ *
+ * Linearising and back-substituting are linear in the number of observations;
+ * the Schur build pairs up the observations of each point, so it costs
+ * O(sum over points of k_p^2) for a point seen k_p times, and the dense solve
+ * depends on the K free cameras alone. A point whose block cannot be inverted
+ * (no observation in front of a camera) is held where it is for that
+ * iteration instead of failing the step.
+ * Poses follow geometry::Pose (world-to-camera) and are updated by a
+ * left-multiplied rotation increment, R <- exp([w]x) R, t <- t + dt.
+ */
+namespace ar_slam {
+
+    /// One pixel measurement of point @ref point in camera @ref camera.
+    struct BAObservation {
+        int camera = -1;
+        int point = -1;
+        double u = 0.0;
+        double v = 0.0;
+    };
+
+    /// Cameras, points and observations to refine (modified in place).
+    struct BAProblem {
+        geometry::Mat3 K = geometry::Mat3::identity();  ///< Shared pinhole intrinsics.
+        std::vector<geometry::Pose> cameras;
+        std::vector<bool> fixed;  ///< Per camera; fixed poses anchor the gauge.
+        std::vector<geometry::Vec3> points;
+        std::vector<BAObservation> observations;
+    };
+
+    /// Tunable solver parameters.
+    struct BAConfig {
+        int max_iterations = 10;           ///< LM iterations (accepted or not).
+        double huber_px = 2.0;             ///< Huber threshold on residual norm, pixels.
+        double initial_lambda = 1e-4;      ///< Initial Marquardt damping.
+        double function_tolerance = 1e-6;  ///< Stop when relative cost decrease is below.
+    };
+
+    /// Outcome of a bundle_adjust() call.
+    struct BASummary {
+        int iterations = 0;         ///< LM iterations performed.
+        int accepted = 0;           ///< Iterations whose step reduced the cost.
+        double initial_cost = 0.0;  ///< Robust cost before optimisation.
+        double final_cost = 0.0;    ///< Robust cost after optimisation.
+        bool converged = false;     ///< True if the tolerance stopped the loop.
+    };
+
+    namespace ba_detail {
+
+        /// Rodrigues' formula: rotation matrix for the axis-angle vector @p w.
+        inline geometry::Mat3 exp_so3(const double w[3]) {
+            const double theta2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+            const double theta = std::sqrt(theta2);
+            double a, b;
+            if (theta < 1e-8) {
+                a = 1.0;
+                b = 0.5;
+            } else {
+                a = std::sin(theta) / theta;
+                b = (1.0 - std::cos(theta)) / theta2;
+            }
+            const double W[3][3] = {{0, -w[2], w[1]}, {w[2], 0, -w[0]}, {-w[1], w[0], 0}};
+            geometry::Mat3 R = geometry::Mat3::identity();
+            for (int i = 0; i < 3; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                    double W2 = W[i][0] * W[0][j] + W[i][1] * W[1][j] + W[i][2] * W[2][j];
+                    R.m[i][j] += a * W[i][j] + b * W2;
+                }
+            }
+            return R;
+        }
+
+        /// Huber cost of a residual with norm @p s (quadratic inside, linear outside).
+        inline double huber_cost(double s, double delta) {
+            return s <= delta ? s * s : 2.0 * delta * s - delta * delta;
+        }
+
+        /// IRLS weight matching huber_cost().
+        inline double huber_weight(double s, double delta) { return s <= delta ? 1.0 : delta / s; }
+
+        /// In-place Cholesky of a dense n x n SPD matrix (lower triangle). False if not PD.
+        inline bool cholesky(std::vector<double>& A, int n) {
+            for (int j = 0; j < n; ++j) {
+                double d = A[j * n + j];
+                for (int k = 0; k < j; ++k) {
+                    d -= A[j * n + k] * A[j * n + k];
+                }
+                if (d <= 1e-12) {
+                    return false;
+                }
+                d = std::sqrt(d);
+                A[j * n + j] = d;
+                for (int i = j + 1; i < n; ++i) {
+                    double s = A[i * n + j];
+                    for (int k = 0; k < j; ++k) {
+                        s -= A[i * n + k] * A[j * n + k];
+                    }
+                    A[i * n + j] = s / d;
+                }
+            }
+            return true;
+        }
+
+        /// Solve L L^T x = b given the factor from cholesky(); b is overwritten with x.
+        inline void cholesky_solve(const std::vector<double>& L, int n, std::vector<double>& b) {
+            for (int i = 0; i < n; ++i) {
+                double s = b[i];
+                for (int k = 0; k < i; ++k) {
+                    s -= L[i * n + k] * b[k];
+                }
+                b[i] = s / L[i * n + i];
+            }
+            for (int i = n - 1; i >= 0; --i) {
+                double s = b[i];
+                for (int k = i + 1; k < n; ++k) {
+                    s -= L[k * n + i] * b[k];
+                }
+                b[i] = s / L[i * n + i];
+            }
+        }
+
+        /// Inverse of a symmetric 3x3 matrix via the adjugate. False if singular.
+        inline bool invert_sym3(const double A[9], double out[9]) {
+            const double c00 = A[4] * A[8] - A[5] * A[7];
+            const double c01 = A[5] * A[6] - A[3] * A[8];
+            const double c02 = A[3] * A[7] - A[4] * A[6];
+            const double det = A[0] * c00 + A[1] * c01 + A[2] * c02;
+            if (std::fabs(det) < 1e-18) {
+                return false;
+            }
+            const double inv = 1.0 / det;
+            out[0] = c00 * inv;
+            out[1] = (A[2] * A[7] - A[1] * A[8]) * inv;
+            out[2] = (A[1] * A[5] - A[2] * A[4]) * inv;
+            out[3] = c01 * inv;
+            out[4] = (A[0] * A[8] - A[2] * A[6]) * inv;
+            out[5] = (A[2] * A[3] - A[0] * A[5]) * inv;
+            out[6] = c02 * inv;
+            out[7] = (A[1] * A[6] - A[0] * A[7]) * inv;
+            out[8] = (A[0] * A[4] - A[1] * A[3]) * inv;
+            return true;
+        }
+
+        /// Total robust reprojection cost. A point behind a camera costs a large fixed
+        /// penalty, so a step can never win by pushing points out of view.
+        inline double total_cost(const BAProblem& p,
+                                 const std::vector<geometry::Pose>& cameras,
+                                 const std::vector<geometry::Vec3>& points,
+                                 double delta) {
+            const double fx = p.K.m[0][0], fy = p.K.m[1][1];
+            const double cx = p.K.m[0][2], cy = p.K.m[1][2];
+            double cost = 0.0;
+            for (const BAObservation& o : p.observations) {
+                const geometry::Vec3 Xc = cameras[o.camera].transform(points[o.point]);
+                if (Xc[2] <= 1e-9) {
+                    cost += huber_cost(1e3, delta);
+                    continue;
+                }
+                const double ru = fx * Xc[0] / Xc[2] + cx - o.u;
+                const double rv = fy * Xc[1] / Xc[2] + cy - o.v;
+                cost += huber_cost(std::sqrt(ru * ru + rv * rv), delta);
+            }
+            return cost;
+        }
+
+    }  // namespace ba_detail
+
+    /**
+     * @brief Refine @p problem's free cameras and all points in place.
+     *
+     * Each iteration linearises every observation once, eliminates the point
+     * blocks into a dense reduced camera system, solves it, back-substitutes the
+     * point updates (a point with a singular block stays put), and accepts the
+     * step only if the robust cost decreases (otherwise the damping is raised
+     * and the step retried next iteration).
+     */
+    inline BASummary bundle_adjust(BAProblem& problem, const BAConfig& config = BAConfig{}) {
+        using ba_detail::huber_weight;
+
+        BASummary summary;
+        const std::size_t num_cams = problem.cameras.size();
+        const std::size_t num_pts = problem.points.size();
+        const std::size_t num_obs = problem.observations.size();
+        const double fx = problem.K.m[0][0], fy = problem.K.m[1][1];
+        const double cx = problem.K.m[0][2], cy = problem.K.m[1][2];
+
+        summary.initial_cost =
+            ba_detail::total_cost(problem, problem.cameras, problem.points, config.huber_px);
+        summary.final_cost = summary.initial_cost;
+        if (num_obs == 0 || num_pts == 0) {
+            summary.converged = true;
+            return summary;
+        }
+
+        // Free cameras get consecutive 6-parameter blocks in the reduced system.
+        std::vector<int> cam_block(num_cams, -1);
+        int num_free = 0;
+        for (std::size_t c = 0; c < num_cams; ++c) {
+            const bool fixed = c < problem.fixed.size() && problem.fixed[c];
+            cam_block[c] = fixed ? -1 : num_free++;
+        }
+        const int n = 6 * num_free;
+
+        // Observations grouped by point (CSR), built once.
+        std::vector<int> pt_start(num_pts + 1, 0);
+        for (const BAObservation& o : problem.observations) {
+            ++pt_start[o.point + 1];
+        }
+        for (std::size_t p = 0; p < num_pts; ++p) {
+            pt_start[p + 1] += pt_start[p];
+        }
+        std::vector<int> pt_obs(num_obs);
+        {
+            std::vector<int> fill(pt_start.begin(), pt_start.end() - 1);
+            for (std::size_t i = 0; i < num_obs; ++i) {
+                pt_obs[fill[problem.observations[i].point]++] = static_cast<int>(i);
+            }
+        }
+
+        // Per-iteration buffers, reused across iterations.
+        std::vector<double> U(static_cast<std::size_t>(num_free) * 36);
+        std::vector<double> gc(n);
+        std::vector<double> V(num_pts * 9);
+        std::vector<double> gp(num_pts * 3);
+        std::vector<double> W(num_obs * 18);  // 6x3 block per observation
+        std::vector<char> obs_valid(num_obs);
+        std::vector<double> S(static_cast<std::size_t>(n) * n);
+        std::vector<double> rhs(n);
+        std::vector<double> Vinv(num_pts * 9);
+        std::vector<char> pt_free(num_pts);  // Point block invertible this iteration
+        std::vector<double> dp(num_pts * 3);
+        std::vector<geometry::Pose> trial_cams;
+        std::vector<geometry::Vec3> trial_pts;
+
+        double lambda = config.initial_lambda;
+        double cost = summary.initial_cost;
+
+        for (int iter = 0; iter < config.max_iterations; ++iter) {
+            ++summary.iterations;
+            std::fill(U.begin(), U.end(), 0.0);
+            std::fill(gc.begin(), gc.end(), 0.0);
+            std::fill(V.begin(), V.end(), 0.0);
+            std::fill(gp.begin(), gp.end(), 0.0);
+
+            // 1. Linearise every observation and accumulate the normal equations.
+            for (std::size_t i = 0; i < num_obs; ++i) {
+                const BAObservation& o = problem.observations[i];
+                const geometry::Pose& cam = problem.cameras[o.camera];
+                const geometry::Vec3& X = problem.points[o.point];
+                const geometry::Vec3 Xr = geometry::mul(cam.R, X);
+                const double x = Xr[0] + cam.t[0], y = Xr[1] + cam.t[1], z = Xr[2] + cam.t[2];
+                obs_valid[i] = z > 1e-9;
+                if (!obs_valid[i]) {
+                    continue;
+                }
+                const double iz = 1.0 / z;
+                const double r[2] = {fx * x * iz + cx - o.u, fy * y * iz + cy - o.v};
+                const double w =
+                    huber_weight(std::sqrt(r[0] * r[0] + r[1] * r[1]), config.huber_px);
+
+                // d(u,v)/d(Xc).
+                const double Jproj[2][3] = {{fx * iz, 0.0, -fx * x * iz * iz},
+                                            {0.0, fy * iz, -fy * y * iz * iz}};
+                // Pose Jacobian: [Jproj * -[Xr]x | Jproj]; point Jacobian: Jproj * R.
+                const double negSkew[3][3] = {
+                    {0.0, Xr[2], -Xr[1]}, {-Xr[2], 0.0, Xr[0]}, {Xr[1], -Xr[0], 0.0}};
+                double Jc[2][6];
+                double Jp[2][3];
+                for (int a = 0; a < 2; ++a) {
+                    for (int k = 0; k < 3; ++k) {
+                        double sr = 0.0, sp = 0.0;
+                        for (int m = 0; m < 3; ++m) {
+                            sr += Jproj[a][m] * negSkew[m][k];
+                            sp += Jproj[a][m] * cam.R.m[m][k];
+                        }
+                        Jc[a][k] = sr;
+                        Jc[a][3 + k] = Jproj[a][k];
+                        Jp[a][k] = sp;
+                    }
+                }
+
+                double* Vp = &V[o.point * 9];
+                double* gpp = &gp[o.point * 3];
+                for (int k = 0; k < 3; ++k) {
+                    for (int m = 0; m < 3; ++m) {
+                        Vp[k * 3 + m] += w * (Jp[0][k] * Jp[0][m] + Jp[1][k] * Jp[1][m]);
+                    }
+                    gpp[k] += w * (Jp[0][k] * r[0] + Jp[1][k] * r[1]);
+                }
+
+                const int blk = cam_block[o.camera];
+                if (blk < 0) {
+                    continue;
+                }
+                double* Uc = &U[blk * 36];
+                double* Wo = &W[i * 18];
+                for (int k = 0; k < 6; ++k) {
+                    for (int m = 0; m < 6; ++m) {
+                        Uc[k * 6 + m] += w * (Jc[0][k] * Jc[0][m] + Jc[1][k] * Jc[1][m]);
+                    }
+                    for (int m = 0; m < 3; ++m) {
+                        Wo[k * 3 + m] = w * (Jc[0][k] * Jp[0][m] + Jc[1][k] * Jp[1][m]);
+                    }
+                    gc[blk * 6 + k] += w * (Jc[0][k] * r[0] + Jc[1][k] * r[1]);
+                }
+            }
+
+            // 2. Damp, eliminate the points (Schur complement), and solve for the
+            //    cameras. A non-PD reduced system just raises the damping.
+            std::fill(S.begin(), S.end(), 0.0);
+            for (int b = 0; b < num_free; ++b) {
+                for (int k = 0; k < 6; ++k) {
+                    for (int m = 0; m < 6; ++m) {
+                        S[(b * 6 + k) * n + b * 6 + m] = U[b * 36 + k * 6 + m];
+                    }
+                    S[(b * 6 + k) * n + b * 6 + k] += lambda * U[b * 36 + k * 7] + 1e-9;
+                }
+            }
+            for (int i = 0; i < n; ++i) {
+                rhs[i] = -gc[i];
+            }
+
+            for (std::size_t p = 0; p < num_pts; ++p) {
+                double Vd[9];
+                for (int k = 0; k < 9; ++k) {
+                    Vd[k] = V[p * 9 + k];
+                }
+                for (int k = 0; k < 3; ++k) {
+                    Vd[k * 4] += lambda * V[p * 9 + k * 4] + 1e-9;
+                }
+                double* Vi = &Vinv[p * 9];
+                // Unconstrained (e.g. behind every camera): treat the point as
+                // fixed this iteration, so it drops out of the Schur complement.
+                pt_free[p] = ba_detail::invert_sym3(Vd, Vi);
+                if (!pt_free[p]) {
+                    continue;
+                }
+                const double* g = &gp[p * 3];
+                for (int a = pt_start[p]; a < pt_start[p + 1]; ++a) {
+                    const int ia = pt_obs[a];
+                    const int ba = cam_block[problem.observations[ia].camera];
+                    if (ba < 0 || !obs_valid[ia]) {
+                        continue;
+                    }
+                    // T = W_a * Vinv (6x3).
+                    double T[18];
+                    const double* Wa = &W[ia * 18];
+                    for (int k = 0; k < 6; ++k) {
+                        for (int m = 0; m < 3; ++m) {
+                            T[k * 3 + m] = Wa[k * 3] * Vi[m] + Wa[k * 3 + 1] * Vi[3 + m] +
+                                           Wa[k * 3 + 2] * Vi[6 + m];
+                        }
+                        rhs[ba * 6 + k] +=
+                            T[k * 3] * g[0] + T[k * 3 + 1] * g[1] + T[k * 3 + 2] * g[2];
+                    }
+                    for (int b = pt_start[p]; b < pt_start[p + 1]; ++b) {
+                        const int ib = pt_obs[b];
+                        const int bb = cam_block[problem.observations[ib].camera];
+                        if (bb < 0 || !obs_valid[ib]) {
+                            continue;
+                        }
+                        const double* Wb = &W[ib * 18];
+                        for (int k = 0; k < 6; ++k) {
+                            double* Srow = &S[(ba * 6 + k) * n + bb * 6];
+                            for (int m = 0; m < 6; ++m) {
+                                Srow[m] -= T[k * 3] * Wb[m * 3] + T[k * 3 + 1] * Wb[m * 3 + 1] +
+                                           T[k * 3 + 2] * Wb[m * 3 + 2];
+                            }
+                        }
+                    }
+                }
+            }
+            if (n > 0 && !ba_detail::cholesky(S, n)) {
+                lambda *= 10.0;
+                continue;
+            }
+            if (n > 0) {
+                ba_detail::cholesky_solve(S, n, rhs);
+            }
+
+            // 3. Back-substitute: dp = Vinv * (-gp - W^T dc).
+            for (std::size_t p = 0; p < num_pts; ++p) {
+                if (!pt_free[p]) {
+                    dp[p * 3] = dp[p * 3 + 1] = dp[p * 3 + 2] = 0.0;
+                    continue;
+                }
+                double b[3] = {-gp[p * 3], -gp[p * 3 + 1], -gp[p * 3 + 2]};
+                for (int a = pt_start[p]; a < pt_start[p + 1]; ++a) {
+                    const int ia = pt_obs[a];
+                    const int blk = cam_block[problem.observations[ia].camera];
+                    if (blk < 0 || !obs_valid[ia]) {
+                        continue;
+                    }
+                    const double* Wa = &W[ia * 18];
+                    for (int m = 0; m < 3; ++m) {
+                        for (int k = 0; k < 6; ++k) {
+                            b[m] -= Wa[k * 3 + m] * rhs[blk * 6 + k];
+                        }
+                    }
+                }
+                const double* Vi = &Vinv[p * 9];
+                for (int m = 0; m < 3; ++m) {
+                    dp[p * 3 + m] = Vi[m * 3] * b[0] + Vi[m * 3 + 1] * b[1] + Vi[m * 3 + 2] * b[2];
+                }
+            }
+
+            // 4. Try the step; keep it only if the robust cost went down.
+            trial_cams = problem.cameras;
+            trial_pts = problem.points;
+            for (std::size_t c = 0; c < num_cams; ++c) {
+                const int blk = cam_block[c];
+                if (blk < 0) {
+                    continue;
+                }
+                const double* d = &rhs[blk * 6];
+                geometry::Pose& pose = trial_cams[c];
+                pose.R = geometry::mul(ba_detail::exp_so3(d), pose.R);
+                for (int k = 0; k < 3; ++k) {
+                    pose.t[k] += d[3 + k];
+                }
+            }
+            for (std::size_t p = 0; p < num_pts; ++p) {
+                for (int k = 0; k < 3; ++k) {
+                    trial_pts[p][k] += dp[p * 3 + k];
+                }
+            }
+
+            const double new_cost =
+                ba_detail::total_cost(problem, trial_cams, trial_pts, config.huber_px);
+            if (new_cost < cost) {
+                const double decrease = (cost - new_cost) / std::max(cost, 1e-12);
+                problem.cameras.swap(trial_cams);
+                problem.points.swap(trial_pts);
+                cost = new_cost;
+                ++summary.accepted;
+                lambda = std::max(lambda * 0.1, 1e-10);
+                if (decrease < config.function_tolerance) {
+                    summary.converged = true;
+                    break;
+                }
+            } else {
+                lambda *= 10.0;
+            }
+        }
+
+        summary.final_cost = cost;
+        return summary;
+    }
+
+}  // namespace ar_slam
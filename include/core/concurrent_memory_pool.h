@@ -0,0 +1,287 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace ar_slam {
+
+    /**
+     * @brief Thread-safe, lock-free counterpart of MemoryPool<T>.
+     *
+     * Same contract and API as MemoryPool: one contiguous, over-aligned slab
+     * sized from a byte budget, O(1) allocate()/deallocate(), a hard capacity,
+     * and create()/destroy() for construction. Any thread may allocate and any
+     * thread may deallocate, including a slot allocated by another thread.
+     *
+     * The free-list is a Treiber stack whose head is a single 64-bit word
+     * holding the top slot's index and a tag bumped by every push and pop.
+     * Because slots live in one slab, an index stands in for the pointer, which
+     * leaves 32 bits for the tag in a word every 64-bit target can
+     * compare-and-swap without a double-width CAS. The tag makes the pop's CAS
+     * fail if the head was popped and pushed back in between (ABA). Each slot's
+     * successor is kept in a side array of atomics rather than inside the free
+     * slot, so a thread reading a stale successor never races with the object a
+     * faster thread has already constructed there.
+     *
+     * allocate_batch()/deallocate_batch() move a whole run of slots with one
+     * CAS, for caching layers such as MagazinePool.
+     *
+     * used() and friends are relaxed counters: exact when the pool is quiescent,
+     * approximate while other threads are allocating. Moving a pool is not
+     * thread-safe; do it before sharing the pool.
+     *
+     * @tparam T Object type stored in the pool.
+     */
+    template <typename T>
+    class ConcurrentMemoryPool {
+    public:
+        /**
+         * @brief Construct a pool whose slab and free-list links fit within @p max_bytes.
+         * @param max_bytes Storage budget in bytes (default 256 MiB). The realised
+         *                  capacity is floor(max_bytes / (slot_size + 4)) objects,
+         *                  at least one and at most 2^32 - 2.
+         */
+        explicit ConcurrentMemoryPool(std::size_t max_bytes = 256ull * 1024 * 1024)
+            : capacity_(max_bytes / (sizeof(Slot) + sizeof(Link))) {
+            if (capacity_ == 0) {
+                capacity_ = 1;  // Always provide room for at least one object.
+            }
+            if (capacity_ > kMaxCapacity) {
+                capacity_ = kMaxCapacity;
+            }
+            slots_ = static_cast<Slot*>(
+                ::operator new(capacity_ * sizeof(Slot), std::align_val_t{kAlign}));
+            links_ = new Link[capacity_];
+
+            // Thread every slot onto the free-list, front to back.
+            for (std::size_t i = 0; i + 1 < capacity_; ++i) {
+                links_[i].store(static_cast<uint32_t>(i + 1), std::memory_order_relaxed);
+            }
+            links_[capacity_ - 1].store(kNil, std::memory_order_relaxed);
+            head_.store(pack(0, 0), std::memory_order_release);
+        }
+
+        ~ConcurrentMemoryPool() { release(); }
+
+        ConcurrentMemoryPool(const ConcurrentMemoryPool&) = delete;
+        ConcurrentMemoryPool& operator=(const ConcurrentMemoryPool&) = delete;
+
+        ConcurrentMemoryPool(ConcurrentMemoryPool&& other) noexcept { steal(other); }
+
+        ConcurrentMemoryPool& operator=(ConcurrentMemoryPool&& other) noexcept {
+            if (this != &other) {
+                release();
+                steal(other);
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Reserve one slot of raw, uninitialised storage.
+         * @return Pointer to storage for a T, or nullptr if the pool is exhausted.
+         */
+        T* allocate() noexcept {
+            uint64_t head = head_.load(std::memory_order_acquire);
+            for (;;) {
+                const uint32_t top = index_of(head);
+                if (top == kNil) {
+                    return nullptr;
+                }
+                // May be stale if another thread pops top first; the tag then
+                // fails the CAS and the value is discarded.
+                const uint32_t next = links_[top].load(std::memory_order_relaxed);
+                if (head_.compare_exchange_weak(head, pack(tag_of(head) + 1, next),
+                                                std::memory_order_acquire,
+                                                std::memory_order_acquire)) {
+                    used_.fetch_add(1, std::memory_order_relaxed);
+                    return reinterpret_cast<T*>(&slots_[top]);
+                }
+            }
+        }
+
+        /**
+         * @brief Return a slot obtained from allocate() to the free-list.
+         * @param ptr Pointer previously returned by allocate()/create() (on any
+         *            thread); nullptr is ignored. Does not call the destructor.
+         */
+        void deallocate(T* ptr) noexcept {
+            if (ptr == nullptr) {
+                return;
+            }
+            const uint32_t index = index_of_slot(ptr);
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            do {
+                links_[index].store(index_of(head), std::memory_order_relaxed);
+            } while (!head_.compare_exchange_weak(head, pack(tag_of(head) + 1, index),
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+            used_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Pop up to @p n slots with a single CAS.
+         *
+         * The chain below the head is walked from one snapshot; the tag check
+         * guarantees nothing was pushed or popped meanwhile, so the walk saw a
+         * consistent list.
+         * @return Number of slots written to @p out (0 if the pool is exhausted).
+         */
+        std::size_t allocate_batch(T** out, std::size_t n) noexcept {
+            if (n == 0) {
+                return 0;
+            }
+            uint64_t head = head_.load(std::memory_order_acquire);
+            for (;;) {
+                uint32_t next = index_of(head);
+                std::size_t count = 0;
+                while (count < n && next != kNil) {
+                    out[count++] = reinterpret_cast<T*>(&slots_[next]);
+                    next = links_[next].load(std::memory_order_relaxed);
+                }
+                if (count == 0) {
+                    return 0;
+                }
+                if (head_.compare_exchange_weak(head, pack(tag_of(head) + 1, next),
+                                                std::memory_order_acquire,
+                                                std::memory_order_acquire)) {
+                    used_.fetch_add(count, std::memory_order_relaxed);
+                    return count;
+                }
+            }
+        }
+
+        /**
+         * @brief Push @p n slots back with a single CAS.
+         * @param ptrs Non-null pointers previously returned by this pool.
+         */
+        void deallocate_batch(T* const* ptrs, std::size_t n) noexcept {
+            if (n == 0) {
+                return;
+            }
+            // Chain the batch privately, then splice it on top of the list.
+            for (std::size_t i = 0; i + 1 < n; ++i) {
+                links_[index_of_slot(ptrs[i])].store(index_of_slot(ptrs[i + 1]),
+                                                     std::memory_order_relaxed);
+            }
+            const uint32_t first = index_of_slot(ptrs[0]);
+            const uint32_t last = index_of_slot(ptrs[n - 1]);
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            do {
+                links_[last].store(index_of(head), std::memory_order_relaxed);
+            } while (!head_.compare_exchange_weak(head, pack(tag_of(head) + 1, first),
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+            used_.fetch_sub(n, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Allocate a slot and construct a T in place.
+         * @return Pointer to the constructed object, or nullptr if the pool is full.
+         *         If the constructor throws, the slot is returned to the pool and
+         *         the exception propagates.
+         */
+        template <typename... Args>
+        T* create(Args&&... args) {
+            T* storage = allocate();
+            if (storage == nullptr) {
+                return nullptr;
+            }
+            try {
+                return ::new (storage) T(std::forward<Args>(args)...);
+            } catch (...) {
+                deallocate(storage);
+                throw;
+            }
+        }
+
+        /**
+         * @brief Destroy an object created with create() and reclaim its slot.
+         */
+        void destroy(T* ptr) noexcept {
+            if (ptr == nullptr) {
+                return;
+            }
+            ptr->~T();
+            deallocate(ptr);
+        }
+
+        /// Maximum number of objects the pool can hold.
+        std::size_t capacity() const noexcept { return capacity_; }
+
+        /// Number of slots currently handed out.
+        std::size_t used() const noexcept { return used_.load(std::memory_order_relaxed); }
+
+        /// Number of slots still available.
+        std::size_t available() const noexcept { return capacity_ - used(); }
+
+        /// True when no further allocations can succeed.
+        bool full() const noexcept { return used() == capacity_; }
+
+        /// Bytes currently in use by live objects.
+        std::size_t get_usage() const noexcept { return used() * sizeof(T); }
+
+        /// Total bytes reserved by the backing slab and its free-list links.
+        std::size_t capacity_bytes() const noexcept {
+            return capacity_ * (sizeof(Slot) + sizeof(Link));
+        }
+
+        /// True if @p ptr points into this pool's slab.
+        bool owns(const T* ptr) const noexcept {
+            const auto* p = reinterpret_cast<const Slot*>(ptr);
+            return p >= slots_ && p < slots_ + capacity_;
+        }
+
+    private:
+        union Slot {
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+        using Link = std::atomic<uint32_t>;
+
+        static constexpr uint32_t kNil = 0xffffffffu;  ///< Empty list / end of list.
+        static constexpr std::size_t kMaxCapacity = kNil - 1;
+        static constexpr std::size_t kAlign = alignof(Slot);
+        static constexpr std::size_t kCacheLine = 64;
+
+        static constexpr uint64_t pack(uint32_t tag, uint32_t index) {
+            return (static_cast<uint64_t>(tag) << 32) | index;
+        }
+        static constexpr uint32_t tag_of(uint64_t head) {
+            return static_cast<uint32_t>(head >> 32);
+        }
+        static constexpr uint32_t index_of(uint64_t head) { return static_cast<uint32_t>(head); }
+        uint32_t index_of_slot(const T* ptr) const {
+            return static_cast<uint32_t>(reinterpret_cast<const Slot*>(ptr) - slots_);
+        }
+
+        void release() noexcept {
+            if (slots_ != nullptr) {
+                ::operator delete(slots_, std::align_val_t{kAlign});
+            }
+            delete[] links_;
+        }
+
+        void steal(ConcurrentMemoryPool& other) noexcept {
+            slots_ = other.slots_;
+            links_ = other.links_;
+            capacity_ = other.capacity_;
+            head_.store(other.head_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            used_.store(other.used_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            other.slots_ = nullptr;
+            other.links_ = nullptr;
+            other.capacity_ = 0;
+            other.head_.store(pack(0, kNil), std::memory_order_relaxed);
+            other.used_.store(0, std::memory_order_relaxed);
+        }
+
+        Slot* slots_ = nullptr;
+        Link* links_ = nullptr;  ///< Successor of each free slot, by index.
+        std::size_t capacity_ = 0;
+
+        alignas(kCacheLine) std::atomic<uint64_t> head_{pack(0, kNil)};  ///< Tag << 32 | top.
+        alignas(kCacheLine) std::atomic<std::size_t> used_{0};
+    };
+
+}  // namespace ar_slam
@@ -1,18 +1,32 @@
 #pragma once
 #include "core/frame.h"
+#include "core/relocalizer.h"
 #include <opencv2/opencv.hpp>
+#include <memory_resource>
 #include <vector>
 
 namespace ar_slam {
 
+    // Per-frame output. Its arrays come from the memory resource passed to
+    // track_features() (the default heap resource unless a FrameArena is given),
+    // so with an arena they are valid only until that arena is reset.
     struct TrackingResult {
-        std::vector<cv::Point2f> prev_points;
-        std::vector<cv::Point2f> curr_points;
-        std::vector<int> track_ids;
-        std::vector<bool> inliers;
+        explicit TrackingResult(
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : prev_points(resource),
+              curr_points(resource),
+              track_ids(resource),
+              inliers(resource) {}
+
+        std::pmr::vector<cv::Point2f> prev_points;
+        std::pmr::vector<cv::Point2f> curr_points;
+        std::pmr::vector<int> track_ids;
+        std::pmr::vector<bool> inliers;
         int num_tracked = 0;
         int num_inliers = 0;
         float tracking_quality = 0.0f;
+        bool relocalized = false;  // Re-detected features re-attached to map landmarks
+        int relocalized_tracks = 0;
     };
 
     class FeatureTracker {
@@ -21,19 +35,32 @@ namespace ar_slam {
         std::vector<cv::Point2f> prev_points_;
         std::vector<int> track_ids_;
         int next_track_id_ = 0;
+        const Relocalizer* relocalizer_ = nullptr;
 
         // Optical flow parameters
         cv::Size win_size_{21, 21};
         int max_level_{3};
 
+        // Start fresh tracks on a newly extracted frame, re-attaching landmark ids
+        // when the relocalizer recognises the features
+        void start_tracks(const Frame::Ptr& frame, TrackingResult& result);
+
     public:
         FeatureTracker() = default;
 
-        // Main tracking function
-        TrackingResult track_features(Frame::Ptr current_frame);
+        // Main tracking function. The result and every per-frame temporary
+        // (flow status and error, inlier lists) are allocated from `scratch`,
+        // typically a FrameArena reset once per frame; nullptr uses the heap.
+        // State carried to the next frame never lives in `scratch`.
+        TrackingResult track_features(Frame::Ptr current_frame,
+                                      std::pmr::memory_resource* scratch = nullptr);
 
         // Reset tracker
         void reset();
+
+        // Relocalize re-detected features against the map instead of giving them
+        // fresh ids (nullptr disables). Not owned; must outlive the tracker's use.
+        void set_relocalizer(const Relocalizer* relocalizer) { relocalizer_ = relocalizer; }
     };
 
 }  // namespace ar_slam
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <vector>
 #include <chrono>
 #include <iostream>
+#include <mutex>
+
+#include "core/shared_pool.h"
 
 namespace ar_slam {
 
@@ -24,6 +27,17 @@ namespace ar_slam {
         using Ptr = std::shared_ptr<Frame>;
         using Timestamp = std::chrono::steady_clock::time_point;
 
+        /// Layout of an image handed to the constructors.
+        enum class PixelFormat {
+            kGray,  ///< CV_8UC1.
+            kBGR,   ///< CV_8UC3.
+            kYUYV,  ///< Packed 4:2:2, Y0 U Y1 V: CV_8UC2, one element per pixel.
+            kUYVY,  ///< Packed 4:2:2, U Y0 V Y1: CV_8UC2.
+            kNV12,  ///< Y plane, then interleaved UV at half size: CV_8UC1, height * 3 / 2 rows.
+            kI420,  ///< Y, U and V planes: CV_8UC1, height * 3 / 2 rows, unpadded rows.
+            kBGRA,  ///< CV_8UC4; alpha is ignored.
+        };
+
         // Public members for simplicity (in production, use getters)
         std::vector<cv::KeyPoint> keypoints_;
         cv::Mat descriptors_;
@@ -34,7 +48,11 @@ namespace ar_slam {
         uint64_t id_;
         Timestamp timestamp_;
         cv::Mat image_gray_;
-        cv::Mat image_rgb_;
+        PixelFormat format_ = PixelFormat::kGray;
+        cv::Mat source_;                      // YUV input, kept for the colour image
+        std::shared_ptr<const void> buffer_;  // Capture buffer the images borrow, if any
+        mutable std::once_flag color_once_;
+        mutable cv::Mat image_rgb_;           // BGR, converted on first request
 
         // Camera parameters
         cv::Mat K_;            // Intrinsic matrix
@@ -50,9 +68,61 @@ namespace ar_slam {
         explicit Frame(const cv::Mat& image,
                        const Timestamp& timestamp = std::chrono::steady_clock::now());
 
+        /**
+         * @brief Wrap @p image without copying its pixels.
+         *
+         * The frame keeps a header onto @p image and holds @p buffer, which
+         * keeps that memory valid, until it is destroyed; a capture buffer is
+         * handed back to the driver then. A single-channel image becomes the
+         * frame's grayscale image as is; three and four channels are taken as
+         * BGR and BGRA and converted, and only the grayscale copy is allocated.
+         * Two channels could be YUYV or UYVY, so they are not guessed: pass the
+         * format. Without it the frame is left empty (get_image().empty()).
+         */
+        Frame(const cv::Mat& image, std::shared_ptr<const void> buffer,
+              const Timestamp& timestamp = std::chrono::steady_clock::now());
+
+        /**
+         * @brief Take the luma of a YUV (or gray, or BGR) @p image, borrowing it.
+         *
+         * The tracker only reads luma, so nothing else is converted up front:
+         * NV12 and I420 lend their Y plane as the grayscale image with no copy,
+         * and YUYV/UYVY cost one strided pass that picks out every other byte.
+         * The image stays referenced (with @p buffer, as above) so that
+         * get_color_image() can convert it if colour is ever asked for. An image
+         * whose channel count does not fit @p format leaves the frame empty.
+         */
+        Frame(const cv::Mat& image, PixelFormat format,
+              std::shared_ptr<const void> buffer = nullptr,
+              const Timestamp& timestamp = std::chrono::steady_clock::now());
+
+        /**
+         * @brief Construct a frame in a slot of @p pool rather than on the heap.
+         * @return The frame (an ordinary Ptr, releasable on any thread), or nullptr
+         *         when every slot is taken.
+         */
+        static Ptr create(SharedPool<Frame>& pool, const cv::Mat& image,
+                          const Timestamp& timestamp = std::chrono::steady_clock::now());
+
+        /// As above, borrowing @p image as Frame(image, buffer, timestamp) does.
+        static Ptr create(SharedPool<Frame>& pool, const cv::Mat& image,
+                          std::shared_ptr<const void> buffer,
+                          const Timestamp& timestamp = std::chrono::steady_clock::now());
+
+        /// As above, from a YUV image as Frame(image, format, buffer, timestamp) does.
+        static Ptr create(SharedPool<Frame>& pool, const cv::Mat& image, PixelFormat format,
+                          std::shared_ptr<const void> buffer = nullptr,
+                          const Timestamp& timestamp = std::chrono::steady_clock::now());
+
         // Getters
         uint64_t get_id() const { return id_; }
+        const Timestamp& get_timestamp() const { return timestamp_; }
         const cv::Mat& get_image() const { return image_gray_; }
+        bool borrows_image() const { return buffer_ != nullptr; }
+        PixelFormat get_source_format() const { return format_; }
+
+        /// BGR image; converted from the source on the first call (thread-safe).
+        const cv::Mat& get_color_image() const;
         const std::vector<Feature>& get_features() const { return features_; }
 
         // Feature extraction
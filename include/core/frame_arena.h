@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace ar_slam {
+
+    /**
+     * @brief Per-frame bump allocator, usable as a std::pmr::memory_resource.
+     *
+     * A frame's temporaries (optical-flow status, inlier lists, triangulation
+     * scratch) all die together at the end of the frame. Giving them to one
+     * arena replaces hundreds of malloc/free pairs with pointer bumps inside a
+     * single contiguous block, and reset() then drops the whole frame at once:
+     * deallocation is a no-op, nothing is freed individually.
+     *
+     * When a frame needs more than the block holds, further requests are served
+     * from overflow chunks taken from the upstream resource, and the next
+     * reset() frees them and regrows the block to the largest frame seen so far
+     * (rounded up to a power of two). After a warm-up frame or two, every frame
+     * fits in the block and the arena never calls upstream again.
+     *
+     * Not thread-safe: give each thread (tracking, mapping) its own arena.
+     * Containers allocated from the arena must not be used after reset().
+     */
+    class FrameArena : public std::pmr::memory_resource {
+    public:
+        /**
+         * @param initial_bytes Size of the first block (may be 0: grown on first reset()).
+         * @param upstream      Source of the block and of overflow chunks.
+         */
+        explicit FrameArena(std::size_t initial_bytes = std::size_t{1} << 20,
+                            std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+            : upstream_(upstream) {
+            grow_block(initial_bytes);
+        }
+
+        ~FrameArena() override {
+            release_chunks();
+            if (block_ != nullptr) {
+                upstream_->deallocate(block_, capacity_, kBlockAlign);
+            }
+        }
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        /// Start a new frame: everything allocated since the last reset() is gone.
+        void reset() {
+            high_water_ = std::max(high_water_, used_);
+            const bool overflowed = chunks_ != nullptr;
+            release_chunks();
+            if (overflowed && high_water_ > capacity_) {
+                std::size_t bytes = 4096;
+                while (bytes < high_water_) {
+                    bytes <<= 1;
+                }
+                if (block_ != nullptr) {
+                    upstream_->deallocate(block_, capacity_, kBlockAlign);
+                    block_ = nullptr;
+                    capacity_ = 0;
+                }
+                grow_block(bytes);
+            }
+            cursor_ = block_;
+            end_ = block_ + capacity_;
+            used_ = 0;
+            overflows_ = 0;
+        }
+
+        /// Bytes handed out since the last reset(), including alignment padding.
+        std::size_t used() const { return used_; }
+
+        /// Size of the contiguous block.
+        std::size_t capacity() const { return capacity_; }
+
+        /// Largest used() seen at a reset().
+        std::size_t high_water() const { return std::max(high_water_, used_); }
+
+        /// Overflow chunks taken from upstream since the last reset().
+        std::size_t overflows() const { return overflows_; }
+
+    private:
+        static constexpr std::size_t kBlockAlign = alignof(std::max_align_t);
+
+        /// Header at the start of each overflow chunk.
+        struct Chunk {
+            Chunk* next;
+            std::size_t bytes;
+        };
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            for (;;) {
+                const auto cursor = reinterpret_cast<std::uintptr_t>(cursor_);
+                const std::uintptr_t aligned = (cursor + alignment - 1) & ~(alignment - 1);
+                if (cursor_ != nullptr &&
+                    aligned + bytes <= reinterpret_cast<std::uintptr_t>(end_)) {
+                    used_ += aligned + bytes - cursor;
+                    cursor_ = reinterpret_cast<unsigned char*>(aligned + bytes);
+                    return reinterpret_cast<void*>(aligned);
+                }
+                add_chunk(bytes + alignment);
+            }
+        }
+
+        void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        void grow_block(std::size_t bytes) {
+            if (bytes > 0) {
+                block_ = static_cast<unsigned char*>(upstream_->allocate(bytes, kBlockAlign));
+                capacity_ = bytes;
+            }
+            cursor_ = block_;
+            end_ = block_ + capacity_;
+        }
+
+        void add_chunk(std::size_t min_bytes) {
+            // At least the block's size, so a long overflowing frame takes few chunks.
+            const std::size_t bytes = sizeof(Chunk) + std::max(min_bytes, capacity_);
+            auto* chunk = static_cast<Chunk*>(upstream_->allocate(bytes, kBlockAlign));
+            chunk->next = chunks_;
+            chunk->bytes = bytes;
+            chunks_ = chunk;
+            ++overflows_;
+            cursor_ = reinterpret_cast<unsigned char*>(chunk + 1);
+            end_ = reinterpret_cast<unsigned char*>(chunk) + bytes;
+        }
+
+        void release_chunks() {
+            while (chunks_ != nullptr) {
+                Chunk* next = chunks_->next;
+                upstream_->deallocate(chunks_, chunks_->bytes, kBlockAlign);
+                chunks_ = next;
+            }
+        }
+
+        std::pmr::memory_resource* upstream_;
+        unsigned char* block_ = nullptr;
+        std::size_t capacity_ = 0;
+        unsigned char* cursor_ = nullptr;  // Next free byte of the current region.
+        unsigned char* end_ = nullptr;     // End of the current region (block or chunk).
+        Chunk* chunks_ = nullptr;          // Overflow chunks, newest first.
+        std::size_t used_ = 0;
+        std::size_t high_water_ = 0;
+        std::size_t overflows_ = 0;
+    };
+
+}  // namespace ar_slam
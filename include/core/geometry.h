@@ -3,6 +3,7 @@
 #include <array>
 #include <cmath>
 #include <cstddef>
+#include <vector>
 
 /**
  * @file geometry.h
@@ -11,9 +12,11 @@
  * This header implements the structure-from-motion math used by the
  * reconstruction front-end without pulling in OpenCV or Eigen, which keeps the
  * core algorithms unit-testable in isolation. It provides:
- *   - small fixed-size matrix/vector types (Mat3, Mat34, Vec3);
+ *   - small fixed-size matrix/vector types (Mat3, Mat34, Vec3), rigid poses and
+ *     similarity transforms, with closed-form similarity alignment (Horn);
  *   - a Jacobi eigen-decomposition for 4x4 symmetric matrices;
- *   - linear (DLT) triangulation of a 3D point from two calibrated views.
+ *   - linear (DLT) triangulation of a 3D point from two calibrated views, and a
+ *     batched Gauss-Newton refinement of such points on reprojection error.
  *
  * Conventions follow Hartley & Zisserman, "Multiple View Geometry": a camera
  * projects a homogeneous world point X to an image point via x ~ P X, with
@@ -39,6 +42,111 @@ namespace ar_slam::geometry {
         double m[3][4] = {{0}};
     };
 
+    /// Matrix product A * B.
+    inline Mat3 mul(const Mat3& A, const Mat3& B) {
+        Mat3 r;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                r.m[i][j] = A.m[i][0] * B.m[0][j] + A.m[i][1] * B.m[1][j] + A.m[i][2] * B.m[2][j];
+            }
+        }
+        return r;
+    }
+
+    /// Matrix-vector product A * x.
+    inline Vec3 mul(const Mat3& A, const Vec3& x) {
+        return {A.m[0][0] * x[0] + A.m[0][1] * x[1] + A.m[0][2] * x[2],
+                A.m[1][0] * x[0] + A.m[1][1] * x[1] + A.m[1][2] * x[2],
+                A.m[2][0] * x[0] + A.m[2][1] * x[1] + A.m[2][2] * x[2]};
+    }
+
+    /// Transpose of a 3x3 matrix (the inverse, for rotations).
+    inline Mat3 transpose(const Mat3& A) {
+        Mat3 r;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                r.m[i][j] = A.m[j][i];
+            }
+        }
+        return r;
+    }
+
+    /**
+     * @brief Rigid world-to-camera transform, X_cam = R * X_world + t.
+     *
+     * Same convention as ReconstructionResult: a keyframe's pose maps world
+     * points into that keyframe's camera frame.
+     */
+    struct Pose {
+        Mat3 R = Mat3::identity();
+        Vec3 t{0.0, 0.0, 0.0};
+
+        /// Map a world point into this pose's camera frame.
+        Vec3 transform(const Vec3& X) const {
+            Vec3 r = mul(R, X);
+            return {r[0] + t[0], r[1] + t[1], r[2] + t[2]};
+        }
+
+        /// The camera-to-world transform.
+        Pose inverse() const {
+            Pose inv;
+            inv.R = transpose(R);
+            Vec3 c = mul(inv.R, t);
+            inv.t = {-c[0], -c[1], -c[2]};
+            return inv;
+        }
+
+        /// Camera centre in world coordinates, C = -R^T t.
+        Vec3 center() const { return inverse().t; }
+    };
+
+    /// Composition a * b: first apply @p b, then @p a.
+    inline Pose compose(const Pose& a, const Pose& b) {
+        Pose r;
+        r.R = mul(a.R, b.R);
+        r.t = a.transform(b.t);
+        return r;
+    }
+
+    /**
+     * @brief Similarity transform X' = s * R * X + t (rotation, translation, scale).
+     *
+     * Monocular maps are only defined up to scale and accumulate scale drift, so
+     * loop closure relates and corrects keyframes with similarities rather than
+     * rigid poses. A Pose is the s = 1 special case.
+     */
+    struct Sim3 {
+        Mat3 R = Mat3::identity();
+        Vec3 t{0.0, 0.0, 0.0};
+        double s = 1.0;
+
+        Sim3() = default;
+        explicit Sim3(const Pose& pose) : R(pose.R), t(pose.t) {}
+
+        Vec3 transform(const Vec3& X) const {
+            Vec3 r = mul(R, X);
+            return {s * r[0] + t[0], s * r[1] + t[1], s * r[2] + t[2]};
+        }
+
+        Sim3 inverse() const {
+            Sim3 inv;
+            inv.s = 1.0 / s;
+            inv.R = transpose(R);
+            Vec3 c = mul(inv.R, t);
+            inv.t = {-inv.s * c[0], -inv.s * c[1], -inv.s * c[2]};
+            return inv;
+        }
+    };
+
+    /// Composition a * b: first apply @p b, then @p a.
+    inline Sim3 compose(const Sim3& a, const Sim3& b) {
+        Sim3 r;
+        r.s = a.s * b.s;
+        r.R = mul(a.R, b.R);
+        r.t = a.transform(b.t);
+        return r;
+    }
+
     /// Build a projection matrix P = K [R | t].
     inline Mat34 make_projection(const Mat3& K, const Mat3& R, const Vec3& t) {
         // Rt = [R | t] (3x4)
@@ -157,6 +265,83 @@ namespace ar_slam::geometry {
         return out;
     }
 
+    /**
+     * @brief Closed-form similarity aligning point set @p a onto @p b.
+     *
+     * Minimises sum |b_i - (s R a_i + t)|^2 with Horn's unit-quaternion method:
+     * the rotation is the dominant eigenvector of a 4x4 symmetric matrix built
+     * from the centred cross-covariance, so it reuses symmetric_eig4().
+     *
+     * @return false if fewer than three points are given or @p a is degenerate.
+     */
+    inline bool align_sim3(const Vec3* a, const Vec3* b, std::size_t n, Sim3& out) {
+        if (n < 3) {
+            return false;
+        }
+        Vec3 ca{0, 0, 0}, cb{0, 0, 0};
+        for (std::size_t i = 0; i < n; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                ca[k] += a[i][k] / n;
+                cb[k] += b[i][k] / n;
+            }
+        }
+        double S[3][3] = {{0}};  // Cross-covariance sum of a'_i b'_i^T.
+        double var_a = 0.0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const Vec3 pa{a[i][0] - ca[0], a[i][1] - ca[1], a[i][2] - ca[2]};
+            const Vec3 pb{b[i][0] - cb[0], b[i][1] - cb[1], b[i][2] - cb[2]};
+            for (int r = 0; r < 3; ++r) {
+                for (int c = 0; c < 3; ++c) {
+                    S[r][c] += pa[r] * pb[c];
+                }
+                var_a += pa[r] * pa[r];
+            }
+        }
+        if (var_a < 1e-12) {
+            return false;
+        }
+
+        const double xx = S[0][0], xy = S[0][1], xz = S[0][2];
+        const double yx = S[1][0], yy = S[1][1], yz = S[1][2];
+        const double zx = S[2][0], zy = S[2][1], zz = S[2][2];
+        const double N[4][4] = {{xx + yy + zz, yz - zy, zx - xz, xy - yx},
+                                {yz - zy, xx - yy - zz, xy + yx, zx + xz},
+                                {zx - xz, xy + yx, -xx + yy - zz, yz + zy},
+                                {xy - yx, zx + xz, yz + zy, -xx - yy + zz}};
+        Eigen4 eig = symmetric_eig4(N);
+        int largest = 0;
+        for (int i = 1; i < 4; ++i) {
+            if (eig.values[i] > eig.values[largest]) {
+                largest = i;
+            }
+        }
+        const double w = eig.vectors[0][largest], x = eig.vectors[1][largest],
+                     y = eig.vectors[2][largest], z = eig.vectors[3][largest];
+        Mat3 R;
+        R.m[0][0] = 1 - 2 * (y * y + z * z);
+        R.m[0][1] = 2 * (x * y - w * z);
+        R.m[0][2] = 2 * (x * z + w * y);
+        R.m[1][0] = 2 * (x * y + w * z);
+        R.m[1][1] = 1 - 2 * (x * x + z * z);
+        R.m[1][2] = 2 * (y * z - w * x);
+        R.m[2][0] = 2 * (x * z - w * y);
+        R.m[2][1] = 2 * (y * z + w * x);
+        R.m[2][2] = 1 - 2 * (x * x + y * y);
+
+        // Scale: projection of b' onto R a', over the spread of a'.
+        double dot = 0.0;
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                dot += R.m[r][c] * S[c][r];
+            }
+        }
+        out.R = R;
+        out.s = dot / var_a;
+        const Vec3 rc = mul(R, ca);
+        out.t = {cb[0] - out.s * rc[0], cb[1] - out.s * rc[1], cb[2] - out.s * rc[2]};
+        return out.s > 0.0;
+    }
+
     /// Result of triangulating a single correspondence.
     struct TriangulationResult {
         Vec3 point{};        ///< 3D point in the world frame of P1.
@@ -234,4 +419,224 @@ namespace ar_slam::geometry {
         return result;
     }
 
+    /// Options for refine_points().
+    struct PointRefineOptions {
+        int iterations = 3;        ///< Gauss-Newton steps per point.
+        double pixel_sigma = 1.0;  ///< Observation noise (px) that scales the covariance.
+    };
+
+    /// Per-point output of refine_points().
+    struct PointRefinement {
+        double covariance[3][3] = {};  ///< sigma^2 (J^T J)^-1 at the refined point.
+        double rms = 0.0;              ///< Reprojection RMS over all views (px).
+        bool valid = false;  ///< In front of every camera, with well-conditioned normal equations.
+    };
+
+    namespace refine_detail {
+
+        /// Points refined together; every lane loop below is straight-line code.
+        constexpr std::size_t kLanes = 8;
+
+        /// Normal equations H = J^T J, g = J^T r of a block of points (SoA).
+        struct Normal {
+            double h00[kLanes], h01[kLanes], h02[kLanes], h11[kLanes], h12[kLanes], h22[kLanes];
+            double g0[kLanes], g1[kLanes], g2[kLanes];
+            double cost[kLanes];   ///< Sum of squared residuals.
+            double front[kLanes];  ///< 1 if in front of every camera, else 0.
+        };
+
+        /// Linearise the reprojection error of points (x, y, z) over all views.
+        /// @p obs holds, per view, kLanes u values followed by kLanes v values.
+        inline void linearise(const Mat34* cameras, std::size_t views, const double* obs,
+                              const double* x, const double* y, const double* z, Normal& n) {
+            for (std::size_t j = 0; j < kLanes; ++j) {
+                n.h00[j] = n.h01[j] = n.h02[j] = n.h11[j] = n.h12[j] = n.h22[j] = 0.0;
+                n.g0[j] = n.g1[j] = n.g2[j] = n.cost[j] = 0.0;
+                n.front[j] = 1.0;
+            }
+            for (std::size_t k = 0; k < views; ++k) {
+                const double(*P)[4] = cameras[k].m;
+                const double* ou = obs + k * 2 * kLanes;
+                const double* ov = ou + kLanes;
+                for (std::size_t j = 0; j < kLanes; ++j) {
+                    const double a = P[0][0] * x[j] + P[0][1] * y[j] + P[0][2] * z[j] + P[0][3];
+                    const double b = P[1][0] * x[j] + P[1][1] * y[j] + P[1][2] * z[j] + P[1][3];
+                    const double w = P[2][0] * x[j] + P[2][1] * y[j] + P[2][2] * z[j] + P[2][3];
+                    n.front[j] = w > 0.0 ? n.front[j] : 0.0;
+                    // Clamp |w| away from zero, keeping its sign (copysign again lets GCC
+                    // vectorise the select).
+                    const double aw = std::fabs(w);
+                    const double iw = 1.0 / std::copysign(aw > 1e-12 ? aw : 1e-12, w);
+                    const double pu = a * iw;
+                    const double pv = b * iw;
+                    const double ru = pu - ou[j];
+                    const double rv = pv - ov[j];
+                    // d(u, v)/dX = (P_row - (u, v) P_2) / w.
+                    const double u0 = (P[0][0] - pu * P[2][0]) * iw;
+                    const double u1 = (P[0][1] - pu * P[2][1]) * iw;
+                    const double u2 = (P[0][2] - pu * P[2][2]) * iw;
+                    const double v0 = (P[1][0] - pv * P[2][0]) * iw;
+                    const double v1 = (P[1][1] - pv * P[2][1]) * iw;
+                    const double v2 = (P[1][2] - pv * P[2][2]) * iw;
+                    n.h00[j] += u0 * u0 + v0 * v0;
+                    n.h01[j] += u0 * u1 + v0 * v1;
+                    n.h02[j] += u0 * u2 + v0 * v2;
+                    n.h11[j] += u1 * u1 + v1 * v1;
+                    n.h12[j] += u1 * u2 + v1 * v2;
+                    n.h22[j] += u2 * u2 + v2 * v2;
+                    n.g0[j] += u0 * ru + v0 * rv;
+                    n.g1[j] += u1 * ru + v1 * rv;
+                    n.g2[j] += u2 * ru + v2 * rv;
+                    n.cost[j] += ru * ru + rv * rv;
+                }
+            }
+        }
+
+        /// Symmetric 3x3 inverse by cofactors; returns false when nearly singular.
+        inline bool invert3(double h00, double h01, double h02, double h11, double h12,
+                            double h22, double inv[6]) {
+            const double c00 = h11 * h22 - h12 * h12;
+            const double c01 = h02 * h12 - h01 * h22;
+            const double c02 = h01 * h12 - h02 * h11;
+            const double det = h00 * c00 + h01 * c01 + h02 * c02;
+            // For a PSD matrix det <= h00 h11 h22 (Hadamard), so this is a relative test.
+            const double floor = 1e-12 * h00 * h11 * h22 + 1e-300;
+            const bool ok = det > floor;
+            // GCC only if-converts a select feeding a division through copysign.
+            const double id = (ok ? 1.0 : 0.0) / std::copysign(ok ? det : floor, 1.0);
+            inv[0] = c00 * id;
+            inv[1] = c01 * id;
+            inv[2] = c02 * id;
+            inv[3] = (h00 * h22 - h02 * h02) * id;
+            inv[4] = (h01 * h02 - h00 * h12) * id;
+            inv[5] = (h00 * h11 - h01 * h01) * id;
+            return ok;
+        }
+
+        /// Gauss-Newton step -scale H^-1 g for every lane of @p n.
+        inline void solve(const Normal& n, const double* scale, double* dx, double* dy,
+                          double* dz) {
+            for (std::size_t j = 0; j < kLanes; ++j) {
+                double inv[6];
+                invert3(n.h00[j], n.h01[j], n.h02[j], n.h11[j], n.h12[j], n.h22[j], inv);
+                dx[j] = -scale[j] * (inv[0] * n.g0[j] + inv[1] * n.g1[j] + inv[2] * n.g2[j]);
+                dy[j] = -scale[j] * (inv[1] * n.g0[j] + inv[3] * n.g1[j] + inv[4] * n.g2[j]);
+                dz[j] = -scale[j] * (inv[2] * n.g0[j] + inv[4] * n.g1[j] + inv[5] * n.g2[j]);
+            }
+        }
+
+    }  // namespace refine_detail
+
+    /**
+     * @brief Batched Gauss-Newton refinement of points on reprojection error.
+     *
+     * DLT triangulation minimises an algebraic error, which is biased for points
+     * seen at low parallax. This polishes such estimates against the pixel error
+     * in every view: each step solves the 3x3 normal equations in closed form,
+     * and a step that does not lower the cost is halved and retried from the best
+     * point so far, so the result is never worse than the input. Points are
+     * processed kLanes at a time in structure-of-arrays form, so the per-view
+     * work compiles to vector code; there is no per-point branching.
+     *
+     * The covariance is pixel_sigma^2 (J^T J)^-1 at the returned point, the
+     * first-order uncertainty of a point observed with that noise.
+     *
+     * @param cameras  The @p views projection matrices.
+     * @param u,v      Observations, view-major: u[k * n + i] is point i in view k.
+     * @param n        Number of points.
+     * @param points   Initial estimates on input (e.g. from triangulate()),
+     *                 refined points on output.
+     * @param results  Optional per-point covariance and RMS (@p n entries).
+     */
+    inline void refine_points(const Mat34* cameras, std::size_t views, const double* u,
+                              const double* v, std::size_t n, Vec3* points,
+                              PointRefinement* results = nullptr,
+                              const PointRefineOptions& options = {}) {
+        using namespace refine_detail;
+        if (views == 0) {
+            return;
+        }
+        std::vector<double> obs(views * 2 * kLanes);
+        double bx[kLanes], by[kLanes], bz[kLanes];  // Best point so far.
+        double x[kLanes], y[kLanes], z[kLanes];     // Trial point.
+        double dx[kLanes], dy[kLanes], dz[kLanes];  // Step from the best point.
+        double scale[kLanes];                       // Step length, halved on rejection.
+        Normal best, trial;
+
+        for (std::size_t start = 0; start < n; start += kLanes) {
+            // Gather the block, padding a short tail with copies of its last point.
+            const std::size_t count = n - start < kLanes ? n - start : kLanes;
+            for (std::size_t j = 0; j < kLanes; ++j) {
+                const std::size_t i = start + (j < count ? j : count - 1);
+                bx[j] = points[i][0];
+                by[j] = points[i][1];
+                bz[j] = points[i][2];
+                for (std::size_t k = 0; k < views; ++k) {
+                    obs[k * 2 * kLanes + j] = u[k * n + i];
+                    obs[k * 2 * kLanes + kLanes + j] = v[k * n + i];
+                }
+            }
+
+            // The lane loops below hold only arithmetic and selects between
+            // stored values, which keeps them vectorisable; the trial step is
+            // recomputed from the best normal equations after every pass.
+            linearise(cameras, views, obs.data(), bx, by, bz, best);
+            for (std::size_t j = 0; j < kLanes; ++j) {
+                scale[j] = 1.0;
+            }
+            solve(best, scale, dx, dy, dz);
+            for (int it = 0; it < options.iterations; ++it) {
+                for (std::size_t j = 0; j < kLanes; ++j) {
+                    x[j] = bx[j] + dx[j];
+                    y[j] = by[j] + dy[j];
+                    z[j] = bz[j] + dz[j];
+                    scale[j] *= 0.5;  // Kept if the trial is rejected.
+                }
+                linearise(cameras, views, obs.data(), x, y, z, trial);
+                for (std::size_t j = 0; j < kLanes; ++j) {
+                    // Moving in front of a camera always wins; otherwise the cost must drop.
+                    const bool accept =
+                        (trial.front[j] > best.front[j]) |
+                        ((trial.front[j] == best.front[j]) & (trial.cost[j] < best.cost[j]));
+                    scale[j] = accept ? 1.0 : scale[j];
+                    bx[j] = accept ? x[j] : bx[j];
+                    by[j] = accept ? y[j] : by[j];
+                    bz[j] = accept ? z[j] : bz[j];
+                    best.h00[j] = accept ? trial.h00[j] : best.h00[j];
+                    best.h01[j] = accept ? trial.h01[j] : best.h01[j];
+                    best.h02[j] = accept ? trial.h02[j] : best.h02[j];
+                    best.h11[j] = accept ? trial.h11[j] : best.h11[j];
+                    best.h12[j] = accept ? trial.h12[j] : best.h12[j];
+                    best.h22[j] = accept ? trial.h22[j] : best.h22[j];
+                    best.g0[j] = accept ? trial.g0[j] : best.g0[j];
+                    best.g1[j] = accept ? trial.g1[j] : best.g1[j];
+                    best.g2[j] = accept ? trial.g2[j] : best.g2[j];
+                    best.cost[j] = accept ? trial.cost[j] : best.cost[j];
+                    best.front[j] = accept ? trial.front[j] : best.front[j];
+                }
+                solve(best, scale, dx, dy, dz);
+            }
+
+            const double var = options.pixel_sigma * options.pixel_sigma;
+            for (std::size_t j = 0; j < count; ++j) {
+                points[start + j] = {bx[j], by[j], bz[j]};
+                if (results == nullptr) {
+                    continue;
+                }
+                PointRefinement& r = results[start + j];
+                double inv[6];
+                const bool ok = invert3(best.h00[j], best.h01[j], best.h02[j], best.h11[j],
+                                        best.h12[j], best.h22[j], inv);
+                const int index[3][3] = {{0, 1, 2}, {1, 3, 4}, {2, 4, 5}};
+                for (int a = 0; a < 3; ++a) {
+                    for (int b = 0; b < 3; ++b) {
+                        r.covariance[a][b] = var * inv[index[a][b]];
+                    }
+                }
+                r.rms = std::sqrt(best.cost[j] / (2.0 * static_cast<double>(views)));
+                r.valid = ok && best.front[j] > 0.0;
+            }
+        }
+    }
+
 }  // namespace ar_slam::geometry
@@ -1,10 +1,20 @@
 #pragma once
 
 #include <opencv2/core.hpp>
-#include <unordered_map>
+#include <opencv2/features2d.hpp>
+#include <cstddef>
+#include <memory>
 #include <vector>
 
+#include "core/frame_arena.h"
+#include "core/landmark_map.h"
+#include "core/local_bundle_adjuster.h"
+#include "core/loop_closer.h"
+#include "core/map_file.h"
 #include "core/reconstruction.h"
+#include "core/relocalizer.h"
+#include "core/track_table.h"
+#include "core/vocabulary.h"
 
 namespace ar_slam {
 
@@ -20,8 +30,35 @@ namespace ar_slam {
      * from a pair with genuine parallax rather than from noise on a near-static
      * pair.
      *
-     * The recovered cloud is expressed in the reference camera frame, up to the
-     * usual monocular scale ambiguity.
+     * Every reconstruction is chained into a persistent LandmarkMap: the new
+     * pair's unit-baseline scale is tied to the map through the landmarks it
+     * shares with earlier keyframes, the new keyframe gets a global pose, and the
+     * triangulated points are appended to (or fused into) the map. The world frame
+     * is the first keyframe's camera frame, and the whole map carries one global
+     * (unknown) monocular scale. Points triangulated under a fresh track id
+     * right next to an existing landmark (the same corner, re-detected) are
+     * merged into it rather than duplicated (Config::landmark_index).
+     *
+     * With local bundle adjustment enabled, each new keyframe also submits the
+     * newest window of the map to a LocalBundleAdjuster thread; refined poses and
+     * points are folded back on a later update without ever blocking on it.
+     *
+     * Given a vocabulary (Config::vocabulary) and the frames' grayscale images,
+     * keyframes also store an ORB descriptor per observation and go through a
+     * LoopCloser: when a place is recognised, its pose-graph correction is
+     * folded in the same way, deforming the whole map to close the loop.
+     *
+     * With relocalization enabled (the default) keyframes store descriptors even
+     * without a vocabulary, and the newest ones are packed into a
+     * RelocalizationMap for the tracker's Relocalizer. When the tracks are
+     * re-detected and the reference goes stale, the new reference is anchored by
+     * PnP on the re-attached landmark ids instead of at the last known pose, so
+     * the next pair chains onto the existing map.
+     *
+     * load_map() starts from a map saved by an earlier session (see MapFile):
+     * the first frame's reference is anchored by PnP like a stale one, so once
+     * the tracker relocalizes against the loaded keyframes, mapping continues
+     * on the saved map instead of starting a new one.
      */
     class IncrementalMapper {
     public:
@@ -32,6 +69,20 @@ namespace ar_slam {
             double force_keyframe_px =
                 80.0;  ///< Parallax beyond which we advance the keyframe
                        ///< even if reconstruction failed (e.g. pure rotation).
+            /// After a failed reconstruction, wait until the median parallax has
+            /// grown by this factor before fitting again (reset by a new reference).
+            double retry_parallax_growth = 1.5;
+            TwoViewReconstruction::Config reconstruction;  ///< H/E selection and triangulation.
+            int min_scale_matches = 8;  ///< Shared landmarks needed to chain scale.
+            /// Landmark spatial index; a fresh track id triangulated within
+            /// merge_radius of a landmark becomes that landmark (map units).
+            VoxelGrid::Config landmark_index{0.1, 0.03, 1024};
+            bool local_ba = true;       ///< Refine the newest keyframes in the background.
+            LocalBundleAdjuster::Config ba;
+            std::shared_ptr<const Vocabulary> vocabulary;  ///< Enables loop closure when set.
+            LoopCloser::Config loop;
+            bool relocalization = true;  ///< Keep descriptors and a RelocalizationMap.
+            Relocalizer::Config relocalization_config;
         };
 
         /// Construct with default thresholds.
@@ -44,39 +95,120 @@ namespace ar_slam {
          * @brief Feed the current frame's tracks.
          * @param track_ids  Stable identifier per tracked feature.
          * @param points     Pixel location of each tracked feature (same size as ids).
-         * @return true if a new 3D cloud was produced on this update.
+         * @param image      Grayscale frame the points were tracked in; needed only
+         *                   for keyframe descriptors (loop closure and
+         *                   relocalization). Copied only when the frame becomes
+         *                   the reference keyframe, so it need not outlive the call.
+         * @return true if the map changed on this update (new keyframe, or a
+         *         background refinement or loop correction folded in).
          */
-        bool update(const std::vector<int>& track_ids, const std::vector<cv::Point2f>& points);
+        bool update(const std::vector<int>& track_ids,
+                    const std::vector<cv::Point2f>& points,
+                    const cv::Mat& image = cv::Mat());
 
         /// True once at least one successful reconstruction has been produced.
         bool has_cloud() const { return has_cloud_; }
 
-        /// The most recent triangulated cloud (reference-camera frame, up to scale).
+        /// Every landmark in the persistent map (world frame), in map insertion order.
         const std::vector<cv::Point3f>& cloud() const { return cloud_; }
 
+        /// The persistent landmark map, with global keyframe poses.
+        const LandmarkMap& map() const { return map_; }
+
+        /**
+         * @brief Indices of cloud() entries written since clear_cloud_changes(),
+         *        in the order written (an index at the then-current size appends).
+         *
+         * Lets a consumer mirror the cloud by copying only what changed; the
+         * log may hold an index more than once.
+         */
+        const std::vector<std::size_t>& cloud_changes() const { return cloud_changes_; }
+
+        /// Start a new cloud_changes() log (the consumer has taken the last one).
+        void clear_cloud_changes() { cloud_changes_.clear(); }
+
         /// Median parallax (px) measured against the reference on the last update.
         double last_parallax() const { return last_parallax_; }
 
+        /// Loop corrections folded into the map so far.
+        int loop_closures() const { return loop_closures_; }
+
+        /// Descriptors of the newest keyframes, or nullptr (relocalization disabled,
+        /// or no keyframe yet). Rebuilt whenever the map changes; never mutated.
+        std::shared_ptr<const RelocalizationMap> relocalization_map() const { return places_; }
+
+        /// Stale re-anchors whose pose was recovered by PnP against the map.
+        int relocalizations() const { return relocalizations_; }
+
         /// Result of the most recent reconstruction attempt.
         const ReconstructionResult& last_result() const { return last_result_; }
 
-        /// Reset all state (drops the reference keyframe and the cloud).
+        /**
+         * @brief Replace the map with the one saved in @p file (see MapFile::restore()).
+         *
+         * Drops the reference keyframe like reset(). The loop closer starts with
+         * an empty place index, so loops close only onto keyframes added after
+         * the load.
+         * @return false (leaving an empty map) if the file does not restore.
+         */
+        bool load_map(const MapFile& file);
+
+        /// Reset all state (drops the reference keyframe and the map).
         void reset();
 
+        /// Block until any in-flight bundle adjustment has finished (tests, shutdown).
+        void wait_for_refinement();
+
     private:
         cv::Matx33d K_;
         Config config_;
         TwoViewReconstruction reconstructor_;
 
-        std::unordered_map<int, cv::Point2f> reference_;
+        TrackTable<cv::Point2f> reference_;  ///< Reference keyframe observations by track id.
+        cv::Mat reference_image_;  ///< Own copy of the reference frame (may be empty).
         bool has_reference_ = false;
-
-        std::vector<cv::Point3f> cloud_;
+        geometry::Pose reference_pose_;  ///< World-to-camera pose of the reference.
+        int reference_keyframe_ = -1;    ///< Map keyframe id of the reference, or -1.
+        double last_scale_ = 1.0;        ///< Scale used for the last chained pair.
+
+        LandmarkMap map_;
+        MapDelta last_delta_;
+        std::vector<cv::Point3f> cloud_;  ///< Mirror of map_ positions for display.
+        std::vector<std::size_t> cloud_changes_;  ///< cloud_ indices written since cleared.
+        std::unique_ptr<LocalBundleAdjuster> ba_;
+        std::unique_ptr<LoopCloser> loop_;
+        cv::Ptr<cv::ORB> orb_;  ///< Keyframe descriptors (loop closure or relocalization).
+        std::shared_ptr<const RelocalizationMap> places_;
+        int loop_closures_ = 0;
+        int relocalizations_ = 0;
         bool has_cloud_ = false;
         double last_parallax_ = 0.0;
+        double retry_parallax_ = 0.0;  ///< Parallax needed before the next attempt.
+        // Per-frame correspondence buffers, reused across update() calls.
+        std::vector<cv::Point2f> ref_pts_;
+        std::vector<cv::Point2f> cur_pts_;
+        std::vector<int> matched_ids_;
+        std::vector<float> parallax2_;  ///< Squared pixel displacement per match.
+        FrameArena scratch_{0};         ///< Reconstruction temporaries; sized by first use.
         ReconstructionResult last_result_;
 
-        void set_reference(const std::vector<int>& ids, const std::vector<cv::Point2f>& pts);
+        void set_reference(const std::vector<int>& ids,
+                           const std::vector<cv::Point2f>& pts,
+                           const cv::Mat& image);
+        void integrate(const ReconstructionResult& result,
+                       const std::vector<int>& ids,
+                       const std::vector<cv::Point2f>& ref_pts,
+                       const std::vector<cv::Point2f>& cur_pts,
+                       const cv::Mat& image);
+        void describe(const cv::Mat& image,
+                      const std::vector<cv::Point2f>& pts,
+                      const std::vector<int>& indices,
+                      std::vector<uint8_t>& out);
+        bool apply_refinement();
+        bool apply_correction();
+        bool relocalize_reference(const std::vector<int>& ids,
+                                  const std::vector<cv::Point2f>& pts);
+        void capture_places();
     };
 
 }  // namespace ar_slam
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core/geometry.h"
+
+namespace ar_slam {
+
+    /// Bytes per binary feature descriptor (ORB / rBRIEF, 256 bits).
+    constexpr std::size_t kDescriptorBytes = 32;
+
+    /// Pixel observation of a landmark (by track id) in a keyframe.
+    struct MapObservation {
+        int keyframe = -1;
+        int landmark = -1;
+        double u = 0.0;
+        double v = 0.0;
+    };
+
+    /// A keyframe registered in the map, with its global world-to-camera pose.
+    struct MapKeyframe {
+        int id = -1;
+        geometry::Pose pose;
+        std::vector<MapObservation> observations;  ///< Landmarks seen by this keyframe.
+        std::vector<uint8_t> descriptors;          ///< kDescriptorBytes per observation, or empty.
+
+        /// Descriptor of observation @p i, or nullptr if none were stored.
+        const uint8_t* descriptor(std::size_t i) const {
+            return (i + 1) * kDescriptorBytes <= descriptors.size()
+                       ? descriptors.data() + i * kDescriptorBytes
+                       : nullptr;
+        }
+    };
+
+    /// Weighted edge of the covisibility graph.
+    struct CovisibilityEdge {
+        int keyframe = -1;  ///< Neighbouring keyframe.
+        int weight = 0;     ///< Landmarks the two keyframes both observe.
+    };
+
+    /**
+     * @brief Keyframe store with a weighted covisibility graph.
+     *
+     * Holds every keyframe's pose, its landmark observations and (optionally) a
+     * compact binary descriptor per observation. Two keyframes are connected when
+     * they observe a common landmark; the edge weight is the number of landmarks
+     * they share.
+     *
+     * The graph is maintained incrementally: each new observation walks only the
+     * landmark's existing observers (landmark -> keyframes index) and bumps those
+     * edges by one. Every keyframe keeps its neighbours sorted by descending
+     * weight, and a bumped edge bubbles towards the front, so "the N keyframes
+     * that share the most with k" is a prefix read, independent of how many
+     * keyframes the session has accumulated. Mapping, local bundle adjustment and
+     * relocalization therefore work on local neighbourhoods instead of scanning
+     * the whole map.
+     *
+     * Keyframe ids are dense indices (0, 1, 2, ...), as assigned by LandmarkMap.
+     */
+    class KeyframeDatabase {
+    public:
+        /**
+         * @brief Register (or overwrite the pose of) keyframe @p keyframe.id.
+         *
+         * Observations carried by @p keyframe are added through add_observation(),
+         * so they update the graph like any later observation.
+         */
+        void insert(const MapKeyframe& keyframe) {
+            if (keyframe.id < 0) {
+                return;
+            }
+            ensure(keyframe.id);
+            keyframes_[keyframe.id].id = keyframe.id;
+            keyframes_[keyframe.id].pose = keyframe.pose;
+            for (std::size_t i = 0; i < keyframe.observations.size(); ++i) {
+                MapObservation o = keyframe.observations[i];
+                o.keyframe = keyframe.id;
+                add_observation(o, keyframe.descriptor(i));
+            }
+        }
+
+        /**
+         * @brief Record that @p o.keyframe sees @p o.landmark and update the graph.
+         * @param descriptor kDescriptorBytes bytes, or nullptr.
+         * @return false if the keyframe is unknown or already observes the landmark.
+         */
+        bool add_observation(const MapObservation& o, const uint8_t* descriptor = nullptr) {
+            if (!contains(o.keyframe)) {
+                return false;
+            }
+            std::vector<int>& seen_by = observers_[o.landmark];
+            if (std::find(seen_by.begin(), seen_by.end(), o.keyframe) != seen_by.end()) {
+                return false;
+            }
+            for (int other : seen_by) {
+                bump(o.keyframe, other);
+                bump(other, o.keyframe);
+            }
+            seen_by.push_back(o.keyframe);
+
+            MapKeyframe& kf = keyframes_[o.keyframe];
+            if (descriptor != nullptr) {
+                // Keep descriptors aligned with observations: pad earlier rows if needed.
+                kf.descriptors.resize(kf.observations.size() * kDescriptorBytes, 0);
+                kf.descriptors.insert(
+                    kf.descriptors.end(), descriptor, descriptor + kDescriptorBytes);
+            } else if (!kf.descriptors.empty()) {
+                kf.descriptors.resize((kf.observations.size() + 1) * kDescriptorBytes, 0);
+            }
+            kf.observations.push_back(o);
+            return true;
+        }
+
+        /**
+         * @brief Load keyframe @p keyframe verbatim, with its saved neighbour list.
+         *
+         * For restoring a saved map: observations are indexed for observers() but
+         * the graph is not recomputed, so a whole map loads in one linear pass.
+         * @p edges must be sorted by descending weight, and every keyframe whose
+         * edges were saved must be restored this way.
+         */
+        void restore(MapKeyframe keyframe, std::vector<CovisibilityEdge> edges) {
+            if (keyframe.id < 0) {
+                return;
+            }
+            const int id = keyframe.id;
+            ensure(id);
+            for (MapObservation& o : keyframe.observations) {
+                o.keyframe = id;
+                observers_[o.landmark].push_back(id);
+            }
+            Node& node = graph_[id];
+            node.slot.clear();
+            for (std::size_t i = 0; i < edges.size(); ++i) {
+                node.slot.emplace(edges[i].keyframe, i);
+            }
+            node.edges = std::move(edges);
+            keyframes_[id] = std::move(keyframe);
+        }
+
+        /// Replace the pose of keyframe @p id (e.g. after bundle adjustment).
+        void set_pose(int id, const geometry::Pose& pose) {
+            if (contains(id)) {
+                keyframes_[id].pose = pose;
+            }
+        }
+
+        bool contains(int id) const {
+            return id >= 0 && static_cast<std::size_t>(id) < keyframes_.size() &&
+                   keyframes_[id].id == id;
+        }
+
+        /// Keyframe @p id, or nullptr.
+        const MapKeyframe* find(int id) const { return contains(id) ? &keyframes_[id] : nullptr; }
+
+        /// All keyframes, indexed by keyframe id.
+        const std::vector<MapKeyframe>& keyframes() const { return keyframes_; }
+
+        /// Keyframes observing @p landmark, in the order they first saw it.
+        const std::vector<int>& observers(int landmark) const {
+            static const std::vector<int> kNone;
+            auto it = observers_.find(landmark);
+            return it == observers_.end() ? kNone : it->second;
+        }
+
+        /// Covisibility weight between @p a and @p b (0 if not connected).
+        int weight(int a, int b) const {
+            if (!contains(a)) {
+                return 0;
+            }
+            const Node& node = graph_[a];
+            auto it = node.slot.find(b);
+            return it == node.slot.end() ? 0 : node.edges[it->second].weight;
+        }
+
+        /// Neighbours of @p id sorted by descending weight.
+        const std::vector<CovisibilityEdge>& neighbours(int id) const {
+            static const std::vector<CovisibilityEdge> kNone;
+            return contains(id) ? graph_[id].edges : kNone;
+        }
+
+        /**
+         * @brief The (at most) @p n keyframes sharing the most landmarks with @p id.
+         *
+         * O(n): the neighbour list is kept sorted, so this is a prefix read.
+         */
+        std::vector<int> best_covisible(int id, std::size_t n, int min_weight = 1) const {
+            std::vector<int> out;
+            for (const CovisibilityEdge& e : neighbours(id)) {
+                if (out.size() >= n || e.weight < min_weight) {
+                    break;
+                }
+                out.push_back(e.keyframe);
+            }
+            return out;
+        }
+
+        /**
+         * @brief Local neighbourhood of @p id: itself, its strongest neighbours,
+         * then (if still short of @p n) their strongest neighbours.
+         *
+         * Cost depends on @p n and the local graph degree, not on the map size.
+         */
+        std::vector<int> neighbourhood(int id, std::size_t n, int min_weight = 1) const {
+            std::vector<int> out;
+            if (!contains(id) || n == 0) {
+                return out;
+            }
+            out.push_back(id);
+            const std::vector<int> ring = best_covisible(id, n - 1, min_weight);
+            out.insert(out.end(), ring.begin(), ring.end());
+            for (std::size_t r = 0; r < ring.size() && out.size() < n; ++r) {
+                for (const CovisibilityEdge& e : graph_[ring[r]].edges) {
+                    if (out.size() >= n || e.weight < min_weight) {
+                        break;
+                    }
+                    if (std::find(out.begin(), out.end(), e.keyframe) == out.end()) {
+                        out.push_back(e.keyframe);
+                    }
+                }
+            }
+            return out;
+        }
+
+        std::size_t size() const { return keyframes_.size(); }
+        bool empty() const { return keyframes_.empty(); }
+
+        /// Drop every keyframe, observation and edge.
+        void clear() {
+            keyframes_.clear();
+            graph_.clear();
+            observers_.clear();
+        }
+
+    private:
+        struct Node {
+            std::vector<CovisibilityEdge> edges;        // Sorted by descending weight.
+            std::unordered_map<int, std::size_t> slot;  // Neighbour id -> index in edges.
+        };
+
+        void ensure(int id) {
+            if (static_cast<std::size_t>(id) >= keyframes_.size()) {
+                keyframes_.resize(id + 1);
+                graph_.resize(id + 1);
+            }
+        }
+
+        // Add one shared landmark to the edge from -> to, keeping the order. Ties go
+        // to the edge strengthened last, which favours recent keyframes.
+        void bump(int from, int to) {
+            Node& node = graph_[from];
+            auto it = node.slot.find(to);
+            std::size_t i;
+            if (it == node.slot.end()) {
+                i = node.edges.size();
+                node.slot.emplace(to, i);
+                node.edges.push_back({to, 0});
+            } else {
+                i = it->second;
+            }
+            const int w = ++node.edges[i].weight;
+            while (i > 0 && node.edges[i - 1].weight <= w) {
+                std::swap(node.edges[i - 1], node.edges[i]);
+                node.slot[node.edges[i].keyframe] = i;
+                --i;
+            }
+            node.slot[to] = i;
+        }
+
+        std::vector<MapKeyframe> keyframes_;
+        std::vector<Node> graph_;
+        std::unordered_map<int, std::vector<int>> observers_;
+    };
+
+}  // namespace ar_slam
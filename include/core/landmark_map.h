@@ -0,0 +1,503 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "core/geometry.h"
+#include "core/keyframe_database.h"
+#include "core/voxel_grid.h"
+
+namespace ar_slam {
+
+    /// A persistent 3D point, identified by the track id that observed it.
+    struct Landmark {
+        int id = -1;                ///< Track id (stable across frames).
+        geometry::Vec3 position{};  ///< World-frame position (map scale).
+        int observations = 0;       ///< Number of keyframes that triangulated it.
+        int first_keyframe = -1;    ///< Keyframe that created the landmark.
+        int last_keyframe = -1;     ///< Most recent keyframe that refined it.
+    };
+
+    /// One landmark position carried by a MapDelta.
+    struct LandmarkUpdate {
+        int id = -1;
+        geometry::Vec3 position{};
+    };
+
+    /// A new track id recognised as an existing landmark (see LandmarkMap::add_keyframe()).
+    struct LandmarkAlias {
+        int id = -1;    ///< Track id that triangulated a duplicate.
+        int into = -1;  ///< Landmark it now refers to.
+    };
+
+    /**
+     * @brief Incremental change set produced by one keyframe insertion.
+     *
+     * @ref added entries are new landmarks, in the order they were appended to the
+     * map; @ref merged entries make new track ids aliases of existing landmarks;
+     * @ref updated entries replace the position of landmarks that already
+     * existed. Consumers (viewers, a replica map) mirror the map by applying
+     * deltas in order instead of re-reading the whole cloud.
+     */
+    struct MapDelta {
+        MapKeyframe keyframe;  ///< The inserted keyframe (observations travel separately).
+        std::vector<LandmarkUpdate> added;
+        std::vector<LandmarkAlias> merged;
+        std::vector<LandmarkUpdate> updated;
+        std::vector<MapObservation> observations;  ///< New observations, any keyframe.
+        std::vector<uint8_t> descriptors;          ///< kDescriptorBytes per observation, or empty.
+
+        bool empty() const {
+            return added.empty() && merged.empty() && updated.empty() && observations.empty();
+        }
+    };
+
+    /// Refined keyframe pose carried by a MapRefinement.
+    struct KeyframeUpdate {
+        int id = -1;
+        geometry::Pose pose;
+    };
+
+    /**
+     * @brief Optimised poses and positions computed on a snapshot of the map.
+     *
+     * Produced off-thread (e.g. by local bundle adjustment) and folded back with
+     * LandmarkMap::refine(). @ref newest_keyframe is the latest keyframe the
+     * snapshot contained, so landmarks re-observed since are left untouched.
+     */
+    struct MapRefinement {
+        int newest_keyframe = -1;
+        int generation = 0;  ///< LandmarkMap::generation() of the snapshot.
+        std::vector<KeyframeUpdate> keyframes;
+        std::vector<LandmarkUpdate> landmarks;
+    };
+
+    /// Loop-closure correction of one keyframe carried by a MapCorrection.
+    struct KeyframeCorrection {
+        int id = -1;
+        geometry::Pose before;  ///< Pose the correction was computed from.
+        geometry::Sim3 after;   ///< Corrected world-to-camera similarity.
+    };
+
+    /**
+     * @brief Similarity corrections from pose-graph optimisation (loop closure).
+     *
+     * Applied with LandmarkMap::correct(). Keyframes newer than
+     * @ref newest_keyframe, and the landmarks they created, follow the correction
+     * of the newest keyframe.
+     */
+    struct MapCorrection {
+        int newest_keyframe = -1;
+        std::vector<KeyframeCorrection> keyframes;
+    };
+
+    /**
+     * @brief Persistent landmark store keyed by track id, with global keyframe poses.
+     *
+     * Two-view reconstructions are each expressed in their own reference frame and
+     * at their own unit-baseline scale. The map anchors everything in a single world
+     * frame (the first keyframe's camera frame): relative_scale() measures the scale
+     * of a new reconstruction against landmarks it shares with the map, and
+     * add_keyframe() integrates the rescaled points, appending new landmarks and
+     * fusing re-observed ones by a running average.
+     *
+     * Landmarks live in a contiguous vector in insertion order (so index i of the
+     * map matches the i-th landmark ever added), with a track id -> index table
+     * for lookups. Keyframes, their observations and the covisibility graph live
+     * in a KeyframeDatabase (see database()).
+     *
+     * Landmark positions are also indexed in a VoxelGrid (see spatial_index(),
+     * whose handles are landmark indices) for radius, nearest-neighbour and
+     * frustum queries. With a merge radius set, a new track id triangulated
+     * within that distance of an existing landmark becomes an alias of it
+     * instead of a duplicate point: the same physical point re-detected under a
+     * fresh track id keeps one landmark, and its observations accumulate there.
+     */
+    class LandmarkMap {
+    public:
+        /// Map without duplicate merging (spatial index with default voxels).
+        LandmarkMap() = default;
+
+        /// Map whose spatial index, and duplicate merging, follow @p spatial.
+        explicit LandmarkMap(const VoxelGrid::Config& spatial)
+            : grid_(spatial), merge_radius_(spatial.merge_radius) {}
+
+        /**
+         * @brief Scale that brings a unit-baseline reconstruction into map scale.
+         *
+         * For every id already in the map, the landmark is moved into the
+         * reference camera frame and its depth compared with the freshly
+         * triangulated point; the median depth ratio is robust to the odd bad
+         * triangulation.
+         *
+         * @param ref         World-to-camera pose of the reconstruction's view 1.
+         * @param ids         Track id of each triangulated point.
+         * @param ref_points  Triangulated points in view-1 frame, unit baseline.
+         * @param min_matches Minimum shared landmarks needed to trust the estimate.
+         * @param fallback    Returned when there are too few shared landmarks.
+         */
+        double relative_scale(const geometry::Pose& ref,
+                              const std::vector<int>& ids,
+                              const std::vector<geometry::Vec3>& ref_points,
+                              int min_matches,
+                              double fallback) const {
+            std::vector<double> ratios;
+            ratios.reserve(ids.size());
+            for (std::size_t i = 0; i < ids.size() && i < ref_points.size(); ++i) {
+                const Landmark* lm = find(ids[i]);
+                if (lm == nullptr || ref_points[i][2] <= 1e-9) {
+                    continue;
+                }
+                const geometry::Vec3 known = ref.transform(lm->position);
+                if (known[2] <= 1e-9) {
+                    continue;
+                }
+                ratios.push_back(known[2] / ref_points[i][2]);
+            }
+            if (static_cast<int>(ratios.size()) < min_matches || ratios.empty()) {
+                return fallback;
+            }
+            std::nth_element(ratios.begin(), ratios.begin() + ratios.size() / 2, ratios.end());
+            return ratios[ratios.size() / 2];
+        }
+
+        /**
+         * @brief Register a keyframe and integrate its world-frame points.
+         * @param pose          World-to-camera pose of the new keyframe.
+         * @param ids           Track id of each point.
+         * @param world_points  Points already expressed in the world frame.
+         * @param observations  Pixel observations to record; may refer to the new
+         *                      keyframe (next_keyframe_id()) or to earlier ones.
+         * @param descriptors   kDescriptorBytes per observation, or empty.
+         * @return The change set that was applied (also usable by replicas).
+         *
+         * A new id within the merge radius of a landmark this keyframe does not
+         * already observe is merged into the nearest such landmark. Observations
+         * are recorded under each landmark's own id, never under an alias.
+         */
+        MapDelta add_keyframe(const geometry::Pose& pose,
+                              const std::vector<int>& ids,
+                              const std::vector<geometry::Vec3>& world_points,
+                              const std::vector<MapObservation>& observations = {},
+                              const std::vector<uint8_t>& descriptors = {}) {
+            MapDelta delta;
+            delta.keyframe.id = next_keyframe_id();
+            delta.keyframe.pose = pose;
+            delta.observations = observations;
+            delta.descriptors = descriptors;
+
+            // Landmarks this keyframe observes directly are never merge targets:
+            // two distinct features of one view are two distinct points.
+            std::unordered_set<int> touched;
+            if (merge_radius_ > 0.0) {
+                for (std::size_t i = 0; i < ids.size() && i < world_points.size(); ++i) {
+                    if (const Landmark* lm = find(ids[i])) {
+                        touched.insert(lm->id);
+                    }
+                }
+            }
+
+            std::unordered_map<int, int> aliases;
+            std::vector<int> nearby;
+            for (std::size_t i = 0; i < ids.size() && i < world_points.size(); ++i) {
+                const Landmark* lm = find(ids[i]);
+                if (lm == nullptr && merge_radius_ > 0.0) {
+                    lm = merge_target(world_points[i], touched, nearby);
+                    if (lm != nullptr) {
+                        delta.merged.push_back({ids[i], lm->id});
+                        aliases.emplace(ids[i], lm->id);
+                        touched.insert(lm->id);
+                    }
+                }
+                if (lm == nullptr) {
+                    delta.added.push_back({ids[i], world_points[i]});
+                    continue;
+                }
+                // Running average over every keyframe that triangulated the point.
+                const double n = static_cast<double>(lm->observations);
+                geometry::Vec3 fused;
+                for (int k = 0; k < 3; ++k) {
+                    fused[k] = (lm->position[k] * n + world_points[i][k]) / (n + 1.0);
+                }
+                delta.updated.push_back({lm->id, fused});
+            }
+
+            for (MapObservation& o : delta.observations) {
+                auto alias = aliases.find(o.landmark);
+                if (alias != aliases.end()) {
+                    o.landmark = alias->second;
+                } else if (const Landmark* lm = find(o.landmark)) {
+                    o.landmark = lm->id;
+                }
+            }
+
+            apply(delta);
+            return delta;
+        }
+
+        /**
+         * @brief Apply a change set produced by add_keyframe() (possibly on another map).
+         *
+         * Keyframes must be applied in the order they were produced.
+         */
+        void apply(const MapDelta& delta) {
+            const int kf = delta.keyframe.id;
+            keyframes_.insert(delta.keyframe);
+            for (std::size_t i = 0; i < delta.observations.size(); ++i) {
+                const bool has_descriptor = (i + 1) * kDescriptorBytes <= delta.descriptors.size();
+                keyframes_.add_observation(
+                    delta.observations[i],
+                    has_descriptor ? delta.descriptors.data() + i * kDescriptorBytes : nullptr);
+            }
+
+            for (const LandmarkUpdate& u : delta.added) {
+                if (!index_.emplace(u.id, landmarks_.size()).second) {
+                    continue;  // Duplicate id within one delta: keep the first.
+                }
+                Landmark lm;
+                lm.id = u.id;
+                lm.position = u.position;
+                lm.observations = 1;
+                lm.first_keyframe = kf;
+                lm.last_keyframe = kf;
+                landmarks_.push_back(lm);
+                grid_.add(u.position, u.id);  // Handle == landmark index.
+            }
+
+            for (const LandmarkAlias& a : delta.merged) {
+                auto it = index_.find(a.into);
+                if (it != index_.end() && index_.emplace(a.id, it->second).second) {
+                    aliases_.push_back(a);
+                }
+            }
+
+            for (const LandmarkUpdate& u : delta.updated) {
+                auto it = index_.find(u.id);
+                if (it == index_.end()) {
+                    continue;
+                }
+                Landmark& lm = landmarks_[it->second];
+                lm.position = u.position;
+                ++lm.observations;
+                lm.last_keyframe = kf;
+                grid_.move(static_cast<int>(it->second), u.position);
+            }
+        }
+
+        /**
+         * @brief Fold an off-thread optimisation result back into the map.
+         *
+         * Keyframe poses are replaced; landmark positions are replaced unless the
+         * landmark was refined by a keyframe newer than the snapshot. A refinement
+         * computed before the last correct() is dropped entirely.
+         * @return The landmark positions that were actually changed.
+         */
+        std::vector<LandmarkUpdate> refine(const MapRefinement& refinement) {
+            if (refinement.generation != generation_) {
+                return {};
+            }
+            for (const KeyframeUpdate& k : refinement.keyframes) {
+                keyframes_.set_pose(k.id, k.pose);
+            }
+            std::vector<LandmarkUpdate> applied;
+            applied.reserve(refinement.landmarks.size());
+            for (const LandmarkUpdate& u : refinement.landmarks) {
+                auto it = index_.find(u.id);
+                if (it == index_.end()) {
+                    continue;
+                }
+                Landmark& lm = landmarks_[it->second];
+                if (lm.last_keyframe > refinement.newest_keyframe) {
+                    continue;  // Changed since the snapshot; the refinement is stale.
+                }
+                lm.position = u.position;
+                grid_.move(static_cast<int>(it->second), u.position);
+                applied.push_back(u);
+            }
+            return applied;
+        }
+
+        /**
+         * @brief Deform the map by a loop-closure correction.
+         *
+         * Each corrected keyframe k defines a world-to-world similarity
+         * C_k = after_k^-1 * before_k. A keyframe's pose becomes pose * C_k^-1
+         * (rescaled back to a rigid pose, so poses refined since the snapshot keep
+         * their refinement) and every landmark moves with the correction of the
+         * keyframe that created it; keyframes outside the correction use the
+         * newest corrected keyframe's. Bumps generation().
+         * @return Every landmark position that changed.
+         */
+        std::vector<LandmarkUpdate> correct(const MapCorrection& correction) {
+            std::vector<LandmarkUpdate> applied;
+            if (correction.keyframes.empty()) {
+                return applied;
+            }
+            const std::size_t n = keyframes_.size();
+            std::vector<geometry::Sim3> world(n);
+            std::vector<bool> has(n, false);
+            int newest = -1;
+            for (const KeyframeCorrection& c : correction.keyframes) {
+                if (c.id < 0 || static_cast<std::size_t>(c.id) >= n) {
+                    continue;
+                }
+                world[c.id] = geometry::compose(c.after.inverse(), geometry::Sim3(c.before));
+                has[c.id] = true;
+                if (c.id > newest) {
+                    newest = c.id;
+                }
+            }
+            if (newest < 0) {
+                return applied;
+            }
+            auto world_correction = [&](int k) -> const geometry::Sim3& {
+                return k >= 0 && static_cast<std::size_t>(k) < n && has[k] ? world[k]
+                                                                           : world[newest];
+            };
+
+            for (const MapKeyframe& kf : keyframes_.keyframes()) {
+                if (kf.id < 0) {
+                    continue;
+                }
+                const geometry::Sim3 S = geometry::compose(geometry::Sim3(kf.pose),
+                                                           world_correction(kf.id).inverse());
+                geometry::Pose pose;
+                pose.R = S.R;
+                pose.t = {S.t[0] / S.s, S.t[1] / S.s, S.t[2] / S.s};
+                keyframes_.set_pose(kf.id, pose);
+            }
+
+            applied.reserve(landmarks_.size());
+            for (std::size_t i = 0; i < landmarks_.size(); ++i) {
+                Landmark& lm = landmarks_[i];
+                lm.position = world_correction(lm.first_keyframe).transform(lm.position);
+                grid_.move(static_cast<int>(i), lm.position);
+                applied.push_back({lm.id, lm.position});
+            }
+            ++generation_;
+            return applied;
+        }
+
+        /**
+         * @brief Load keyframe @p keyframe verbatim with its saved neighbour list.
+         *
+         * For restoring a saved map (see MapFile::restore()); the covisibility
+         * graph is taken as given (KeyframeDatabase::restore()).
+         */
+        void restore_keyframe(MapKeyframe keyframe, std::vector<CovisibilityEdge> edges) {
+            keyframes_.restore(std::move(keyframe), std::move(edges));
+        }
+
+        /// Append @p lm verbatim, or overwrite the landmark with its id (restoring a saved map).
+        void restore_landmark(const Landmark& lm) {
+            auto it = index_.find(lm.id);
+            if (it == index_.end()) {
+                index_.emplace(lm.id, landmarks_.size());
+                landmarks_.push_back(lm);
+                grid_.add(lm.position, lm.id);
+                return;
+            }
+            landmarks_[it->second] = lm;
+            grid_.move(static_cast<int>(it->second), lm.position);
+        }
+
+        /// Make @p alias.id refer to landmark @p alias.into; false if that is unknown.
+        bool restore_alias(const LandmarkAlias& alias) {
+            auto it = index_.find(alias.into);
+            if (it == index_.end()) {
+                return false;
+            }
+            if (index_.emplace(alias.id, it->second).second) {
+                aliases_.push_back(alias);
+            }
+            return true;
+        }
+
+        /// Incremented by every correct(); refinements from older snapshots are dropped.
+        int generation() const { return generation_; }
+
+        /// Id the next add_keyframe() call will assign.
+        int next_keyframe_id() const { return static_cast<int>(keyframes_.size()); }
+
+        /// Landmark for @p id, or nullptr if the track was never triangulated.
+        const Landmark* find(int id) const {
+            auto it = index_.find(id);
+            return it == index_.end() ? nullptr : &landmarks_[it->second];
+        }
+
+        /// Position of @p id in the landmarks() array, or -1.
+        long index_of(int id) const {
+            auto it = index_.find(id);
+            return it == index_.end() ? -1 : static_cast<long>(it->second);
+        }
+
+        /// All landmarks, in insertion order.
+        const std::vector<Landmark>& landmarks() const { return landmarks_; }
+
+        /// All keyframes, indexed by keyframe id.
+        const std::vector<MapKeyframe>& keyframes() const { return keyframes_.keyframes(); }
+
+        /// Keyframe store and covisibility graph.
+        const KeyframeDatabase& database() const { return keyframes_; }
+
+        /// Track ids merged into existing landmarks, in the order they were merged.
+        const std::vector<LandmarkAlias>& aliases() const { return aliases_; }
+
+        /// Spatial index of landmark positions; handles are indices into landmarks().
+        const VoxelGrid& spatial_index() const { return grid_; }
+
+        /// Distance within which a new track id is merged into a landmark (0 = off).
+        double merge_radius() const { return merge_radius_; }
+
+        std::size_t size() const { return landmarks_.size(); }
+        bool empty() const { return landmarks_.empty(); }
+
+        /// Drop every landmark and keyframe.
+        void clear() {
+            landmarks_.clear();
+            keyframes_.clear();
+            index_.clear();
+            aliases_.clear();
+            grid_.clear();
+            ++generation_;
+        }
+
+    private:
+        // Nearest landmark within the merge radius of @p p that is not in @p excluded.
+        const Landmark* merge_target(const geometry::Vec3& p,
+                                     const std::unordered_set<int>& excluded,
+                                     std::vector<int>& scratch) const {
+            grid_.radius_search(p, merge_radius_, scratch);
+            const Landmark* best = nullptr;
+            double best2 = 0.0;
+            for (int h : scratch) {
+                const Landmark& lm = landmarks_[h];
+                if (excluded.count(lm.id) != 0) {
+                    continue;
+                }
+                double d2 = 0.0;
+                for (int k = 0; k < 3; ++k) {
+                    d2 += (lm.position[k] - p[k]) * (lm.position[k] - p[k]);
+                }
+                if (best == nullptr || d2 < best2) {
+                    best = &lm;
+                    best2 = d2;
+                }
+            }
+            return best;
+        }
+
+        std::vector<Landmark> landmarks_;
+        KeyframeDatabase keyframes_;
+        std::unordered_map<int, std::size_t> index_;  ///< Track id (or alias) -> index.
+        std::vector<LandmarkAlias> aliases_;
+        VoxelGrid grid_;
+        double merge_radius_ = 0.0;
+        int generation_ = 0;
+    };
+
+}  // namespace ar_slam
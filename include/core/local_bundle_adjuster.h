@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core/bundle_adjustment.h"
+#include "core/landmark_map.h"
+
+namespace ar_slam {
+
+    /**
+     * @brief Sliding-window bundle adjustment on a background thread.
+     *
+     * submit() snapshots the newest keyframe of a LandmarkMap and its strongest
+     * covisible keyframes (poses, the landmarks they observe, and those
+     * observations) into a BAProblem and hands it to a worker thread; it never
+     * blocks on the optimisation itself. When the
+     * worker finishes, poll() returns a MapRefinement for LandmarkMap::refine().
+     * Only one job is in flight at a time: submitting while busy is rejected, so
+     * a slow optimisation simply skips keyframes instead of queueing up work.
+     */
+    class LocalBundleAdjuster {
+    public:
+        struct Config {
+            int window = 5;            ///< Keyframes optimised together: newest + covisible.
+            int fixed_keyframes = 2;   ///< Oldest window keyframes held fixed (gauge + scale).
+            int min_observations = 2;  ///< Landmarks seen fewer times are left out.
+            BAConfig solver;
+        };
+
+        /// Construct with default window settings.
+        explicit LocalBundleAdjuster(const geometry::Mat3& K) : LocalBundleAdjuster(K, Config{}) {}
+
+        /// Construct with explicit window settings.
+        LocalBundleAdjuster(const geometry::Mat3& K, const Config& config)
+            : K_(K), config_(config), worker_([this] { run(); }) {}
+
+        ~LocalBundleAdjuster() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            worker_.join();
+        }
+
+        LocalBundleAdjuster(const LocalBundleAdjuster&) = delete;
+        LocalBundleAdjuster& operator=(const LocalBundleAdjuster&) = delete;
+
+        /**
+         * @brief Build the windowed problem around @p map's newest keyframe.
+         * @param keyframe_ids Filled with the map keyframe id of each BA camera.
+         * @param landmark_ids Filled with the track id of each BA point.
+         */
+        static BAProblem make_problem(const LandmarkMap& map,
+                                      const geometry::Mat3& K,
+                                      const Config& config,
+                                      std::vector<int>& keyframe_ids,
+                                      std::vector<int>& landmark_ids) {
+            BAProblem problem;
+            problem.K = K;
+            keyframe_ids.clear();
+            landmark_ids.clear();
+
+            // The window is the newest keyframe's covisibility neighbourhood, so its
+            // cost follows the local graph rather than the session length. Ordered
+            // by id, the oldest members are the ones held fixed.
+            const KeyframeDatabase& db = map.database();
+            std::vector<int> window;
+            if (!db.empty() && config.window > 0) {
+                window = db.neighbourhood(static_cast<int>(db.size()) - 1, config.window);
+            }
+            std::sort(window.begin(), window.end());
+
+            // Count in-window observations per landmark first, so points the window
+            // cannot constrain (a single ray) stay out of the problem. A ray from a
+            // camera the point is behind constrains nothing either, so a point
+            // behind every window camera is left out too.
+            auto in_front = [&map](const MapKeyframe& kf, int landmark) {
+                const Landmark* lm = map.find(landmark);
+                return lm != nullptr && kf.pose.transform(lm->position)[2] > 1e-9;
+            };
+            std::unordered_map<int, int> seen;
+            for (int k : window) {
+                const MapKeyframe& kf = *db.find(k);
+                for (const MapObservation& o : kf.observations) {
+                    if (in_front(kf, o.landmark)) {
+                        ++seen[o.landmark];
+                    }
+                }
+            }
+
+            std::unordered_map<int, int> point_index;
+            for (int k : window) {
+                const MapKeyframe& kf = *db.find(k);
+                const int cam = static_cast<int>(problem.cameras.size());
+                problem.cameras.push_back(kf.pose);
+                problem.fixed.push_back(cam < config.fixed_keyframes);
+                keyframe_ids.push_back(k);
+
+                for (const MapObservation& o : kf.observations) {
+                    if (seen[o.landmark] < config.min_observations ||
+                        !in_front(kf, o.landmark)) {
+                        continue;
+                    }
+                    auto it = point_index.find(o.landmark);
+                    if (it == point_index.end()) {
+                        const Landmark* lm = map.find(o.landmark);
+                        it = point_index.emplace(o.landmark, problem.points.size()).first;
+                        problem.points.push_back(lm->position);
+                        landmark_ids.push_back(o.landmark);
+                    }
+                    problem.observations.push_back({cam, it->second, o.u, o.v});
+                }
+            }
+            return problem;
+        }
+
+        /**
+         * @brief Snapshot @p map and start optimising it in the background.
+         * @return false if a job is still running or the window has nothing to refine.
+         */
+        bool submit(const LandmarkMap& map) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (has_job_) {
+                    return false;
+                }
+            }
+            std::vector<int> keyframe_ids;
+            std::vector<int> landmark_ids;
+            BAProblem problem = make_problem(map, K_, config_, keyframe_ids, landmark_ids);
+            if (problem.observations.empty()) {
+                return false;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                job_ = std::move(problem);
+                job_keyframes_ = std::move(keyframe_ids);
+                job_landmarks_ = std::move(landmark_ids);
+                job_generation_ = map.generation();
+                has_job_ = true;
+            }
+            cv_.notify_all();
+            return true;
+        }
+
+        /**
+         * @brief Non-blocking: take the finished refinement, if any.
+         * @return true if @p out was filled.
+         */
+        bool poll(MapRefinement& out) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!has_result_) {
+                return false;
+            }
+            out = std::move(result_);
+            has_result_ = false;
+            return true;
+        }
+
+        /// True while a submitted job has not finished.
+        bool busy() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return has_job_;
+        }
+
+        /// Block until the in-flight job (if any) has finished.
+        void wait_idle() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return !has_job_; });
+        }
+
+        /// Solver summary of the most recently finished job.
+        BASummary last_summary() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return summary_;
+        }
+
+    private:
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                cv_.wait(lock, [this] { return stop_ || has_job_; });
+                if (stop_) {
+                    return;
+                }
+                // The job is only touched by this thread until has_job_ is cleared.
+                lock.unlock();
+                BASummary summary = bundle_adjust(job_, config_.solver);
+                MapRefinement refinement;
+                refinement.newest_keyframe = job_keyframes_.empty() ? -1 : job_keyframes_.back();
+                refinement.generation = job_generation_;
+                for (std::size_t c = 0; c < job_.cameras.size(); ++c) {
+                    if (!job_.fixed[c]) {
+                        refinement.keyframes.push_back({job_keyframes_[c], job_.cameras[c]});
+                    }
+                }
+                refinement.landmarks.reserve(job_.points.size());
+                for (std::size_t p = 0; p < job_.points.size(); ++p) {
+                    refinement.landmarks.push_back({job_landmarks_[p], job_.points[p]});
+                }
+                lock.lock();
+
+                result_ = std::move(refinement);
+                summary_ = summary;
+                has_result_ = true;
+                has_job_ = false;
+                cv_.notify_all();
+            }
+        }
+
+        geometry::Mat3 K_;
+        Config config_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stop_ = false;
+        bool has_job_ = false;
+        bool has_result_ = false;
+        BAProblem job_;
+        std::vector<int> job_keyframes_;
+        std::vector<int> job_landmarks_;
+        int job_generation_ = 0;
+        MapRefinement result_;
+        BASummary summary_;
+
+        std::thread worker_;  // Declared last: started after every member above exists.
+    };
+
+}  // namespace ar_slam
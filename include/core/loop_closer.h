@@ -0,0 +1,450 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/bow_index.h"
+#include "core/geometry.h"
+#include "core/landmark_map.h"
+#include "core/pose_graph.h"
+#include "core/vocabulary.h"
+
+namespace ar_slam {
+
+    /// A verified loop: keyframe @ref query revisits the place seen by @ref match.
+    struct LoopConstraint {
+        int query = -1;
+        int match = -1;
+        geometry::Sim3 relative;  ///< Maps the query's camera frame into the match's.
+        int inliers = 0;
+    };
+
+    /**
+     * @brief Appearance-based loop detection with pose-graph correction.
+     *
+     * add_keyframe() is called by the mapper (never by the tracking thread) for
+     * every new keyframe. It turns the keyframe's descriptors into a bag of
+     * words, asks the BowIndex for the most similar keyframes that are neither
+     * recent nor covisible, and verifies each candidate geometrically: descriptor
+     * matches between the two keyframes give pairs of landmarks, each expressed
+     * in its own keyframe's camera frame, and a 3-point RANSAC over
+     * geometry::align_sim3() must explain enough of them with one similarity
+     * (scale included, since monocular drift is a scale drift too).
+     *
+     * A verified loop becomes an edge of the essential graph (consecutive
+     * keyframes, strong covisibility edges and every loop found so far), which a
+     * worker thread optimises with optimise_pose_graph() under a time budget.
+     * poll() hands the result back as a MapCorrection for LandmarkMap::correct().
+     * As with LocalBundleAdjuster only one optimisation is in flight; loops found
+     * meanwhile are kept and join the next one.
+     */
+    class LoopCloser {
+    public:
+        struct Config {
+            int min_keyframe_gap = 30;       ///< Candidates must be this many keyframes older.
+            int min_loop_gap = 10;           ///< Keyframes between two accepted loops.
+            std::size_t max_candidates = 3;  ///< BoW candidates verified per keyframe.
+            int max_hamming = 50;            ///< Descriptor match distance limit (bits).
+            double ratio_test = 0.8;         ///< Best / second-best distance ratio.
+            int min_matches = 20;            ///< Descriptor matches needed to try RANSAC.
+            int min_inliers = 15;            ///< Inliers needed to accept a loop.
+            int ransac_iterations = 200;
+            double inlier_ratio = 0.1;       ///< Max 3D error relative to the point's range.
+            int covisibility_weight = 30;    ///< Min weight of a covisibility edge in the graph.
+            int covisibility_edges = 5;      ///< Per keyframe, beyond the odometry edge.
+            double loop_weight = 1.0;        ///< Information of a loop edge.
+            PoseGraphConfig solver{20, 1e-6, 1e-10, 50.0};  ///< 50 ms budget.
+        };
+
+        /// Detection is disabled while @p vocabulary is null or empty.
+        explicit LoopCloser(std::shared_ptr<const Vocabulary> vocabulary)
+            : LoopCloser(std::move(vocabulary), Config{}) {}
+
+        LoopCloser(std::shared_ptr<const Vocabulary> vocabulary, const Config& config)
+            : vocabulary_(std::move(vocabulary))
+            , config_(config)
+            , index_(vocabulary_ ? vocabulary_->word_count() : 0)
+            , worker_([this] { run(); }) {}
+
+        ~LoopCloser() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            worker_.join();
+        }
+
+        LoopCloser(const LoopCloser&) = delete;
+        LoopCloser& operator=(const LoopCloser&) = delete;
+
+        /**
+         * @brief Index keyframe @p id of @p map and look for a loop through it.
+         * @return true if a loop was verified (its correction arrives via poll()).
+         */
+        bool add_keyframe(const LandmarkMap& map, int id) {
+            const MapKeyframe* kf = map.database().find(id);
+            if (kf == nullptr || !vocabulary_ || vocabulary_->empty()) {
+                return false;
+            }
+            valid_rows(*kf, rows_, scratch_);
+            vocabulary_->transform(scratch_.data(), rows_.size(), bow_);
+
+            // Candidates must score at least as well as the keyframe's weakest
+            // strong covisible neighbour: that is how similar "the same place"
+            // looks under the current conditions.
+            const KeyframeDatabase& db = map.database();
+            double min_score = 1.0;
+            bool has_neighbour = false;
+            for (int n : db.best_covisible(id, 10)) {
+                if (const BowVector* other = index_.vector(n)) {
+                    min_score = std::min(min_score, Vocabulary::score(bow_, *other));
+                    has_neighbour = true;
+                }
+            }
+            if (!has_neighbour) {
+                min_score = 0.0;
+            }
+
+            bool found = false;
+            if (id - last_loop_ >= config_.min_loop_gap) {
+                index_.query(
+                    bow_, config_.max_candidates,
+                    [&](int c) {
+                        return id - c >= config_.min_keyframe_gap && db.weight(id, c) == 0;
+                    },
+                    candidates_);
+                for (const BowMatch& c : candidates_) {
+                    LoopConstraint loop;
+                    if (c.score < min_score || !verify(map, id, c.keyframe, config_, loop)) {
+                        continue;
+                    }
+                    loops_.push_back(loop);
+                    last_loop_ = id;
+                    found = true;
+                    break;
+                }
+            }
+            index_.add(id, bow_);
+
+            if (loops_.size() > submitted_loops_) {
+                submit(map);  // Deferred to a later keyframe if the worker is busy.
+            }
+            return found;
+        }
+
+        /**
+         * @brief Geometric verification of a loop between @p query and @p match.
+         *
+         * Matches the keyframes' descriptors (Hamming distance with a ratio test),
+         * expresses each matched landmark in its keyframe's camera frame, and
+         * runs a 3-point align_sim3() RANSAC followed by a refit on the inliers.
+         */
+        static bool verify(const LandmarkMap& map,
+                           int query,
+                           int match,
+                           const Config& config,
+                           LoopConstraint& out) {
+            const MapKeyframe* q = map.database().find(query);
+            const MapKeyframe* m = map.database().find(match);
+            if (q == nullptr || m == nullptr || q->descriptors.empty() || m->descriptors.empty()) {
+                return false;
+            }
+
+            std::vector<geometry::Vec3> from;  // Query camera frame.
+            std::vector<geometry::Vec3> to;    // Match camera frame.
+            for (std::size_t i = 0; i < q->observations.size(); ++i) {
+                const uint8_t* d = q->descriptor(i);
+                const Landmark* lq = map.find(q->observations[i].landmark);
+                if (d == nullptr || lq == nullptr || is_blank(d)) {
+                    continue;
+                }
+                int best = 256, second = 256;
+                std::size_t best_j = 0;
+                for (std::size_t j = 0; j < m->observations.size(); ++j) {
+                    const uint8_t* e = m->descriptor(j);
+                    if (e == nullptr || is_blank(e)) {
+                        continue;
+                    }
+                    const int dist = bow_detail::hamming(d, e);
+                    if (dist < best) {
+                        second = best;
+                        best = dist;
+                        best_j = j;
+                    } else if (dist < second) {
+                        second = dist;
+                    }
+                }
+                if (best > config.max_hamming || best >= config.ratio_test * second) {
+                    continue;
+                }
+                const Landmark* lm = map.find(m->observations[best_j].landmark);
+                if (lm == nullptr) {
+                    continue;
+                }
+                from.push_back(q->pose.transform(lq->position));
+                to.push_back(m->pose.transform(lm->position));
+            }
+            const int n = static_cast<int>(from.size());
+            if (n < config.min_matches || n < 3) {
+                return false;
+            }
+
+            auto inliers_of = [&](const geometry::Sim3& S, std::vector<int>* keep) {
+                int count = 0;
+                for (int i = 0; i < n; ++i) {
+                    const geometry::Vec3 p = S.transform(from[i]);
+                    const double dx = p[0] - to[i][0], dy = p[1] - to[i][1], dz = p[2] - to[i][2];
+                    const double range2 =
+                        to[i][0] * to[i][0] + to[i][1] * to[i][1] + to[i][2] * to[i][2];
+                    if (dx * dx + dy * dy + dz * dz <
+                        config.inlier_ratio * config.inlier_ratio * range2) {
+                        ++count;
+                        if (keep != nullptr) {
+                            keep->push_back(i);
+                        }
+                    }
+                }
+                return count;
+            };
+
+            uint32_t state = static_cast<uint32_t>(query * 2654435761u + match);
+            auto next = [&state](int range) {
+                state = state * 1664525u + 1013904223u;
+                return static_cast<int>((state >> 8) % static_cast<uint32_t>(range));
+            };
+            geometry::Sim3 best_model;
+            int best_count = 0;
+            for (int it = 0; it < config.ransac_iterations; ++it) {
+                const int a = next(n), b = next(n), c = next(n);
+                if (a == b || b == c || a == c) {
+                    continue;
+                }
+                const geometry::Vec3 sa[3] = {from[a], from[b], from[c]};
+                const geometry::Vec3 sb[3] = {to[a], to[b], to[c]};
+                geometry::Sim3 model;
+                if (!geometry::align_sim3(sa, sb, 3, model)) {
+                    continue;
+                }
+                const int count = inliers_of(model, nullptr);
+                if (count > best_count) {
+                    best_count = count;
+                    best_model = model;
+                }
+            }
+            if (best_count < config.min_inliers) {
+                return false;
+            }
+
+            // Refit on every inlier of the best hypothesis.
+            std::vector<int> keep;
+            inliers_of(best_model, &keep);
+            std::vector<geometry::Vec3> fa, fb;
+            for (int i : keep) {
+                fa.push_back(from[i]);
+                fb.push_back(to[i]);
+            }
+            geometry::Sim3 refined;
+            if (geometry::align_sim3(fa.data(), fb.data(), fa.size(), refined) &&
+                inliers_of(refined, nullptr) >= best_count) {
+                best_model = refined;
+            }
+
+            out.query = query;
+            out.match = match;
+            out.relative = best_model;
+            out.inliers = inliers_of(best_model, nullptr);
+            return out.inliers >= config.min_inliers;
+        }
+
+        /**
+         * @brief Essential graph of @p map: one node per keyframe (keyframe 0 fixed),
+         * odometry edges between consecutive keyframes, the strongest covisibility
+         * edges and one edge per loop.
+         */
+        static PoseGraph make_graph(const LandmarkMap& map,
+                                    const std::vector<LoopConstraint>& loops,
+                                    const Config& config) {
+            PoseGraph graph;
+            const KeyframeDatabase& db = map.database();
+            const int n = static_cast<int>(db.size());
+            graph.nodes.reserve(n);
+            graph.fixed.assign(n, false);
+            for (const MapKeyframe& kf : db.keyframes()) {
+                graph.nodes.emplace_back(kf.pose);
+            }
+            if (n > 0) {
+                graph.fixed[0] = true;  // Gauge: the world frame is keyframe 0's camera.
+            }
+
+            // Edges carry the current relative poses, so only the loops disagree.
+            auto relative = [&graph](int a, int b) {
+                return geometry::compose(graph.nodes[a], graph.nodes[b].inverse());
+            };
+            for (int k = 1; k < n; ++k) {
+                graph.edges.push_back({k - 1, k, relative(k - 1, k), 1.0});
+                int added = 0;
+                for (const CovisibilityEdge& e : db.neighbours(k)) {
+                    if (added >= config.covisibility_edges ||
+                        e.weight < config.covisibility_weight) {
+                        break;
+                    }
+                    if (e.keyframe < k - 1) {
+                        graph.edges.push_back({e.keyframe, k, relative(e.keyframe, k), 1.0});
+                        ++added;
+                    }
+                }
+            }
+            for (const LoopConstraint& loop : loops) {
+                if (loop.match < n && loop.query < n) {
+                    graph.edges.push_back({loop.match, loop.query, loop.relative,
+                                           config.loop_weight});
+                }
+            }
+            return graph;
+        }
+
+        /**
+         * @brief Non-blocking: take the finished correction, if any.
+         * @return true if @p out was filled.
+         */
+        bool poll(MapCorrection& out) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!has_result_) {
+                return false;
+            }
+            out = std::move(result_);
+            has_result_ = false;
+            return true;
+        }
+
+        /// True while a pose-graph optimisation is running.
+        bool busy() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return has_job_;
+        }
+
+        /// Block until the in-flight optimisation (if any) has finished.
+        void wait_idle() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return !has_job_; });
+        }
+
+        /// Every loop verified so far, oldest first.
+        const std::vector<LoopConstraint>& loops() const { return loops_; }
+
+        /// Solver summary of the most recently finished optimisation (poll() has no
+        /// correction for one that accepted no step).
+        PoseGraphSummary last_summary() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return summary_;
+        }
+
+    private:
+        static bool is_blank(const uint8_t* d) {
+            return std::all_of(d, d + kDescriptorBytes, [](uint8_t b) { return b == 0; });
+        }
+
+        // Descriptor rows of @p kf that hold a real descriptor (padding rows are zero).
+        static void valid_rows(const MapKeyframe& kf,
+                               std::vector<std::size_t>& rows,
+                               std::vector<uint8_t>& packed) {
+            rows.clear();
+            packed.clear();
+            for (std::size_t i = 0; i < kf.observations.size(); ++i) {
+                const uint8_t* d = kf.descriptor(i);
+                if (d != nullptr && !is_blank(d)) {
+                    rows.push_back(i);
+                    packed.insert(packed.end(), d, d + kDescriptorBytes);
+                }
+            }
+        }
+
+        void submit(const LandmarkMap& map) {
+            {
+                // An unpolled result means the map has not been corrected yet:
+                // a graph built from it now would apply that correction twice.
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (has_job_ || has_result_) {
+                    return;
+                }
+            }
+            PoseGraph graph = make_graph(map, loops_, config_);
+            std::vector<geometry::Pose> before;
+            before.reserve(map.keyframes().size());
+            for (const MapKeyframe& kf : map.keyframes()) {
+                before.push_back(kf.pose);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                job_ = std::move(graph);
+                job_before_ = std::move(before);
+                has_job_ = true;
+            }
+            submitted_loops_ = loops_.size();
+            cv_.notify_all();
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                cv_.wait(lock, [this] { return stop_ || has_job_; });
+                if (stop_) {
+                    return;
+                }
+                // The job is only touched by this thread until has_job_ is cleared.
+                lock.unlock();
+                PoseGraphSummary summary = optimise_pose_graph(job_, config_.solver);
+                MapCorrection correction;
+                correction.newest_keyframe = static_cast<int>(job_.nodes.size()) - 1;
+                correction.keyframes.reserve(job_.nodes.size());
+                for (std::size_t k = 0; k < job_.nodes.size(); ++k) {
+                    correction.keyframes.push_back(
+                        {static_cast<int>(k), job_before_[k], job_.nodes[k]});
+                }
+                lock.lock();
+
+                // With no accepted step (out of time, or stalled) the graph is
+                // unchanged: there is nothing to correct.
+                result_ = std::move(correction);
+                summary_ = summary;
+                has_result_ = summary.accepted > 0;
+                has_job_ = false;
+                cv_.notify_all();
+            }
+        }
+
+        std::shared_ptr<const Vocabulary> vocabulary_;
+        Config config_;
+
+        // Mapper-thread state.
+        BowIndex index_;
+        std::vector<LoopConstraint> loops_;
+        std::size_t submitted_loops_ = 0;  // Loops already handed to an optimisation.
+        int last_loop_ = -1000000;         // Query keyframe of the last accepted loop.
+        BowVector bow_;
+        std::vector<BowMatch> candidates_;
+        std::vector<std::size_t> rows_;
+        std::vector<uint8_t> scratch_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stop_ = false;
+        bool has_job_ = false;
+        bool has_result_ = false;
+        PoseGraph job_;
+        std::vector<geometry::Pose> job_before_;
+        MapCorrection result_;
+        PoseGraphSummary summary_;
+
+        std::thread worker_;  // Declared last: started after every member above exists.
+    };
+
+}  // namespace ar_slam
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+
+#include "core/concurrent_memory_pool.h"
+
+namespace ar_slam {
+
+    namespace magazine_detail {
+
+        /// Ids of the MagazinePools alive in the process, so a thread exiting
+        /// after a pool was destroyed does not flush into freed memory.
+        struct Registry {
+            std::mutex mutex;
+            std::unordered_set<uint64_t> live;
+            uint64_t next_id = 1;
+        };
+
+        inline Registry& registry() {
+            static Registry instance;
+            return instance;
+        }
+
+    }  // namespace magazine_detail
+
+    /**
+     * @brief ConcurrentMemoryPool with a per-thread cache ("magazine") of free slots.
+     *
+     * Even a lock-free free-list makes every thread contend on one cache line,
+     * its head. Here each thread keeps a bounded stack of free slots per pool:
+     * allocate() pops from it and deallocate() pushes onto it, touching only
+     * thread-local memory. An empty magazine is refilled with half its size in
+     * one batch CAS on the shared pool, and a full one flushes half back the
+     * same way, so the shared head is hit at most once per magazine_size / 2
+     * operations per thread and a thread alternating allocate and free never
+     * reaches it. A slot freed by another thread than the one that allocated it
+     * simply joins the freeing thread's magazine.
+     *
+     * A thread's magazines are returned to their pools when the thread exits
+     * (or on flush()). A thread caches slots for at most kMaxPools pools of one
+     * type at a time; beyond that, it goes to the shared pool directly.
+     *
+     * The capacity stays a hard limit, but slots parked in other threads'
+     * magazines count as used: used() reports slots taken from the shared pool,
+     * and allocate() can return nullptr while other threads still cache free
+     * slots. Non-copyable and non-movable (threads cache it by address).
+     *
+     * @tparam T Object type stored in the pool.
+     */
+    template <typename T>
+    class MagazinePool {
+    public:
+        /// Pools of one type a thread can hold magazines for at once.
+        static constexpr std::size_t kMaxPools = 4;
+
+        /**
+         * @param max_bytes     Storage budget of the shared pool (see ConcurrentMemoryPool).
+         * @param magazine_size Free slots each thread may cache (at least 2).
+         */
+        explicit MagazinePool(std::size_t max_bytes = 256ull * 1024 * 1024,
+                              std::size_t magazine_size = 64)
+            : shared_(max_bytes), magazine_size_(magazine_size < 2 ? 2 : magazine_size) {
+            magazine_detail::Registry& registry = magazine_detail::registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            id_ = registry.next_id++;
+            registry.live.insert(id_);
+        }
+
+        ~MagazinePool() {
+            // Other threads' magazines still pointing here are abandoned with
+            // the slab; the calling thread's entry is released for reuse.
+            magazine_detail::Registry& registry = magazine_detail::registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.live.erase(id_);
+            for (Magazine& magazine : cache_.magazines) {
+                if (magazine.pool_id == id_) {
+                    magazine.pool_id = 0;
+                    magazine.count = 0;
+                }
+            }
+        }
+
+        MagazinePool(const MagazinePool&) = delete;
+        MagazinePool& operator=(const MagazinePool&) = delete;
+
+        /**
+         * @brief Reserve one slot of raw, uninitialised storage.
+         * @return Pointer to storage for a T, or nullptr if the shared pool is exhausted.
+         */
+        T* allocate() noexcept {
+            Magazine* magazine = local();
+            if (magazine == nullptr) {
+                return shared_.allocate();
+            }
+            if (magazine->count == 0) {
+                magazine->count = shared_.allocate_batch(magazine->slots.get(), batch());
+                if (magazine->count == 0) {
+                    return nullptr;
+                }
+            }
+            return magazine->slots[--magazine->count];
+        }
+
+        /**
+         * @brief Return a slot to the calling thread's magazine.
+         * @param ptr Pointer previously returned by allocate()/create() on any
+         *            thread; nullptr is ignored. Does not call the destructor.
+         */
+        void deallocate(T* ptr) noexcept {
+            if (ptr == nullptr) {
+                return;
+            }
+            Magazine* magazine = local();
+            if (magazine == nullptr) {
+                shared_.deallocate(ptr);
+                return;
+            }
+            if (magazine->count == magazine_size_) {
+                // Flush the older half; the newest slots are the warmest in cache.
+                const std::size_t n = batch();
+                shared_.deallocate_batch(magazine->slots.get(), n);
+                std::move(magazine->slots.get() + n, magazine->slots.get() + magazine->count,
+                          magazine->slots.get());
+                magazine->count -= n;
+            }
+            magazine->slots[magazine->count++] = ptr;
+        }
+
+        /**
+         * @brief Allocate a slot and construct a T in place.
+         * @return Pointer to the constructed object, or nullptr if the pool is full.
+         *         If the constructor throws, the slot is returned to the pool and
+         *         the exception propagates.
+         */
+        template <typename... Args>
+        T* create(Args&&... args) {
+            T* storage = allocate();
+            if (storage == nullptr) {
+                return nullptr;
+            }
+            try {
+                return ::new (storage) T(std::forward<Args>(args)...);
+            } catch (...) {
+                deallocate(storage);
+                throw;
+            }
+        }
+
+        /**
+         * @brief Destroy an object created with create() and reclaim its slot.
+         */
+        void destroy(T* ptr) noexcept {
+            if (ptr == nullptr) {
+                return;
+            }
+            ptr->~T();
+            deallocate(ptr);
+        }
+
+        /// Return the calling thread's cached slots to the shared pool.
+        void flush() noexcept {
+            for (Magazine& magazine : cache_.magazines) {
+                if (magazine.pool_id == id_) {
+                    shared_.deallocate_batch(magazine.slots.get(), magazine.count);
+                    magazine.count = 0;
+                }
+            }
+        }
+
+        /// Free slots cached by the calling thread.
+        std::size_t cached() const noexcept {
+            for (const Magazine& magazine : cache_.magazines) {
+                if (magazine.pool_id == id_) {
+                    return magazine.count;
+                }
+            }
+            return 0;
+        }
+
+        /// Maximum number of objects the pool can hold.
+        std::size_t capacity() const noexcept { return shared_.capacity(); }
+
+        /// Slots taken from the shared pool: live objects plus every thread's magazines.
+        std::size_t used() const noexcept { return shared_.used(); }
+
+        /// Slots left in the shared pool.
+        std::size_t available() const noexcept { return shared_.available(); }
+
+        /// Free slots each thread may cache.
+        std::size_t magazine_size() const noexcept { return magazine_size_; }
+
+        /// True if @p ptr points into this pool's slab.
+        bool owns(const T* ptr) const noexcept { return shared_.owns(ptr); }
+
+    private:
+        struct Magazine {
+            uint64_t pool_id = 0;  ///< 0: unused.
+            ConcurrentMemoryPool<T>* pool = nullptr;
+            std::unique_ptr<T*[]> slots;
+            std::size_t capacity = 0;
+            std::size_t count = 0;
+        };
+
+        /// One thread's magazines for every MagazinePool<T>.
+        struct ThreadCache {
+            Magazine magazines[kMaxPools];
+            uint64_t uncached_id = 0;  ///< Last pool refused an entry (all were live).
+
+            ~ThreadCache() {
+                magazine_detail::Registry& registry = magazine_detail::registry();
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                for (Magazine& magazine : magazines) {
+                    if (magazine.pool_id != 0 && magazine.count > 0 &&
+                        registry.live.count(magazine.pool_id) != 0) {
+                        magazine.pool->deallocate_batch(magazine.slots.get(), magazine.count);
+                    }
+                }
+            }
+        };
+
+        static thread_local ThreadCache cache_;
+
+        std::size_t batch() const { return magazine_size_ / 2; }
+
+        Magazine* local() noexcept {
+            for (Magazine& magazine : cache_.magazines) {
+                if (magazine.pool_id == id_) {
+                    return &magazine;
+                }
+            }
+            return cache_.uncached_id == id_ ? nullptr : attach();
+        }
+
+        /// First use of this pool on the calling thread: claim a free (or dead) entry.
+        Magazine* attach() noexcept {
+            magazine_detail::Registry& registry = magazine_detail::registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (Magazine& magazine : cache_.magazines) {
+                if (magazine.pool_id != 0 && registry.live.count(magazine.pool_id) != 0) {
+                    continue;
+                }
+                if (magazine.capacity < magazine_size_) {
+                    magazine.slots.reset(new (std::nothrow) T*[magazine_size_]);
+                    magazine.capacity = magazine.slots ? magazine_size_ : 0;
+                    if (!magazine.slots) {
+                        return nullptr;
+                    }
+                }
+                magazine.pool_id = id_;
+                magazine.pool = &shared_;
+                magazine.count = 0;
+                return &magazine;
+            }
+            cache_.uncached_id = id_;  // Every entry serves a live pool: stay uncached.
+            return nullptr;
+        }
+
+        ConcurrentMemoryPool<T> shared_;
+        std::size_t magazine_size_;
+        uint64_t id_ = 0;
+    };
+
+    template <typename T>
+    thread_local typename MagazinePool<T>::ThreadCache MagazinePool<T>::cache_;
+
+}  // namespace ar_slam
@@ -0,0 +1,827 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "core/landmark_map.h"
+
+namespace ar_slam {
+
+    // The arrays below are written and mapped back byte for byte.
+    static_assert(sizeof(int) == 4, "Map files store ids as 32-bit integers");
+    static_assert(std::is_trivially_copyable<geometry::Pose>::value &&
+                      sizeof(geometry::Pose) == 96,
+                  "geometry::Pose is part of the map file format");
+    static_assert(sizeof(geometry::Vec3) == 24, "geometry::Vec3 is part of the map file format");
+    static_assert(std::is_trivially_copyable<MapObservation>::value &&
+                      sizeof(MapObservation) == 24,
+                  "MapObservation is part of the map file format");
+    static_assert(std::is_trivially_copyable<CovisibilityEdge>::value &&
+                      sizeof(CovisibilityEdge) == 8,
+                  "CovisibilityEdge is part of the map file format");
+    static_assert(std::is_trivially_copyable<LandmarkAlias>::value && sizeof(LandmarkAlias) == 8,
+                  "LandmarkAlias is part of the map file format");
+
+    namespace map_file_detail {
+
+        constexpr uint32_t kFileVersion = 1;
+        constexpr uint64_t kAlignment = 64;  ///< Every segment and section starts on a cache line.
+        constexpr bool kLittleEndian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+        /// Section slots of a segment, in file order.
+        enum Section : uint32_t {
+            kKeyframeIds,
+            kKeyframePoses,
+            kObservationOffsets,
+            kObservations,
+            kDescriptors,
+            kLandmarkIds,
+            kLandmarkPositions,
+            kLandmarkObservations,
+            kLandmarkFirstKeyframes,
+            kLandmarkLastKeyframes,
+            kAliases,
+            kCovisibilityOffsets,
+            kCovisibilityEdges,
+            kSectionCount
+        };
+
+        /// Bytes per element of each section.
+        constexpr uint32_t kElementSize[kSectionCount] = {
+            4, 96, 4, 24, static_cast<uint32_t>(kDescriptorBytes), 4, 24, 4, 4, 4, 8, 4, 8};
+
+        /// Section slots in every segment header; later versions may use the spare ones.
+        constexpr uint32_t kMaxSections = 16;
+
+        /// Little-endian file header (one cache line); segments follow it.
+        struct FileHeader {
+            char magic[4];  // "ARMP"
+            uint32_t version;
+            uint32_t alignment;
+            uint32_t reserved0;
+            uint64_t reserved[5];
+            uint64_t checksum;  // Of the 56 bytes above.
+        };
+        static_assert(sizeof(FileHeader) == 64, "FileHeader is part of the file format");
+
+        struct SectionEntry {
+            uint64_t offset;  // From the segment start; a multiple of kAlignment.
+            uint64_t count;   // Elements.
+            uint32_t element_size;
+            uint32_t reserved;
+            uint64_t checksum;  // Of the count * element_size bytes.
+        };
+        static_assert(sizeof(SectionEntry) == 32, "SectionEntry is part of the file format");
+
+        struct SegmentHeader {
+            char magic[4];  // "ARMS"
+            uint32_t kind;
+            uint32_t sequence;
+            uint32_t section_count;
+            uint64_t size;      // Header and sections, a multiple of kAlignment.
+            uint64_t checksum;  // Of the header with this field zeroed.
+            SectionEntry sections[kMaxSections];
+        };
+        static_assert(sizeof(SegmentHeader) == 544, "SegmentHeader is part of the file format");
+
+        /// The segment header padded to the alignment; the first section follows.
+        constexpr uint64_t kSegmentHeaderSize = 576;
+
+        inline uint64_t align(uint64_t n) { return (n + kAlignment - 1) / kAlignment * kAlignment; }
+
+        inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+        /**
+         * @brief 64-bit checksum of @p size bytes.
+         *
+         * Four independent lanes of 8-byte words, each mixed with xxHash64's
+         * round, then xxHash64's final avalanche (the construction, not the
+         * xxHash64 value). Catches torn and corrupted sections at close to memory
+         * bandwidth; it is not a cryptographic hash.
+         */
+        inline uint64_t checksum(const void* data, std::size_t size) {
+            constexpr uint64_t kP1 = 0x9E3779B185EBCA87ull;
+            constexpr uint64_t kP2 = 0xC2B2AE3D27D4EB4Full;
+            constexpr uint64_t kP3 = 0x165667B19E3779F9ull;
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            uint64_t lane[4] = {kP1 + kP2, kP2, 0, 0 - kP1};
+            std::size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                for (int k = 0; k < 4; ++k) {
+                    uint64_t w;
+                    std::memcpy(&w, p + i + 8 * k, 8);
+                    lane[k] = rotl(lane[k] + w * kP2, 31) * kP1;
+                }
+            }
+            uint64_t h = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) +
+                         rotl(lane[3], 18) + static_cast<uint64_t>(size);
+            for (; i < size; ++i) {
+                h = rotl(h ^ (p[i] * kP3), 11) * kP1;
+            }
+            h ^= h >> 33;
+            h *= kP2;
+            h ^= h >> 29;
+            h *= kP3;
+            h ^= h >> 32;
+            return h;
+        }
+
+        inline uint64_t header_checksum(FileHeader header) {
+            return checksum(&header, offsetof(FileHeader, checksum));
+        }
+
+        inline uint64_t header_checksum(SegmentHeader header) {
+            header.checksum = 0;
+            return checksum(&header, sizeof(header));
+        }
+
+    }  // namespace map_file_detail
+
+    /// Read-only array inside a mapped map file.
+    template <typename T>
+    struct MapArray {
+        const T* data = nullptr;
+        std::size_t size = 0;
+
+        const T* begin() const { return data; }
+        const T* end() const { return data + size; }
+        const T& operator[](std::size_t i) const { return data[i]; }
+        bool empty() const { return size == 0; }
+    };
+
+    /**
+     * @brief One segment of a map file, as structure-of-arrays used in place.
+     *
+     * Entry k of the keyframe arrays is keyframe keyframe_ids[k] at poses[k];
+     * its observations are observations[observation_offsets[k] ..
+     * observation_offsets[k + 1]), each with a descriptor row when descriptors
+     * is not empty (all-zero rows mean "none"). Entry i of the landmark arrays is
+     * one landmark. Snapshot segments hold the whole map and every keyframe's
+     * covisibility neighbours (covisibility_offsets works like
+     * observation_offsets); append segments hold only what changed since the
+     * previous segment (see MapWriter) and no covisibility.
+     */
+    struct MapSegment {
+        enum Kind : uint32_t {
+            kSnapshot = 1,  ///< The whole map; earlier segments are superseded.
+            kAppend = 2,    ///< Changes since the previous segment.
+        };
+
+        Kind kind = kSnapshot;
+        uint32_t sequence = 0;  ///< Position of the segment in the file.
+
+        MapArray<int32_t> keyframe_ids;
+        MapArray<geometry::Pose> poses;
+        MapArray<uint32_t> observation_offsets;  ///< keyframe_ids.size + 1 entries.
+        MapArray<MapObservation> observations;
+        MapArray<uint8_t> descriptors;  ///< kDescriptorBytes per observation, or empty.
+
+        MapArray<int32_t> landmark_ids;
+        MapArray<geometry::Vec3> positions;
+        MapArray<int32_t> landmark_observations;  ///< Landmark::observations.
+        MapArray<int32_t> first_keyframes;        ///< Landmark::first_keyframe.
+        MapArray<int32_t> last_keyframes;         ///< Landmark::last_keyframe.
+        MapArray<LandmarkAlias> aliases;
+
+        MapArray<uint32_t> covisibility_offsets;  ///< Empty in append segments.
+        MapArray<CovisibilityEdge> covisibility;
+
+        /// Observations of entry @p k of the keyframe arrays.
+        MapArray<MapObservation> observations_of(std::size_t k) const {
+            const uint32_t b = observation_offsets[k];
+            return {observations.data + b, observation_offsets[k + 1] - b};
+        }
+
+        /// Covisibility neighbours of entry @p k, by descending weight (snapshots only).
+        MapArray<CovisibilityEdge> neighbours_of(std::size_t k) const {
+            if (covisibility_offsets.empty()) {
+                return {};
+            }
+            const uint32_t b = covisibility_offsets[k];
+            return {covisibility.data + b, covisibility_offsets[k + 1] - b};
+        }
+
+        /// Descriptor row of observation @p i, or nullptr if the segment has none.
+        const uint8_t* descriptor(std::size_t i) const {
+            return descriptors.empty() ? nullptr : descriptors.data + i * kDescriptorBytes;
+        }
+    };
+
+    /**
+     * @brief Read-only, memory-mapped map file written by MapWriter.
+     *
+     * The file is a little-endian header followed by segments, each a header
+     * with a section table and then the sections themselves, every one aligned
+     * to 64 bytes and covered by a checksum. The sections are the arrays of
+     * MapSegment, so open() maps the file and points into it: there is nothing
+     * to parse, only headers and offset tables to check, and opening a map of
+     * a million landmarks costs a few page faults rather than a re-run of the
+     * session. restore() turns the file back into an editable LandmarkMap when
+     * mapping is to continue.
+     */
+    class MapFile {
+    public:
+        MapFile() = default;
+        ~MapFile() { close(); }
+
+        MapFile(const MapFile&) = delete;
+        MapFile& operator=(const MapFile&) = delete;
+
+        MapFile(MapFile&& other) noexcept { *this = std::move(other); }
+
+        MapFile& operator=(MapFile&& other) noexcept {
+            if (this != &other) {
+                close();
+                segments_ = std::move(other.segments_);
+                mapping_ = other.mapping_;
+                mapping_size_ = other.mapping_size_;
+                valid_size_ = other.valid_size_;
+                truncated_ = other.truncated_;
+                other.segments_.clear();
+                other.mapping_ = nullptr;
+                other.mapping_size_ = 0;
+                other.valid_size_ = 0;
+                other.truncated_ = false;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Map a file written by MapWriter (read-only, zero-copy).
+         * @param verify Also check every section's checksum, which reads the whole
+         *               file; headers and offset tables are always checked.
+         * @return false if the file is missing, corrupt or not a map file. A last
+         *         segment cut short (a crash mid-append) is not an error: it is
+         *         left out and truncated() reports it.
+         */
+        bool open(const std::string& path, bool verify = true) {
+            close();
+            if (!map_file_detail::kLittleEndian) {
+                return false;
+            }
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat st {};
+            void* mapped = MAP_FAILED;
+            if (::fstat(fd, &st) == 0 &&
+                static_cast<std::size_t>(st.st_size) >= sizeof(map_file_detail::FileHeader)) {
+                mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            ::close(fd);  // The mapping keeps the file referenced.
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+            mapping_ = mapped;
+            mapping_size_ = static_cast<std::size_t>(st.st_size);
+
+            map_file_detail::FileHeader header;
+            std::memcpy(&header, mapping_, sizeof(header));
+            if (std::memcmp(header.magic, "ARMP", 4) != 0 ||
+                header.version != map_file_detail::kFileVersion ||
+                header.alignment != map_file_detail::kAlignment ||
+                header.checksum != map_file_detail::header_checksum(header)) {
+                close();
+                return false;
+            }
+
+            uint64_t offset = sizeof(header);
+            while (offset < mapping_size_) {
+                MapSegment segment;
+                uint64_t size = 0;
+                const int status = parse_segment(offset, verify, segment, size);
+                if (status < 0) {
+                    close();
+                    return false;
+                }
+                if (status == 0) {
+                    truncated_ = true;
+                    break;
+                }
+                segments_.push_back(segment);
+                offset += size;
+            }
+            valid_size_ = offset;
+            return true;
+        }
+
+        /// Unmap the file; every MapSegment obtained from it becomes invalid.
+        void close() {
+            if (mapping_ != nullptr) {
+                ::munmap(mapping_, mapping_size_);
+                mapping_ = nullptr;
+                mapping_size_ = 0;
+            }
+            segments_.clear();
+            valid_size_ = 0;
+            truncated_ = false;
+        }
+
+        bool is_open() const { return mapping_ != nullptr; }
+
+        /// Complete segments, in file order.
+        const std::vector<MapSegment>& segments() const { return segments_; }
+
+        /// Newest snapshot segment (where restore() starts), or nullptr.
+        const MapSegment* snapshot() const {
+            for (auto it = segments_.rbegin(); it != segments_.rend(); ++it) {
+                if (it->kind == MapSegment::kSnapshot) {
+                    return &*it;
+                }
+            }
+            return nullptr;
+        }
+
+        /// True if a torn last segment was left out.
+        bool truncated() const { return truncated_; }
+
+        /// Bytes of the header and the complete segments (where the next segment goes).
+        uint64_t valid_size() const { return valid_size_; }
+
+        /**
+         * @brief Rebuild an editable map: the newest snapshot, then every later
+         *        segment in order.
+         *
+         * The snapshot loads in one linear pass (its covisibility graph is taken
+         * as saved); later segments replay their keyframes through
+         * LandmarkMap::apply(), which extends the graph as it did live.
+         * @return false, leaving @p map cleared, if there is no snapshot or a
+         *         segment is inconsistent with the map built so far.
+         */
+        bool restore(LandmarkMap& map) const {
+            map.clear();
+            const MapSegment* start = snapshot();
+            if (start == nullptr) {
+                return segments_.empty();
+            }
+            for (const MapSegment* s = start; s != segments_.data() + segments_.size(); ++s) {
+                if (!restore_segment(*s, map)) {
+                    map.clear();
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        // Check the segment at @p offset and point @p out into it: 1 if complete,
+        // 0 if cut short by the end of the file, -1 if corrupt.
+        int parse_segment(uint64_t offset, bool verify, MapSegment& out, uint64_t& size) const {
+            using namespace map_file_detail;
+            const uint64_t remaining = mapping_size_ - offset;
+            if (remaining < kSegmentHeaderSize) {
+                return 0;
+            }
+            const char* base = static_cast<const char*>(mapping_) + offset;
+            SegmentHeader header;
+            std::memcpy(&header, base, sizeof(header));
+            if (std::memcmp(header.magic, "ARMS", 4) != 0 ||
+                header.checksum != header_checksum(header)) {
+                return -1;
+            }
+            if (header.size > remaining) {
+                return 0;
+            }
+            if (header.size < kSegmentHeaderSize || header.size % kAlignment != 0 ||
+                header.section_count < kSectionCount || header.section_count > kMaxSections ||
+                (header.kind != MapSegment::kSnapshot && header.kind != MapSegment::kAppend)) {
+                return -1;
+            }
+            const void* data[kSectionCount];
+            std::size_t count[kSectionCount];
+            for (uint32_t s = 0; s < kSectionCount; ++s) {
+                const SectionEntry& e = header.sections[s];
+                if (e.element_size != kElementSize[s] || e.offset % kAlignment != 0 ||
+                    e.offset < kSegmentHeaderSize || e.offset > header.size ||
+                    e.count > (header.size - e.offset) / e.element_size) {
+                    return -1;
+                }
+                data[s] = base + e.offset;
+                count[s] = static_cast<std::size_t>(e.count);
+                if (verify && checksum(data[s], count[s] * e.element_size) != e.checksum) {
+                    return -1;
+                }
+            }
+
+            const std::size_t keyframes = count[kKeyframeIds];
+            const std::size_t landmarks = count[kLandmarkIds];
+            const bool has_covisibility = count[kCovisibilityOffsets] != 0;
+            if (count[kKeyframePoses] != keyframes || count[kObservationOffsets] != keyframes + 1 ||
+                (count[kDescriptors] != 0 && count[kDescriptors] != count[kObservations]) ||
+                count[kLandmarkPositions] != landmarks ||
+                count[kLandmarkObservations] != landmarks ||
+                count[kLandmarkFirstKeyframes] != landmarks ||
+                count[kLandmarkLastKeyframes] != landmarks ||
+                (has_covisibility && count[kCovisibilityOffsets] != keyframes + 1) ||
+                (has_covisibility && header.kind != MapSegment::kSnapshot) ||
+                !monotone(static_cast<const uint32_t*>(data[kObservationOffsets]), keyframes + 1,
+                          count[kObservations]) ||
+                (has_covisibility &&
+                 !monotone(static_cast<const uint32_t*>(data[kCovisibilityOffsets]),
+                           keyframes + 1, count[kCovisibilityEdges]))) {
+                return -1;
+            }
+
+            out.kind = static_cast<MapSegment::Kind>(header.kind);
+            out.sequence = header.sequence;
+            out.keyframe_ids = array<int32_t>(data, count, kKeyframeIds);
+            out.poses = array<geometry::Pose>(data, count, kKeyframePoses);
+            out.observation_offsets = array<uint32_t>(data, count, kObservationOffsets);
+            out.observations = array<MapObservation>(data, count, kObservations);
+            out.descriptors = {static_cast<const uint8_t*>(data[kDescriptors]),
+                               count[kDescriptors] * kDescriptorBytes};
+            out.landmark_ids = array<int32_t>(data, count, kLandmarkIds);
+            out.positions = array<geometry::Vec3>(data, count, kLandmarkPositions);
+            out.landmark_observations = array<int32_t>(data, count, kLandmarkObservations);
+            out.first_keyframes = array<int32_t>(data, count, kLandmarkFirstKeyframes);
+            out.last_keyframes = array<int32_t>(data, count, kLandmarkLastKeyframes);
+            out.aliases = array<LandmarkAlias>(data, count, kAliases);
+            out.covisibility_offsets = array<uint32_t>(data, count, kCovisibilityOffsets);
+            out.covisibility = array<CovisibilityEdge>(data, count, kCovisibilityEdges);
+            size = header.size;
+            return 1;
+        }
+
+        template <typename T>
+        static MapArray<T> array(const void* const* data, const std::size_t* count, int s) {
+            return {static_cast<const T*>(data[s]), count[s]};
+        }
+
+        // Offset tables start at 0, never decrease and end at @p total.
+        static bool monotone(const uint32_t* offsets, std::size_t n, std::size_t total) {
+            if (offsets[0] != 0 || offsets[n - 1] != total) {
+                return false;
+            }
+            for (std::size_t i = 1; i < n; ++i) {
+                if (offsets[i] < offsets[i - 1]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static bool restore_segment(const MapSegment& s, LandmarkMap& map) {
+            for (std::size_t k = 0; k < s.keyframe_ids.size; ++k) {
+                const int id = s.keyframe_ids[k];
+                if (id < 0 || id > map.next_keyframe_id()) {
+                    return false;  // Keyframes are registered in id order.
+                }
+                const MapArray<MapObservation> observations = s.observations_of(k);
+                const std::size_t first = s.observation_offsets[k];
+                // A keyframe whose rows are all blank stored no descriptors.
+                std::vector<uint8_t> rows;
+                if (s.descriptor(first) != nullptr) {
+                    const uint8_t* b = s.descriptor(first);
+                    const uint8_t* e = b + observations.size * kDescriptorBytes;
+                    if (std::any_of(b, e, [](uint8_t v) { return v != 0; })) {
+                        rows.assign(b, e);
+                    }
+                }
+                if (s.kind == MapSegment::kSnapshot) {
+                    MapKeyframe keyframe;
+                    keyframe.id = id;
+                    keyframe.pose = s.poses[k];
+                    keyframe.observations.assign(observations.begin(), observations.end());
+                    keyframe.descriptors = std::move(rows);
+                    const MapArray<CovisibilityEdge> edges = s.neighbours_of(k);
+                    map.restore_keyframe(std::move(keyframe),
+                                         std::vector<CovisibilityEdge>(edges.begin(), edges.end()));
+                } else {
+                    MapDelta delta;
+                    delta.keyframe.id = id;
+                    delta.keyframe.pose = s.poses[k];
+                    delta.observations.assign(observations.begin(), observations.end());
+                    delta.descriptors = std::move(rows);
+                    map.apply(delta);
+                }
+            }
+            for (std::size_t i = 0; i < s.landmark_ids.size; ++i) {
+                Landmark lm;
+                lm.id = s.landmark_ids[i];
+                lm.position = s.positions[i];
+                lm.observations = s.landmark_observations[i];
+                lm.first_keyframe = s.first_keyframes[i];
+                lm.last_keyframe = s.last_keyframes[i];
+                map.restore_landmark(lm);
+            }
+            for (const LandmarkAlias& a : s.aliases) {
+                if (!map.restore_alias(a)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::vector<MapSegment> segments_;
+        void* mapping_ = nullptr;
+        std::size_t mapping_size_ = 0;
+        uint64_t valid_size_ = 0;
+        bool truncated_ = false;
+    };
+
+    /**
+     * @brief Streams a LandmarkMap into a map file, one segment per append().
+     *
+     * The first segment is a snapshot of the whole map. Each later append()
+     * writes only what changed since the previous segment: new keyframes and
+     * landmarks, keyframes whose pose changed or that gained observations (with
+     * just the new observations), landmarks whose position or counts changed,
+     * and new aliases. The writer keeps a copy of what it wrote to find the
+     * changes, so an append costs one comparison pass over the map plus the
+     * bytes it writes; a long session grows the file by its deltas instead of
+     * rewriting it. checkpoint() writes a fresh snapshot, after which readers
+     * skip every earlier segment (a loop correction, which moves every
+     * landmark, costs about as much either way).
+     *
+     * Segments are written whole at the end of the file and flushed; a crash
+     * mid-append leaves a torn tail that MapFile::open() ignores and resume()
+     * cuts off. A failed write closes the writer.
+     */
+    class MapWriter {
+    public:
+        MapWriter() = default;
+        ~MapWriter() { close(); }
+
+        MapWriter(const MapWriter&) = delete;
+        MapWriter& operator=(const MapWriter&) = delete;
+
+        /// Write @p map to @p path as a single snapshot.
+        static bool save(const LandmarkMap& map, const std::string& path) {
+            MapWriter writer;
+            return writer.create(path) && writer.append(map) && writer.close();
+        }
+
+        /// Start a new, empty map file at @p path (replacing any file there).
+        bool create(const std::string& path) {
+            close();
+            if (!map_file_detail::kLittleEndian) {
+                return false;
+            }
+            file_ = std::fopen(path.c_str(), "wb");
+            if (file_ == nullptr) {
+                return false;
+            }
+            map_file_detail::FileHeader header{};
+            std::memcpy(header.magic, "ARMP", 4);
+            header.version = map_file_detail::kFileVersion;
+            header.alignment = map_file_detail::kAlignment;
+            header.checksum = map_file_detail::header_checksum(header);
+            if (std::fwrite(&header, sizeof(header), 1, file_) != 1 || std::fflush(file_) != 0) {
+                close();
+                return false;
+            }
+            size_ = sizeof(header);
+            segments_ = 0;
+            forget();
+            return true;
+        }
+
+        /**
+         * @brief Continue appending to @p path, which @p map was restored from.
+         *
+         * A torn last segment is cut off first. @p map must hold exactly what
+         * the file restores to, since later appends are diffs against it.
+         */
+        bool resume(const std::string& path, const LandmarkMap& map) {
+            close();
+            MapFile existing;
+            if (!existing.open(path)) {
+                return false;
+            }
+            const uint64_t valid = existing.valid_size();
+            const uint32_t segments = static_cast<uint32_t>(existing.segments().size());
+            existing.close();
+            if (::truncate(path.c_str(), static_cast<off_t>(valid)) != 0) {
+                return false;
+            }
+            file_ = std::fopen(path.c_str(), "r+b");
+            if (file_ == nullptr || ::fseeko(file_, static_cast<off_t>(valid), SEEK_SET) != 0) {
+                close();
+                return false;
+            }
+            size_ = valid;
+            segments_ = segments;
+            forget();
+            if (segments_ > 0) {
+                remember(map);
+            }
+            return true;
+        }
+
+        /// Append the changes since the previous segment (a snapshot if this is the first).
+        bool append(const LandmarkMap& map) { return write(map, false); }
+
+        /// Append a snapshot of the whole map.
+        bool checkpoint(const LandmarkMap& map) { return write(map, true); }
+
+        /// Close the file; false if the final flush failed.
+        bool close() {
+            if (file_ == nullptr) {
+                return true;
+            }
+            const bool ok = std::fclose(file_) == 0;
+            file_ = nullptr;
+            return ok;
+        }
+
+        bool is_open() const { return file_ != nullptr; }
+
+        /// Segments in the file, including those present before resume().
+        uint32_t segments() const { return segments_; }
+
+        /// File size in bytes.
+        uint64_t size() const { return size_; }
+
+    private:
+        bool write(const LandmarkMap& map, bool snapshot) {
+            using namespace map_file_detail;
+            if (file_ == nullptr) {
+                return false;
+            }
+            const std::vector<MapKeyframe>& keyframes = map.keyframes();
+            const std::vector<Landmark>& landmarks = map.landmarks();
+            const std::vector<LandmarkAlias>& aliases = map.aliases();
+            // A map that shrank was cleared or replaced: only a snapshot describes it.
+            if (segments_ == 0 || keyframes.size() < observed_.size() ||
+                landmarks.size() < landmarks_.size() || aliases.size() < aliases_) {
+                snapshot = true;
+            }
+            if (snapshot) {
+                forget();
+            }
+
+            std::vector<int32_t> keyframe_ids;
+            std::vector<geometry::Pose> poses;
+            std::vector<uint32_t> observation_offsets{0};
+            std::vector<MapObservation> observations;
+            std::vector<uint8_t> descriptors;
+            std::vector<uint32_t> covisibility_offsets;
+            std::vector<CovisibilityEdge> covisibility;
+            if (snapshot) {
+                covisibility_offsets.push_back(0);
+            }
+            bool has_descriptors = false;
+            const std::size_t known_keyframes = observed_.size();
+            poses_.resize(keyframes.size());
+            observed_.resize(keyframes.size(), 0);
+            for (std::size_t k = 0; k < keyframes.size(); ++k) {
+                const MapKeyframe& kf = keyframes[k];
+                if (kf.id < 0) {
+                    continue;
+                }
+                const std::size_t from = observed_[k];
+                if (k < known_keyframes && from == kf.observations.size() &&
+                    std::memcmp(&poses_[k], &kf.pose, sizeof(kf.pose)) == 0) {
+                    continue;
+                }
+                keyframe_ids.push_back(kf.id);
+                poses.push_back(kf.pose);
+                for (std::size_t i = from; i < kf.observations.size(); ++i) {
+                    observations.push_back(kf.observations[i]);
+                    const uint8_t* d = kf.descriptor(i);
+                    has_descriptors = has_descriptors || d != nullptr;
+                    if (d != nullptr) {
+                        descriptors.insert(descriptors.end(), d, d + kDescriptorBytes);
+                    } else {
+                        descriptors.resize(descriptors.size() + kDescriptorBytes, 0);
+                    }
+                }
+                observation_offsets.push_back(static_cast<uint32_t>(observations.size()));
+                if (snapshot) {
+                    const std::vector<CovisibilityEdge>& edges = map.database().neighbours(kf.id);
+                    covisibility.insert(covisibility.end(), edges.begin(), edges.end());
+                    covisibility_offsets.push_back(static_cast<uint32_t>(covisibility.size()));
+                }
+                poses_[k] = kf.pose;
+                observed_[k] = kf.observations.size();
+            }
+            if (!has_descriptors) {
+                descriptors.clear();
+            }
+
+            std::vector<int32_t> landmark_ids;
+            std::vector<geometry::Vec3> positions;
+            std::vector<int32_t> counts;
+            std::vector<int32_t> first_keyframes;
+            std::vector<int32_t> last_keyframes;
+            const std::size_t known_landmarks = landmarks_.size();
+            landmarks_.resize(landmarks.size());
+            for (std::size_t i = 0; i < landmarks.size(); ++i) {
+                const Landmark& lm = landmarks[i];
+                Landmark& written = landmarks_[i];
+                if (i < known_landmarks && written.id == lm.id &&
+                    written.observations == lm.observations &&
+                    written.first_keyframe == lm.first_keyframe &&
+                    written.last_keyframe == lm.last_keyframe &&
+                    std::memcmp(&written.position, &lm.position, sizeof(lm.position)) == 0) {
+                    continue;
+                }
+                landmark_ids.push_back(lm.id);
+                positions.push_back(lm.position);
+                counts.push_back(lm.observations);
+                first_keyframes.push_back(lm.first_keyframe);
+                last_keyframes.push_back(lm.last_keyframe);
+                written = lm;
+            }
+            const std::vector<LandmarkAlias> new_aliases(aliases.begin() + aliases_, aliases.end());
+            aliases_ = aliases.size();
+
+            struct Chunk {
+                const void* data;
+                std::size_t count;
+            };
+            const Chunk chunks[kSectionCount] = {
+                {keyframe_ids.data(), keyframe_ids.size()},
+                {poses.data(), poses.size()},
+                {observation_offsets.data(), observation_offsets.size()},
+                {observations.data(), observations.size()},
+                {descriptors.data(), descriptors.size() / kDescriptorBytes},
+                {landmark_ids.data(), landmark_ids.size()},
+                {positions.data(), positions.size()},
+                {counts.data(), counts.size()},
+                {first_keyframes.data(), first_keyframes.size()},
+                {last_keyframes.data(), last_keyframes.size()},
+                {new_aliases.data(), new_aliases.size()},
+                {covisibility_offsets.data(), covisibility_offsets.size()},
+                {covisibility.data(), covisibility.size()},
+            };
+
+            SegmentHeader header{};
+            std::memcpy(header.magic, "ARMS", 4);
+            header.kind = snapshot ? MapSegment::kSnapshot : MapSegment::kAppend;
+            header.sequence = segments_;
+            header.section_count = kSectionCount;
+            uint64_t offset = kSegmentHeaderSize;
+            for (uint32_t s = 0; s < kSectionCount; ++s) {
+                const std::size_t bytes = chunks[s].count * kElementSize[s];
+                header.sections[s].offset = offset;
+                header.sections[s].count = chunks[s].count;
+                header.sections[s].element_size = kElementSize[s];
+                header.sections[s].checksum = checksum(chunks[s].data, bytes);
+                offset = align(offset + bytes);
+            }
+            header.size = offset;
+            header.checksum = header_checksum(header);
+
+            static const char kPad[kSegmentHeaderSize] = {};
+            bool ok = std::fwrite(&header, sizeof(header), 1, file_) == 1 &&
+                      std::fwrite(kPad, kSegmentHeaderSize - sizeof(header), 1, file_) == 1;
+            for (uint32_t s = 0; ok && s < kSectionCount; ++s) {
+                const std::size_t bytes = chunks[s].count * kElementSize[s];
+                const std::size_t pad = static_cast<std::size_t>(align(bytes) - bytes);
+                ok = (bytes == 0 || std::fwrite(chunks[s].data, bytes, 1, file_) == 1) &&
+                     (pad == 0 || std::fwrite(kPad, pad, 1, file_) == 1);
+            }
+            if (!ok || std::fflush(file_) != 0) {
+                close();
+                return false;
+            }
+            size_ += header.size;
+            ++segments_;
+            return true;
+        }
+
+        // Drop the record of what was written (the next segment is a snapshot).
+        void forget() {
+            poses_.clear();
+            observed_.clear();
+            landmarks_.clear();
+            aliases_ = 0;
+        }
+
+        // Record @p map as written.
+        void remember(const LandmarkMap& map) {
+            const std::vector<MapKeyframe>& keyframes = map.keyframes();
+            poses_.resize(keyframes.size());
+            observed_.resize(keyframes.size());
+            for (std::size_t k = 0; k < keyframes.size(); ++k) {
+                poses_[k] = keyframes[k].pose;
+                observed_[k] = keyframes[k].observations.size();
+            }
+            landmarks_ = map.landmarks();
+            aliases_ = map.aliases().size();
+        }
+
+        std::FILE* file_ = nullptr;
+        uint64_t size_ = 0;
+        uint32_t segments_ = 0;
+        std::vector<geometry::Pose> poses_;  // Last written pose per keyframe id.
+        std::vector<std::size_t> observed_;  // Observations written per keyframe id.
+        std::vector<Landmark> landmarks_;    // Last written state per landmark index.
+        std::size_t aliases_ = 0;            // Aliases written.
+    };
+
+}  // namespace ar_slam
@@ -1,9 +1,20 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <new>
+#include <string>
 #include <utility>
+#include <vector>
+
+#include "core/pool_stats_config.h"
+#include "core/slab_backing.h"
+
+// The counters pull in <iostream> and <mutex>; plain builds never see them.
+#if AR_SLAM_POOL_STATS
+#include "core/pool_stats.h"
+#endif
 
 namespace ar_slam {
 
@@ -22,6 +33,27 @@ namespace ar_slam {
      * or destruct objects. Use create()/destroy() for the common case where you
      * want construction and destruction handled for you.
      *
+     * Growable mode (the Growth constructor) is opt-in for pools whose demand
+     * varies widely: the byte budget becomes a ceiling, and fixed-size slabs
+     * are added only when the existing ones are full. Each slab is aligned to
+     * its own power-of-two size and keeps its own free-list and a bump pointer
+     * for never-used slots, so a new slab costs one allocation and touches no
+     * slot memory up front; allocate() takes from the first slab with room and
+     * deallocate() finds a slot's slab by masking its address, both O(1).
+     * owns() looks the masked address up in a sorted slab index. Optionally, a
+     * slab that becomes entirely free is handed back to the system (one empty
+     * slab is kept so a pool oscillating around a slab boundary does not
+     * thrash).
+     *
+     * Where the slab memory comes from is a SlabBacking policy: operator new
+     * by default, or mmap'd huge pages, optionally NUMA-bound, locked and
+     * pre-faulted so that no thread takes a first-touch page fault later.
+     *
+     * Built with AR_SLAM_POOL_STATS, the pool also counts allocations,
+     * failures and its high-water mark, registers for pool_stats() /
+     * dump_pool_stats(), and reports objects still live when it is destroyed.
+     * Without it, none of that code or state exists.
+     *
      * The type is non-copyable (it owns a unique slab) but movable.
      *
      * @tparam T Object type stored in the pool.
@@ -35,12 +67,23 @@ namespace ar_slam {
          *                  capacity is floor(max_bytes / slot_size) objects.
          */
         explicit MemoryPool(std::size_t max_bytes = 256ull * 1024 * 1024)
+            : MemoryPool(max_bytes, SlabBacking{}) {}
+
+        /**
+         * @brief Construct a fixed pool whose slab is obtained under @p backing.
+         * @throws std::bad_alloc if no memory could be obtained at all.
+         */
+        MemoryPool(std::size_t max_bytes, const SlabBacking& backing)
             : capacity_(max_bytes / kSlotSize) {
             if (capacity_ == 0) {
                 capacity_ = 1;  // Always provide room for at least one object.
             }
-            slots_ = static_cast<Slot*>(
-                ::operator new(capacity_ * sizeof(Slot), std::align_val_t{kAlign}));
+            slab_ = slab_detail::map_slab(capacity_ * sizeof(Slot), kAlign, backing);
+            if (slab_.data == nullptr) {
+                throw std::bad_alloc();
+            }
+            slots_ = static_cast<Slot*>(slab_.data);
+            AR_POOL_STATS(stats_.set_capacity(capacity_));
 
             // Thread every slot onto the free-list, front to back.
             for (std::size_t i = 0; i + 1 < capacity_; ++i) {
@@ -50,33 +93,44 @@ namespace ar_slam {
             free_head_ = &slots_[0];
         }
 
-        ~MemoryPool() { ::operator delete(slots_, std::align_val_t{kAlign}); }
+        /// Growable-mode parameters.
+        struct Growth {
+            std::size_t slab_bytes = std::size_t{1} << 20;  ///< Rounded up to a power of two.
+            bool release_free_slabs = false;  ///< Return an emptied slab to the system.
+            SlabBacking backing;              ///< How each slab's memory is obtained.
+        };
+
+        /**
+         * @brief Construct a growable pool: slabs are added on demand up to @p max_bytes.
+         * @param max_bytes Ceiling in bytes; at least one slab is always allowed.
+         *                  capacity() reports the ceiling in objects.
+         * @param growth    Slab size and release policy. No slab is allocated
+         *                  until the first allocate().
+         */
+        MemoryPool(std::size_t max_bytes, const Growth& growth)
+            : backing_(growth.backing), release_free_slabs_(growth.release_free_slabs) {
+            slot_offset_ = (sizeof(SlabHeader) + kAlign - 1) / kAlign * kAlign;
+            slab_span_ = std::max<std::size_t>(kAlign, alignof(SlabHeader));
+            while (slab_span_ < growth.slab_bytes || slab_span_ < slot_offset_ + kSlotSize) {
+                slab_span_ <<= 1;
+            }
+            slab_capacity_ = (slab_span_ - slot_offset_) / kSlotSize;
+            max_slabs_ = std::max<std::size_t>(1, max_bytes / slab_span_);
+            capacity_ = max_slabs_ * slab_capacity_;
+            AR_POOL_STATS(stats_.set_capacity(capacity_));
+        }
+
+        ~MemoryPool() { release(); }
 
         MemoryPool(const MemoryPool&) = delete;
         MemoryPool& operator=(const MemoryPool&) = delete;
 
-        MemoryPool(MemoryPool&& other) noexcept
-            : slots_(other.slots_)
-            , free_head_(other.free_head_)
-            , capacity_(other.capacity_)
-            , used_(other.used_) {
-            other.slots_ = nullptr;
-            other.free_head_ = nullptr;
-            other.capacity_ = 0;
-            other.used_ = 0;
-        }
+        MemoryPool(MemoryPool&& other) noexcept { steal(other); }
 
         MemoryPool& operator=(MemoryPool&& other) noexcept {
             if (this != &other) {
-                ::operator delete(slots_, std::align_val_t{kAlign});
-                slots_ = other.slots_;
-                free_head_ = other.free_head_;
-                capacity_ = other.capacity_;
-                used_ = other.used_;
-                other.slots_ = nullptr;
-                other.free_head_ = nullptr;
-                other.capacity_ = 0;
-                other.used_ = 0;
+                release();
+                steal(other);
             }
             return *this;
         }
@@ -86,12 +140,17 @@ namespace ar_slam {
          * @return Pointer to storage for a T, or nullptr if the pool is exhausted.
          */
         T* allocate() noexcept {
+            if (slab_span_ != 0) {
+                return allocate_from_slabs();
+            }
             if (free_head_ == nullptr) {
+                AR_POOL_STATS(stats_.on_failure());
                 return nullptr;
             }
             Slot* slot = free_head_;
             free_head_ = slot->next;
             ++used_;
+            AR_POOL_STATS(stats_.on_allocate(used_));
             return reinterpret_cast<T*>(slot);
         }
 
@@ -104,6 +163,11 @@ namespace ar_slam {
             if (ptr == nullptr) {
                 return;
             }
+            AR_POOL_STATS(stats_.on_deallocate());
+            if (slab_span_ != 0) {
+                deallocate_to_slab(ptr);
+                return;
+            }
             Slot* slot = reinterpret_cast<Slot*>(ptr);
             slot->next = free_head_;
             free_head_ = slot;
@@ -141,7 +205,7 @@ namespace ar_slam {
             deallocate(ptr);
         }
 
-        /// Maximum number of objects the pool can hold.
+        /// Maximum number of objects the pool can hold (the ceiling, when growable).
         std::size_t capacity() const noexcept { return capacity_; }
 
         /// Number of slots currently handed out.
@@ -156,11 +220,43 @@ namespace ar_slam {
         /// Bytes currently in use by live objects.
         std::size_t get_usage() const noexcept { return used_ * sizeof(T); }
 
-        /// Total bytes reserved by the backing slab.
-        std::size_t capacity_bytes() const noexcept { return capacity_ * sizeof(Slot); }
+        /// Total bytes reserved by the backing slab (the slabs allocated so far, when growable).
+        std::size_t capacity_bytes() const noexcept {
+            return slab_span_ != 0 ? slab_index_.size() * slab_span_ : capacity_ * sizeof(Slot);
+        }
 
-        /// True if @p ptr points into this pool's slab.
+        /// True for a pool built with the Growth constructor.
+        bool growable() const noexcept { return slab_span_ != 0; }
+
+        /// Slabs currently allocated (1 for a fixed pool).
+        std::size_t slabs() const noexcept {
+            return slab_span_ != 0 ? slab_index_.size() : (slots_ != nullptr ? 1 : 0);
+        }
+
+        /// Label for pool_stats() and the leak report (no-op without AR_SLAM_POOL_STATS).
+        void set_name(const std::string& name) {
+#if AR_SLAM_POOL_STATS
+            stats_.set_name(name);
+#else
+            (void)name;
+#endif
+        }
+
+        /// SlabBacking::Flags obtained for the slab (the most recent slab, when growable).
+        uint32_t backing_flags() const noexcept {
+            return slab_span_ != 0 ? backing_flags_ : slab_.flags;
+        }
+
+        /// True if @p ptr points into one of this pool's slabs.
         bool owns(const T* ptr) const noexcept {
+            if (slab_span_ != 0) {
+                const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+                auto* slab = reinterpret_cast<SlabHeader*>(address & ~(slab_span_ - 1));
+                const std::size_t offset = address - reinterpret_cast<std::uintptr_t>(slab);
+                return offset >= slot_offset_ &&
+                       offset < slot_offset_ + slab_capacity_ * kSlotSize &&
+                       std::binary_search(slab_index_.begin(), slab_index_.end(), slab);
+            }
             const auto* p = reinterpret_cast<const Slot*>(ptr);
             return p >= slots_ && p < slots_ + capacity_;
         }
@@ -177,10 +273,164 @@ namespace ar_slam {
         static constexpr std::size_t kAlign = alignof(T) > alignof(Slot*) ? alignof(T)
                                                                           : alignof(Slot*);
 
+        // Start of a growable-mode slab; its slots follow at slot_offset_.
+        struct SlabHeader {
+            SlabHeader* prev = nullptr;  // Links of the list of slabs with room.
+            SlabHeader* next = nullptr;
+            Slot* free = nullptr;        // Freed slots of this slab.
+            std::size_t carved = 0;      // Slots handed out at least once (bump pointer).
+            std::size_t used = 0;
+            slab_detail::Mapping mapping;  // The slab's own memory.
+        };
+
+        T* allocate_from_slabs() noexcept {
+            SlabHeader* slab = open_head_;
+            if (slab == nullptr && (slab = add_slab()) == nullptr) {
+                AR_POOL_STATS(stats_.on_failure());
+                return nullptr;
+            }
+            Slot* slot = slab->free;
+            if (slot != nullptr) {
+                slab->free = slot->next;
+            } else {
+                slot = reinterpret_cast<Slot*>(reinterpret_cast<unsigned char*>(slab) +
+                                               slot_offset_) +
+                       slab->carved++;
+            }
+            if (slab->used++ == 0) {
+                --empty_slabs_;
+            }
+            if (slab->used == slab_capacity_) {
+                unlink(slab);  // Full: no longer a candidate.
+            }
+            ++used_;
+            AR_POOL_STATS(stats_.on_allocate(used_));
+            return reinterpret_cast<T*>(slot);
+        }
+
+        void deallocate_to_slab(T* ptr) noexcept {
+            auto* slab = reinterpret_cast<SlabHeader*>(reinterpret_cast<std::uintptr_t>(ptr) &
+                                                       ~(slab_span_ - 1));
+            Slot* slot = reinterpret_cast<Slot*>(ptr);
+            slot->next = slab->free;
+            slab->free = slot;
+            --used_;
+            if (slab->used-- == slab_capacity_) {
+                push_front(slab);  // Was full: its freshly freed slot is warm.
+            }
+            if (slab->used == 0) {
+                // Fill other slabs first, so this one can stay empty.
+                unlink(slab);
+                push_back(slab);
+                if (++empty_slabs_ > 1 && release_free_slabs_) {
+                    free_slab(slab);
+                }
+            }
+        }
+
+        SlabHeader* add_slab() noexcept {
+            if (slab_index_.size() == max_slabs_) {
+                return nullptr;
+            }
+            const slab_detail::Mapping mapping =
+                slab_detail::map_slab(slab_span_, slab_span_, backing_);
+            if (mapping.data == nullptr) {
+                return nullptr;
+            }
+            auto* slab = ::new (mapping.data) SlabHeader();
+            slab->mapping = mapping;
+            try {
+                slab_index_.insert(
+                    std::upper_bound(slab_index_.begin(), slab_index_.end(), slab), slab);
+            } catch (...) {
+                slab_detail::unmap_slab(mapping);
+                return nullptr;
+            }
+            backing_flags_ = mapping.flags;
+            push_front(slab);
+            ++empty_slabs_;
+            return slab;
+        }
+
+        void free_slab(SlabHeader* slab) noexcept {
+            unlink(slab);
+            slab_index_.erase(std::lower_bound(slab_index_.begin(), slab_index_.end(), slab));
+            --empty_slabs_;
+            slab_detail::unmap_slab(slab->mapping);
+        }
+
+        void push_front(SlabHeader* slab) noexcept {
+            slab->prev = nullptr;
+            slab->next = open_head_;
+            (open_head_ != nullptr ? open_head_->prev : open_tail_) = slab;
+            open_head_ = slab;
+        }
+
+        void push_back(SlabHeader* slab) noexcept {
+            slab->next = nullptr;
+            slab->prev = open_tail_;
+            (open_tail_ != nullptr ? open_tail_->next : open_head_) = slab;
+            open_tail_ = slab;
+        }
+
+        void unlink(SlabHeader* slab) noexcept {
+            (slab->prev != nullptr ? slab->prev->next : open_head_) = slab->next;
+            (slab->next != nullptr ? slab->next->prev : open_tail_) = slab->prev;
+            slab->prev = slab->next = nullptr;
+        }
+
+        void release() noexcept {
+            for (SlabHeader* slab : slab_index_) {
+                slab_detail::unmap_slab(slab->mapping);
+            }
+            slab_index_.clear();
+            slab_detail::unmap_slab(slab_);
+            slab_ = slab_detail::Mapping{};
+            slots_ = nullptr;
+        }
+
+        void steal(MemoryPool& other) noexcept {
+            slots_ = std::exchange(other.slots_, nullptr);
+            slab_ = std::exchange(other.slab_, slab_detail::Mapping{});
+            free_head_ = std::exchange(other.free_head_, nullptr);
+            capacity_ = std::exchange(other.capacity_, 0);
+            used_ = std::exchange(other.used_, 0);
+            slab_index_ = std::move(other.slab_index_);
+            other.slab_index_.clear();
+            open_head_ = std::exchange(other.open_head_, nullptr);
+            open_tail_ = std::exchange(other.open_tail_, nullptr);
+            slab_span_ = other.slab_span_;
+            slab_capacity_ = other.slab_capacity_;
+            slot_offset_ = other.slot_offset_;
+            max_slabs_ = std::exchange(other.max_slabs_, 0);
+            empty_slabs_ = std::exchange(other.empty_slabs_, 0);
+            release_free_slabs_ = other.release_free_slabs_;
+            backing_ = other.backing_;
+            backing_flags_ = other.backing_flags_;
+            AR_POOL_STATS(stats_.take(other.stats_));
+        }
+
         Slot* slots_ = nullptr;
+        slab_detail::Mapping slab_;  // Fixed mode: the one slab.
         Slot* free_head_ = nullptr;
         std::size_t capacity_ = 0;
         std::size_t used_ = 0;
+
+        // Growable mode only (slab_span_ == 0 for a fixed pool).
+        std::vector<SlabHeader*> slab_index_;  // Every slab, sorted by address.
+        SlabHeader* open_head_ = nullptr;      // Slabs with room; empty ones at the back.
+        SlabHeader* open_tail_ = nullptr;
+        std::size_t slab_span_ = 0;      // Bytes per slab, a power of two; also its alignment.
+        std::size_t slab_capacity_ = 0;  // Slots per slab.
+        std::size_t slot_offset_ = 0;    // Header bytes before the first slot.
+        std::size_t max_slabs_ = 0;
+        std::size_t empty_slabs_ = 0;
+        SlabBacking backing_;
+        uint32_t backing_flags_ = 0;
+        bool release_free_slabs_ = false;
+#if AR_SLAM_POOL_STATS
+        PoolCounters stats_{kSlotSize, 0};
+#endif
     };
 
 }  // namespace ar_slam
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "core/memory_pool.h"
+
+namespace ar_slam {
+
+    namespace pool_detail {
+
+        /// Storage unit of one size class: @p Size bytes at the class alignment.
+        template <std::size_t Size, std::size_t Align>
+        struct Block {
+            alignas(Align) unsigned char bytes[Size];
+        };
+
+    }  // namespace pool_detail
+
+    /**
+     * @brief std::pmr::memory_resource serving small fixed-size requests from MemoryPools.
+     *
+     * Node-based containers (map, set, list, unordered_map) allocate one small
+     * node per element, always of the same size for a given container. This
+     * resource keeps one growable MemoryPool per size class (multiples of
+     * kGranule bytes up to kMaxBlock), so a node allocation is a free-list pop
+     * from a slab shared with its neighbours instead of a trip through malloc,
+     * and erasing a node pushes it back in O(1). A class costs nothing until
+     * its first request, and each grows slab by slab up to its own ceiling.
+     *
+     * Requests larger than kMaxBlock, over-aligned beyond kGranule, or for a
+     * class whose ceiling is reached go to the upstream resource, as do
+     * unordered_map's bucket arrays and deque's chunks.
+     *
+     * Use it through std::pmr containers, or through PoolAllocator<T> to skip
+     * the virtual call. Not thread-safe, like MemoryPool: give each thread its
+     * own resource. Non-copyable and non-movable (containers hold its address);
+     * it must outlive every container allocating from it.
+     */
+    class PoolResource : public std::pmr::memory_resource {
+    public:
+        static constexpr std::size_t kGranule = 16;  ///< Class size step and max alignment.
+        static constexpr std::size_t kClasses = 16;  ///< Number of size classes.
+        static constexpr std::size_t kMaxBlock = kGranule * kClasses;  ///< Largest pooled size.
+
+        /**
+         * @param class_bytes Ceiling per size class, in bytes.
+         * @param slab_bytes  Slab size of each class's pool (see MemoryPool::Growth).
+         * @param upstream    Resource for requests the pools do not serve.
+         */
+        explicit PoolResource(std::size_t class_bytes = 64ull * 1024 * 1024,
+                              std::size_t slab_bytes = 64 * 1024,
+                              std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+            : PoolResource(class_bytes, slab_bytes, upstream, Classes{}) {}
+
+        PoolResource(const PoolResource&) = delete;
+        PoolResource& operator=(const PoolResource&) = delete;
+
+        /// Non-virtual allocate(), for PoolAllocator.
+        void* allocate_block(std::size_t bytes, std::size_t alignment) {
+            if (pooled(bytes, alignment)) {
+                if (void* p = pool_allocate(class_of(bytes), Classes{})) {
+                    ++pooled_blocks_;
+                    return p;
+                }
+            }
+            ++upstream_allocations_;
+            return upstream_->allocate(bytes, alignment);
+        }
+
+        /// Non-virtual deallocate(), for PoolAllocator.
+        void deallocate_block(void* p, std::size_t bytes, std::size_t alignment) noexcept {
+            if (pooled(bytes, alignment) && pool_deallocate(class_of(bytes), p, Classes{})) {
+                --pooled_blocks_;
+                return;
+            }
+            upstream_->deallocate(p, bytes, alignment);
+        }
+
+        /// Blocks currently handed out from the pools.
+        std::size_t pooled_blocks() const { return pooled_blocks_; }
+
+        /// Requests passed to upstream so far (too large, over-aligned or class full).
+        std::size_t upstream_allocations() const { return upstream_allocations_; }
+
+        /// Slab bytes reserved across all classes.
+        std::size_t reserved_bytes() const { return reserved(Classes{}); }
+
+        std::pmr::memory_resource* upstream() const { return upstream_; }
+
+    private:
+        using Classes = std::make_index_sequence<kClasses>;
+
+        template <std::size_t I>
+        using Pool = MemoryPool<pool_detail::Block<(I + 1) * kGranule, kGranule>>;
+
+        template <std::size_t... I>
+        PoolResource(std::size_t class_bytes, std::size_t slab_bytes,
+                     std::pmr::memory_resource* upstream, std::index_sequence<I...>)
+            : pools_(Pool<I>(class_bytes,
+                             typename Pool<I>::Growth{slab_bytes, true, SlabBacking{}})...),
+              upstream_(upstream) {
+            AR_POOL_STATS((std::get<I>(pools_).set_name("PoolResource " +
+                                                         std::to_string((I + 1) * kGranule) + " B"),
+                           ...));
+        }
+
+        static bool pooled(std::size_t bytes, std::size_t alignment) {
+            return bytes != 0 && bytes <= kMaxBlock && alignment <= kGranule;
+        }
+
+        static std::size_t class_of(std::size_t bytes) { return (bytes - 1) / kGranule; }
+
+        template <std::size_t... I>
+        void* pool_allocate(std::size_t cls, std::index_sequence<I...>) {
+            void* p = nullptr;
+            (void)((cls == I && (p = std::get<I>(pools_).allocate(), true)) || ...);
+            return p;
+        }
+
+        /// False if @p p came from upstream (its class was full at the time).
+        template <std::size_t... I>
+        bool pool_deallocate(std::size_t cls, void* p, std::index_sequence<I...>) {
+            return ((cls == I && deallocate_in(std::get<I>(pools_), p)) || ...);
+        }
+
+        template <typename P>
+        static bool deallocate_in(P& pool, void* p) {
+            using Block = std::remove_pointer_t<decltype(pool.allocate())>;
+            Block* block = static_cast<Block*>(p);
+            if (!pool.owns(block)) {
+                return false;
+            }
+            pool.deallocate(block);
+            return true;
+        }
+
+        template <std::size_t... I>
+        std::size_t reserved(std::index_sequence<I...>) const {
+            return (std::get<I>(pools_).capacity_bytes() + ...);
+        }
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            return allocate_block(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+            deallocate_block(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        template <std::size_t... I>
+        static std::tuple<Pool<I>...> pool_tuple(std::index_sequence<I...>);
+
+        decltype(pool_tuple(Classes{})) pools_;
+        std::pmr::memory_resource* upstream_;
+        std::size_t pooled_blocks_ = 0;
+        std::size_t upstream_allocations_ = 0;
+    };
+
+    /**
+     * @brief Standard allocator over a PoolResource, for node-based std containers.
+     *
+     * Rebinds to whatever node type the container allocates, so
+     * std::set<int, std::less<int>, PoolAllocator<int>> draws its tree nodes
+     * from the resource's size class for that node. Calls the resource
+     * directly (no virtual dispatch). Copies, and rebound copies, compare
+     * equal exactly when they share a resource.
+     *
+     * @tparam T Value type.
+     */
+    template <typename T>
+    class PoolAllocator {
+    public:
+        using value_type = T;
+
+        template <typename U>
+        struct rebind {
+            using other = PoolAllocator<U>;
+        };
+
+        explicit PoolAllocator(PoolResource* resource) noexcept : resource_(resource) {}
+
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U>& other) noexcept : resource_(other.resource()) {}
+
+        T* allocate(std::size_t n) {
+            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+                throw std::bad_array_new_length();
+            }
+            return static_cast<T*>(resource_->allocate_block(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* p, std::size_t n) noexcept {
+            resource_->deallocate_block(p, n * sizeof(T), alignof(T));
+        }
+
+        PoolResource* resource() const noexcept { return resource_; }
+
+    private:
+        PoolResource* resource_;
+    };
+
+    template <typename T, typename U>
+    bool operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b) noexcept {
+        return a.resource() == b.resource();
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b) noexcept {
+        return a.resource() != b.resource();
+    }
+
+}  // namespace ar_slam
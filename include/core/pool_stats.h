@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/pool_stats_config.h"
+
+namespace ar_slam {
+
+    /// Snapshot of one instrumented pool.
+    struct PoolStats {
+        std::string name;             ///< set_name(), or "unnamed".
+        std::size_t object_size = 0;  ///< Bytes per slot.
+        std::size_t capacity = 0;     ///< Objects (the ceiling, when growable).
+        std::size_t used = 0;         ///< Live objects now.
+        std::size_t high_water = 0;   ///< Most live objects at any one time.
+        uint64_t allocations = 0;     ///< Successful allocations, lifetime.
+        uint64_t deallocations = 0;
+        uint64_t failures = 0;        ///< Allocations refused (pool exhausted).
+        double lifetime_seconds = 0.0;
+        double allocations_per_second = 0.0;  ///< Lifetime average.
+        double recent_per_second = 0.0;       ///< Since the previous pool_stats() call.
+    };
+
+    class PoolCounters;
+
+    namespace pool_stats_detail {
+
+        /// Every live PoolCounters in the process.
+        struct Registry {
+            std::mutex mutex;
+            std::vector<PoolCounters*> pools;
+        };
+
+        inline Registry& registry() {
+            static Registry instance;
+            return instance;
+        }
+
+    }  // namespace pool_stats_detail
+
+    /**
+     * @brief Usage counters embedded in an instrumented pool.
+     *
+     * Only the owning pool writes them, so a bump is a relaxed load and store
+     * (a plain add, no locked instruction); atomics let pool_stats() read them
+     * from any thread without a data race. Registers itself in a process-wide
+     * registry for its lifetime, and on destruction reports objects still
+     * live to std::cerr.
+     */
+    class PoolCounters {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        PoolCounters(std::size_t object_size, std::size_t capacity)
+            : object_size_(object_size), capacity_(capacity), created_(Clock::now()) {
+            sampled_at_ = created_;
+            pool_stats_detail::Registry& registry = pool_stats_detail::registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.pools.push_back(this);
+        }
+
+        ~PoolCounters();
+
+        PoolCounters(const PoolCounters&) = delete;
+        PoolCounters& operator=(const PoolCounters&) = delete;
+
+        void on_allocate(std::size_t used) noexcept {
+            bump(allocations_);
+            if (used > high_water_.load(std::memory_order_relaxed)) {
+                high_water_.store(used, std::memory_order_relaxed);
+            }
+        }
+
+        void on_deallocate() noexcept { bump(deallocations_); }
+
+        void on_failure() noexcept { bump(failures_); }
+
+        void set_name(std::string name) {
+            std::lock_guard<std::mutex> lock(pool_stats_detail::registry().mutex);
+            name_ = std::move(name);
+        }
+
+        void set_capacity(std::size_t capacity) {
+            std::lock_guard<std::mutex> lock(pool_stats_detail::registry().mutex);
+            capacity_ = capacity;
+        }
+
+        /// Take over @p other's history (pool move); @p other starts afresh.
+        void take(PoolCounters& other) noexcept {
+            std::lock_guard<std::mutex> lock(pool_stats_detail::registry().mutex);
+            name_.swap(other.name_);
+            object_size_ = other.object_size_;
+            capacity_ = other.capacity_;
+            created_ = other.created_;
+            sampled_at_ = other.sampled_at_;
+            sampled_allocations_ = other.sampled_allocations_;
+            constexpr auto relaxed = std::memory_order_relaxed;
+            allocations_.store(other.allocations_.exchange(0, relaxed), relaxed);
+            deallocations_.store(other.deallocations_.exchange(0, relaxed), relaxed);
+            failures_.store(other.failures_.exchange(0, relaxed), relaxed);
+            high_water_.store(other.high_water_.exchange(0, relaxed), relaxed);
+            other.capacity_ = 0;
+        }
+
+        /// Snapshot; the caller holds the registry mutex.
+        PoolStats snapshot_locked(Clock::time_point now) {
+            PoolStats s;
+            s.name = name_.empty() ? "unnamed" : name_;
+            s.object_size = object_size_;
+            s.capacity = capacity_;
+            s.allocations = allocations_.load(std::memory_order_relaxed);
+            s.deallocations = deallocations_.load(std::memory_order_relaxed);
+            s.failures = failures_.load(std::memory_order_relaxed);
+            s.used = static_cast<std::size_t>(s.allocations - s.deallocations);
+            s.high_water = high_water_.load(std::memory_order_relaxed);
+            s.lifetime_seconds = std::chrono::duration<double>(now - created_).count();
+            if (s.lifetime_seconds > 0.0) {
+                s.allocations_per_second = s.allocations / s.lifetime_seconds;
+            }
+            const double window = std::chrono::duration<double>(now - sampled_at_).count();
+            if (window > 0.0) {
+                s.recent_per_second = (s.allocations - sampled_allocations_) / window;
+            }
+            sampled_at_ = now;
+            sampled_allocations_ = s.allocations;
+            return s;
+        }
+
+    private:
+        static void bump(std::atomic<uint64_t>& counter) noexcept {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        std::string name_;
+        std::size_t object_size_;
+        std::size_t capacity_;
+        Clock::time_point created_;
+        Clock::time_point sampled_at_;
+        uint64_t sampled_allocations_ = 0;
+        std::atomic<uint64_t> allocations_{0};
+        std::atomic<uint64_t> deallocations_{0};
+        std::atomic<uint64_t> failures_{0};
+        std::atomic<std::size_t> high_water_{0};
+    };
+
+    inline PoolCounters::~PoolCounters() {
+        pool_stats_detail::Registry& registry = pool_stats_detail::registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        const uint64_t live = allocations_.load(std::memory_order_relaxed) -
+                              deallocations_.load(std::memory_order_relaxed);
+        if (live != 0) {
+            std::cerr << "pool '" << (name_.empty() ? "unnamed" : name_) << "' destroyed with "
+                      << live << " live object(s) of " << object_size_ << " bytes (peak "
+                      << high_water_.load(std::memory_order_relaxed) << ")" << std::endl;
+        }
+        registry.pools.erase(std::find(registry.pools.begin(), registry.pools.end(), this));
+    }
+
+    /// Snapshot of every instrumented pool alive now (empty when instrumentation is off).
+    inline std::vector<PoolStats> pool_stats() {
+        std::vector<PoolStats> out;
+        pool_stats_detail::Registry& registry = pool_stats_detail::registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        const auto now = PoolCounters::Clock::now();
+        for (PoolCounters* pool : registry.pools) {
+            out.push_back(pool->snapshot_locked(now));
+        }
+        return out;
+    }
+
+    /// Print pool_stats() as a table; prints nothing when no pool is instrumented.
+    inline void dump_pool_stats(std::ostream& os) {
+        const std::vector<PoolStats> stats = pool_stats();
+        if (stats.empty()) {
+            return;
+        }
+        os << std::left << std::setw(24) << "pool" << std::right << std::setw(8) << "bytes"
+           << std::setw(12) << "capacity" << std::setw(10) << "used" << std::setw(10) << "peak"
+           << std::setw(14) << "allocs" << std::setw(10) << "failed" << std::setw(12)
+           << "allocs/s" << std::setw(12) << "recent/s" << '\n';
+        for (const PoolStats& s : stats) {
+            os << std::left << std::setw(24) << s.name.substr(0, 23) << std::right
+               << std::setw(8) << s.object_size << std::setw(12) << s.capacity << std::setw(10)
+               << s.used << std::setw(10) << s.high_water << std::setw(14) << s.allocations
+               << std::setw(10) << s.failures << std::fixed << std::setprecision(0)
+               << std::setw(12) << s.allocations_per_second << std::setw(12)
+               << s.recent_per_second << '\n';
+        }
+        os.flush();
+    }
+
+}  // namespace ar_slam
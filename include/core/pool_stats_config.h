@@ -0,0 +1,17 @@
+#pragma once
+
+/// Compile-time switch for pool instrumentation (CMake: -DENABLE_POOL_STATS=ON).
+/// It changes MemoryPool's layout, so it must be the same in every translation unit.
+#ifndef AR_SLAM_POOL_STATS
+#define AR_SLAM_POOL_STATS 0
+#endif
+
+/// Run a statement only in instrumented builds, e.g. `AR_POOL_STATS(stats_.on_failure());`.
+/// Disabled, it expands to nothing, so the hot paths compile exactly as before.
+#if AR_SLAM_POOL_STATS
+#define AR_POOL_STATS(statement) statement
+#else
+#define AR_POOL_STATS(statement) \
+    do {                         \
+    } while (0)
+#endif
@@ -0,0 +1,551 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <set>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "core/bundle_adjustment.h"
+#include "core/geometry.h"
+
+/**
+ * @file pose_graph.h
+ * @brief Sparse Sim(3) pose-graph optimisation for loop closure.
+ *
+ * Nodes are keyframe similarities (world-to-camera, with scale); edges are
+ * relative similarities measured between keyframes (odometry, covisibility
+ * and loop constraints). Levenberg-Marquardt minimises the 7-DoF residuals
+ * log(S_ab * S_b * S_a^-1) with a block-sparse Cholesky factorisation whose
+ * elimination order comes from a minimum-degree heuristic: a trajectory with
+ * a handful of loops factors with fill proportional to its length, so an
+ * iteration is linear in the number of keyframes.
+ */
+namespace ar_slam {
+
+    /// Relative constraint between two nodes: S_a ~ relative * S_b.
+    struct PoseGraphEdge {
+        int a = -1;
+        int b = -1;
+        geometry::Sim3 relative;  ///< Maps node b's camera frame into node a's.
+        double weight = 1.0;      ///< Information (isotropic) of the constraint.
+    };
+
+    /// Pose graph: world-to-camera similarities and the constraints between them.
+    struct PoseGraph {
+        std::vector<geometry::Sim3> nodes;
+        std::vector<bool> fixed;  ///< Nodes held constant (at least one fixes the gauge).
+        std::vector<PoseGraphEdge> edges;
+    };
+
+    /// Solver settings for optimise_pose_graph().
+    struct PoseGraphConfig {
+        int max_iterations = 20;
+        double initial_lambda = 1e-6;       ///< Initial LM damping (relative to the diagonal).
+        double function_tolerance = 1e-10;  ///< Stop when the relative cost drop is below this.
+        double time_budget_ms = 0.0;        ///< Checked before each factorisation (0 = none).
+    };
+
+    /// Outcome of optimise_pose_graph().
+    struct PoseGraphSummary {
+        int iterations = 0;
+        int accepted = 0;
+        double initial_cost = 0.0;
+        double final_cost = 0.0;
+        bool converged = false;
+        bool stalled = false;  ///< Stopped because no damped step lowered the cost.
+        std::size_t factor_blocks = 0;  ///< Off-diagonal blocks of the Cholesky factor (fill).
+        double elapsed_ms = 0.0;
+    };
+
+    namespace pg_detail {
+
+        constexpr int kDim = 7;  // Tangent: rotation (3), translation (3), log-scale (1).
+        using Block = std::array<double, kDim * kDim>;
+        using Vec7 = std::array<double, kDim>;
+
+        /// Rotation vector of @p R (inverse of ba_detail::exp_so3).
+        inline void log_so3(const geometry::Mat3& R, double w[3]) {
+            const double cos_theta =
+                std::max(-1.0, std::min(1.0, 0.5 * (R.m[0][0] + R.m[1][1] + R.m[2][2] - 1.0)));
+            const double theta = std::acos(cos_theta);
+            const double v[3] = {R.m[2][1] - R.m[1][2], R.m[0][2] - R.m[2][0],
+                                 R.m[1][0] - R.m[0][1]};
+            if (theta < 1e-6) {
+                for (int k = 0; k < 3; ++k) {
+                    w[k] = 0.5 * v[k];
+                }
+            } else if (theta > M_PI - 1e-4) {
+                // Near pi the antisymmetric part vanishes: read the axis off R + I.
+                int i = 0;
+                for (int k = 1; k < 3; ++k) {
+                    if (R.m[k][k] > R.m[i][i]) {
+                        i = k;
+                    }
+                }
+                double axis[3];
+                const double d = std::sqrt(std::max(0.0, (R.m[i][i] + 1.0) * 0.5));
+                for (int k = 0; k < 3; ++k) {
+                    axis[k] = k == i ? d : (R.m[k][i] + R.m[i][k]) / (4.0 * d);
+                }
+                const double sign = axis[0] * v[0] + axis[1] * v[1] + axis[2] * v[2] < 0 ? -1 : 1;
+                for (int k = 0; k < 3; ++k) {
+                    w[k] = sign * theta * axis[k];
+                }
+            } else {
+                const double f = theta / (2.0 * std::sin(theta));
+                for (int k = 0; k < 3; ++k) {
+                    w[k] = f * v[k];
+                }
+            }
+        }
+
+        /// exp(delta) * S, with delta = (rotation, translation, log-scale).
+        inline geometry::Sim3 retract(const geometry::Sim3& S, const double* delta) {
+            geometry::Sim3 D;
+            D.R = ba_detail::exp_so3(delta);
+            D.t = {delta[3], delta[4], delta[5]};
+            D.s = std::exp(delta[6]);
+            return geometry::compose(D, S);
+        }
+
+        /// Residual chart of the error similarity E = S_ab * S_b * S_a^-1.
+        inline void residual(const geometry::Sim3& E, Vec7& r) {
+            log_so3(E.R, r.data());
+            r[3] = E.t[0];
+            r[4] = E.t[1];
+            r[5] = E.t[2];
+            r[6] = std::log(E.s);
+        }
+
+        inline geometry::Sim3 error(const PoseGraphEdge& e,
+                                    const geometry::Sim3& Sa,
+                                    const geometry::Sim3& Sb) {
+            return geometry::compose(geometry::compose(e.relative, Sb), Sa.inverse());
+        }
+
+        /// Adjoint of a similarity on (rotation, translation, log-scale) tangents.
+        inline Block adjoint(const geometry::Sim3& S) {
+            Block A{};
+            const double tx[3][3] = {
+                {0, -S.t[2], S.t[1]}, {S.t[2], 0, -S.t[0]}, {-S.t[1], S.t[0], 0}};
+            for (int i = 0; i < 3; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                    A[i * kDim + j] = S.R.m[i][j];
+                    A[(i + 3) * kDim + j + 3] = S.s * S.R.m[i][j];
+                    double tR = 0.0;
+                    for (int k = 0; k < 3; ++k) {
+                        tR += tx[i][k] * S.R.m[k][j];
+                    }
+                    A[(i + 3) * kDim + j] = tR;
+                }
+                A[(i + 3) * kDim + 6] = -S.t[i];
+            }
+            A[6 * kDim + 6] = 1.0;
+            return A;
+        }
+
+        inline double total_cost(const PoseGraph& graph, const std::vector<geometry::Sim3>& nodes) {
+            double cost = 0.0;
+            Vec7 r;
+            for (const PoseGraphEdge& e : graph.edges) {
+                residual(error(e, nodes[e.a], nodes[e.b]), r);
+                double sq = 0.0;
+                for (double x : r) {
+                    sq += x * x;
+                }
+                cost += e.weight * sq;
+            }
+            return cost;
+        }
+
+        // C -= A * B^T for 7x7 blocks.
+        inline void sub_abt(const Block& A, const Block& B, Block& C) {
+            for (int i = 0; i < kDim; ++i) {
+                for (int j = 0; j < kDim; ++j) {
+                    double s = 0.0;
+                    for (int k = 0; k < kDim; ++k) {
+                        s += A[i * kDim + k] * B[j * kDim + k];
+                    }
+                    C[i * kDim + j] -= s;
+                }
+            }
+        }
+
+        /**
+         * @brief Block-sparse Cholesky factorisation of a symmetric 7x7-block system.
+         *
+         * analyse() orders the unknowns by minimum degree and records, for every
+         * column, the rows its elimination fills in. Values are then assembled
+         * with add() into exactly those slots, factored in place (right-looking)
+         * and used by solve(). The symbolic analysis is reused across iterations.
+         */
+        class SparseBlockCholesky {
+        public:
+            void analyse(int n, const std::vector<std::pair<int, int>>& pairs) {
+                std::vector<std::unordered_set<int>> adj(n);
+                for (const auto& p : pairs) {
+                    if (p.first != p.second) {
+                        adj[p.first].insert(p.second);
+                        adj[p.second].insert(p.first);
+                    }
+                }
+                std::set<std::pair<std::size_t, int>> queue;
+                for (int v = 0; v < n; ++v) {
+                    queue.insert({adj[v].size(), v});
+                }
+
+                order_.clear();
+                position_.assign(n, -1);
+                columns_.assign(n, Column{});
+                std::vector<int> nbrs;
+                while (!queue.empty()) {
+                    const int v = queue.begin()->second;
+                    queue.erase(queue.begin());
+                    position_[v] = static_cast<int>(order_.size());
+                    order_.push_back(v);
+
+                    nbrs.assign(adj[v].begin(), adj[v].end());
+                    columns_[v].rows = nbrs;
+                    for (int u : nbrs) {
+                        queue.erase({adj[u].size(), u});
+                        adj[u].erase(v);
+                    }
+                    // Eliminating v connects all of its neighbours (fill-in).
+                    for (std::size_t i = 0; i < nbrs.size(); ++i) {
+                        for (std::size_t j = i + 1; j < nbrs.size(); ++j) {
+                            if (adj[nbrs[i]].insert(nbrs[j]).second) {
+                                adj[nbrs[j]].insert(nbrs[i]);
+                            }
+                        }
+                    }
+                    for (int u : nbrs) {
+                        queue.insert({adj[u].size(), u});
+                    }
+                    adj[v].clear();
+                }
+
+                blocks_ = 0;
+                for (Column& c : columns_) {
+                    std::sort(c.rows.begin(), c.rows.end(),
+                              [this](int x, int y) { return position_[x] < position_[y]; });
+                    c.blocks.assign(c.rows.size(), Block{});
+                    blocks_ += c.rows.size();
+                }
+            }
+
+            /// Number of off-diagonal blocks in the factor.
+            std::size_t blocks() const { return blocks_; }
+
+            void zero() {
+                for (Column& c : columns_) {
+                    c.diag.fill(0.0);
+                    for (Block& b : c.blocks) {
+                        b.fill(0.0);
+                    }
+                }
+            }
+
+            /// Add @p H (row block @p a, column block @p b) to the system.
+            void add(int a, int b, const Block& H) {
+                if (a == b) {
+                    for (int k = 0; k < kDim * kDim; ++k) {
+                        columns_[a].diag[k] += H[k];
+                    }
+                    return;
+                }
+                // Stored as A(later, earlier) in the column eliminated first.
+                const bool transpose = position_[a] < position_[b];
+                const int col = transpose ? a : b;
+                const int row = transpose ? b : a;
+                Block& dst = columns_[col].blocks[slot(col, row)];
+                for (int i = 0; i < kDim; ++i) {
+                    for (int j = 0; j < kDim; ++j) {
+                        dst[i * kDim + j] += transpose ? H[j * kDim + i] : H[i * kDim + j];
+                    }
+                }
+            }
+
+            /// Marquardt damping: scale every diagonal entry by (1 + lambda).
+            void damp(double lambda) {
+                for (Column& c : columns_) {
+                    for (int k = 0; k < kDim; ++k) {
+                        c.diag[k * kDim + k] *= 1.0 + lambda;
+                        c.diag[k * kDim + k] += 1e-12;
+                    }
+                }
+            }
+
+            /// Factor in place. @return false if the system is not positive definite.
+            bool factor() {
+                std::vector<double> diag(kDim * kDim);
+                for (int v : order_) {
+                    Column& c = columns_[v];
+                    diag.assign(c.diag.begin(), c.diag.end());
+                    if (!ba_detail::cholesky(diag, kDim)) {
+                        return false;
+                    }
+                    std::copy(diag.begin(), diag.end(), c.diag.begin());
+
+                    // L_rv = A_rv * L_vv^-T: forward substitution on every row.
+                    for (Block& B : c.blocks) {
+                        for (int i = 0; i < kDim; ++i) {
+                            for (int j = 0; j < kDim; ++j) {
+                                double s = B[i * kDim + j];
+                                for (int k = 0; k < j; ++k) {
+                                    s -= B[i * kDim + k] * c.diag[j * kDim + k];
+                                }
+                                B[i * kDim + j] = s / c.diag[j * kDim + j];
+                            }
+                        }
+                    }
+                    // Schur update of the remaining (filled) rows.
+                    for (std::size_t k1 = 0; k1 < c.rows.size(); ++k1) {
+                        const int r1 = c.rows[k1];
+                        sub_abt(c.blocks[k1], c.blocks[k1], columns_[r1].diag);
+                        for (std::size_t k2 = 0; k2 < k1; ++k2) {
+                            const int r2 = c.rows[k2];  // Eliminated before r1.
+                            sub_abt(c.blocks[k1], c.blocks[k2],
+                                    columns_[r2].blocks[slot(r2, r1)]);
+                        }
+                    }
+                }
+                return true;
+            }
+
+            /// Solve L L^T x = b in place (after factor()).
+            void solve(std::vector<double>& x) const {
+                for (int v : order_) {
+                    const Column& c = columns_[v];
+                    double* xv = &x[v * kDim];
+                    for (int i = 0; i < kDim; ++i) {
+                        double s = xv[i];
+                        for (int k = 0; k < i; ++k) {
+                            s -= c.diag[i * kDim + k] * xv[k];
+                        }
+                        xv[i] = s / c.diag[i * kDim + i];
+                    }
+                    for (std::size_t k = 0; k < c.rows.size(); ++k) {
+                        double* xr = &x[c.rows[k] * kDim];
+                        const Block& L = c.blocks[k];
+                        for (int i = 0; i < kDim; ++i) {
+                            double s = 0.0;
+                            for (int j = 0; j < kDim; ++j) {
+                                s += L[i * kDim + j] * xv[j];
+                            }
+                            xr[i] -= s;
+                        }
+                    }
+                }
+                for (auto it = order_.rbegin(); it != order_.rend(); ++it) {
+                    const Column& c = columns_[*it];
+                    double* xv = &x[*it * kDim];
+                    for (std::size_t k = 0; k < c.rows.size(); ++k) {
+                        const double* xr = &x[c.rows[k] * kDim];
+                        const Block& L = c.blocks[k];
+                        for (int j = 0; j < kDim; ++j) {
+                            double s = 0.0;
+                            for (int i = 0; i < kDim; ++i) {
+                                s += L[i * kDim + j] * xr[i];
+                            }
+                            xv[j] -= s;
+                        }
+                    }
+                    for (int i = kDim - 1; i >= 0; --i) {
+                        double s = xv[i];
+                        for (int k = i + 1; k < kDim; ++k) {
+                            s -= c.diag[k * kDim + i] * xv[k];
+                        }
+                        xv[i] = s / c.diag[i * kDim + i];
+                    }
+                }
+            }
+
+        private:
+            struct Column {
+                Block diag{};
+                std::vector<int> rows;      // Later-eliminated rows, in elimination order.
+                std::vector<Block> blocks;  // A (then L) block for each row.
+            };
+
+            std::size_t slot(int col, int row) const {
+                const std::vector<int>& rows = columns_[col].rows;
+                return static_cast<std::size_t>(std::find(rows.begin(), rows.end(), row) -
+                                                rows.begin());
+            }
+
+            std::vector<int> order_;
+            std::vector<int> position_;
+            std::vector<Column> columns_;
+            std::size_t blocks_ = 0;
+        };
+
+    }  // namespace pg_detail
+
+    /**
+     * @brief Optimise @p graph in place with sparse Levenberg-Marquardt.
+     *
+     * The residual Jacobians are the similarity adjoints (-Adj(E) for node a,
+     * Adj(S_ab) for node b), so assembling the normal equations costs a few 7x7
+     * products per edge. Fixed nodes are left out of the system entirely.
+     *
+     * The time budget is checked after the symbolic analysis and before every
+     * factorisation, damping retries included. Only accepted steps are written
+     * to @p graph, so stopping early leaves it at the best state found so far.
+     */
+    inline PoseGraphSummary optimise_pose_graph(PoseGraph& graph,
+                                                const PoseGraphConfig& config = PoseGraphConfig{}) {
+        using namespace pg_detail;
+        const auto start = std::chrono::steady_clock::now();
+        auto elapsed_ms = [&start] {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                             start)
+                .count();
+        };
+        auto out_of_time = [&] {
+            return config.time_budget_ms > 0.0 && elapsed_ms() > config.time_budget_ms;
+        };
+
+        PoseGraphSummary summary;
+        const int n = static_cast<int>(graph.nodes.size());
+        std::vector<int> free_index(n, -1);
+        std::vector<int> free_nodes;
+        for (int i = 0; i < n; ++i) {
+            if (i >= static_cast<int>(graph.fixed.size()) || !graph.fixed[i]) {
+                free_index[i] = static_cast<int>(free_nodes.size());
+                free_nodes.push_back(i);
+            }
+        }
+        summary.initial_cost = summary.final_cost = total_cost(graph, graph.nodes);
+        const int m = static_cast<int>(free_nodes.size());
+        if (m == 0 || graph.edges.empty() || summary.initial_cost == 0.0) {
+            summary.converged = true;
+            return summary;
+        }
+
+        std::vector<std::pair<int, int>> pairs;
+        pairs.reserve(graph.edges.size());
+        for (const PoseGraphEdge& e : graph.edges) {
+            if (free_index[e.a] >= 0 && free_index[e.b] >= 0) {
+                pairs.push_back({free_index[e.a], free_index[e.b]});
+            }
+        }
+        SparseBlockCholesky system;
+        system.analyse(m, pairs);
+        summary.factor_blocks = system.blocks();
+
+        double cost = summary.initial_cost;
+        double lambda = config.initial_lambda;
+        std::vector<double> gradient(m * kDim);
+        std::vector<double> step;
+        std::vector<geometry::Sim3> trial;
+        SparseBlockCholesky work;
+
+        bool timed_out = false;
+        for (int iter = 0; iter < config.max_iterations && !timed_out; ++iter) {
+            if (out_of_time()) {
+                break;
+            }
+            ++summary.iterations;
+
+            // Normal equations H dx = g with g = -J^T r.
+            system.zero();
+            std::fill(gradient.begin(), gradient.end(), 0.0);
+            Vec7 r;
+            for (const PoseGraphEdge& e : graph.edges) {
+                const int fa = free_index[e.a];
+                const int fb = free_index[e.b];
+                const geometry::Sim3 E = error(e, graph.nodes[e.a], graph.nodes[e.b]);
+                residual(E, r);
+                Block Ja = adjoint(E);
+                for (double& x : Ja) {
+                    x = -x;
+                }
+                const Block Jb = adjoint(e.relative);
+                const Block* J[2] = {&Ja, &Jb};
+                const int idx[2] = {fa, fb};
+                for (int p = 0; p < 2; ++p) {
+                    if (idx[p] < 0) {
+                        continue;
+                    }
+                    for (int i = 0; i < kDim; ++i) {
+                        double s = 0.0;
+                        for (int k = 0; k < kDim; ++k) {
+                            s += (*J[p])[k * kDim + i] * r[k];
+                        }
+                        gradient[idx[p] * kDim + i] -= e.weight * s;
+                    }
+                    for (int q = 0; q < 2; ++q) {
+                        if (idx[q] < 0 || (q < p && idx[q] != idx[p])) {
+                            continue;  // Each off-diagonal pair is added once, as (a, b).
+                        }
+                        Block H{};
+                        for (int i = 0; i < kDim; ++i) {
+                            for (int j = 0; j < kDim; ++j) {
+                                double s = 0.0;
+                                for (int k = 0; k < kDim; ++k) {
+                                    s += (*J[p])[k * kDim + i] * (*J[q])[k * kDim + j];
+                                }
+                                H[i * kDim + j] = e.weight * s;
+                            }
+                        }
+                        if (p == q || idx[p] != idx[q]) {
+                            system.add(idx[p], idx[q], H);
+                        }
+                    }
+                }
+            }
+
+            bool accepted = false;
+            for (int attempt = 0; attempt < 8 && !accepted; ++attempt) {
+                if (out_of_time()) {
+                    timed_out = true;
+                    break;
+                }
+                work = system;
+                work.damp(lambda);
+                if (!work.factor()) {
+                    lambda *= 10.0;
+                    continue;
+                }
+                step = gradient;
+                work.solve(step);
+
+                trial = graph.nodes;
+                for (int f = 0; f < m; ++f) {
+                    trial[free_nodes[f]] = retract(graph.nodes[free_nodes[f]], &step[f * kDim]);
+                }
+                const double trial_cost = total_cost(graph, trial);
+                if (trial_cost < cost) {
+                    const double drop = (cost - trial_cost) / std::max(cost, 1e-300);
+                    graph.nodes.swap(trial);
+                    cost = trial_cost;
+                    lambda = std::max(lambda * 0.1, 1e-12);
+                    accepted = true;
+                    ++summary.accepted;
+                    if (drop < config.function_tolerance) {
+                        summary.converged = true;
+                    }
+                } else {
+                    lambda *= 10.0;
+                }
+            }
+            if (!accepted && !timed_out) {
+                summary.stalled = true;  // Every damping tried; not a minimum, just stuck.
+                break;
+            }
+            if (summary.converged) {
+                break;
+            }
+        }
+
+        summary.final_cost = cost;
+        summary.elapsed_ms = elapsed_ms();
+        return summary;
+    }
+
+}  // namespace ar_slam
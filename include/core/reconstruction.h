@@ -1,10 +1,19 @@
 #pragma once
 
+#include <memory>
+#include <memory_resource>
 #include <opencv2/core.hpp>
 #include <vector>
 
 namespace ar_slam {
 
+    /// Two-view model a reconstruction was initialised from.
+    enum class TwoViewModel {
+        kNone,        ///< Nothing fitted (too few correspondences or RANSAC failed).
+        kEssential,   ///< General scene with translation.
+        kHomography,  ///< Planar scene or (near) pure rotation.
+    };
+
     /**
      * @brief Output of a two-view reconstruction attempt.
      *
@@ -22,16 +31,29 @@ namespace ar_slam {
         std::vector<int> point_indices;      ///< Index of each point in the input arrays.
         int num_inliers = 0;                 ///< Correspondences passing the cheirality check.
         double inlier_ratio = 0.0;           ///< num_inliers / input correspondences.
+
+        TwoViewModel model = TwoViewModel::kNone;  ///< Model the pose came from.
+        double homography_score_ratio = 0.0;       ///< S_H / (S_H + S_E); 0 if H was not fitted.
+        bool low_parallax = false;                 ///< Failed: (near) pure rotation.
     };
 
     /**
      * @brief Recovers relative camera motion and sparse 3D structure from two views.
      *
      * Given pixel correspondences between two frames of a calibrated camera, this
-     * class estimates the essential matrix with RANSAC, decomposes it into a
-     * relative pose using the cheirality (positive-depth) constraint, and
-     * triangulates the surviving inliers. Triangulation uses the dependency-free
-     * DLT solver in geometry.h, which is unit-tested in isolation.
+     * class fits a homography and an essential matrix with RANSAC, the homography
+     * on a worker thread the instance keeps for its lifetime (inline when only
+     * one core is available), and scores both on every correspondence (symmetric
+     * transfer error for H, Sampson error for E). When the homography explains
+     * the data as well (a planar scene, or a motion close to pure rotation), the
+     * pose comes from decomposing it; otherwise the essential matrix is
+     * decomposed using the cheirality (positive-depth) constraint. A homography
+     * whose best decomposition gives too little triangulation angle is reported
+     * as low_parallax instead of producing a poor map. It then triangulates the
+     * surviving inliers. Triangulation uses the dependency-free
+     * DLT solver in geometry.h, and the points are then refined together on
+     * reprojection error; a point is kept if its depth is well determined (from
+     * the refined covariance) rather than by a fixed depth cut-off.
      *
      * This is the geometric back-end that turns the tracking front-end's 2D
      * correspondences into real 3D structure.
@@ -40,10 +62,16 @@ namespace ar_slam {
     public:
         /// Tunable thresholds for the reconstruction.
         struct Config {
-            double ransac_prob = 0.999;     ///< RANSAC confidence for findEssentialMat.
-            double ransac_threshold = 1.0;  ///< Max epipolar error in pixels for inliers.
-            int min_correspondences = 30;   ///< Minimum matches required to attempt.
-            double max_depth = 100.0;       ///< Reject points farther than this (scale units).
+            double ransac_prob = 0.999;          ///< RANSAC confidence for findEssentialMat.
+            double ransac_threshold = 1.0;       ///< Max epipolar error in pixels for inliers.
+            int min_correspondences = 30;        ///< Minimum matches required to attempt.
+            double max_depth = 1000.0;           ///< Hard cap on point depth (scale units).
+            int refine_iterations = 3;           ///< Gauss-Newton steps per point (0: DLT only).
+            double max_reprojection_rms = 2.0;   ///< Reject refined points above this (px).
+            double max_depth_sigma = 0.25;       ///< Reject if depth std-dev > this * depth.
+            bool fit_homography = true;          ///< Fit H next to E and select between them.
+            double homography_ratio = 0.45;      ///< Use H when S_H / (S_H + S_E) exceeds this.
+            double min_triangulation_deg = 1.0;  ///< Min median ray angle for an H pose.
         };
 
         /// Construct with default thresholds.
@@ -52,20 +80,42 @@ namespace ar_slam {
         /// Construct with explicit thresholds.
         TwoViewReconstruction(const cv::Matx33d& K, const Config& config);
 
+        ~TwoViewReconstruction();
+
+        TwoViewReconstruction(const TwoViewReconstruction&) = delete;
+        TwoViewReconstruction& operator=(const TwoViewReconstruction&) = delete;
+
         /**
          * @brief Reconstruct structure and motion from matched correspondences.
          * @param pts1 Pixel observations in view 1.
          * @param pts2 Pixel observations in view 2 (pts2[i] matches pts1[i]).
+         * @param scratch Resource for the internal temporaries (masks, DLT and
+         *                refinement buffers), e.g. a FrameArena; nullptr uses the heap.
+         *                The result itself is always heap-allocated.
          * @return A ReconstructionResult; check .success before using its fields.
          */
         ReconstructionResult reconstruct(const std::vector<cv::Point2f>& pts1,
-                                         const std::vector<cv::Point2f>& pts2) const;
+                                         const std::vector<cv::Point2f>& pts2,
+                                         std::pmr::memory_resource* scratch = nullptr) const;
 
         const cv::Matx33d& intrinsics() const { return K_; }
 
     private:
+        class HomographyWorker;
+
         cv::Matx33d K_;
         Config config_;
+        std::unique_ptr<HomographyWorker> worker_;  ///< Null: fit H inline.
+
+        bool pose_from_homography(const cv::Mat& H,
+                                  const std::vector<cv::Point2f>& pts1,
+                                  const std::vector<cv::Point2f>& pts2,
+                                  const std::vector<unsigned char>& inliers,
+                                  const cv::Matx33d* essential_R,
+                                  cv::Matx33d& R,
+                                  cv::Vec3d& t,
+                                  std::pmr::vector<unsigned char>& good,
+                                  bool& low_parallax) const;
     };
 
 }  // namespace ar_slam
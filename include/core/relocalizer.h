@@ -0,0 +1,115 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "core/geometry.h"
+#include "core/landmark_map.h"
+
+namespace ar_slam {
+
+    /**
+     * @brief Landmarks of the newest keyframes, packed for descriptor search.
+     *
+     * Built on the mapping thread by Relocalizer::capture() and published
+     * immutable (shared_ptr to const), so the tracking thread can search it
+     * without touching the live map. A landmark seen by several of the
+     * keyframes appears once per view, each row with that view's descriptor.
+     */
+    struct RelocalizationMap {
+        std::vector<int> keyframes;       ///< Keyframe ids covered, newest first.
+        std::vector<int> landmarks;       ///< Landmark (track) id of each row.
+        std::vector<cv::Point3f> points;  ///< World position of each row's landmark.
+        cv::Mat descriptors;              ///< CV_8U, kDescriptorBytes columns per row.
+
+        bool empty() const { return landmarks.empty(); }
+    };
+
+    /// Outcome of Relocalizer::relocalize().
+    struct RelocalizationResult {
+        bool success = false;
+        geometry::Pose pose;         ///< World-to-camera pose of the frame.
+        std::vector<int> track_ids;  ///< Per input keypoint: re-attached landmark id, or -1.
+        int matches = 0;             ///< Descriptor matches passed to PnP.
+        int inliers = 0;             ///< Matches consistent with the recovered pose.
+        double time_ms = 0.0;
+    };
+
+    /**
+     * @brief Recovers the camera pose against the map after tracking is lost.
+     *
+     * When the tracker has to re-detect from scratch, the fresh ORB features
+     * are matched (Hamming distance, ratio test, one feature per landmark)
+     * against the descriptors stored with the newest keyframes, and the
+     * matches are fed to a RANSAC PnP against the landmarks' world positions.
+     * On success every inlier feature inherits the landmark's track id, so
+     * the mapper sees its known tracks again and keeps extending the same map
+     * instead of bootstrapping a new one from a fresh two-view baseline.
+     *
+     * Only the few newest keyframes are searched: tracking loss is usually a
+     * brief occlusion or blur near where the camera was, and a bounded search
+     * keeps a relocalization attempt within a few milliseconds.
+     */
+    class Relocalizer {
+    public:
+        struct Config {
+            std::size_t recent_keyframes = 5;  ///< Newest keyframes searched.
+            int max_hamming = 50;              ///< Descriptor match distance limit (bits).
+            double ratio_test = 0.8;           ///< Best / second-best (other landmark) ratio.
+            int min_matches = 15;              ///< Matches needed to attempt PnP.
+            int min_inliers = 12;              ///< PnP inliers needed to accept the pose.
+            int ransac_iterations = 100;       ///< PnP RANSAC hypotheses.
+            float reprojection_px = 4.0f;      ///< PnP RANSAC inlier threshold.
+        };
+
+        /// Construct with default thresholds.
+        explicit Relocalizer(const cv::Matx33d& K);
+
+        /// Construct with explicit thresholds.
+        Relocalizer(const cv::Matx33d& K, const Config& config);
+
+        /**
+         * @brief Pack the descriptors of @p map's @p recent newest keyframes.
+         * @return nullptr if those keyframes carry no descriptors.
+         */
+        static std::shared_ptr<const RelocalizationMap> capture(const LandmarkMap& map,
+                                                                std::size_t recent);
+
+        /// Replace the map searched by relocalize() (a pointer swap).
+        void set_map(std::shared_ptr<const RelocalizationMap> map) { map_ = std::move(map); }
+
+        /// True once a non-empty map has been set.
+        bool has_map() const { return map_ && !map_->empty(); }
+
+        /**
+         * @brief Localise a frame from its freshly extracted features.
+         * @param keypoints   ORB keypoints of the frame.
+         * @param descriptors Their descriptors (CV_8U, one row per keypoint).
+         */
+        RelocalizationResult relocalize(const std::vector<cv::KeyPoint>& keypoints,
+                                        const cv::Mat& descriptors) const;
+
+        /**
+         * @brief RANSAC PnP of a calibrated camera (no distortion).
+         * @param inliers Filled with the indices of the consistent correspondences.
+         * @return false if fewer than Config::min_inliers correspondences agree.
+         */
+        static bool solve_pnp(const cv::Matx33d& K,
+                              const std::vector<cv::Point3f>& points,
+                              const std::vector<cv::Point2f>& pixels,
+                              const Config& config,
+                              geometry::Pose& pose,
+                              std::vector<int>& inliers);
+
+        const Config& config() const { return config_; }
+
+    private:
+        cv::Matx33d K_;
+        Config config_;
+        std::shared_ptr<const RelocalizationMap> map_;
+    };
+
+}  // namespace ar_slam
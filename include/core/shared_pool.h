@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "core/concurrent_memory_pool.h"
+
+namespace ar_slam {
+
+    namespace shared_pool_detail {
+
+        /// Room for a control block next to the object: std::allocate_shared's
+        /// in-place block adds a vtable pointer, two counts and the allocator.
+        constexpr std::size_t kControlBytes = 6 * sizeof(void*);
+
+        /// One pool slot: a T, its control block and its allocator, in one piece.
+        template <typename T>
+        struct alignas(alignof(T) > alignof(std::max_align_t) ? alignof(T)
+                                                               : alignof(std::max_align_t)) Block {
+            unsigned char bytes[sizeof(T) + kControlBytes];
+        };
+
+        template <typename T>
+        using Pool = ConcurrentMemoryPool<Block<T>>;
+
+        /// Thrown by SharedPoolAllocator when the pool is out of slots.
+        struct PoolExhausted : std::bad_alloc {
+            const char* what() const noexcept override { return "shared pool exhausted"; }
+        };
+
+    }  // namespace shared_pool_detail
+
+    /**
+     * @brief Allocator that places std::allocate_shared's block in a SharedPool slot.
+     *
+     * allocate_shared rebinds the allocator to its control block type (which
+     * embeds the object) and allocates exactly one of those; each slot is sized
+     * for that, which is checked at compile time. The allocator holds shared
+     * ownership of the pool, so a pool outlives every object placed in it, and
+     * an object may be released on any thread (the pool is lock-free).
+     *
+     * @tparam U Type being allocated (T itself, or the rebound control block).
+     * @tparam T Object type the pool's slots are sized for.
+     */
+    template <typename U, typename T>
+    class SharedPoolAllocator {
+    public:
+        using value_type = U;
+
+        template <typename V>
+        struct rebind {
+            using other = SharedPoolAllocator<V, T>;
+        };
+
+        explicit SharedPoolAllocator(std::shared_ptr<shared_pool_detail::Pool<T>> pool) noexcept
+            : pool_(std::move(pool)) {}
+
+        template <typename V>
+        SharedPoolAllocator(const SharedPoolAllocator<V, T>& other) noexcept
+            : pool_(other.pool()) {}
+
+        U* allocate(std::size_t n) {
+            using Block = shared_pool_detail::Block<T>;
+            static_assert(sizeof(U) <= sizeof(Block) && alignof(U) <= alignof(Block),
+                          "control block does not fit a slot: raise kControlBytes");
+            if (n != 1) {
+                throw std::bad_alloc();  // allocate_shared only ever asks for one.
+            }
+            Block* slot = pool_->allocate();
+            if (slot == nullptr) {
+                throw shared_pool_detail::PoolExhausted();
+            }
+            return reinterpret_cast<U*>(slot);
+        }
+
+        void deallocate(U* p, std::size_t) noexcept {
+            pool_->deallocate(reinterpret_cast<shared_pool_detail::Block<T>*>(p));
+        }
+
+        const std::shared_ptr<shared_pool_detail::Pool<T>>& pool() const noexcept {
+            return pool_;
+        }
+
+    private:
+        std::shared_ptr<shared_pool_detail::Pool<T>> pool_;
+    };
+
+    template <typename U, typename V, typename T>
+    bool operator==(const SharedPoolAllocator<U, T>& a, const SharedPoolAllocator<V, T>& b) {
+        return a.pool() == b.pool();
+    }
+
+    template <typename U, typename V, typename T>
+    bool operator!=(const SharedPoolAllocator<U, T>& a, const SharedPoolAllocator<V, T>& b) {
+        return a.pool() != b.pool();
+    }
+
+    /**
+     * @brief Fixed-capacity source of std::shared_ptr<T> with no global-heap allocation.
+     *
+     * make() is std::allocate_shared into a slot of a lock-free
+     * ConcurrentMemoryPool: the object and its control block share one slot,
+     * taken and returned in O(1), instead of one operator new per object.
+     * The result is an ordinary shared_ptr (copies, weak_ptr, aliasing and
+     * release on any thread all behave as with make_shared); only where the
+     * bytes live differs. The slots stay reserved until the pool and every
+     * object made from it are gone.
+     *
+     * @tparam T Object type.
+     */
+    template <typename T>
+    class SharedPool {
+    public:
+        /// @param capacity Objects that can be alive at once.
+        explicit SharedPool(std::size_t capacity)
+            : pool_(std::make_shared<shared_pool_detail::Pool<T>>(
+                  capacity * (sizeof(shared_pool_detail::Block<T>) + sizeof(uint32_t)))) {}
+
+        /**
+         * @brief Construct a T in a pool slot.
+         * @return The shared object, or nullptr if every slot is taken. If the
+         *         constructor throws, the slot is returned and the exception propagates.
+         */
+        template <typename... Args>
+        std::shared_ptr<T> make(Args&&... args) {
+            try {
+                return std::allocate_shared<T>(SharedPoolAllocator<T, T>(pool_),
+                                               std::forward<Args>(args)...);
+            } catch (const shared_pool_detail::PoolExhausted&) {
+                return nullptr;
+            }
+        }
+
+        /// Objects that can be alive at once.
+        std::size_t capacity() const noexcept { return pool_->capacity(); }
+
+        /// Objects currently alive.
+        std::size_t used() const noexcept { return pool_->used(); }
+
+        /// Slots still free.
+        std::size_t available() const noexcept { return pool_->available(); }
+
+        /// True if @p object was made by this pool.
+        bool owns(const std::shared_ptr<T>& object) const noexcept {
+            // The object sits inside its slot, after the control block's header;
+            // owns() is a range check over the slab.
+            return object != nullptr &&
+                   pool_->owns(
+                       reinterpret_cast<const shared_pool_detail::Block<T>*>(object.get()));
+        }
+
+    private:
+        std::shared_ptr<shared_pool_detail::Pool<T>> pool_;
+    };
+
+}  // namespace ar_slam
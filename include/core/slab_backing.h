@@ -0,0 +1,221 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+
+namespace ar_slam {
+
+    /**
+     * @brief How MemoryPool obtains the memory behind its slabs.
+     *
+     * The default takes slabs from operator new, as ever. Any other setting maps
+     * them with mmap so the pages can be chosen and pinned:
+     *  - Pages::kHuge asks for explicit huge pages (MAP_HUGETLB) for slabs of at
+     *    least one huge page, falling back to transparent huge pages when the
+     *    system has none reserved;
+     *  - Pages::kTransparentHuge maps normal pages aligned to the huge page size
+     *    and advises the kernel to back them with huge pages (MADV_HUGEPAGE);
+     *  - numa_node binds the slab to one NUMA node before it is touched;
+     *  - lock pins the slab in RAM (mlock), which also faults it in;
+     *  - prefault writes every page up front.
+     * With lock or prefault, the fault for every page is taken when the slab is
+     * created (at construction for a fixed pool, in the allocate() that adds a
+     * slab for a growable one), never at a later first touch.
+     *
+     * Each step is best effort: if the system refuses it (no huge pages
+     * reserved, RLIMIT_MEMLOCK, no NUMA support, not Linux), the slab is still
+     * created without it. MemoryPool::backing_flags() reports what was obtained.
+     */
+    struct SlabBacking {
+        enum class Pages {
+            kDefault,          ///< Base pages, from operator new unless another option maps.
+            kTransparentHuge,  ///< mmap + MADV_HUGEPAGE.
+            kHuge,             ///< MAP_HUGETLB, else as kTransparentHuge.
+        };
+
+        /// What a slab actually got (bitmask).
+        enum Flags : uint32_t {
+            kMapped = 1u << 0,           ///< Mapped with mmap (not from operator new).
+            kHugeTlb = 1u << 1,          ///< Explicit huge pages.
+            kTransparentHuge = 1u << 2,  ///< MADV_HUGEPAGE accepted.
+            kLocked = 1u << 3,           ///< mlock succeeded.
+            kPrefaulted = 1u << 4,       ///< Every page faulted in.
+            kNumaBound = 1u << 5,        ///< mbind to numa_node succeeded.
+        };
+
+        Pages pages = Pages::kDefault;
+        bool lock = false;      ///< mlock the slab.
+        bool prefault = false;  ///< Touch every page when the slab is created.
+        int numa_node = -1;     ///< Bind to this NUMA node (-1: no binding).
+
+        /// True when slabs come from mmap rather than operator new.
+        bool mapped() const {
+            return pages != Pages::kDefault || lock || prefault || numa_node >= 0;
+        }
+    };
+
+    namespace slab_detail {
+
+        /// One slab's memory and how to give it back.
+        struct Mapping {
+            void* data = nullptr;
+            std::size_t bytes = 0;      ///< Length mapped (or allocated).
+            std::size_t alignment = 0;  ///< Alignment requested (operator new only).
+            uint32_t flags = 0;         ///< SlabBacking::Flags obtained.
+        };
+
+        inline std::size_t page_size() {
+            static const std::size_t size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            return size;
+        }
+
+        /// Default huge page size, from /proc/meminfo (2 MiB if unknown).
+        inline std::size_t huge_page_size() {
+            static const std::size_t size = [] {
+                std::size_t kib = 2048;
+                if (std::FILE* f = std::fopen("/proc/meminfo", "r")) {
+                    char line[128];
+                    while (std::fgets(line, sizeof(line), f) != nullptr) {
+                        unsigned long value = 0;
+                        if (std::sscanf(line, "Hugepagesize: %lu kB", &value) == 1) {
+                            kib = value;
+                            break;
+                        }
+                    }
+                    std::fclose(f);
+                }
+                return kib * 1024;
+            }();
+            return size;
+        }
+
+        inline std::size_t round_up(std::size_t bytes, std::size_t multiple) {
+            return (bytes + multiple - 1) / multiple * multiple;
+        }
+
+        /// mmap @p bytes at @p alignment (a power of two), trimming the excess.
+        inline void* map_aligned(std::size_t bytes, std::size_t alignment, int extra_flags,
+                                 std::size_t granule) {
+            const std::size_t padded = alignment > granule ? bytes + alignment : bytes;
+            void* raw = ::mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+            if (raw == MAP_FAILED) {
+                return nullptr;
+            }
+            const auto start = reinterpret_cast<std::uintptr_t>(raw);
+            const std::uintptr_t aligned = (start + alignment - 1) & ~(alignment - 1);
+            if (aligned > start) {
+                ::munmap(raw, aligned - start);
+            }
+            const std::size_t tail = start + padded - (aligned + bytes);
+            if (tail > 0) {
+                ::munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+            }
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        inline bool bind_to_node(void* data, std::size_t bytes, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+            constexpr int kMpolBind = 2;  // From <numaif.h>, to avoid depending on libnuma.
+            constexpr std::size_t kBits = 8 * sizeof(unsigned long);
+            if (node < 0 || node >= 1024) {
+                return false;
+            }
+            unsigned long mask[1024 / kBits] = {};
+            mask[node / kBits] = 1ul << (node % kBits);
+            return ::syscall(SYS_mbind, data, bytes, kMpolBind, mask,
+                             static_cast<unsigned long>(node) + 2, 0u) == 0;
+#else
+            (void)data;
+            (void)bytes;
+            (void)node;
+            return false;
+#endif
+        }
+
+        /**
+         * @brief Obtain @p bytes aligned to @p alignment under @p backing.
+         * @return A Mapping with data == nullptr if even the fallback failed.
+         */
+        inline Mapping map_slab(std::size_t bytes, std::size_t alignment,
+                                const SlabBacking& backing) {
+            Mapping m;
+            if (!backing.mapped()) {
+                m.data = ::operator new(bytes, std::align_val_t{alignment}, std::nothrow);
+                m.bytes = bytes;
+                m.alignment = alignment;
+                return m;
+            }
+
+            const std::size_t huge = huge_page_size();
+#ifdef MAP_HUGETLB
+            if (backing.pages == SlabBacking::Pages::kHuge && bytes >= huge) {
+                m.bytes = round_up(bytes, huge);
+                m.data = map_aligned(m.bytes, alignment, MAP_HUGETLB, huge);
+                if (m.data != nullptr) {
+                    m.flags |= SlabBacking::kHugeTlb;
+                }
+            }
+#endif
+            if (m.data == nullptr) {
+                m.bytes = round_up(bytes, page_size());
+                std::size_t align = alignment < page_size() ? page_size() : alignment;
+                if (backing.pages != SlabBacking::Pages::kDefault && m.bytes >= huge &&
+                    align < huge) {
+                    align = huge;  // Let whole huge pages fit inside the slab.
+                }
+                m.data = map_aligned(m.bytes, align, 0, page_size());
+                if (m.data == nullptr) {
+                    return m;
+                }
+#ifdef MADV_HUGEPAGE
+                if (backing.pages != SlabBacking::Pages::kDefault &&
+                    ::madvise(m.data, m.bytes, MADV_HUGEPAGE) == 0) {
+                    m.flags |= SlabBacking::kTransparentHuge;
+                }
+#endif
+            }
+            m.flags |= SlabBacking::kMapped;
+
+            // Placement policy must be set before the first touch.
+            if (backing.numa_node >= 0 && bind_to_node(m.data, m.bytes, backing.numa_node)) {
+                m.flags |= SlabBacking::kNumaBound;
+            }
+            if (backing.lock && ::mlock(m.data, m.bytes) == 0) {
+                m.flags |= SlabBacking::kLocked | SlabBacking::kPrefaulted;
+            }
+            if (backing.prefault && (m.flags & SlabBacking::kPrefaulted) == 0) {
+                // A write, so each page gets its own frame rather than the zero page.
+                const std::size_t step = (m.flags & SlabBacking::kHugeTlb) != 0 ? huge
+                                                                              : page_size();
+                auto* bytes_ptr = static_cast<volatile unsigned char*>(m.data);
+                for (std::size_t offset = 0; offset < m.bytes; offset += step) {
+                    bytes_ptr[offset] = 0;
+                }
+                m.flags |= SlabBacking::kPrefaulted;
+            }
+            return m;
+        }
+
+        inline void unmap_slab(const Mapping& m) {
+            if (m.data == nullptr) {
+                return;
+            }
+            if ((m.flags & SlabBacking::kMapped) != 0) {
+                ::munmap(m.data, m.bytes);  // Also drops any mlock.
+            } else {
+                ::operator delete(m.data, std::align_val_t{m.alignment});
+            }
+        }
+
+    }  // namespace slab_detail
+
+}  // namespace ar_slam
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace ar_slam {
+
+    /**
+     * @brief Bounded lock-free single-producer/single-consumer ring buffer.
+     *
+     * One thread may call try_push() and one (other) thread may call try_pop();
+     * neither ever blocks or allocates after construction. The producer owns the
+     * tail index and the consumer the head index, each on its own cache line, and
+     * slots are handed over with acquire/release ordering. Each side also keeps a
+     * cached copy of the other's index so the common case touches only its own
+     * cache line.
+     *
+     * Capacity is rounded up to a power of two so indices wrap with a mask. Both
+     * ends exchange elements with the slot (swap) instead of copying, so buffers
+     * such as vectors circulate between producer, queue and consumer and keep
+     * their allocations: in steady state neither side allocates.
+     *
+     * @tparam T Default-constructible, move-assignable element type.
+     */
+    template <typename T>
+    class SpscQueue {
+    public:
+        /// Construct with room for at least @p capacity elements.
+        explicit SpscQueue(std::size_t capacity) {
+            std::size_t size = 2;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            slots_.resize(size);
+            mask_ = size - 1;
+        }
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        /**
+         * @brief Producer: enqueue @p value.
+         *
+         * On success @p value receives the slot's previous contents (a recycled
+         * buffer the consumer handed back), ready to be refilled.
+         * @return false (and leaves @p value untouched) if the queue is full.
+         */
+        bool try_push(T& value) {
+            const std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_cache_ > mask_) {
+                head_cache_ = head_.load(std::memory_order_acquire);
+                if (tail - head_cache_ > mask_) {
+                    return false;
+                }
+            }
+            std::swap(slots_[tail & mask_], value);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Producer: true if try_push() would succeed now.
+         *
+         * Only the producer fills slots, so the answer can only change to true
+         * before its next push; checking first lets it skip refilling a buffer
+         * that would be rejected.
+         */
+        bool writable() {
+            const std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_cache_ > mask_) {
+                head_cache_ = head_.load(std::memory_order_acquire);
+            }
+            return tail - head_cache_ <= mask_;
+        }
+
+        /**
+         * @brief Consumer: dequeue the oldest element into @p out.
+         * @return false if the queue is empty.
+         */
+        bool try_pop(T& out) {
+            const std::size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_cache_) {
+                tail_cache_ = tail_.load(std::memory_order_acquire);
+                if (head == tail_cache_) {
+                    return false;
+                }
+            }
+            std::swap(out, slots_[head & mask_]);  // Hand the old buffer back to the producer.
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// Approximate number of queued elements (exact when called by either side
+        /// while the other is idle).
+        std::size_t size_approx() const {
+            return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+        }
+
+        bool empty() const { return size_approx() == 0; }
+
+        /// Number of elements the queue can hold.
+        std::size_t capacity() const { return mask_ + 1; }
+
+    private:
+        static constexpr std::size_t kCacheLine = 64;
+
+        std::vector<T> slots_;
+        std::size_t mask_ = 0;
+
+        alignas(kCacheLine) std::atomic<std::size_t> head_{0};  // Written by the consumer.
+        std::size_t tail_cache_ = 0;                            // Consumer's view of tail_.
+
+        alignas(kCacheLine) std::atomic<std::size_t> tail_{0};  // Written by the producer.
+        std::size_t head_cache_ = 0;                            // Producer's view of head_.
+    };
+
+}  // namespace ar_slam
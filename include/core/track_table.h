@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ar_slam {
+
+    /**
+     * @brief Track id -> value table for one keyframe, indexed densely by id.
+     *
+     * The tracker hands out track ids in increasing order, so the ids alive in
+     * one keyframe sit in a narrow window below the newest one. assign() makes
+     * sure a power-of-two ring covers that window and stores each entry at slot
+     * id & (capacity - 1), tagged with its id and the table's generation; within
+     * the window no two ids share a slot, so find() is one masked load and two
+     * compares, with no hashing. Reassigning bumps the generation instead of
+     * clearing, so it writes only the new entries, and the ring is kept and only
+     * ever grows.
+     *
+     * Ids more than kMaxWindow below the newest (landmark ids re-attached by
+     * relocalization can be arbitrarily old) go to a sorted overflow list
+     * searched by bisection, so a few outliers cannot blow the ring up.
+     *
+     * @tparam T Default-constructible, copyable value type.
+     */
+    template <typename T>
+    class TrackTable {
+    public:
+        /// Widest id range kept in the ring; older ids overflow.
+        static constexpr int64_t kMaxWindow = int64_t{1} << 16;
+
+        /// Replace the contents with @p ids[i] -> @p values[i]; a repeated id keeps its last value.
+        void assign(const std::vector<int>& ids, const std::vector<T>& values) {
+            const std::size_t n = std::min(ids.size(), values.size());
+            next_generation();
+            overflow_.clear();
+            size_ = 0;
+            window_ = 0;
+            if (n == 0) {
+                return;
+            }
+
+            const int hi = *std::max_element(ids.begin(), ids.begin() + n);
+            int64_t lo = hi;
+            for (std::size_t i = 0; i < n; ++i) {
+                if (ids[i] < lo && hi - static_cast<int64_t>(ids[i]) < kMaxWindow) {
+                    lo = ids[i];
+                }
+            }
+            const std::size_t span = static_cast<std::size_t>(hi - lo + 1);
+            if (span > slots_.size()) {
+                std::size_t capacity = 16;
+                while (capacity < span) {
+                    capacity <<= 1;
+                }
+                slots_.assign(capacity, Slot{});  // Generation 0: never current.
+                mask_ = capacity - 1;
+            }
+            lo_ = lo;
+            window_ = slots_.size();
+
+            for (std::size_t i = 0; i < n; ++i) {
+                const int id = ids[i];
+                if (!in_window(id)) {
+                    overflow_.emplace_back(id, values[i]);
+                    continue;
+                }
+                Slot& slot = slots_[static_cast<std::size_t>(id) & mask_];
+                size_ += slot.generation != generation_ ? 1 : 0;
+                slot.id = id;
+                slot.generation = generation_;
+                slot.value = values[i];
+            }
+            if (!overflow_.empty()) {
+                // Sort by id, keeping the last of any repeated id.
+                std::stable_sort(overflow_.begin(), overflow_.end(),
+                                 [](const Entry& a, const Entry& b) { return a.first < b.first; });
+                auto last = overflow_.begin();
+                for (auto it = last + 1; it != overflow_.end(); ++it) {
+                    if (it->first != last->first) {
+                        ++last;
+                    }
+                    *last = *it;
+                }
+                overflow_.erase(last + 1, overflow_.end());
+                size_ += overflow_.size();
+            }
+        }
+
+        /// Value stored for @p id, or nullptr.
+        const T* find(int id) const {
+            if (in_window(id)) {
+                const Slot& slot = slots_[static_cast<std::size_t>(id) & mask_];
+                return slot.generation == generation_ && slot.id == id ? &slot.value : nullptr;
+            }
+            if (overflow_.empty()) {
+                return nullptr;
+            }
+            auto it = std::lower_bound(overflow_.begin(), overflow_.end(), id,
+                                       [](const Entry& e, int key) { return e.first < key; });
+            return it != overflow_.end() && it->first == id ? &it->second : nullptr;
+        }
+
+        /// Number of distinct ids stored.
+        std::size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        /// Drop every entry (the ring is kept).
+        void clear() {
+            next_generation();
+            overflow_.clear();
+            size_ = 0;
+            window_ = 0;
+        }
+
+        /// Ring slots allocated so far.
+        std::size_t capacity() const { return slots_.size(); }
+
+        /// Entries held outside the ring.
+        std::size_t overflow() const { return overflow_.size(); }
+
+    private:
+        struct Slot {
+            int id = 0;
+            uint32_t generation = 0;
+            T value{};
+        };
+        using Entry = std::pair<int, T>;
+
+        bool in_window(int id) const {
+            return static_cast<uint64_t>(static_cast<int64_t>(id) - lo_) < window_;
+        }
+
+        void next_generation() {
+            if (++generation_ == 0) {
+                for (Slot& slot : slots_) {
+                    slot.generation = 0;
+                }
+                generation_ = 1;
+            }
+        }
+
+        std::vector<Slot> slots_;
+        std::vector<Entry> overflow_;  // Sorted by id.
+        std::size_t mask_ = 0;
+        uint64_t window_ = 0;  // Ids in [lo_, lo_ + window_) live in the ring.
+        int64_t lo_ = 0;
+        std::size_t size_ = 0;
+        uint32_t generation_ = 0;
+    };
+
+}  // namespace ar_slam
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ar_slam {
+
+    /**
+     * @brief Lock-free single-producer/single-consumer "latest value wins" buffer.
+     *
+     * Three slots: the producer fills back(), the consumer reads front(), and
+     * the third holds the newest published value. publish() and update() each
+     * exchange their own slot with that middle one in a single atomic swap, so
+     * neither side ever waits for the other or sees a slot being written. A
+     * value published before the consumer took the previous one replaces it:
+     * the consumer always gets the newest, and the producer learns the older
+     * one was dropped.
+     *
+     * Slots are recycled rather than cleared, so buffers such as images keep
+     * their allocations as they circulate: in steady state neither side
+     * allocates.
+     *
+     * @tparam T Default-constructible element type.
+     */
+    template <typename T>
+    class TripleBuffer {
+    public:
+        TripleBuffer() = default;
+
+        TripleBuffer(const TripleBuffer&) = delete;
+        TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+        /// Producer: the slot to fill next (it holds a value the consumer finished with).
+        T& back() { return slots_[back_]; }
+
+        /**
+         * @brief Producer: make back() the newest value and take a free slot.
+         * @return false if the value it replaced was never taken by the consumer
+         *         (a dropped value).
+         */
+        bool publish() {
+            const uint8_t previous = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+            back_ = previous & kIndex;
+            return (previous & kFresh) == 0;
+        }
+
+        /**
+         * @brief Consumer: move to the newest published value, if there is one.
+         * @return false (and front() is unchanged) if nothing was published since
+         *         the last update().
+         */
+        bool update() {
+            if (!has_update()) {
+                return false;
+            }
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+            return true;
+        }
+
+        /// Consumer: whether update() would find a new value.
+        bool has_update() const { return (middle_.load(std::memory_order_relaxed) & kFresh) != 0; }
+
+        /// Consumer: the value taken by the last successful update().
+        T& front() { return slots_[front_]; }
+
+    private:
+        static constexpr std::size_t kCacheLine = 64;
+        static constexpr uint8_t kIndex = 0x3;
+        static constexpr uint8_t kFresh = 0x4;  // Set on the middle slot until it is taken.
+
+        T slots_[3];
+
+        alignas(kCacheLine) std::atomic<uint8_t> middle_{1};  // Slot index | kFresh.
+        alignas(kCacheLine) uint8_t back_ = 0;                // Owned by the producer.
+        alignas(kCacheLine) uint8_t front_ = 2;               // Owned by the consumer.
+    };
+
+}  // namespace ar_slam
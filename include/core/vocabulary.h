@@ -0,0 +1,503 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/keyframe_database.h"
+
+namespace ar_slam {
+
+    /// One visual word of a bag-of-words vector.
+    struct BowEntry {
+        uint32_t word = 0;
+        float weight = 0.0f;
+    };
+
+    /// Sparse tf-idf bag-of-words vector: entries sorted by word, L1-normalised.
+    using BowVector = std::vector<BowEntry>;
+
+    /**
+     * @brief Tree node, stored on disk exactly as in memory (48 bytes).
+     *
+     * The children of a node are contiguous: [first_child, first_child +
+     * child_count). Leaves (child_count == 0) are the visual words.
+     */
+    struct VocabularyNode {
+        uint8_t descriptor[kDescriptorBytes];  ///< Cluster centre (bitwise majority).
+        uint32_t first_child;
+        uint32_t child_count;
+        uint32_t word;  ///< Word id (leaves only).
+        float idf;      ///< Inverse document frequency weight (leaves only).
+    };
+    static_assert(sizeof(VocabularyNode) == 48, "VocabularyNode is part of the file format");
+
+    namespace bow_detail {
+
+        /// Hamming distance between two kDescriptorBytes-byte descriptors.
+        inline int hamming(const uint8_t* a, const uint8_t* b) {
+            int d = 0;
+            for (std::size_t i = 0; i < kDescriptorBytes; i += 8) {
+                uint64_t x, y;
+                std::memcpy(&x, a + i, 8);
+                std::memcpy(&y, b + i, 8);
+                d += __builtin_popcountll(x ^ y);
+            }
+            return d;
+        }
+
+        /// Little-endian file header; nodes follow at kNodeOffset.
+        struct FileHeader {
+            char magic[4];  // "ARBV"
+            uint32_t version;
+            uint32_t branching;
+            uint32_t depth;
+            uint32_t node_count;
+            uint32_t word_count;
+            uint64_t reserved;
+        };
+        static_assert(sizeof(FileHeader) == 32, "FileHeader is part of the file format");
+
+        constexpr uint32_t kFileVersion = 1;
+        constexpr std::size_t kNodeOffset = 64;  // Header padded to a cache line.
+
+    }  // namespace bow_detail
+
+    /**
+     * @brief Hierarchical k-majority vocabulary tree over binary descriptors.
+     *
+     * Training clusters ORB descriptors recursively: each level splits a node's
+     * descriptors into up to @p k clusters by Hamming k-medians (k-means++
+     * seeding, bitwise-majority centres), down to @p depth levels. The leaves are
+     * the visual words, weighted by inverse document frequency over the training
+     * images. transform() turns a keyframe's descriptors into a sparse tf-idf
+     * BowVector by descending the tree (depth x k Hamming distances per
+     * descriptor); score() compares two vectors with the L1 similarity in [0, 1].
+     *
+     * The file format is the node table itself, so load() maps the file with
+     * mmap and uses it in place: loading a million-word vocabulary is one
+     * validation pass over the table rather than parsing and allocating tens of
+     * megabytes, and processes sharing a vocabulary share its pages.
+     */
+    class Vocabulary {
+    public:
+        Vocabulary() = default;
+        ~Vocabulary() { unmap(); }
+
+        Vocabulary(const Vocabulary&) = delete;
+        Vocabulary& operator=(const Vocabulary&) = delete;
+
+        Vocabulary(Vocabulary&& other) noexcept { *this = std::move(other); }
+
+        Vocabulary& operator=(Vocabulary&& other) noexcept {
+            if (this != &other) {
+                unmap();
+                owned_ = std::move(other.owned_);
+                nodes_ = other.nodes_;
+                node_count_ = other.node_count_;
+                word_count_ = other.word_count_;
+                branching_ = other.branching_;
+                depth_ = other.depth_;
+                mapping_ = other.mapping_;
+                mapping_size_ = other.mapping_size_;
+                if (mapping_ == nullptr) {
+                    nodes_ = owned_.data();
+                }
+                other.nodes_ = nullptr;
+                other.node_count_ = other.word_count_ = 0;
+                other.mapping_ = nullptr;
+                other.mapping_size_ = 0;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Train from per-image descriptor sets.
+         * @param images  One entry per training image: kDescriptorBytes per row.
+         * @param k       Branching factor.
+         * @param depth   Number of levels below the root.
+         * @param seed    Seed for k-means++ initialisation (training is deterministic).
+         */
+        static Vocabulary train(const std::vector<std::vector<uint8_t>>& images,
+                                int k,
+                                int depth,
+                                uint32_t seed = 1u) {
+            Vocabulary voc;
+            voc.branching_ = static_cast<uint32_t>(std::max(2, k));
+            voc.depth_ = static_cast<uint32_t>(std::max(1, depth));
+
+            std::vector<const uint8_t*> rows;
+            for (const auto& image : images) {
+                for (std::size_t r = 0; r + kDescriptorBytes <= image.size();
+                     r += kDescriptorBytes) {
+                    rows.push_back(image.data() + r);
+                }
+            }
+
+            voc.owned_.push_back(VocabularyNode{});
+            std::mt19937 rng(seed);
+            voc.split(0, rows, 0, rng);
+
+            // Number the leaves and weight them by idf over the training images.
+            voc.word_count_ = 0;
+            for (VocabularyNode& node : voc.owned_) {
+                if (node.child_count == 0) {
+                    node.word = voc.word_count_++;
+                }
+            }
+            voc.nodes_ = voc.owned_.data();
+            voc.node_count_ = static_cast<uint32_t>(voc.owned_.size());
+
+            std::vector<uint32_t> documents(voc.word_count_, 0);
+            std::vector<uint32_t> last_image(voc.word_count_, std::numeric_limits<uint32_t>::max());
+            for (uint32_t i = 0; i < images.size(); ++i) {
+                for (std::size_t r = 0; r + kDescriptorBytes <= images[i].size();
+                     r += kDescriptorBytes) {
+                    const uint32_t w = voc.nodes_[voc.leaf_of(images[i].data() + r)].word;
+                    if (last_image[w] != i) {
+                        last_image[w] = i;
+                        ++documents[w];
+                    }
+                }
+            }
+            const double n_images = static_cast<double>(std::max<std::size_t>(1, images.size()));
+            for (VocabularyNode& node : voc.owned_) {
+                if (node.child_count == 0) {
+                    const double df = std::max<uint32_t>(1, documents[node.word]);
+                    node.idf = static_cast<float>(std::log(n_images / df));
+                }
+            }
+            return voc;
+        }
+
+        /// Write the vocabulary in the mmap-able binary format.
+        bool save(const std::string& path) const {
+            std::FILE* f = std::fopen(path.c_str(), "wb");
+            if (f == nullptr) {
+                return false;
+            }
+            bow_detail::FileHeader header{};
+            std::memcpy(header.magic, "ARBV", 4);
+            header.version = bow_detail::kFileVersion;
+            header.branching = branching_;
+            header.depth = depth_;
+            header.node_count = node_count_;
+            header.word_count = word_count_;
+            char pad[bow_detail::kNodeOffset] = {};
+            bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+                      std::fwrite(pad, bow_detail::kNodeOffset - sizeof(header), 1, f) == 1 &&
+                      std::fwrite(nodes_, sizeof(VocabularyNode), node_count_, f) == node_count_;
+            ok = std::fclose(f) == 0 && ok;
+            return ok;
+        }
+
+        /**
+         * @brief Map a vocabulary file written by save() (read-only, zero-copy).
+         * @return false if the file is missing, truncated, corrupt or not a vocabulary.
+         */
+        bool load(const std::string& path) {
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat st {};
+            void* mapped = MAP_FAILED;
+            if (::fstat(fd, &st) == 0 &&
+                static_cast<std::size_t>(st.st_size) >= bow_detail::kNodeOffset) {
+                mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            ::close(fd);  // The mapping keeps the file referenced.
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+
+            const std::size_t size = static_cast<std::size_t>(st.st_size);
+            bow_detail::FileHeader header;
+            std::memcpy(&header, mapped, sizeof(header));
+            bool valid =
+                std::memcmp(header.magic, "ARBV", 4) == 0 &&
+                header.version == bow_detail::kFileVersion && header.node_count > 0 &&
+                size >= bow_detail::kNodeOffset + header.node_count * sizeof(VocabularyNode);
+            const VocabularyNode* nodes = reinterpret_cast<const VocabularyNode*>(
+                static_cast<const char*>(mapped) + bow_detail::kNodeOffset);
+            // Children must point forward and stay in range, so a corrupt file can
+            // neither read out of bounds nor loop in leaf_of().
+            for (uint32_t n = 0; valid && n < header.node_count; ++n) {
+                const VocabularyNode& node = nodes[n];
+                valid = node.child_count == 0
+                            ? node.word < header.word_count
+                            : node.first_child > n &&
+                                  uint64_t{node.first_child} + node.child_count <=
+                                      header.node_count;
+            }
+            if (!valid) {
+                ::munmap(mapped, size);
+                return false;
+            }
+
+            unmap();
+            owned_.clear();
+            mapping_ = mapped;
+            mapping_size_ = size;
+            nodes_ = nodes;
+            node_count_ = header.node_count;
+            word_count_ = header.word_count;
+            branching_ = header.branching;
+            depth_ = header.depth;
+            return true;
+        }
+
+        /// Word id of one descriptor (descends the tree, one branch per level).
+        uint32_t word_of(const uint8_t* descriptor) const {
+            return nodes_[leaf_of(descriptor)].word;
+        }
+
+        /**
+         * @brief Sparse tf-idf vector of @p count descriptors (kDescriptorBytes each).
+         * @param out Reused: cleared and filled, sorted by word and L1-normalised.
+         */
+        void transform(const uint8_t* descriptors, std::size_t count, BowVector& out) const {
+            out.clear();
+            if (empty()) {
+                return;
+            }
+            // Weight each occurrence by its word's idf; repeats sum to tf * idf.
+            for (std::size_t i = 0; i < count; ++i) {
+                const VocabularyNode& leaf = nodes_[leaf_of(descriptors + i * kDescriptorBytes)];
+                if (leaf.idf > 0.0f) {
+                    out.push_back({leaf.word, leaf.idf});
+                }
+            }
+            std::sort(out.begin(), out.end(),
+                      [](const BowEntry& a, const BowEntry& b) { return a.word < b.word; });
+
+            std::size_t unique = 0;
+            double norm = 0.0;
+            for (std::size_t i = 0; i < out.size(); ++i) {
+                norm += out[i].weight;
+                if (unique > 0 && out[unique - 1].word == out[i].word) {
+                    out[unique - 1].weight += out[i].weight;
+                } else {
+                    out[unique++] = out[i];
+                }
+            }
+            out.resize(unique);
+            if (norm > 0.0) {
+                for (BowEntry& e : out) {
+                    e.weight = static_cast<float>(e.weight / norm);
+                }
+            }
+        }
+
+        /// Convenience overload for descriptor rows stored like MapKeyframe::descriptors.
+        BowVector transform(const std::vector<uint8_t>& descriptors) const {
+            BowVector out;
+            transform(descriptors.data(), descriptors.size() / kDescriptorBytes, out);
+            return out;
+        }
+
+        /**
+         * @brief L1 similarity of two L1-normalised vectors, in [0, 1].
+         *
+         * 1 - |a - b|_1 / 2, evaluated over the words the vectors share only.
+         */
+        static double score(const BowVector& a, const BowVector& b) {
+            double s = 0.0;
+            std::size_t i = 0, j = 0;
+            while (i < a.size() && j < b.size()) {
+                if (a[i].word < b[j].word) {
+                    ++i;
+                } else if (b[j].word < a[i].word) {
+                    ++j;
+                } else {
+                    s += std::fabs(a[i].weight) + std::fabs(b[j].weight) -
+                         std::fabs(a[i].weight - b[j].weight);
+                    ++i;
+                    ++j;
+                }
+            }
+            return 0.5 * s;
+        }
+
+        bool empty() const { return node_count_ == 0; }
+        uint32_t word_count() const { return word_count_; }
+        uint32_t node_count() const { return node_count_; }
+        uint32_t branching() const { return branching_; }
+        uint32_t depth() const { return depth_; }
+
+        /// True if the node table lives in a file mapping rather than on the heap.
+        bool mapped() const { return mapping_ != nullptr; }
+
+    private:
+        // Recursively cluster `rows` under node `parent`.
+        void split(uint32_t parent,
+                   const std::vector<const uint8_t*>& rows,
+                   uint32_t level,
+                   std::mt19937& rng) {
+            if (level >= depth_ || rows.size() <= 1) {
+                return;  // Leaf: its centre was set by the parent's clustering.
+            }
+
+            std::vector<std::vector<uint8_t>> centres;
+            std::vector<std::vector<const uint8_t*>> clusters;
+            k_majority(rows, rng, centres, clusters);
+
+            const uint32_t first = static_cast<uint32_t>(owned_.size());
+            uint32_t count = 0;
+            for (std::size_t c = 0; c < centres.size(); ++c) {
+                if (clusters[c].empty()) {
+                    continue;
+                }
+                VocabularyNode node{};
+                std::memcpy(node.descriptor, centres[c].data(), kDescriptorBytes);
+                owned_.push_back(node);
+                ++count;
+            }
+            owned_[parent].first_child = first;
+            owned_[parent].child_count = count;
+
+            uint32_t child = first;
+            for (std::size_t c = 0; c < centres.size(); ++c) {
+                if (!clusters[c].empty()) {
+                    split(child++, clusters[c], level + 1, rng);
+                }
+            }
+        }
+
+        // Hamming k-medians with k-means++ seeding and bitwise-majority centres.
+        void k_majority(const std::vector<const uint8_t*>& rows,
+                        std::mt19937& rng,
+                        std::vector<std::vector<uint8_t>>& centres,
+                        std::vector<std::vector<const uint8_t*>>& clusters) const {
+            const std::size_t k = std::min<std::size_t>(branching_, rows.size());
+            centres.clear();
+
+            std::vector<double> nearest(rows.size(), std::numeric_limits<double>::max());
+            std::uniform_int_distribution<std::size_t> pick(0, rows.size() - 1);
+            const uint8_t* seed = rows[pick(rng)];
+            centres.emplace_back(seed, seed + kDescriptorBytes);
+            while (centres.size() < k) {
+                double total = 0.0;
+                for (std::size_t i = 0; i < rows.size(); ++i) {
+                    const double d = bow_detail::hamming(rows[i], centres.back().data());
+                    nearest[i] = std::min(nearest[i], d * d);
+                    total += nearest[i];
+                }
+                if (total <= 0.0) {
+                    break;  // Fewer distinct descriptors than clusters.
+                }
+                std::uniform_real_distribution<double> u(0.0, total);
+                double target = u(rng);
+                std::size_t chosen = rows.size() - 1;
+                for (std::size_t i = 0; i < rows.size(); ++i) {
+                    target -= nearest[i];
+                    if (target <= 0.0) {
+                        chosen = i;
+                        break;
+                    }
+                }
+                centres.emplace_back(rows[chosen], rows[chosen] + kDescriptorBytes);
+            }
+
+            std::vector<std::size_t> assignment(rows.size(), 0);
+            constexpr int kMaxIterations = 10;
+            for (int it = 0; it < kMaxIterations; ++it) {
+                bool changed = it == 0;
+                for (std::size_t i = 0; i < rows.size(); ++i) {
+                    std::size_t best = 0;
+                    int best_distance = std::numeric_limits<int>::max();
+                    for (std::size_t c = 0; c < centres.size(); ++c) {
+                        const int d = bow_detail::hamming(rows[i], centres[c].data());
+                        if (d < best_distance) {
+                            best_distance = d;
+                            best = c;
+                        }
+                    }
+                    changed = changed || assignment[i] != best;
+                    assignment[i] = best;
+                }
+                if (!changed) {
+                    break;
+                }
+
+                // Each centre bit becomes the majority bit of its members.
+                std::vector<std::vector<uint32_t>> ones(
+                    centres.size(), std::vector<uint32_t>(kDescriptorBytes * 8));
+                std::vector<uint32_t> members(centres.size(), 0);
+                for (std::size_t i = 0; i < rows.size(); ++i) {
+                    std::vector<uint32_t>& bits = ones[assignment[i]];
+                    ++members[assignment[i]];
+                    for (std::size_t b = 0; b < kDescriptorBytes * 8; ++b) {
+                        bits[b] += (rows[i][b / 8] >> (b % 8)) & 1u;
+                    }
+                }
+                for (std::size_t c = 0; c < centres.size(); ++c) {
+                    if (members[c] == 0) {
+                        continue;
+                    }
+                    std::fill(centres[c].begin(), centres[c].end(), 0);
+                    for (std::size_t b = 0; b < kDescriptorBytes * 8; ++b) {
+                        if (2 * ones[c][b] > members[c]) {
+                            centres[c][b / 8] |= static_cast<uint8_t>(1u << (b % 8));
+                        }
+                    }
+                }
+            }
+
+            clusters.assign(centres.size(), {});
+            for (std::size_t i = 0; i < rows.size(); ++i) {
+                clusters[assignment[i]].push_back(rows[i]);
+            }
+        }
+
+        // Index of the leaf node @p descriptor descends to.
+        uint32_t leaf_of(const uint8_t* descriptor) const {
+            uint32_t n = 0;
+            while (nodes_[n].child_count > 0) {
+                const VocabularyNode& node = nodes_[n];
+                uint32_t best = node.first_child;
+                int best_distance = std::numeric_limits<int>::max();
+                for (uint32_t c = node.first_child; c < node.first_child + node.child_count; ++c) {
+                    const int d = bow_detail::hamming(descriptor, nodes_[c].descriptor);
+                    if (d < best_distance) {
+                        best_distance = d;
+                        best = c;
+                    }
+                }
+                n = best;
+            }
+            return n;
+        }
+
+        void unmap() {
+            if (mapping_ != nullptr) {
+                ::munmap(mapping_, mapping_size_);
+                mapping_ = nullptr;
+                mapping_size_ = 0;
+            }
+        }
+
+        std::vector<VocabularyNode> owned_;  // Node table when trained in-process.
+        const VocabularyNode* nodes_ = nullptr;
+        uint32_t node_count_ = 0;
+        uint32_t word_count_ = 0;
+        uint32_t branching_ = 0;
+        uint32_t depth_ = 0;
+        void* mapping_ = nullptr;  // Node table source when loaded with load().
+        std::size_t mapping_size_ = 0;
+    };
+
+}  // namespace ar_slam
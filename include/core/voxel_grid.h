@@ -0,0 +1,736 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "core/geometry.h"
+
+namespace ar_slam {
+
+    namespace voxel_detail {
+
+        constexpr int kAxisBits = 21;                             ///< Bits per axis in a key.
+        constexpr int32_t kAxisMin = -(1 << (kAxisBits - 1));     ///< Lowest voxel coordinate.
+        constexpr int32_t kAxisMax = (1 << (kAxisBits - 1)) - 1;  ///< Highest voxel coordinate.
+
+        /// Marks a free table slot; never a Morton code, which leaves bit 63 clear.
+        constexpr uint64_t kEmptyKey = ~uint64_t{0};
+
+        /// Points a sequential scan tests in the time of one hashed voxel probe (a
+        /// likely cache miss). A query that would probe more than
+        /// points / kProbeCost voxels scans the points instead.
+        constexpr std::size_t kProbeCost = 8;
+
+        /// Edge, in voxels, of the blocks frustum queries cull before probing voxels.
+        constexpr int32_t kCullBlock = 8;
+
+        /// Spread the low 21 bits of @p v so that two zero bits follow each one.
+        inline uint64_t spread_bits(uint64_t v) {
+            v &= 0x1fffff;
+            v = (v | v << 32) & 0x1f00000000ffffull;
+            v = (v | v << 16) & 0x1f0000ff0000ffull;
+            v = (v | v << 8) & 0x100f00f00f00f00full;
+            v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+            v = (v | v << 2) & 0x1249249249249249ull;
+            return v;
+        }
+
+        /// Inverse of spread_bits(): gather every third bit.
+        inline uint64_t compact_bits(uint64_t v) {
+            v &= 0x1249249249249249ull;
+            v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ull;
+            v = (v ^ (v >> 4)) & 0x100f00f00f00f00full;
+            v = (v ^ (v >> 8)) & 0x1f0000ff0000ffull;
+            v = (v ^ (v >> 16)) & 0x1f00000000ffffull;
+            v = (v ^ (v >> 32)) & 0x1fffff;
+            return v;
+        }
+
+        /// Integer voxel coordinates.
+        struct Voxel {
+            int32_t x = 0;
+            int32_t y = 0;
+            int32_t z = 0;
+        };
+
+        /// Morton (Z-order) code of a voxel; coordinates must lie in [kAxisMin, kAxisMax].
+        inline uint64_t morton(const Voxel& v) {
+            return spread_bits(static_cast<uint64_t>(v.x - kAxisMin)) |
+                   spread_bits(static_cast<uint64_t>(v.y - kAxisMin)) << 1 |
+                   spread_bits(static_cast<uint64_t>(v.z - kAxisMin)) << 2;
+        }
+
+        /// Voxel coordinates of a Morton code.
+        inline Voxel demorton(uint64_t code) {
+            return {static_cast<int32_t>(compact_bits(code)) + kAxisMin,
+                    static_cast<int32_t>(compact_bits(code >> 1)) + kAxisMin,
+                    static_cast<int32_t>(compact_bits(code >> 2)) + kAxisMin};
+        }
+
+        /// Table hash of a Morton code. Neighbouring voxels have neighbouring codes,
+        /// which would form long runs under linear probing; the finaliser of
+        /// SplitMix64 scatters them.
+        inline uint64_t mix(uint64_t k) {
+            k ^= k >> 30;
+            k *= 0xbf58476d1ce4e5b9ull;
+            k ^= k >> 27;
+            k *= 0x94d049bb133111ebull;
+            k ^= k >> 31;
+            return k;
+        }
+
+    }  // namespace voxel_detail
+
+    /// A point stored in a VoxelGrid.
+    struct VoxelPoint {
+        geometry::Vec3 position{};
+        int id = -1;                             ///< Caller's id (e.g. landmark id); -1 if free.
+        int weight = 0;                          ///< Insertions fused into this point.
+        int next = -1;                           ///< Next point in the voxel, or in the free list.
+        uint64_t key = voxel_detail::kEmptyKey;  ///< Morton code of the voxel holding it.
+    };
+
+    /**
+     * @brief Sparse voxel hash grid over 3D points, for deduplication and
+     *        neighbourhood queries without linear scans.
+     *
+     * Space is cut into cubes of Config::voxel_size; only voxels that hold a
+     * point exist. A voxel is keyed by the Morton code of its integer
+     * coordinates (21 bits per axis, so ±2^20 voxels around the origin; points
+     * beyond are clamped into the border voxels, which keeps queries correct but
+     * slower) and found through an open-addressing table with linear probing,
+     * kept at most half full. Each voxel heads an intrusive list of the points
+     * inside it, so insert(), move() and remove() are O(1) plus a short list walk.
+     *
+     * Points are addressed by handles, indices into points() that stay valid
+     * until the point is removed. While nothing is removed, handles are handed
+     * out sequentially from 0, so they can mirror another array's indices.
+     *
+     * Queries probe only the voxels overlapping the query volume, skipping
+     * voxels whose cube cannot intersect it, so their cost follows the points
+     * near the query rather than the size of the cloud. The grid pays off when
+     * the query volume spans few voxels per point: radius queries of a few
+     * voxels, k-nearest queries whose neighbours lie within a voxel or two, and
+     * frustums that see a small part of a large map. When the volume is so large
+     * (or the grid so small) that probing would cost more than testing every
+     * point, the query falls back to one pass over points(). That pass is slower
+     * than scanning a packed array of positions (about 1.4x in
+     * voxel_grid_benchmark), and nearest() only falls back after probing the
+     * shells it has already reached, so on a sparse cloud it can be several
+     * times slower than a scan. Not thread-safe.
+     */
+    class VoxelGrid {
+    public:
+        struct Config {
+            double voxel_size = 0.1;           ///< Voxel edge length (map units).
+            double merge_radius = 0.0;         ///< insert() fuses points this close (0 = never).
+            std::size_t initial_slots = 1024;  ///< Table slots reserved up front.
+        };
+
+        /// Outcome of insert().
+        struct InsertResult {
+            int handle = -1;      ///< Point that now holds the position.
+            bool merged = false;  ///< True if fused into an existing point.
+        };
+
+        /// Construct with default settings.
+        VoxelGrid() : VoxelGrid(Config{}) {}
+
+        /// Construct with explicit settings.
+        explicit VoxelGrid(const Config& config) : config_(config) {
+            if (!(config_.voxel_size > 0.0)) {
+                config_.voxel_size = 0.1;
+            }
+            inv_voxel_ = 1.0 / config_.voxel_size;
+            std::size_t slots = 16;
+            while (slots < config_.initial_slots) {
+                slots <<= 1;
+            }
+            table_.assign(slots, Slot{});
+        }
+
+        /**
+         * @brief Insert a point, fusing it into the nearest existing point within
+         *        Config::merge_radius if there is one.
+         *
+         * A fused point moves to the weighted mean of everything fused into it and
+         * keeps its id.
+         */
+        InsertResult insert(const geometry::Vec3& p, int id) {
+            if (config_.merge_radius > 0.0) {
+                const int near = nearest_one(p, config_.merge_radius);
+                if (near >= 0) {
+                    VoxelPoint& q = points_[near];
+                    const double w = static_cast<double>(q.weight);
+                    geometry::Vec3 fused;
+                    for (int k = 0; k < 3; ++k) {
+                        fused[k] = (q.position[k] * w + p[k]) / (w + 1.0);
+                    }
+                    ++q.weight;
+                    move(near, fused);
+                    return {near, true};
+                }
+            }
+            return {add(p, id), false};
+        }
+
+        /// Insert a point without looking for duplicates. @return Its handle.
+        int add(const geometry::Vec3& p, int id) {
+            int h;
+            if (free_ >= 0) {
+                h = free_;
+                free_ = points_[h].next;
+            } else {
+                h = static_cast<int>(points_.size());
+                points_.emplace_back();
+            }
+            VoxelPoint& q = points_[h];
+            q.position = p;
+            q.id = id;
+            q.weight = 1;
+            link(h, voxel_detail::morton(voxel_of(p)));
+            ++size_;
+            return h;
+        }
+
+        /// Change the position of point @p handle (relinking it if its voxel changed).
+        void move(int handle, const geometry::Vec3& p) {
+            VoxelPoint& q = points_[handle];
+            q.position = p;
+            const uint64_t key = voxel_detail::morton(voxel_of(p));
+            if (key != q.key) {
+                unlink(handle);
+                link(handle, key);
+            }
+        }
+
+        /// Remove point @p handle; its handle may be reused by a later insertion.
+        void remove(int handle) {
+            if (!valid(handle)) {
+                return;
+            }
+            unlink(handle);
+            VoxelPoint& q = points_[handle];
+            q.id = -1;
+            q.weight = 0;
+            q.next = free_;
+            free_ = handle;
+            --size_;
+        }
+
+        /// True if @p handle refers to a stored point.
+        bool valid(int handle) const {
+            return handle >= 0 && handle < static_cast<int>(points_.size()) &&
+                   points_[handle].weight > 0;
+        }
+
+        /// Point @p handle (must be valid()).
+        const VoxelPoint& point(int handle) const { return points_[handle]; }
+
+        /// Every slot, indexed by handle; free slots have weight 0.
+        const std::vector<VoxelPoint>& points() const { return points_; }
+
+        /// Number of stored points.
+        std::size_t size() const { return size_; }
+
+        /// Number of non-empty voxels.
+        std::size_t voxels() const { return voxels_; }
+
+        /// Number of hash-table slots.
+        std::size_t slots() const { return table_.size(); }
+
+        const Config& config() const { return config_; }
+
+        /// Drop every point (keeps the table's capacity).
+        void clear() {
+            std::fill(table_.begin(), table_.end(), Slot{});
+            points_.clear();
+            free_ = -1;
+            size_ = 0;
+            voxels_ = 0;
+            used_ = 0;
+            has_bounds_ = false;
+        }
+
+        /**
+         * @brief Handles of all points within @p radius of @p center.
+         * @param out Cleared, then filled (in no particular order).
+         */
+        void radius_search(const geometry::Vec3& center,
+                           double radius,
+                           std::vector<int>& out) const {
+            out.clear();
+            if (radius < 0.0) {
+                return;
+            }
+            const double r2 = radius * radius;
+            const geometry::Vec3 lo{center[0] - radius, center[1] - radius, center[2] - radius};
+            const geometry::Vec3 hi{center[0] + radius, center[1] + radius, center[2] + radius};
+            visit_box(
+                voxel_of(lo), voxel_of(hi),
+                [&](const Slot& slot) { return box_distance2(slot.key, center) <= r2; },
+                [&](int h) {
+                    if (distance2(points_[h].position, center) <= r2) {
+                        out.push_back(h);
+                    }
+                });
+        }
+
+        /**
+         * @brief Handles of the @p k points nearest to @p center, nearest first.
+         *
+         * Searches shells of voxels outwards from the centre's voxel and stops as
+         * soon as the next shell cannot hold anything closer than the k-th best.
+         * @param max_radius Ignore points farther than this.
+         */
+        void nearest(const geometry::Vec3& center,
+                     std::size_t k,
+                     std::vector<int>& out,
+                     double max_radius = std::numeric_limits<double>::infinity()) const {
+            out.clear();
+            if (k == 0 || size_ == 0 || max_radius < 0.0) {
+                return;
+            }
+            const double limit2 = max_radius * max_radius;
+            std::vector<std::pair<double, int>> best;  // Max-heap on distance.
+            best.reserve(k + 1);
+            auto offer = [&](int h) {
+                const double d2 = distance2(points_[h].position, center);
+                if (d2 > limit2 || (best.size() == k && d2 >= best.front().first)) {
+                    return;
+                }
+                best.emplace_back(d2, h);
+                std::push_heap(best.begin(), best.end());
+                if (best.size() > k) {
+                    std::pop_heap(best.begin(), best.end());
+                    best.pop_back();
+                }
+            };
+
+            const voxel_detail::Voxel c = voxel_of(center);
+            std::size_t probes = 0;
+            const int32_t reach =
+                std::max({std::abs(c.x - bounds_lo_.x), std::abs(c.x - bounds_hi_.x),
+                          std::abs(c.y - bounds_lo_.y), std::abs(c.y - bounds_hi_.y),
+                          std::abs(c.z - bounds_lo_.z), std::abs(c.z - bounds_hi_.z)});
+            for (int32_t r = 0; r <= reach; ++r) {
+                // Every unvisited point lies at least r voxels away.
+                const double floor_dist = r > 0 ? (r - 1) * config_.voxel_size : 0.0;
+                if (floor_dist * floor_dist > limit2 ||
+                    (best.size() == k && best.front().first <= floor_dist * floor_dist)) {
+                    break;
+                }
+                // Once the shells probed cost more than testing every point, do that.
+                const std::size_t shell = r == 0 ? 1 : 24 * static_cast<std::size_t>(r) * r + 2;
+                probes += shell;
+                if (probes * voxel_detail::kProbeCost > size_) {
+                    best.clear();
+                    scan_points(offer);
+                    break;
+                }
+                visit_shell(c, r, [&](const Slot& slot) {
+                    for (int h = slot.head; h >= 0; h = points_[h].next) {
+                        offer(h);
+                    }
+                });
+            }
+            std::sort_heap(best.begin(), best.end());
+            out.reserve(best.size());
+            for (const auto& b : best) {
+                out.push_back(b.second);
+            }
+        }
+
+        /**
+         * @brief Handles of the points a camera at @p pose sees in its image.
+         *
+         * A point is visible when its depth lies in [near, far] and it projects
+         * inside the width x height image through @p K. Blocks of voxels, then
+         * voxels, are culled first by testing their bounding spheres against the
+         * frustum's six planes, so only the voxels along the frustum are probed.
+         * A frustum too large for probing to beat a scan, judged from its volume
+         * before any culling, is answered by a scan straight away.
+         */
+        void frustum(const geometry::Pose& pose,
+                     const geometry::Mat3& K,
+                     int width,
+                     int height,
+                     double near,
+                     double far,
+                     std::vector<int>& out) const {
+            out.clear();
+            if (width <= 0 || height <= 0 || !(far > near) || near < 0.0) {
+                return;
+            }
+            // Side planes through the optical centre, in the camera frame:
+            // u >= 0, u <= width, v >= 0, v <= height with u = row0.X / z, etc.
+            const double W = width;
+            const double H = height;
+            geometry::Vec3 planes[4] = {{K.m[0][0], K.m[0][1], K.m[0][2]},
+                                        {-K.m[0][0], -K.m[0][1], W - K.m[0][2]},
+                                        {K.m[1][0], K.m[1][1], K.m[1][2]},
+                                        {-K.m[1][0], -K.m[1][1], H - K.m[1][2]}};
+            for (geometry::Vec3& n : planes) {
+                const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                for (double& c : n) {
+                    c /= len;
+                }
+            }
+            const double sphere = 0.5 * std::sqrt(3.0) * config_.voxel_size;
+            const geometry::Pose to_world = pose.inverse();
+
+            // World bounding box of the frustum: the camera centre and the four
+            // far-plane corners enclose it.
+            const geometry::Vec3 centre = to_world.t;
+            geometry::Vec3 lo = centre;
+            geometry::Vec3 hi = centre;
+            const double fx = K.m[0][0];
+            const double fy = K.m[1][1];
+            for (int corner = 0; corner < 4; ++corner) {
+                const double u = (corner & 1) ? W : 0.0;
+                const double v = (corner & 2) ? H : 0.0;
+                const double y = (v - K.m[1][2]) / fy;
+                const double x = (u - K.m[0][2] - K.m[0][1] * y) / fx;
+                const geometry::Vec3 w = to_world.transform({x * far, y * far, far});
+                for (int i = 0; i < 3; ++i) {
+                    lo[i] = std::min(lo[i], w[i]);
+                    hi[i] = std::max(hi[i], w[i]);
+                }
+            }
+
+            auto outside = [&](const geometry::Vec3& world, double radius) {
+                const geometry::Vec3 pc = pose.transform(world);
+                if (pc[2] < near - radius || pc[2] > far + radius) {
+                    return true;
+                }
+                for (const geometry::Vec3& n : planes) {
+                    if (n[0] * pc[0] + n[1] * pc[1] + n[2] * pc[2] < -radius) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            auto test = [&](int h) {
+                const geometry::Vec3 X = pose.transform(points_[h].position);
+                if (X[2] < near || X[2] > far) {
+                    return;
+                }
+                const double u = (K.m[0][0] * X[0] + K.m[0][1] * X[1]) / X[2] + K.m[0][2];
+                const double v = (K.m[1][0] * X[0] + K.m[1][1] * X[1]) / X[2] + K.m[1][2];
+                if (u >= 0.0 && u < W && v >= 0.0 && v < H) {
+                    out.push_back(h);
+                }
+            };
+
+            voxel_detail::Voxel a, b;
+            if (!clip(voxel_of(lo), voxel_of(hi), a, b)) {
+                return;
+            }
+            // Decide on the scan before culling anything: the frustum's volume (a
+            // truncated pyramid), capped by the occupied part of its bounding box,
+            // is a cheap estimate of the voxels probing would visit.
+            const double vs = config_.voxel_size;
+            const double pyramid = (far * far * far - near * near * near) / 3.0 *
+                                   std::fabs(W / fx) * std::fabs(H / fy) / (vs * vs * vs);
+            const double box = (b.x - a.x + 1.0) * (b.y - a.y + 1.0) * (b.z - a.z + 1.0);
+            if (std::min(pyramid, box) * voxel_detail::kProbeCost > static_cast<double>(size_)) {
+                scan_points(test);
+                return;
+            }
+            // Keep the blocks that may intersect the frustum, then probe their voxels
+            // unless the blocks kept still cost more than testing every point.
+            constexpr int32_t B = voxel_detail::kCullBlock;
+            std::vector<voxel_detail::Voxel> blocks;
+            for (int32_t z = a.z; z <= b.z; z += B) {
+                for (int32_t y = a.y; y <= b.y; y += B) {
+                    for (int32_t x = a.x; x <= b.x; x += B) {
+                        const geometry::Vec3 centre{(x + 0.5 * B) * vs, (y + 0.5 * B) * vs,
+                                                    (z + 0.5 * B) * vs};
+                        if (!outside(centre, sphere * B)) {
+                            blocks.push_back({x, y, z});
+                        }
+                    }
+                }
+            }
+            const std::size_t block_voxels = static_cast<std::size_t>(B) * B * B;
+            if (blocks.size() * block_voxels * voxel_detail::kProbeCost > size_) {
+                scan_points(test);
+                return;
+            }
+            auto visit = [&](const Slot& slot) {
+                if (!outside(voxel_centre(slot.key), sphere)) {
+                    for (int h = slot.head; h >= 0; h = points_[h].next) {
+                        test(h);
+                    }
+                }
+            };
+            for (const voxel_detail::Voxel& c : blocks) {
+                for (int32_t z = c.z; z < c.z + B && z <= b.z; ++z) {
+                    for (int32_t y = c.y; y < c.y + B && y <= b.y; ++y) {
+                        for (int32_t x = c.x; x < c.x + B && x <= b.x; ++x) {
+                            visit_voxel({x, y, z}, visit);
+                        }
+                    }
+                }
+            }
+        }
+
+    private:
+        struct Slot {
+            uint64_t key = voxel_detail::kEmptyKey;
+            int head = -1;  ///< First point of the voxel, or -1 once emptied.
+        };
+
+        static double distance2(const geometry::Vec3& a, const geometry::Vec3& b) {
+            const double dx = a[0] - b[0];
+            const double dy = a[1] - b[1];
+            const double dz = a[2] - b[2];
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+        voxel_detail::Voxel voxel_of(const geometry::Vec3& p) const {
+            auto axis = [this](double x) {
+                const double v = std::floor(x * inv_voxel_);
+                if (!(v >= voxel_detail::kAxisMin)) {
+                    return voxel_detail::kAxisMin;  // Also catches NaN.
+                }
+                return v > voxel_detail::kAxisMax ? voxel_detail::kAxisMax
+                                                  : static_cast<int32_t>(v);
+            };
+            return {axis(p[0]), axis(p[1]), axis(p[2])};
+        }
+
+        geometry::Vec3 voxel_centre(uint64_t key) const {
+            const voxel_detail::Voxel v = voxel_detail::demorton(key);
+            return {(v.x + 0.5) * config_.voxel_size, (v.y + 0.5) * config_.voxel_size,
+                    (v.z + 0.5) * config_.voxel_size};
+        }
+
+        // Squared distance from @p p to the cube of voxel @p key.
+        double box_distance2(uint64_t key, const geometry::Vec3& p) const {
+            const voxel_detail::Voxel v = voxel_detail::demorton(key);
+            const int32_t c[3] = {v.x, v.y, v.z};
+            double d2 = 0.0;
+            for (int i = 0; i < 3; ++i) {
+                const double lo = c[i] * config_.voxel_size;
+                const double hi = lo + config_.voxel_size;
+                const double d = p[i] < lo ? lo - p[i] : (p[i] > hi ? p[i] - hi : 0.0);
+                d2 += d * d;
+            }
+            return d2;
+        }
+
+        // Table index of @p key, or -1.
+        long find(uint64_t key) const {
+            const std::size_t mask = table_.size() - 1;
+            for (std::size_t i = voxel_detail::mix(key) & mask;; i = (i + 1) & mask) {
+                if (table_[i].key == key) {
+                    return static_cast<long>(i);
+                }
+                if (table_[i].key == voxel_detail::kEmptyKey) {
+                    return -1;
+                }
+            }
+        }
+
+        // Table index of @p key, claiming a slot if the voxel is new.
+        std::size_t find_or_claim(uint64_t key) {
+            if (2 * (used_ + 1) > table_.size()) {
+                rehash();
+            }
+            const std::size_t mask = table_.size() - 1;
+            std::size_t i = voxel_detail::mix(key) & mask;
+            while (table_[i].key != key && table_[i].key != voxel_detail::kEmptyKey) {
+                i = (i + 1) & mask;
+            }
+            if (table_[i].key == voxel_detail::kEmptyKey) {
+                table_[i].key = key;
+                ++used_;
+            }
+            return i;
+        }
+
+        // Rebuild the table without the voxels that emptied out, doubling it if
+        // the live voxels alone would still fill more than a quarter.
+        void rehash() {
+            std::vector<Slot> old;
+            old.swap(table_);
+            std::size_t size = old.size();
+            while (4 * (voxels_ + 1) > size) {
+                size <<= 1;
+            }
+            table_.assign(size, Slot{});
+            used_ = 0;
+            const std::size_t mask = size - 1;
+            for (const Slot& s : old) {
+                if (s.head < 0) {
+                    continue;
+                }
+                std::size_t i = voxel_detail::mix(s.key) & mask;
+                while (table_[i].key != voxel_detail::kEmptyKey) {
+                    i = (i + 1) & mask;
+                }
+                table_[i] = s;
+                ++used_;
+            }
+        }
+
+        void link(int handle, uint64_t key) {
+            Slot& slot = table_[find_or_claim(key)];
+            if (slot.head < 0) {
+                ++voxels_;
+                const voxel_detail::Voxel v = voxel_detail::demorton(key);
+                if (!has_bounds_) {
+                    bounds_lo_ = bounds_hi_ = v;
+                    has_bounds_ = true;
+                }
+                bounds_lo_ = {std::min(bounds_lo_.x, v.x), std::min(bounds_lo_.y, v.y),
+                              std::min(bounds_lo_.z, v.z)};
+                bounds_hi_ = {std::max(bounds_hi_.x, v.x), std::max(bounds_hi_.y, v.y),
+                              std::max(bounds_hi_.z, v.z)};
+            }
+            points_[handle].key = key;
+            points_[handle].next = slot.head;
+            slot.head = handle;
+        }
+
+        void unlink(int handle) {
+            VoxelPoint& q = points_[handle];
+            Slot& slot = table_[find(q.key)];
+            if (slot.head == handle) {
+                slot.head = q.next;
+            } else {
+                int prev = slot.head;
+                while (points_[prev].next != handle) {
+                    prev = points_[prev].next;
+                }
+                points_[prev].next = q.next;
+            }
+            if (slot.head < 0) {
+                --voxels_;  // The slot keeps its key until the next rehash.
+            }
+            q.next = -1;
+            q.key = voxel_detail::kEmptyKey;
+        }
+
+        // Intersect the voxel box [lo, hi] with the occupied bounds into [a, b].
+        bool clip(const voxel_detail::Voxel& lo,
+                  const voxel_detail::Voxel& hi,
+                  voxel_detail::Voxel& a,
+                  voxel_detail::Voxel& b) const {
+            if (voxels_ == 0) {
+                return false;
+            }
+            a = {std::max(lo.x, bounds_lo_.x), std::max(lo.y, bounds_lo_.y),
+                 std::max(lo.z, bounds_lo_.z)};
+            b = {std::min(hi.x, bounds_hi_.x), std::min(hi.y, bounds_hi_.y),
+                 std::min(hi.z, bounds_hi_.z)};
+            return a.x <= b.x && a.y <= b.y && a.z <= b.z;
+        }
+
+        // Call @p fn on every point of the voxels in the box [lo, hi] (inclusive)
+        // that pass @p keep, or on every point if probing the box costs more.
+        template <typename Keep, typename Fn>
+        void visit_box(const voxel_detail::Voxel& lo,
+                       const voxel_detail::Voxel& hi,
+                       Keep&& keep,
+                       Fn&& fn) const {
+            voxel_detail::Voxel a, b;
+            if (!clip(lo, hi, a, b)) {
+                return;
+            }
+            const double box = (b.x - a.x + 1.0) * (b.y - a.y + 1.0) * (b.z - a.z + 1.0);
+            if (box * voxel_detail::kProbeCost > static_cast<double>(size_)) {
+                scan_points(fn);
+                return;
+            }
+            auto visit = [&](const Slot& slot) {
+                if (keep(slot)) {
+                    for (int h = slot.head; h >= 0; h = points_[h].next) {
+                        fn(h);
+                    }
+                }
+            };
+            for (int32_t z = a.z; z <= b.z; ++z) {
+                for (int32_t y = a.y; y <= b.y; ++y) {
+                    for (int32_t x = a.x; x <= b.x; ++x) {
+                        visit_voxel({x, y, z}, visit);
+                    }
+                }
+            }
+        }
+
+        // Call @p fn on every stored point, in handle order.
+        template <typename Fn>
+        void scan_points(Fn&& fn) const {
+            for (std::size_t h = 0; h < points_.size(); ++h) {
+                if (points_[h].weight > 0) {
+                    fn(static_cast<int>(h));
+                }
+            }
+        }
+
+        // Call @p fn on the non-empty voxels at Chebyshev distance exactly @p r from @p c.
+        template <typename Fn>
+        void visit_shell(const voxel_detail::Voxel& c, int32_t r, Fn&& fn) const {
+            for (int32_t dz = -r; dz <= r; ++dz) {
+                for (int32_t dy = -r; dy <= r; ++dy) {
+                    const bool face = dz == -r || dz == r || dy == -r || dy == r;
+                    const int32_t step = face ? 1 : 2 * std::max(r, 1);
+                    for (int32_t dx = -r; dx <= r; dx += step) {
+                        visit_voxel({c.x + dx, c.y + dy, c.z + dz}, fn);
+                    }
+                }
+            }
+        }
+
+        template <typename Fn>
+        void visit_voxel(const voxel_detail::Voxel& v, Fn&& fn) const {
+            if (v.x < voxel_detail::kAxisMin || v.x > voxel_detail::kAxisMax ||
+                v.y < voxel_detail::kAxisMin || v.y > voxel_detail::kAxisMax ||
+                v.z < voxel_detail::kAxisMin || v.z > voxel_detail::kAxisMax) {
+                return;
+            }
+            const long i = find(voxel_detail::morton(v));
+            if (i >= 0 && table_[i].head >= 0) {
+                fn(table_[i]);
+            }
+        }
+
+        // Nearest point within @p radius of @p p, or -1.
+        int nearest_one(const geometry::Vec3& p, double radius) const {
+            int best = -1;
+            double best2 = radius * radius;
+            const geometry::Vec3 lo{p[0] - radius, p[1] - radius, p[2] - radius};
+            const geometry::Vec3 hi{p[0] + radius, p[1] + radius, p[2] + radius};
+            visit_box(
+                voxel_of(lo), voxel_of(hi), [](const Slot&) { return true; },
+                [&](int h) {
+                    const double d2 = distance2(points_[h].position, p);
+                    if (d2 <= best2) {
+                        best2 = d2;
+                        best = h;
+                    }
+                });
+            return best;
+        }
+
+        Config config_;
+        double inv_voxel_ = 10.0;
+        std::vector<Slot> table_;  ///< Open addressing, power-of-two size.
+        std::vector<VoxelPoint> points_;
+        int free_ = -1;                  ///< Head of the free-slot list in points_.
+        std::size_t size_ = 0;           ///< Live points.
+        std::size_t voxels_ = 0;         ///< Slots whose voxel holds points.
+        std::size_t used_ = 0;           ///< Slots with a key (includes emptied voxels).
+        voxel_detail::Voxel bounds_lo_;  ///< Box enclosing every voxel ever occupied.
+        voxel_detail::Voxel bounds_hi_;
+        bool has_bounds_ = false;
+    };
+
+}  // namespace ar_slam
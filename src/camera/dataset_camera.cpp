@@ -0,0 +1,262 @@
+#include "camera/dataset_camera.h"
+#include "core/log.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace ar_slam {
+
+    namespace fs = std::filesystem;
+
+    namespace {
+
+        /// TUM: "<seconds> <path>" per line, the path relative to the list.
+        bool parse_tum(const fs::path& list, std::vector<DatasetCamera::Entry>& entries) {
+            std::ifstream in(list);
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+                std::istringstream fields(line);
+                DatasetCamera::Entry entry;
+                std::string file;
+                if (!(fields >> entry.timestamp >> file)) {
+                    AR_LOG("Dataset: skipping malformed line in " << list << ": " << line);
+                    continue;
+                }
+                entry.path = (list.parent_path() / file).string();
+                entries.push_back(std::move(entry));
+            }
+            return in.eof();
+        }
+
+        /// EuRoC: "<nanoseconds>,<file>" per line, the files in data/ beside the CSV.
+        bool parse_euroc(const fs::path& csv, std::vector<DatasetCamera::Entry>& entries) {
+            std::ifstream in(csv);
+            const fs::path data = csv.parent_path() / "data";
+            std::string line;
+            while (std::getline(in, line)) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+                const std::size_t comma = line.find(',');
+                if (comma == std::string::npos) {
+                    AR_LOG("Dataset: skipping malformed line in " << csv << ": " << line);
+                    continue;
+                }
+                std::size_t first = comma + 1;
+                while (first < line.size() && line[first] == ' ') {
+                    ++first;
+                }
+                DatasetCamera::Entry entry;
+                entry.timestamp = std::stoull(line.substr(0, comma)) * 1e-9;
+                entry.path = (data / line.substr(first)).string();
+                entries.push_back(std::move(entry));
+            }
+            return in.eof();
+        }
+
+    }  // namespace
+
+    bool DatasetCamera::load_index(const std::string& path, std::vector<Entry>& entries) {
+        entries.clear();
+        fs::path list = path;
+        std::error_code error;
+        if (fs::is_directory(list, error)) {
+            for (const char* candidate : {"rgb.txt", "mav0/cam0/data.csv", "cam0/data.csv",
+                                          "data.csv"}) {
+                if (fs::is_regular_file(list / candidate, error)) {
+                    list /= candidate;
+                    break;
+                }
+            }
+        }
+        if (!fs::is_regular_file(list, error)) {
+            AR_LOG("Dataset: no image list at " << path);
+            return false;
+        }
+
+        bool parsed = false;
+        try {
+            parsed = list.extension() == ".csv" ? parse_euroc(list, entries)
+                                                : parse_tum(list, entries);
+        } catch (const std::exception& e) {  // Timestamp out of range or not a number
+            AR_LOG("Dataset: cannot parse " << list << ": " << e.what());
+        }
+        if (!parsed || entries.empty()) {
+            entries.clear();
+            return false;
+        }
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const Entry& a, const Entry& b) { return a.timestamp < b.timestamp; });
+        return true;
+    }
+
+    DatasetCamera::DatasetCamera() : DatasetCamera(Options{}) {}
+
+    DatasetCamera::DatasetCamera(const Options& options) : options_(options) {
+        options_.decode_threads = std::max(1u, options_.decode_threads);
+        options_.prefetch = std::max<std::size_t>(1, options_.prefetch);
+        if (options_.speed <= 0) {
+            options_.speed = 1.0;
+        }
+    }
+
+    DatasetCamera::~DatasetCamera() { close(); }
+
+    bool DatasetCamera::open(const CameraConfig& config) {
+        close();
+        config_ = config;
+        if (!load_index(config.device_path, entries_)) {
+            return false;
+        }
+        const double span = entries_.back().timestamp - entries_.front().timestamp;
+        fps_ = span > 0 ? (entries_.size() - 1) / span : 0;
+
+        ring_.assign(options_.prefetch, Slot{});
+        stop_ = false;
+        decode_wait_ms_ = 0;
+        failures_ = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            restart(0);
+        }
+        for (unsigned i = 0; i < options_.decode_threads; ++i) {
+            workers_.emplace_back(&DatasetCamera::decode_loop, this);
+        }
+        is_running_ = true;
+        AR_LOG("Dataset: " << entries_.size() << " frames from " << config.device_path);
+        return true;
+    }
+
+    void DatasetCamera::close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        work_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+        workers_.clear();
+        ring_.clear();
+        entries_.clear();
+        position_ = next_decode_ = 0;
+        is_running_ = false;
+    }
+
+    bool DatasetCamera::seek(std::size_t index) {
+        if (!is_open() || index >= entries_.size()) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            restart(index);
+        }
+        work_.notify_all();
+        return true;
+    }
+
+    bool DatasetCamera::seek_time(double seconds) {
+        const auto it = std::lower_bound(
+            entries_.begin(), entries_.end(), seconds,
+            [](const Entry& entry, double t) { return entry.timestamp < t; });
+        return seek(static_cast<std::size_t>(it - entries_.begin()));
+    }
+
+    void DatasetCamera::restart(std::size_t index) {
+        ++generation_;  // Decodes in flight finish into nothing.
+        for (Slot& slot : ring_) {
+            slot = Slot{};
+        }
+        position_ = next_decode_ = index;
+        pace_start_ = {};  // Pacing restarts from the next frame served.
+    }
+
+    bool DatasetCamera::grab_frame(cv::Mat& frame) {
+        Frame::Timestamp timestamp;
+        return grab_frame(frame, timestamp);
+    }
+
+    bool DatasetCamera::grab_frame(cv::Mat& frame, Frame::Timestamp& timestamp) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            if (workers_.empty() || position_ >= entries_.size()) {
+                return false;
+            }
+            Slot& slot = ring_[position_ % ring_.size()];
+            if (!(slot.ready && slot.index == position_)) {
+                const auto start = std::chrono::steady_clock::now();
+                ready_.wait(lock, [&] { return slot.ready && slot.index == position_; });
+                decode_wait_ms_ += std::chrono::duration<double, std::milli>(
+                                       std::chrono::steady_clock::now() - start)
+                                       .count();
+            }
+            const std::size_t index = position_++;
+            cv::Mat image = std::move(slot.image);
+            slot = Slot{};
+            lock.unlock();
+            work_.notify_one();  // The slot can take the next frame.
+
+            if (image.empty()) {
+                AR_LOG("Dataset: cannot decode " << entries_[index].path);
+                ++failures_;
+                lock.lock();
+                continue;
+            }
+
+            const double t = entries_[index].timestamp;
+            if (options_.pacing == Pacing::kRealTime) {
+                if (pace_start_ == std::chrono::steady_clock::time_point{}) {
+                    pace_start_ = std::chrono::steady_clock::now();
+                    pace_origin_ = t;
+                }
+                const std::chrono::duration<double> offset((t - pace_origin_) / options_.speed);
+                std::this_thread::sleep_until(
+                    pace_start_ +
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+            }
+            frame = std::move(image);
+            timestamp = Frame::Timestamp(std::chrono::duration_cast<Frame::Timestamp::duration>(
+                std::chrono::duration<double>(t)));
+            return true;
+        }
+    }
+
+    void DatasetCamera::decode_loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            // The next frame may be decoded once the frame a ring length before it has gone.
+            work_.wait(lock, [this] {
+                return stop_ || (next_decode_ < entries_.size() &&
+                                 next_decode_ < position_ + ring_.size());
+            });
+            if (stop_) {
+                return;
+            }
+            const std::size_t index = next_decode_++;
+            const uint64_t generation = generation_;
+            ring_[index % ring_.size()].index = index;
+            const std::string path = entries_[index].path;
+
+            lock.unlock();
+            cv::Mat image = cv::imread(path, options_.imread_flags);
+            lock.lock();
+
+            if (generation != generation_) {
+                continue;  // A seek moved on; the slot belongs to another frame now.
+            }
+            Slot& slot = ring_[index % ring_.size()];
+            slot.image = std::move(image);
+            slot.ready = true;
+            ready_.notify_one();
+        }
+    }
+
+}  // namespace ar_slam
@@ -0,0 +1,332 @@
+#include "camera/raw_recording.h"
+#include "core/log.h"
+#include "core/map_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace ar_slam {
+
+    using namespace raw_recording_detail;
+    using map_file_detail::checksum;
+
+    namespace {
+
+        int64_t to_ns(const Frame::Timestamp& timestamp) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       timestamp.time_since_epoch())
+                .count();
+        }
+
+        Frame::Timestamp from_ns(int64_t ns) {
+            return Frame::Timestamp(std::chrono::duration_cast<Frame::Timestamp::duration>(
+                std::chrono::nanoseconds(ns)));
+        }
+
+        uint64_t header_checksum(const FileHeader& header) {
+            return checksum(&header, offsetof(FileHeader, checksum));
+        }
+
+        uint64_t record_checksum(FrameRecord record) {
+            record.checksum = 0;
+            return checksum(&record, sizeof(record));
+        }
+
+        uint64_t trailer_checksum(const IndexTrailer& trailer) {
+            return checksum(&trailer, offsetof(IndexTrailer, checksum));
+        }
+
+        /// Geometry a reader can turn into a cv::Mat header without overrunning it.
+        bool valid_geometry(uint32_t format, int32_t rows, int32_t cols, int32_t type,
+                            uint64_t step) {
+            return format <= static_cast<uint32_t>(Frame::PixelFormat::kBGRA) && rows > 0 &&
+                   cols > 0 && type >= 0 && type == CV_MAT_TYPE(type) &&
+                   step >= static_cast<uint64_t>(cols) * CV_ELEM_SIZE(type);
+        }
+
+        RecordedFrame to_frame(uint64_t offset, int64_t timestamp_ns, uint32_t format,
+                               uint64_t sequence, int32_t rows, int32_t cols, int32_t type,
+                               uint64_t step) {
+            RecordedFrame frame;
+            frame.timestamp = from_ns(timestamp_ns);
+            frame.format = static_cast<Frame::PixelFormat>(format);
+            frame.sequence = sequence;
+            frame.offset = offset;
+            frame.rows = rows;
+            frame.cols = cols;
+            frame.type = type;
+            frame.step = static_cast<std::size_t>(step);
+            return frame;
+        }
+
+        /// One page of zeros to pad records with.
+        const char kZeros[kPageSize] = {};
+
+    }  // namespace
+
+    // --- RawRecorder ------------------------------------------------------
+
+    bool RawRecorder::open(const std::string& path) {
+        close();
+        if (!map_file_detail::kLittleEndian) {
+            return false;
+        }
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            AR_LOG("Raw recording: cannot create " << path << ": " << std::strerror(errno));
+            return false;
+        }
+        path_ = path;
+        offset_ = 0;
+        index_.clear();
+
+        FileHeader header{};
+        std::memcpy(header.magic, "ARRW", 4);
+        header.version = kFileVersion;
+        header.page_size = static_cast<uint32_t>(kPageSize);
+        header.checksum = header_checksum(header);
+        if (!write_fully(&header, sizeof(header)) || !pad_to_page()) {
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        return true;
+    }
+
+    bool RawRecorder::write(const cv::Mat& image, Frame::PixelFormat format,
+                            const Frame::Timestamp& timestamp) {
+        if (fd_ < 0 || image.empty()) {
+            return false;
+        }
+        // Rows are stored packed whatever the source stride.
+        const uint64_t row_bytes = static_cast<uint64_t>(image.cols) * image.elemSize();
+        FrameRecord record{};
+        std::memcpy(record.magic, "ARFR", 4);
+        record.pixel_format = static_cast<uint32_t>(format);
+        record.timestamp_ns = to_ns(timestamp);
+        record.sequence = index_.size();
+        record.rows = image.rows;
+        record.cols = image.cols;
+        record.type = image.type();
+        record.step = row_bytes;
+        record.size = row_bytes * image.rows;
+        record.checksum = record_checksum(record);
+
+        const uint64_t start = offset_;
+        bool ok = write_fully(&record, sizeof(record));
+        if (ok && image.isContinuous()) {
+            ok = write_fully(image.data, record.size);
+        } else {
+            for (int r = 0; ok && r < image.rows; ++r) {
+                ok = write_fully(image.ptr(r), row_bytes);
+            }
+        }
+        ok = ok && pad_to_page();
+        if (!ok) {
+            // Cut the torn record off so later frames (and the index) still line up.
+            AR_LOG("Raw recording: write to " << path_ << " failed: " << std::strerror(errno));
+            offset_ = start;
+            if (::ftruncate(fd_, static_cast<off_t>(start)) != 0) {
+                AR_LOG("Raw recording: cannot truncate " << path_);
+            }
+            return false;
+        }
+
+        IndexEntry entry{};
+        entry.timestamp_ns = record.timestamp_ns;
+        entry.offset = start;
+        entry.pixel_format = record.pixel_format;
+        entry.rows = record.rows;
+        entry.cols = record.cols;
+        entry.type = record.type;
+        entry.step = record.step;
+        entry.sequence = record.sequence;
+        index_.push_back(entry);
+        return true;
+    }
+
+    bool RawRecorder::close() {
+        if (fd_ < 0) {
+            return true;
+        }
+        IndexTrailer trailer{};
+        std::memcpy(trailer.magic, "ARIX", 4);
+        trailer.index_offset = offset_;
+        trailer.count = index_.size();
+        trailer.index_checksum = checksum(index_.data(), index_.size() * sizeof(IndexEntry));
+        trailer.checksum = trailer_checksum(trailer);
+        const bool ok = write_fully(index_.data(), index_.size() * sizeof(IndexEntry)) &&
+                        write_fully(&trailer, sizeof(trailer));
+        if (!ok) {
+            AR_LOG("Raw recording: cannot write the index of " << path_
+                                                               << "; readers will scan it");
+        }
+        ::close(fd_);
+        fd_ = -1;
+        return ok;
+    }
+
+    bool RawRecorder::write_fully(const void* data, std::size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            const ssize_t n = ::pwrite(fd_, p, size, static_cast<off_t>(offset_));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            p += n;
+            size -= static_cast<std::size_t>(n);
+            offset_ += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    bool RawRecorder::pad_to_page() {
+        return write_fully(kZeros, page_align(offset_) - offset_);
+    }
+
+    // --- RawRecording -----------------------------------------------------
+
+    bool RawRecording::open(const std::string& path) {
+        close();
+        if (!map_file_detail::kLittleEndian) {
+            return false;
+        }
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st {};
+        void* mapped = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(FileHeader)) {
+            // Private and writable: callers may draw on a frame; the file never changes.
+            mapped = ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);  // The mapping keeps the file referenced.
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        const std::size_t size = static_cast<std::size_t>(st.st_size);
+        mapping_ = std::shared_ptr<void>(mapped, [size](void* p) { ::munmap(p, size); });
+        mapping_size_ = size;
+
+        FileHeader header;
+        std::memcpy(&header, mapped, sizeof(header));
+        if (std::memcmp(header.magic, "ARRW", 4) != 0 || header.version != kFileVersion ||
+            header.page_size != kPageSize || header.checksum != header_checksum(header)) {
+            AR_LOG("Raw recording: " << path << " is not a raw recording");
+            close();
+            return false;
+        }
+        ::madvise(mapped, size, MADV_SEQUENTIAL);
+
+        if (!read_index()) {
+            frames_.clear();
+            scan_records();
+            AR_LOG("Raw recording: " << path << " has no index; recovered " << frames_.size()
+                                     << " frames" << (truncated_ ? " before a torn record" : ""));
+        }
+        return true;
+    }
+
+    void RawRecording::close() {
+        mapping_.reset();
+        mapping_size_ = 0;
+        frames_.clear();
+        indexed_ = false;
+        truncated_ = false;
+    }
+
+    bool RawRecording::read_index() {
+        const auto* base = static_cast<const uint8_t*>(mapping_.get());
+        if (mapping_size_ < kPageSize + sizeof(IndexTrailer)) {
+            return false;
+        }
+        const uint64_t trailer_offset = mapping_size_ - sizeof(IndexTrailer);
+        IndexTrailer trailer;
+        std::memcpy(&trailer, base + trailer_offset, sizeof(trailer));
+        if (std::memcmp(trailer.magic, "ARIX", 4) != 0 ||
+            trailer.checksum != trailer_checksum(trailer) ||
+            trailer.index_offset % kPageSize != 0 || trailer.index_offset < kPageSize ||
+            trailer.index_offset > trailer_offset ||
+            trailer.count != (trailer_offset - trailer.index_offset) / sizeof(IndexEntry) ||
+            trailer.index_offset + trailer.count * sizeof(IndexEntry) != trailer_offset ||
+            trailer.index_checksum !=
+                checksum(base + trailer.index_offset, trailer.count * sizeof(IndexEntry))) {
+            return false;
+        }
+
+        frames_.reserve(trailer.count);
+        for (uint64_t i = 0; i < trailer.count; ++i) {
+            IndexEntry entry;
+            std::memcpy(&entry, base + trailer.index_offset + i * sizeof(IndexEntry),
+                        sizeof(entry));
+            if (entry.offset % kPageSize != 0 || entry.offset < kPageSize ||
+                !valid_geometry(entry.pixel_format, entry.rows, entry.cols, entry.type,
+                                entry.step) ||
+                entry.offset + kRecordHeaderSize + entry.step * entry.rows >
+                    trailer.index_offset) {
+                return false;
+            }
+            frames_.push_back(to_frame(entry.offset, entry.timestamp_ns, entry.pixel_format,
+                                       entry.sequence, entry.rows, entry.cols, entry.type,
+                                       entry.step));
+        }
+        indexed_ = true;
+        return true;
+    }
+
+    void RawRecording::scan_records() {
+        const auto* base = static_cast<const uint8_t*>(mapping_.get());
+        uint64_t offset = kPageSize;
+        while (offset + kRecordHeaderSize <= mapping_size_) {
+            FrameRecord record;
+            std::memcpy(&record, base + offset, sizeof(record));
+            if (std::memcmp(record.magic, "ARFR", 4) != 0 ||
+                record.checksum != record_checksum(record) ||
+                record.sequence != frames_.size() ||
+                !valid_geometry(record.pixel_format, record.rows, record.cols, record.type,
+                                record.step) ||
+                record.size != record.step * record.rows ||
+                record.size > mapping_size_ - offset - kRecordHeaderSize) {
+                break;
+            }
+            frames_.push_back(to_frame(offset, record.timestamp_ns, record.pixel_format,
+                                       record.sequence, record.rows, record.cols, record.type,
+                                       record.step));
+            offset = page_align(offset + kRecordHeaderSize + record.size);
+        }
+        truncated_ = offset < mapping_size_;
+    }
+
+    cv::Mat RawRecording::image(std::size_t i) const {
+        const RecordedFrame& frame = frames_[i];
+        auto* pixels = static_cast<uint8_t*>(mapping_.get()) + frame.offset + kRecordHeaderSize;
+        return cv::Mat(frame.rows, frame.cols, frame.type, pixels, frame.step);
+    }
+
+    void RawRecording::prefetch(std::size_t first, std::size_t count) const {
+        if (!mapping_ || first >= frames_.size() || count == 0) {
+            return;
+        }
+        const std::size_t last = std::min(frames_.size(), first + count) - 1;
+        const RecordedFrame& end_frame = frames_[last];
+        // madvise() wants the host page size, which may be larger than kPageSize.
+        const uint64_t host_page = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+        const uint64_t begin = frames_[first].offset / host_page * host_page;
+        const uint64_t end = std::min<uint64_t>(
+            mapping_size_, end_frame.offset + kRecordHeaderSize + end_frame.step * end_frame.rows);
+        if (end > begin) {
+            ::madvise(static_cast<uint8_t*>(mapping_.get()) + begin, end - begin,
+                      MADV_WILLNEED);
+        }
+    }
+
+}  // namespace ar_slam
@@ -0,0 +1,98 @@
+#include "camera/raw_replay_camera.h"
+#include "core/log.h"
+#include <chrono>
+#include <memory>
+
+namespace ar_slam {
+
+    RawReplayCamera::RawReplayCamera() : RawReplayCamera(Options{}) {}
+
+    RawReplayCamera::RawReplayCamera(const Options& options) : options_(options) {}
+
+    bool RawReplayCamera::open(const CameraConfig& config) {
+        close();
+        config_ = config;
+        if (!recording_.open(config.device_path)) {
+            AR_LOG("Replay: cannot open recording " << config.device_path);
+            return false;
+        }
+        const std::vector<RecordedFrame>& frames = recording_.frames();
+        if (frames.empty()) {
+            AR_LOG("Replay: no frames in " << config.device_path);
+            recording_.close();
+            return false;
+        }
+        const std::chrono::duration<double> span = frames.back().timestamp -
+                                                   frames.front().timestamp;
+        fps_ = span.count() > 0 ? (frames.size() - 1) / span.count() : 0;
+        position_ = 0;
+        recording_.prefetch(0, options_.readahead + 1);
+        is_running_ = true;
+        AR_LOG("Replay: " << frames.size() << " frames from " << config.device_path);
+        return true;
+    }
+
+    void RawReplayCamera::close() {
+        recording_.close();
+        position_ = 0;
+        fps_ = 0;
+        is_running_ = false;
+    }
+
+    bool RawReplayCamera::seek(std::size_t index) {
+        if (!is_open() || index >= frame_count()) {
+            return false;
+        }
+        position_ = index;
+        recording_.prefetch(index, options_.readahead + 1);
+        return true;
+    }
+
+    bool RawReplayCamera::advance(std::size_t& index) {
+        if (!is_open()) {
+            return false;
+        }
+        if (position_ >= frame_count()) {
+            if (!options_.loop) {
+                return false;
+            }
+            position_ = 0;
+            recording_.prefetch(0, options_.readahead + 1);
+        }
+        index = position_++;
+        // One frame further ahead each time keeps the window full.
+        recording_.prefetch(index + options_.readahead, 1);
+        return true;
+    }
+
+    bool RawReplayCamera::grab_frame(cv::Mat& frame) {
+        Frame::Timestamp timestamp;
+        return grab_frame(frame, timestamp);
+    }
+
+    bool RawReplayCamera::grab_frame(cv::Mat& frame, Frame::Timestamp& timestamp) {
+        std::size_t index = 0;
+        if (!advance(index)) {
+            return false;
+        }
+        frame = recording_.image(index);
+        timestamp = recording_.frames()[index].timestamp;
+        return true;
+    }
+
+    Frame::Ptr RawReplayCamera::next_frame(SharedPool<Frame>* pool) {
+        std::size_t index = 0;
+        if (!advance(index)) {
+            return nullptr;
+        }
+        const RecordedFrame& recorded = recording_.frames()[index];
+        const cv::Mat image = recording_.image(index);
+        if (pool != nullptr) {
+            return Frame::create(*pool, image, recorded.format, recording_.mapping(),
+                                 recorded.timestamp);
+        }
+        return std::make_shared<Frame>(image, recorded.format, recording_.mapping(),
+                                       recorded.timestamp);
+    }
+
+}  // namespace ar_slam
@@ -0,0 +1,112 @@
+#include "camera/recording_camera.h"
+#include "core/log.h"
+#include <chrono>
+#include <utility>
+
+namespace ar_slam {
+
+    namespace {
+
+        Frame::PixelFormat format_of(const cv::Mat& image) {
+            switch (image.type()) {
+                case CV_8UC3:
+                    return Frame::PixelFormat::kBGR;
+                case CV_8UC4:
+                    return Frame::PixelFormat::kBGRA;
+                case CV_8UC2:
+                    return Frame::PixelFormat::kYUYV;
+                default:
+                    return Frame::PixelFormat::kGray;
+            }
+        }
+
+    }  // namespace
+
+    RecordingCamera::RecordingCamera(CameraInterface::Ptr source, std::string path,
+                                     std::size_t queue_frames)
+        : source_(std::move(source)), path_(std::move(path)), queue_(queue_frames) {}
+
+    RecordingCamera::~RecordingCamera() { close(); }
+
+    bool RecordingCamera::open(const CameraConfig& config) {
+        close();
+        config_ = config;
+        if (!source_->open(config)) {
+            return false;
+        }
+        if (!recorder_.open(path_)) {
+            source_->close();
+            return false;
+        }
+        recorded_ = 0;
+        dropped_ = 0;
+        stop_ = false;
+        writer_ = std::thread(&RecordingCamera::run, this);
+        is_running_ = true;
+        return true;
+    }
+
+    void RecordingCamera::close() {
+        if (!writer_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stop_.store(true, std::memory_order_release);
+        }
+        wake_.notify_all();
+        writer_.join();  // After writing out what is still queued.
+        recorder_.close();
+        source_->close();
+        is_running_ = false;
+        AR_LOG("Recorded " << recorded_ << " frames to " << path_ << " (" << dropped_
+                           << " dropped)");
+    }
+
+    bool RecordingCamera::grab_frame(cv::Mat& frame) {
+        Frame::Timestamp captured;
+        return grab_frame(frame, captured);
+    }
+
+    bool RecordingCamera::grab_frame(cv::Mat& frame, Frame::Timestamp& captured) {
+        if (!is_open() || !source_->grab_frame(frame)) {
+            return false;
+        }
+        captured = std::chrono::steady_clock::now();
+
+        // Refill the recycled staging image in place (no allocation once warm).
+        frame.copyTo(staging_.image);
+        staging_.format = format_of(frame);
+        staging_.captured = captured;
+        if (!queue_.try_push(staging_)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        // notify_one never waits on the writer; a missed wake-up is covered by
+        // the writer's short timed wait.
+        wake_.notify_one();
+        return true;
+    }
+
+    void RecordingCamera::run() {
+        Packet packet;
+        while (true) {
+            if (queue_.try_pop(packet)) {
+                if (recorder_.write(packet.image, packet.format, packet.captured)) {
+                    recorded_.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                }
+                continue;
+            }
+            if (stop_.load(std::memory_order_acquire)) {
+                return;  // Queue drained.
+            }
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_.wait_for(lock, std::chrono::milliseconds(2), [this] {
+                return stop_.load(std::memory_order_acquire) || !queue_.empty();
+            });
+        }
+    }
+
+}  // namespace ar_slam
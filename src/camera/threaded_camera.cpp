@@ -0,0 +1,119 @@
+#include "camera/threaded_camera.h"
+#include "core/log.h"
+#include <utility>
+
+namespace ar_slam {
+
+    ThreadedCamera::ThreadedCamera(CameraInterface::Ptr source)
+        : ThreadedCamera(std::move(source), Options{}) {}
+
+    ThreadedCamera::ThreadedCamera(CameraInterface::Ptr source, const Options& options)
+        : source_(std::move(source)), options_(options) {}
+
+    ThreadedCamera::~ThreadedCamera() { close(); }
+
+    bool ThreadedCamera::open(const CameraConfig& config) {
+        close();
+        config_ = config;
+        if (!source_->open(config)) {
+            return false;
+        }
+
+        buffer_.update();  // Discard a frame left from the last session.
+        captured_ = 0;
+        dropped_ = 0;
+        fps_ = 0;
+        delivered_ = 0;
+        latency_ms_ = 0;
+        latency_total_ms_ = 0;
+
+        is_running_ = true;
+        thread_ = std::thread(&ThreadedCamera::run, this);
+        return true;
+    }
+
+    void ThreadedCamera::close() {
+        if (!thread_.joinable()) {
+            return;
+        }
+        is_running_ = false;
+        thread_.join();
+        source_->close();
+    }
+
+    bool ThreadedCamera::grab_frame(cv::Mat& frame) {
+        Frame::Timestamp captured;
+        return grab_frame(frame, captured);
+    }
+
+    bool ThreadedCamera::grab_frame(cv::Mat& frame, Frame::Timestamp& captured) {
+        if (!thread_.joinable()) {
+            return false;
+        }
+        if (!buffer_.update()) {
+            const auto deadline =
+                std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.timeout_ms);
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            frame_ready_.wait_until(lock, deadline,
+                                    [this] { return buffer_.has_update() || !is_running_; });
+            lock.unlock();
+            // The source may have ended just after publishing its last frame.
+            if (!buffer_.update()) {
+                return false;
+            }
+        }
+
+        Slot& slot = buffer_.front();
+        std::swap(frame, slot.image);  // The caller's old image goes back to the ring.
+        captured = slot.captured;
+
+        const double latency = std::chrono::duration<double, std::milli>(
+                                   std::chrono::steady_clock::now() - captured)
+                                   .count();
+        ++delivered_;
+        latency_ms_ = latency;
+        latency_total_ms_ += latency;
+        return true;
+    }
+
+    void ThreadedCamera::run() {
+        Frame::Timestamp last_time{};
+        int failures = 0;
+        while (is_running_.load(std::memory_order_acquire)) {
+            Slot& slot = buffer_.back();
+            if (!source_->grab_frame(slot.image) || slot.image.empty()) {
+                if (++failures >= options_.failure_limit) {
+                    AR_LOG("ThreadedCamera: source ended after " << failures << " failed grabs");
+                    break;
+                }
+                continue;
+            }
+            failures = 0;
+            slot.captured = std::chrono::steady_clock::now();
+
+            if (last_time != Frame::Timestamp{} && slot.captured > last_time) {
+                const double fps =
+                    1.0 / std::chrono::duration<double>(slot.captured - last_time).count();
+                const double average = fps_.load(std::memory_order_relaxed);
+                fps_.store(average == 0 ? fps : 0.9 * average + 0.1 * fps,
+                           std::memory_order_relaxed);
+            }
+            last_time = slot.captured;
+
+            captured_.fetch_add(1, std::memory_order_relaxed);
+            if (!buffer_.publish()) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+            notify();
+        }
+        is_running_.store(false, std::memory_order_release);
+        notify();
+    }
+
+    void ThreadedCamera::notify() {
+        // Taking the lock orders this with a consumer between its check and its wait.
+        { std::lock_guard<std::mutex> lock(wait_mutex_); }
+        frame_ready_.notify_one();
+    }
+
+}  // namespace ar_slam
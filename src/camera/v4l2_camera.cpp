@@ -0,0 +1,490 @@
+#include "camera/v4l2_camera.h"
+#include "core/log.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+
+namespace ar_slam {
+
+    // --- V4L2Io: straight to the kernel ---------------------------------------
+
+    int V4L2Io::open(const char* path, int flags) { return ::open(path, flags); }
+
+    int V4L2Io::close(int fd) { return ::close(fd); }
+
+    int V4L2Io::ioctl(int fd, unsigned long request, void* arg) {
+        return ::ioctl(fd, request, arg);
+    }
+
+    void* V4L2Io::mmap(std::size_t length, int fd, off_t offset) {
+        return ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    }
+
+    int V4L2Io::munmap(void* start, std::size_t length) { return ::munmap(start, length); }
+
+    int V4L2Io::poll(int fd, int timeout_ms) {
+        pollfd p{fd, POLLIN, 0};
+        return ::poll(&p, 1, timeout_ms);
+    }
+
+    namespace {
+
+        std::string fourcc_name(uint32_t fourcc) {
+            std::string name(4, ' ');
+            for (int i = 0; i < 4; ++i) {
+                name[i] = static_cast<char>((fourcc >> (8 * i)) & 0xff);
+            }
+            return name;
+        }
+
+        /// Bytes per pixel in the first plane of a format V4L2Camera understands (0: unsupported).
+        unsigned bytes_per_pixel(uint32_t fourcc) {
+            switch (fourcc) {
+                case V4L2_PIX_FMT_GREY:
+                case V4L2_PIX_FMT_NV12:
+                    return 1;
+                case V4L2_PIX_FMT_YUYV:
+                case V4L2_PIX_FMT_UYVY:
+                    return 2;
+                default:
+                    return 0;
+            }
+        }
+
+        /// Rows of the capture image: NV12's chroma plane follows the luma rows.
+        uint32_t image_rows(uint32_t fourcc, uint32_t height) {
+            return fourcc == V4L2_PIX_FMT_NV12 ? height * 3 / 2 : height;
+        }
+
+        Frame::PixelFormat frame_format(uint32_t fourcc) {
+            switch (fourcc) {
+                case V4L2_PIX_FMT_YUYV:
+                    return Frame::PixelFormat::kYUYV;
+                case V4L2_PIX_FMT_UYVY:
+                    return Frame::PixelFormat::kUYVY;
+                case V4L2_PIX_FMT_NV12:
+                    return Frame::PixelFormat::kNV12;
+                default:
+                    return Frame::PixelFormat::kGray;
+            }
+        }
+
+        int to_bgr(uint32_t fourcc) {
+            switch (fourcc) {
+                case V4L2_PIX_FMT_UYVY:
+                    return cv::COLOR_YUV2BGR_UYVY;
+                case V4L2_PIX_FMT_NV12:
+                    return cv::COLOR_YUV2BGR_NV12;
+                default:
+                    return cv::COLOR_YUV2BGR_YUYV;
+            }
+        }
+
+        /// Driver timestamp as a steady_clock time, when the driver stamps with CLOCK_MONOTONIC.
+        Frame::Timestamp capture_time(const v4l2_buffer& buf) {
+            if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+                // steady_clock is CLOCK_MONOTONIC on Linux.
+                const auto since_boot = std::chrono::seconds(buf.timestamp.tv_sec) +
+                                        std::chrono::microseconds(buf.timestamp.tv_usec);
+                return Frame::Timestamp(
+                    std::chrono::duration_cast<Frame::Timestamp::duration>(since_boot));
+            }
+            return std::chrono::steady_clock::now();
+        }
+
+        std::size_t page_size() { return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)); }
+
+    }  // namespace
+
+    /**
+     * The device and its buffers, shared by the camera and every buffer it has
+     * handed out, so a buffer outlives close() for as long as a frame holds it.
+     * The mutex orders requeues from releasing threads against STREAMOFF.
+     */
+    struct V4L2Camera::Stream {
+        struct Buffer {
+            void* start;
+            std::size_t length;
+        };
+
+        /// One dequeued buffer; destroying it queues the buffer back to the driver.
+        struct Lease {
+            Lease(std::shared_ptr<Stream> owner, uint32_t buffer_index)
+                : stream(std::move(owner)), index(buffer_index) {}
+            ~Lease();
+
+            std::shared_ptr<Stream> stream;
+            uint32_t index;
+        };
+
+        std::shared_ptr<V4L2Io> io;
+        int fd = -1;
+        IoMethod method = IoMethod::kMmap;
+        std::vector<Buffer> buffers;
+        std::unique_ptr<SharedPool<Lease>> leases;
+
+        std::mutex mutex;
+        bool streaming = false;  // Guarded by mutex
+        std::size_t queued = 0;  // Buffers owned by the driver; guarded by mutex
+
+        ~Stream();
+
+        uint32_t memory() const {
+            return method == IoMethod::kMmap ? V4L2_MEMORY_MMAP : V4L2_MEMORY_USERPTR;
+        }
+
+        bool xioctl(unsigned long request, void* arg) {
+            int result;
+            do {
+                result = io->ioctl(fd, request, arg);
+            } while (result == -1 && errno == EINTR);
+            return result != -1;
+        }
+
+        /// Hand buffer @p index to the driver; the caller holds the mutex.
+        bool queue(uint32_t index) {
+            v4l2_buffer buf{};
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = memory();
+            buf.index = index;
+            if (method == IoMethod::kUserPtr) {
+                buf.m.userptr = reinterpret_cast<unsigned long>(buffers[index].start);
+                buf.length = static_cast<uint32_t>(buffers[index].length);
+            }
+            if (!xioctl(VIDIOC_QBUF, &buf)) {
+                return false;
+            }
+            ++queued;
+            return true;
+        }
+
+        /// Give back a buffer that was dequeued; dropped once streaming has stopped.
+        void requeue(uint32_t index) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (streaming && !queue(index)) {
+                AR_LOG("V4L2: requeueing buffer " << index << " failed: " << std::strerror(errno));
+            }
+        }
+
+        bool stop() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!streaming) {
+                return true;
+            }
+            streaming = false;
+            queued = 0;  // STREAMOFF returns every buffer to the application.
+            int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            return xioctl(VIDIOC_STREAMOFF, &type);
+        }
+    };
+
+    V4L2Camera::Stream::Lease::~Lease() { stream->requeue(index); }
+
+    V4L2Camera::Stream::~Stream() {
+        if (fd < 0) {
+            return;
+        }
+        stop();
+        for (const Buffer& b : buffers) {
+            if (method == IoMethod::kMmap) {
+                io->munmap(b.start, b.length);
+            } else {
+                ::operator delete(b.start, std::align_val_t{page_size()});
+            }
+        }
+        v4l2_requestbuffers release{};
+        release.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        release.memory = memory();
+        release.count = 0;
+        xioctl(VIDIOC_REQBUFS, &release);  // Best effort: closing frees them too.
+        io->close(fd);
+    }
+
+    V4L2Camera::V4L2Camera() : V4L2Camera(Options{}) {}
+
+    V4L2Camera::V4L2Camera(const Options& options, std::shared_ptr<V4L2Io> io)
+        : options_(options), io_(io ? std::move(io) : std::make_shared<V4L2Io>()) {}
+
+    V4L2Camera::~V4L2Camera() { close(); }
+
+    bool V4L2Camera::open(const CameraConfig& config) {
+        close();
+        config_ = config;
+
+        auto stream = std::make_shared<Stream>();
+        stream->io = io_;
+        stream->method = options_.io;
+        stream->fd = io_->open(config.device_path.c_str(), O_RDWR | O_NONBLOCK);
+        if (stream->fd < 0) {
+            AR_LOG("V4L2: cannot open " << config.device_path << ": " << std::strerror(errno));
+            return false;
+        }
+        stream_ = std::move(stream);
+
+        const bool ready = init_device() &&
+                           (options_.io == IoMethod::kMmap ? init_mmap() : init_userptr()) &&
+                           start_capture();
+        if (!ready) {
+            close();
+            return false;
+        }
+        is_running_ = true;
+        return true;
+    }
+
+    void V4L2Camera::close() {
+        if (!stream_) {
+            return;
+        }
+        stream_->stop();
+        stream_.reset();  // Buffers still held keep the device open until released.
+        is_running_ = false;
+        last_frame_time_ = Frame::Timestamp{};
+        measured_fps_ = 0;
+    }
+
+    bool V4L2Camera::init_device() {
+        v4l2_capability cap{};
+        if (!stream_->xioctl(VIDIOC_QUERYCAP, &cap)) {
+            AR_LOG("V4L2: " << config_.device_path << " is not a V4L2 device");
+            return false;
+        }
+        const uint32_t caps =
+            (cap.capabilities & V4L2_CAP_DEVICE_CAPS) != 0 ? cap.device_caps : cap.capabilities;
+        if ((caps & V4L2_CAP_VIDEO_CAPTURE) == 0 || (caps & V4L2_CAP_STREAMING) == 0) {
+            AR_LOG("V4L2: " << config_.device_path << " cannot stream video capture");
+            return false;
+        }
+
+        format_ = v4l2_format{};
+        format_.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        format_.fmt.pix.width = static_cast<uint32_t>(config_.width);
+        format_.fmt.pix.height = static_cast<uint32_t>(config_.height);
+        format_.fmt.pix.pixelformat = options_.pixel_format;
+        format_.fmt.pix.field = V4L2_FIELD_NONE;
+        if (!stream_->xioctl(VIDIOC_S_FMT, &format_)) {
+            AR_LOG("V4L2: setting the format failed: " << std::strerror(errno));
+            return false;
+        }
+        v4l2_pix_format& pix = format_.fmt.pix;
+        const unsigned bpp = bytes_per_pixel(pix.pixelformat);
+        if (bpp == 0) {
+            AR_LOG("V4L2: driver chose unsupported format " << fourcc_name(pix.pixelformat));
+            return false;
+        }
+        // Some drivers leave these zero.
+        if (pix.bytesperline < pix.width * bpp) {
+            pix.bytesperline = pix.width * bpp;
+        }
+        const uint32_t rows = image_rows(pix.pixelformat, pix.height);
+        if (pix.sizeimage < pix.bytesperline * rows) {
+            pix.sizeimage = pix.bytesperline * rows;
+        }
+
+        // Frame rate is best effort: not every driver lets it be set.
+        v4l2_streamparm parm{};
+        parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        parm.parm.capture.timeperframe.numerator = 1;
+        parm.parm.capture.timeperframe.denominator = static_cast<uint32_t>(config_.fps);
+        stream_->xioctl(VIDIOC_S_PARM, &parm);
+
+        AR_LOG("V4L2: " << pix.width << "x" << pix.height << " " << fourcc_name(pix.pixelformat)
+                        << ", stride " << pix.bytesperline);
+        return true;
+    }
+
+    bool V4L2Camera::init_mmap() {
+        v4l2_requestbuffers req{};
+        req.count = options_.buffer_count;
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_MMAP;
+        if (!stream_->xioctl(VIDIOC_REQBUFS, &req)) {
+            AR_LOG("V4L2: " << config_.device_path << " does not support memory mapping");
+            return false;
+        }
+        if (req.count < 2) {
+            AR_LOG("V4L2: insufficient buffer memory on " << config_.device_path);
+            return false;
+        }
+
+        for (uint32_t i = 0; i < req.count; ++i) {
+            v4l2_buffer buf{};
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = i;
+            if (!stream_->xioctl(VIDIOC_QUERYBUF, &buf)) {
+                return false;
+            }
+            void* start = io_->mmap(buf.length, stream_->fd, static_cast<off_t>(buf.m.offset));
+            if (start == MAP_FAILED) {
+                AR_LOG("V4L2: mapping buffer " << i << " failed: " << std::strerror(errno));
+                return false;
+            }
+            stream_->buffers.push_back({start, buf.length});
+        }
+        return true;
+    }
+
+    bool V4L2Camera::init_userptr() {
+        v4l2_requestbuffers req{};
+        req.count = options_.buffer_count;
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_USERPTR;
+        if (!stream_->xioctl(VIDIOC_REQBUFS, &req)) {
+            AR_LOG("V4L2: " << config_.device_path << " does not support user pointer i/o");
+            return false;
+        }
+        if (req.count < 2) {
+            AR_LOG("V4L2: insufficient buffer memory on " << config_.device_path);
+            return false;
+        }
+
+        // Whole pages, page-aligned: what DMA into user memory needs.
+        const std::size_t page = page_size();
+        const std::size_t length = (format_.fmt.pix.sizeimage + page - 1) / page * page;
+        for (uint32_t i = 0; i < req.count; ++i) {
+            void* start = ::operator new(length, std::align_val_t{page}, std::nothrow);
+            if (start == nullptr) {
+                return false;
+            }
+            stream_->buffers.push_back({start, length});
+        }
+        return true;
+    }
+
+    bool V4L2Camera::start_capture() {
+        // A buffer can be in at most one lease at a time; the slack covers leases
+        // whose buffer is already requeued but whose slot is not yet returned.
+        stream_->leases =
+            std::make_unique<SharedPool<Stream::Lease>>(2 * stream_->buffers.size());
+
+        std::lock_guard<std::mutex> lock(stream_->mutex);
+        for (uint32_t i = 0; i < stream_->buffers.size(); ++i) {
+            if (!stream_->queue(i)) {
+                AR_LOG("V4L2: queueing buffer " << i << " failed: " << std::strerror(errno));
+                return false;
+            }
+        }
+        int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (!stream_->xioctl(VIDIOC_STREAMON, &type)) {
+            AR_LOG("V4L2: starting the stream failed: " << std::strerror(errno));
+            return false;
+        }
+        stream_->streaming = true;
+        return true;
+    }
+
+    bool V4L2Camera::capture(Capture& out) {
+        if (!stream_) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(stream_->mutex);
+            if (stream_->queued == 0) {
+                return false;  // Every buffer is held downstream; none can be filled.
+            }
+        }
+
+        v4l2_buffer buf{};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = stream_->memory();
+        const auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.timeout_ms);
+        while (!stream_->xioctl(VIDIOC_DQBUF, &buf)) {
+            if (errno != EAGAIN) {
+                AR_LOG("V4L2: dequeueing failed: " << std::strerror(errno));
+                return false;
+            }
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0 ||
+                io_->poll(stream_->fd, static_cast<int>(remaining.count())) <= 0) {
+                return false;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(stream_->mutex);
+            --stream_->queued;
+        }
+
+        const uint32_t index = buf.index;
+        if (index >= stream_->buffers.size()) {
+            return false;
+        }
+        const v4l2_pix_format& pix = format_.fmt.pix;
+        if ((buf.flags & V4L2_BUF_FLAG_ERROR) != 0 ||
+            buf.bytesused < pix.bytesperline * image_rows(pix.pixelformat, pix.height)) {
+            stream_->requeue(index);  // Corrupt or short frame: drop it.
+            return false;
+        }
+
+        std::shared_ptr<Stream::Lease> lease = stream_->leases->make(stream_, index);
+        if (!lease) {
+            lease = std::make_shared<Stream::Lease>(stream_, index);
+        }
+        void* start = stream_->buffers[index].start;
+        const int type = bytes_per_pixel(pix.pixelformat) == 1 ? CV_8UC1 : CV_8UC2;
+        out.image = cv::Mat(static_cast<int>(image_rows(pix.pixelformat, pix.height)), width(),
+                            type, start, pix.bytesperline);
+        out.buffer = std::shared_ptr<const void>(std::move(lease), start);
+        out.timestamp = capture_time(buf);
+        out.sequence = buf.sequence;
+        update_fps(out.timestamp);
+        return true;
+    }
+
+    Frame::Ptr V4L2Camera::capture_frame(SharedPool<Frame>* pool) {
+        Capture c;
+        if (!capture(c)) {
+            return nullptr;
+        }
+        // Frame takes the luma from the buffer itself; no conversion here.
+        const Frame::PixelFormat format = frame_format(pixel_format());
+        if (pool != nullptr) {
+            return Frame::create(*pool, c.image, format, std::move(c.buffer), c.timestamp);
+        }
+        return std::make_shared<Frame>(c.image, format, std::move(c.buffer), c.timestamp);
+    }
+
+    bool V4L2Camera::grab_frame(cv::Mat& frame) {
+        Capture c;
+        if (!capture(c)) {
+            return false;
+        }
+        if (pixel_format() == V4L2_PIX_FMT_GREY) {
+            c.image.copyTo(frame);
+        } else {
+            cv::cvtColor(c.image, frame, to_bgr(pixel_format()));
+        }
+        return true;
+    }
+
+    std::size_t V4L2Camera::buffer_count() const {
+        return stream_ ? stream_->buffers.size() : 0;
+    }
+
+    std::size_t V4L2Camera::buffers_held() const {
+        if (!stream_) {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lock(stream_->mutex);
+        return stream_->buffers.size() - stream_->queued;
+    }
+
+    void V4L2Camera::update_fps(const Frame::Timestamp& timestamp) {
+        if (last_frame_time_ != Frame::Timestamp{} && timestamp > last_frame_time_) {
+            const double fps =
+                1.0 / std::chrono::duration<double>(timestamp - last_frame_time_).count();
+            measured_fps_ = measured_fps_ == 0 ? fps : 0.9 * measured_fps_ + 0.1 * fps;
+        }
+        last_frame_time_ = timestamp;
+    }
+
+}  // namespace ar_slam
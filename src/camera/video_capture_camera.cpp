@@ -0,0 +1,36 @@
+#include "camera/video_capture_camera.h"
+#include "core/log.h"
+
+namespace ar_slam {
+
+    bool VideoCaptureCamera::open(const CameraConfig& config) {
+        close();
+        config_ = config;
+
+        const bool device = config.device_path.compare(0, 5, "/dev/") == 0;
+        if (device ? !capture_.open(config.device_id) : !capture_.open(config.device_path)) {
+            AR_LOG("VideoCapture: cannot open "
+                   << (device ? "camera " + std::to_string(config.device_id) : config.device_path));
+            return false;
+        }
+        if (device) {
+            capture_.set(cv::CAP_PROP_FRAME_WIDTH, config.width);
+            capture_.set(cv::CAP_PROP_FRAME_HEIGHT, config.height);
+            capture_.set(cv::CAP_PROP_FPS, config.fps);
+        }
+        fps_ = capture_.get(cv::CAP_PROP_FPS);
+        is_running_ = true;
+        return true;
+    }
+
+    void VideoCaptureCamera::close() {
+        capture_.release();
+        is_running_ = false;
+        fps_ = 0;
+    }
+
+    bool VideoCaptureCamera::grab_frame(cv::Mat& frame) {
+        return capture_.read(frame) && !frame.empty();
+    }
+
+}  // namespace ar_slam
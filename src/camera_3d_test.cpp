@@ -4,13 +4,26 @@
 #include <chrono>
 #include <cmath>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
+#include "camera/recording_camera.h"
+#include "camera/threaded_camera.h"
+#include "camera/video_capture_camera.h"
+#ifdef __linux__
+#include "camera/v4l2_camera.h"
+#endif
 #include "core/frame.h"
+#include "core/frame_arena.h"
+#include "core/pool_allocator.h"
+#include "core/pool_stats.h"
 #include "core/feature_tracker.h"
-#include "core/incremental_mapper.h"
+#include "core/async_mapper.h"
 #include "rendering/gl_viewer.h"
 
 namespace {
@@ -23,46 +36,52 @@ namespace {
         return cv::Matx33d(f, 0, size.width / 2.0, 0, f, size.height / 2.0, 0, 0, 1);
     }
 
-    // Centre and scale a reconstructed cloud for the orbit viewer (Y flipped to
-    // OpenGL's up axis). Relative geometry is preserved; only the global pose and
-    // scale are normalised for display.
-    std::vector<cv::Point3f> to_display_cloud(const std::vector<cv::Point3f>& pts) {
-        std::vector<cv::Point3f> out;
+    // Centre and scale of a reconstructed cloud for the orbit viewer (Y flipped
+    // to OpenGL's up axis). Relative geometry is preserved; only the global pose
+    // and scale are normalised for display. Kept between map updates, so only
+    // the points that changed are re-projected; refitted once the cloud doubles.
+    struct DisplayFit {
+        double cx = 0, cy = 0, cz = 0;
+        float scale = 1.0f;
+        std::size_t fitted = 0;  // Cloud size when fitted.
+    };
+
+    DisplayFit fit_display(const std::vector<cv::Point3f>& pts) {
+        DisplayFit fit;
+        fit.fitted = pts.size();
         if (pts.empty())
-            return out;
+            return fit;
 
-        double cx = 0, cy = 0, cz = 0;
         for (const auto& p : pts) {
-            cx += p.x;
-            cy += p.y;
-            cz += p.z;
+            fit.cx += p.x;
+            fit.cy += p.y;
+            fit.cz += p.z;
         }
-        cx /= pts.size();
-        cy /= pts.size();
-        cz /= pts.size();
+        fit.cx /= pts.size();
+        fit.cy /= pts.size();
+        fit.cz /= pts.size();
 
         std::vector<float> radii;
         radii.reserve(pts.size());
         for (const auto& p : pts) {
-            double dx = p.x - cx, dy = p.y - cy, dz = p.z - cz;
+            double dx = p.x - fit.cx, dy = p.y - fit.cy, dz = p.z - fit.cz;
             radii.push_back(static_cast<float>(std::sqrt(dx * dx + dy * dy + dz * dz)));
         }
         std::nth_element(radii.begin(), radii.begin() + radii.size() / 2, radii.end());
         float median_radius = radii[radii.size() / 2];
-        float scale = (median_radius > 1e-3f) ? 2.5f / median_radius : 1.0f;
+        fit.scale = (median_radius > 1e-3f) ? 2.5f / median_radius : 1.0f;
+        return fit;
+    }
 
-        out.reserve(pts.size());
-        for (const auto& p : pts) {
-            out.push_back(cv::Point3f(static_cast<float>(p.x - cx) * scale,
-                                      static_cast<float>(-(p.y - cy)) * scale,
-                                      static_cast<float>(p.z - cz) * scale));
-        }
-        return out;
+    cv::Point3f to_display(const cv::Point3f& p, const DisplayFit& fit) {
+        return cv::Point3f(static_cast<float>(p.x - fit.cx) * fit.scale,
+                           static_cast<float>(-(p.y - fit.cy)) * fit.scale,
+                           static_cast<float>(p.z - fit.cz) * fit.scale);
     }
 
     // Until enough parallax accrues, show the live features on a frontal plane.
     // This is an honest 2D projection (constant depth) rather than invented depth.
-    std::vector<cv::Point3f> features_on_plane(const std::vector<cv::Point2f>& pts,
+    std::vector<cv::Point3f> features_on_plane(const std::pmr::vector<cv::Point2f>& pts,
                                                const cv::Matx33d& K,
                                                float depth) {
         std::vector<cv::Point3f> out;
@@ -78,14 +97,34 @@ namespace {
 
 }  // namespace
 
-int main() {
+int main(int argc, char** argv) {
     std::cout << "=== 3D Camera Test ===" << std::endl;
 
-    // Initialize camera
-    cv::VideoCapture cap(0);
-    if (!cap.isOpened()) {
-        std::cerr << "Cannot open camera" << std::endl;
-        return -1;
+    // Usage: camera_3d_test [vocabulary.arbv] [--map session.armp] [--record session.arrec]
+    // A vocabulary (see train_vocabulary) enables loop closure; a map file is
+    // resumed if it exists and the session is streamed into it. A recording
+    // keeps every captured frame for replay (RawReplayCamera, benchmark_slam).
+    ar_slam::AsyncMapper::Config mapper_config;
+    std::string record_path;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--map" && i + 1 < argc) {
+            mapper_config.map_path = argv[++i];
+            std::cout << "Map file: " << mapper_config.map_path << std::endl;
+            continue;
+        }
+        if (arg == "--record" && i + 1 < argc) {
+            record_path = argv[++i];
+            std::cout << "Recording to: " << record_path << std::endl;
+            continue;
+        }
+        auto vocabulary = std::make_shared<ar_slam::Vocabulary>();
+        if (vocabulary->load(arg)) {
+            std::cout << "Loop closure: " << vocabulary->word_count() << " words" << std::endl;
+            mapper_config.mapper.vocabulary = vocabulary;
+        } else {
+            std::cerr << "Cannot load vocabulary " << arg << ", loop closure off" << std::endl;
+        }
     }
 
     // Initialize 3D viewer
@@ -96,12 +135,77 @@ int main() {
     }
 
     ar_slam::FeatureTracker tracker;
-    std::unique_ptr<ar_slam::IncrementalMapper> mapper;  // created once frame size is known
-    cv::Mat frame;
-
-    // Trail history for 2D visualization
+    std::unique_ptr<ar_slam::AsyncMapper> mapper;       // created once frame size is known
+    std::unique_ptr<ar_slam::Relocalizer> relocalizer;  // likewise; searched by the tracker
+    std::vector<cv::Point3f> map_cloud;                 // mirror of the map, by delta
+    uint64_t map_version = 0;                           // version map_cloud reflects
+    std::vector<std::size_t> map_changed;               // indices the last delta wrote
+    DisplayFit display_fit;
+    std::vector<cv::Point3f> map_display;               // normalised copy of the map
+    int relocalizations = 0;
+
+    // Trail history for 2D visualization. Trails are created and erased as
+    // tracks come and go, so their nodes come from fixed-size pools.
     const int TRAIL_LENGTH = 10;
-    std::map<int, std::deque<cv::Point2f>> feature_trails;
+    ar_slam::PoolResource node_pool;
+    std::pmr::map<int, std::pmr::deque<cv::Point2f>> feature_trails(&node_pool);
+
+    ar_slam::FrameArena frame_arena;
+
+    // Frame objects (not their pixels) come from a small pool: the tracker
+    // keeps only the previous frame, so four slots are never all taken.
+    ar_slam::SharedPool<ar_slam::Frame> frame_pool(4);
+
+    // Initialize camera. next_frame() yields the next Frame, or nullptr once
+    // the camera stops.
+    std::function<ar_slam::Frame::Ptr()> next_frame;
+#ifdef __linux__
+    // Stream straight from the driver where the device allows it: each Frame
+    // borrows a V4L2 buffer, so no pixel is copied between capture and the
+    // tracker. The first capture tells whether the device actually streams.
+    ar_slam::V4L2Camera v4l2;
+    if (record_path.empty() && v4l2.open(ar_slam::CameraConfig{})) {
+        ar_slam::Frame::Ptr first = v4l2.capture_frame(&frame_pool);
+        if (first) {
+            std::cout << "Capture: V4L2 " << v4l2.width() << "x" << v4l2.height()
+                      << ", zero-copy" << std::endl;
+            next_frame = [&v4l2, &frame_pool, first]() mutable -> ar_slam::Frame::Ptr {
+                if (first) {
+                    return std::exchange(first, nullptr);
+                }
+                return v4l2.capture_frame(&frame_pool);
+            };
+        } else {
+            v4l2.close();
+        }
+    }
+#endif
+    // Otherwise OpenCV capture on its own thread, so a slow iteration skips to
+    // the newest frame instead of working through stale ones.
+    ar_slam::CameraInterface::Ptr source = std::make_shared<ar_slam::VideoCaptureCamera>();
+    if (!record_path.empty()) {
+        // Recorded on the capture thread: every frame captured, not just those processed.
+        source = std::make_shared<ar_slam::RecordingCamera>(source, record_path);
+    }
+    ar_slam::ThreadedCamera camera(source);
+    if (!next_frame) {
+        if (!camera.open(ar_slam::CameraConfig{})) {
+            std::cerr << "Cannot open camera" << std::endl;
+            return -1;
+        }
+        next_frame = [&camera, &frame_pool]() -> ar_slam::Frame::Ptr {
+            cv::Mat image;
+            ar_slam::Frame::Timestamp captured;
+            if (!camera.grab_frame(image, captured)) {
+                return nullptr;
+            }
+            auto frame = ar_slam::Frame::create(frame_pool, image, captured);
+            if (!frame) {
+                frame = std::make_shared<ar_slam::Frame>(image, captured);  // Pool exhausted.
+            }
+            return frame;
+        };
+    }
 
     // FPS tracking
     int frame_count = 0;
@@ -111,32 +215,67 @@ int main() {
     std::cout << "Controls:" << std::endl;
     std::cout << "  Arrow Keys: Rotate/Zoom camera" << std::endl;
     std::cout << "  Q: Quit" << std::endl;
-    std::cout << "  Space: Print stats" << std::endl;
+    std::cout << "  Space: Print stats (and pool usage, if instrumented)" << std::endl;
 
     while (!viewer.should_close()) {
-        cap >> frame;
-        if (frame.empty())
+        auto slam_frame = next_frame();
+        if (!slam_frame)
             break;
+        const cv::Size frame_size = slam_frame->get_image().size();
+
+        // Everything the tracker allocates for this frame comes from the arena.
+        frame_arena.reset();
+        auto result = tracker.track_features(slam_frame, &frame_arena);
 
-        auto slam_frame = std::make_shared<ar_slam::Frame>(frame);
-        auto result = tracker.track_features(slam_frame);
+        if (result.relocalized) {
+            relocalizations++;
+        }
 
         // Lazily build the intrinsics + mapper once we know the frame size.
         if (!mapper) {
-            mapper = std::make_unique<ar_slam::IncrementalMapper>(default_intrinsics(frame.size()));
+            mapper = std::make_unique<ar_slam::AsyncMapper>(default_intrinsics(frame_size),
+                                                            mapper_config);
+            relocalizer = std::make_unique<ar_slam::Relocalizer>(
+                default_intrinsics(frame_size), mapper_config.mapper.relocalization_config);
+            tracker.set_relocalizer(relocalizer.get());
+            if (mapper->snapshot()->places) {
+                // Resumed a saved map: re-detect so the next frame relocalizes in it.
+                relocalizer->set_map(mapper->snapshot()->places);
+                tracker.reset();
+            }
         }
 
-        // Feed the tracks to the mapper. Once it has triangulated real structure
-        // from a wide-enough baseline, show that; until then show the live
-        // features on a frontal plane (an honest 2D projection, not fake depth).
-        mapper->update(result.track_ids, result.curr_points);
+        // Hand the tracks to the mapping thread (never blocks) and show its latest
+        // published state. Once it has triangulated real structure from a
+        // wide-enough baseline, show that; until then show the live features on a
+        // frontal plane (an honest 2D projection, not fake depth). The display
+        // cloud follows the map by delta: only the points that changed are
+        // re-projected, unless the snapshot made us reload or the cloud doubled.
+        mapper->submit(result.track_ids, result.curr_points, slam_frame->get_timestamp(),
+                       slam_frame->get_image());
+        auto snapshot = mapper->snapshot();
+        const bool reloaded = snapshot->update_cloud(map_cloud, map_version, &map_changed);
+        if (reloaded || map_cloud.size() > 2 * display_fit.fitted) {
+            display_fit = fit_display(map_cloud);
+            map_display.clear();
+            for (const cv::Point3f& p : map_cloud) {
+                map_display.push_back(to_display(p, display_fit));
+            }
+        } else if (!map_changed.empty() || map_display.size() != map_cloud.size()) {
+            map_display.resize(map_cloud.size());
+            for (std::size_t i : map_changed) {
+                map_display[i] = to_display(map_cloud[i], display_fit);
+            }
+        }
+        // The next re-detection relocalizes against the newest published keyframes.
+        relocalizer->set_map(snapshot->places);
 
         std::vector<cv::Point3f> points_3d;
-        if (mapper->has_cloud()) {
-            points_3d = to_display_cloud(mapper->cloud());
+        if (snapshot->has_cloud) {
+            points_3d = map_display;
         } else {
             points_3d =
-                features_on_plane(result.curr_points, default_intrinsics(frame.size()), 1.0f);
+                features_on_plane(result.curr_points, default_intrinsics(frame_size), 1.0f);
         }
 
         // Update 3D viewer
@@ -163,10 +302,11 @@ int main() {
             break;
 
         // Show 2D view with overlays
-        cv::Mat display = frame.clone();
+        cv::Mat display = slam_frame->get_color_image().clone();
 
         // Update trails
-        std::set<int> current_ids;
+        std::set<int, std::less<int>, ar_slam::PoolAllocator<int>> current_ids{
+            ar_slam::PoolAllocator<int>(&node_pool)};
         for (size_t i = 0; i < result.track_ids.size(); ++i) {
             int id = result.track_ids[i];
             current_ids.insert(id);
@@ -231,10 +371,12 @@ int main() {
         // Mapping status: shows whether we are triangulating real structure or
         // still gathering baseline.
         std::string map_status =
-            mapper->has_cloud()
-                ? "Map: " + std::to_string(mapper->cloud().size()) + " pts (triangulated)"
-                : "Map: gathering baseline (" + std::to_string((int)mapper->last_parallax()) +
-                      "px)";
+            snapshot->has_cloud
+                ? "Map: " + std::to_string(snapshot->cloud_size) + " pts, " +
+                      std::to_string(snapshot->keyframes) + " keyframes, " +
+                      std::to_string(snapshot->loop_closures) + " loops, " +
+                      std::to_string(relocalizations) + " relocs"
+                : "Map: gathering baseline (" + std::to_string((int)snapshot->parallax) + "px)";
         cv::putText(display, map_status, cv::Point(10, 150), cv::FONT_HERSHEY_SIMPLEX, 0.55,
                     cv::Scalar(0, 220, 255), 1, cv::LINE_AA);
 
@@ -249,10 +391,31 @@ int main() {
             std::cout << "Tracked Features: " << result.num_tracked << std::endl;
             std::cout << "Tracking Quality: " << result.tracking_quality << std::endl;
             std::cout << "3D Points: " << points_3d.size() << std::endl;
+            if (camera.is_open()) {
+                std::cout << "Camera frames: " << camera.frames_captured() << " captured, "
+                          << camera.frames_dropped() << " dropped, " << camera.latency_ms()
+                          << " ms capture latency" << std::endl;
+            }
+#ifdef __linux__
+            if (v4l2.is_open()) {
+                std::cout << "V4L2 buffers: " << v4l2.buffers_held() << " of "
+                          << v4l2.buffer_count() << " held, " << v4l2.get_fps() << " fps"
+                          << std::endl;
+            }
+#endif
+            if (mapper) {
+                std::cout << "Mapper packets: " << mapper->processed() << " processed, "
+                          << mapper->coalesced() << " coalesced, " << mapper->dropped()
+                          << " dropped" << std::endl;
+            }
+            ar_slam::dump_pool_stats(std::cout);  // Instrumented builds only.
         }
     }
 
-    cap.release();
+    camera.close();
+#ifdef __linux__
+    v4l2.close();  // Buffers the tracker still holds are released with it.
+#endif
     cv::destroyAllWindows();
 
     std::cout << "\nShutting down..." << std::endl;
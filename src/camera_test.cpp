@@ -5,6 +5,13 @@
 #include <deque>
 #include <numeric>
 #include <iomanip>
+#include <functional>
+#include <utility>
+#include "camera/threaded_camera.h"
+#include "camera/video_capture_camera.h"
+#ifdef __linux__
+#include "camera/v4l2_camera.h"
+#endif
 #include "core/frame.h"
 #include "core/feature_tracker.h"
 #include "rendering/gl_viewer.h"
@@ -67,24 +74,63 @@ int main() {
     std::cout << "=== AR SLAM 3D Camera Test ===" << std::endl;
     std::cout << "Real-world performance monitoring enabled\n" << std::endl;
 
-    // Initialize camera
-    cv::VideoCapture cap(0);
-    if (!cap.isOpened()) {
-        std::cerr << "Cannot open camera" << std::endl;
-        std::cerr << "Trying to use video file instead..." << std::endl;
-
-        // Fallback to video file if available
-        cap.open("test_video.mp4");
-        if (!cap.isOpened()) {
-            std::cerr << "No video source available" << std::endl;
-            return -1;
+    ar_slam::SharedPool<ar_slam::Frame> frame_pool(4);  // Current and previous frame.
+
+    // Initialize camera (640x480 at 30 fps). next_frame() yields the next
+    // Frame, or nullptr once the source ends.
+    ar_slam::CameraConfig camera_config;
+    ar_slam::CameraInterface::Ptr camera;
+    std::function<ar_slam::Frame::Ptr()> next_frame;
+#ifdef __linux__
+    // Frames borrow the driver's buffers: no pixel copy between capture and
+    // the tracker. Used only if the device actually delivers a frame.
+    auto v4l2 = std::make_shared<ar_slam::V4L2Camera>();
+    if (v4l2->open(camera_config)) {
+        ar_slam::Frame::Ptr first = v4l2->capture_frame(&frame_pool);
+        if (first) {
+            camera = v4l2;
+            next_frame = [v4l2, &frame_pool, first]() mutable -> ar_slam::Frame::Ptr {
+                if (first) {
+                    return std::exchange(first, nullptr);
+                }
+                return v4l2->capture_frame(&frame_pool);
+            };
+        } else {
+            v4l2->close();
         }
     }
-
-    // Set camera properties for better performance
-    cap.set(cv::CAP_PROP_FRAME_WIDTH, 640);
-    cap.set(cv::CAP_PROP_FRAME_HEIGHT, 480);
-    cap.set(cv::CAP_PROP_FPS, 30);
+#endif
+    // Otherwise a live camera is captured on its own thread so the loop
+    // always gets the newest frame.
+    auto source = std::make_shared<ar_slam::VideoCaptureCamera>();
+    auto threaded = std::make_shared<ar_slam::ThreadedCamera>(source);
+    if (!camera) {
+        camera = threaded;
+        if (!camera->open(camera_config)) {
+            std::cerr << "Cannot open camera" << std::endl;
+            std::cerr << "Trying to use video file instead..." << std::endl;
+
+            // Fallback to video file if available, read in step with the loop
+            // rather than raced through by a capture thread.
+            camera_config.device_path = "test_video.mp4";
+            camera = source;
+            if (!camera->open(camera_config)) {
+                std::cerr << "No video source available" << std::endl;
+                return -1;
+            }
+        }
+        next_frame = [&camera, &frame_pool]() -> ar_slam::Frame::Ptr {
+            cv::Mat image;
+            if (!camera->grab_frame(image)) {
+                return nullptr;
+            }
+            auto frame = ar_slam::Frame::create(frame_pool, image);
+            if (!frame) {
+                frame = std::make_shared<ar_slam::Frame>(image);  // Pool exhausted.
+            }
+            return frame;
+        };
+    }
 
     // Initialize 3D viewer
     ar_slam::GLViewer viewer("AR SLAM - 3D Point Cloud");
@@ -113,15 +159,15 @@ int main() {
     while (!viewer.should_close()) {
         auto frame_start = std::chrono::high_resolution_clock::now();
 
-        cap >> frame;
-        if (frame.empty()) {
+        auto slam_frame = next_frame();
+        if (!slam_frame) {
             std::cout << "End of video or camera disconnected" << std::endl;
             break;
         }
 
         // Process frame
-        auto slam_frame = std::make_shared<ar_slam::Frame>(frame);
         auto result = tracker.track_features(slam_frame);
+        frame = slam_frame->get_color_image();  // For display; converted only if not BGR.
 
         // Calculate frame timing
         auto frame_end = std::chrono::high_resolution_clock::now();
@@ -265,6 +311,11 @@ int main() {
             std::cout << "Max quality: " << (monitor.max_quality() * 100) << "%" << std::endl;
             std::cout << "Low quality frames: " << low_quality_frames << " ("
                       << (100.0 * low_quality_frames / frame_count) << "%)" << std::endl;
+            if (camera == threaded) {
+                std::cout << "Camera frames dropped: " << threaded->frames_dropped() << " of "
+                          << threaded->frames_captured() << ", capture latency "
+                          << threaded->mean_latency_ms() << " ms" << std::endl;
+            }
             std::cout << "===========================\n" << std::endl;
         }
         if (key == 'r' || key == 'R') {  // R - reset tracker
@@ -287,6 +338,12 @@ int main() {
               << (monitor.max_quality() * 100) << "%" << std::endl;
     std::cout << "Low quality frames (<70%): " << low_quality_frames << " ("
               << (100.0 * low_quality_frames / frame_count) << "%)" << std::endl;
+    if (camera == threaded) {
+        std::cout << "Camera frames dropped: " << threaded->frames_dropped() << " of "
+                  << threaded->frames_captured() << std::endl;
+        std::cout << "Capture-to-processing latency: " << threaded->mean_latency_ms() << " ms"
+                  << std::endl;
+    }
 
     if (monitor.avg_quality() > 0.85) {
         std::cout << "\nExcellent tracking performance!" << std::endl;
@@ -297,7 +354,7 @@ int main() {
         std::cout << "Consider better lighting or slower camera motion." << std::endl;
     }
 
-    cap.release();
+    camera->close();
     cv::destroyAllWindows();
 
     std::cout << "\nShutting down..." << std::endl;
@@ -0,0 +1,277 @@
+#include "core/async_mapper.h"
+
+#include <unistd.h>
+
+#include <utility>
+
+#include "core/log.h"
+
+namespace ar_slam {
+
+    namespace {
+
+        // Deltas kept before the base is re-taken: bounds a lagging reader's
+        // walk and the history held alive by old snapshots.
+        constexpr std::size_t kMaxChainLength = 32;
+
+    }  // namespace
+
+    bool MapSnapshot::update_cloud(std::vector<cv::Point3f>& cloud, uint64_t& version,
+                                   std::vector<std::size_t>* changed) const {
+        if (changed != nullptr) {
+            changed->clear();
+        }
+        if (version == map_version) {
+            return false;
+        }
+        // Older than the base (or from another session): start over from it.
+        const bool reload = version < base_version || version > map_version;
+        if (reload) {
+            cloud.clear();
+            if (cloud_base) {
+                cloud = *cloud_base;
+            }
+        }
+        const uint64_t from = reload ? base_version : version;
+        std::vector<const CloudDelta*> missed;  // Newest first
+        for (const CloudDelta* d = cloud_delta.get(); d != nullptr && d->map_version > from;
+             d = d->previous.get()) {
+            missed.push_back(d);
+        }
+        for (auto it = missed.rbegin(); it != missed.rend(); ++it) {
+            const CloudDelta& d = **it;
+            cloud.resize(d.size);
+            for (std::size_t k = 0; k < d.indices.size(); ++k) {
+                cloud[d.indices[k]] = d.points[k];
+            }
+            if (changed != nullptr && !reload) {
+                changed->insert(changed->end(), d.indices.begin(), d.indices.end());
+            }
+        }
+        cloud.resize(cloud_size);
+        version = map_version;
+        return reload;
+    }
+
+    AsyncMapper::AsyncMapper(const cv::Matx33d& K) : AsyncMapper(K, Config{}) {}
+
+    AsyncMapper::AsyncMapper(const cv::Matx33d& K, const Config& config)
+        : config_(config)
+        , mapper_(K, config.mapper)
+        , queue_(config.queue_capacity)
+        , front_(std::make_shared<const MapSnapshot>()) {
+        if (!config_.map_path.empty()) {
+            open_map();
+        }
+        worker_ = std::thread([this] { run(); });
+    }
+
+    AsyncMapper::~AsyncMapper() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stop_.store(true, std::memory_order_release);
+        }
+        wake_.notify_all();
+        worker_.join();
+        save_map(true);
+    }
+
+    bool AsyncMapper::submit(const std::vector<int>& track_ids,
+                             const std::vector<cv::Point2f>& points,
+                             const Frame::Timestamp& timestamp,
+                             const cv::Mat& image) {
+        return submit(track_ids.data(), track_ids.size(), points.data(), points.size(),
+                      timestamp, image);
+    }
+
+    bool AsyncMapper::submit(const std::pmr::vector<int>& track_ids,
+                             const std::pmr::vector<cv::Point2f>& points,
+                             const Frame::Timestamp& timestamp,
+                             const cv::Mat& image) {
+        return submit(track_ids.data(), track_ids.size(), points.data(), points.size(),
+                      timestamp, image);
+    }
+
+    bool AsyncMapper::submit(const int* track_ids, std::size_t num_tracks,
+                             const cv::Point2f* points, std::size_t num_points,
+                             const Frame::Timestamp& timestamp, const cv::Mat& image) {
+        submitted_.fetch_add(1, std::memory_order_relaxed);
+        // Drop before copying anything: a full queue is exactly when the frame copy
+        // would be wasted.
+        if (!queue_.writable()) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Refill the recycled staging buffers in place (no allocation once warm).
+        staging_.track_ids.assign(track_ids, track_ids + num_tracks);
+        staging_.points.assign(points, points + num_points);
+        staging_.timestamp = timestamp;
+        image.copyTo(staging_.image);  // The caller's pixels may go back to the driver.
+        queue_.try_push(staging_);     // Only this thread fills slots: room is still there.
+
+        // The mutex is taken only when the worker is (about to be) asleep. Both sides
+        // exchange sleeping_, so whichever goes second sees the other: the worker
+        // sees this packet and does not sleep, or we see it asleep and wake it.
+        if (sleeping_.exchange(false, std::memory_order_acq_rel)) {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            wake_.notify_one();
+        }
+        return true;
+    }
+
+    std::shared_ptr<const MapSnapshot> AsyncMapper::snapshot() const {
+        return std::atomic_load(&front_);
+    }
+
+    void AsyncMapper::flush() {
+        const uint64_t target = submitted_.load(std::memory_order_relaxed) -
+                                dropped_.load(std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        flushed_.wait(lock, [this, target] {
+            return consumed_.load(std::memory_order_acquire) >= target;
+        });
+    }
+
+    void AsyncMapper::run() {
+        Packet packet;
+        while (!stop_.load(std::memory_order_acquire)) {
+            if (!queue_.try_pop(packet)) {
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                sleeping_.exchange(true, std::memory_order_acq_rel);
+                wake_.wait(lock, [this] {
+                    return stop_.load(std::memory_order_acquire) || !queue_.empty();
+                });
+                sleeping_.store(false, std::memory_order_relaxed);
+                continue;
+            }
+
+            // Behind the tracker: drop everything but the newest packet.
+            uint64_t skipped = 0;
+            if (config_.coalesce == Coalesce::kLatest) {
+                while (queue_.try_pop(packet)) {
+                    ++skipped;
+                }
+            }
+
+            const bool changed = mapper_.update(packet.track_ids, packet.points, packet.image);
+            if (changed) {
+                ++map_version_;
+            }
+            publish(packet, changed, processed_.load(std::memory_order_relaxed) + 1);
+            if (changed) {
+                save_map(false);
+            }
+
+            coalesced_.fetch_add(skipped, std::memory_order_relaxed);
+            processed_.fetch_add(1, std::memory_order_relaxed);
+            {
+                // Under the mutex, so a flush() between its check and its wait
+                // cannot miss this.
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                consumed_.fetch_add(skipped + 1, std::memory_order_release);
+            }
+            flushed_.notify_all();
+        }
+    }
+
+    void AsyncMapper::open_map() {
+        // Resume an existing file; never overwrite one that fails to load.
+        MapFile file;
+        if (file.open(config_.map_path)) {
+            if (mapper_.load_map(file) && writer_.resume(config_.map_path, mapper_.map())) {
+                ++map_version_;
+                publish(Packet{}, true, 0);
+                AR_LOG("Loaded map " << config_.map_path << ": "
+                                     << mapper_.map().keyframes().size() << " keyframes, "
+                                     << mapper_.map().size() << " landmarks");
+            } else {
+                mapper_.reset();
+            }
+        } else if (::access(config_.map_path.c_str(), F_OK) != 0) {
+            writer_.create(config_.map_path);
+        }
+        if (!writer_.is_open()) {
+            AR_LOG("Map file " << config_.map_path << " unusable; not persisting the map");
+        }
+        saved_keyframes_ = mapper_.map().keyframes().size();
+    }
+
+    void AsyncMapper::save_map(bool force) {
+        const std::size_t keyframes = mapper_.map().keyframes().size();
+        if (!writer_.is_open() || (!force && keyframes < saved_keyframes_ + config_.save_every)) {
+            return;
+        }
+        if (!writer_.append(mapper_.map())) {
+            AR_LOG("Writing map file " << config_.map_path << " failed; not persisting the map");
+        }
+        saved_keyframes_ = keyframes;
+    }
+
+    void AsyncMapper::publish_cloud() {
+        // Only the entries written since the last version go out, as a delta
+        // linked onto the chain; readers that skipped versions walk back along it.
+        const std::vector<cv::Point3f>& cloud = mapper_.cloud();
+        const std::vector<std::size_t>& changes = mapper_.cloud_changes();
+        const std::size_t published = cloud_delta_   ? cloud_delta_->size
+                                      : cloud_base_ ? cloud_base_->size()
+                                                    : 0;
+        if (!cloud_base_ || cloud.size() < published || chain_length_ >= kMaxChainLength ||
+            chain_points_ + changes.size() > cloud.size() / 4) {
+            cloud_base_ = std::make_shared<const std::vector<cv::Point3f>>(cloud);
+            base_version_ = map_version_;
+            cloud_delta_.reset();
+            chain_length_ = 0;
+            chain_points_ = 0;
+        } else {
+            auto delta = std::make_shared<CloudDelta>();
+            delta->map_version = map_version_;
+            delta->size = cloud.size();
+            delta->indices = changes;
+            delta->points.reserve(changes.size());
+            for (std::size_t index : changes) {
+                delta->points.push_back(cloud[index]);
+            }
+            delta->previous = std::move(cloud_delta_);
+            cloud_delta_ = std::move(delta);
+            ++chain_length_;
+            chain_points_ += changes.size();
+        }
+        mapper_.clear_cloud_changes();
+    }
+
+    void AsyncMapper::publish(const Packet& packet, bool map_changed, uint64_t sequence) {
+        // Reuse the previous front as the back buffer unless a reader still holds it
+        // (moved out, so ours is the only reference then). It is no longer in front_,
+        // so a count of 1 cannot grow again; but use_count() is a relaxed load, and
+        // the acquire fence is what orders a reader's last reads of the snapshot,
+        // made before its releasing decrement, ahead of our writes to it.
+        std::shared_ptr<MapSnapshot> next = std::move(back_);
+        if (!next || next.use_count() > 1) {
+            next = std::make_shared<MapSnapshot>();
+        } else {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+
+        next->sequence = sequence;
+        next->timestamp = packet.timestamp;
+        next->has_cloud = mapper_.has_cloud();
+        next->parallax = mapper_.last_parallax();
+        next->keyframes = mapper_.map().keyframes().size();
+        next->loop_closures = mapper_.loop_closures();
+        next->places = mapper_.relocalization_map();  // Immutable; shared, not copied.
+        if (map_changed) {
+            publish_cloud();
+        }
+        next->map_version = map_version_;
+        next->cloud_size = mapper_.cloud().size();
+        next->cloud_base = cloud_base_;
+        next->base_version = base_version_;
+        next->cloud_delta = cloud_delta_;
+
+        std::shared_ptr<const MapSnapshot> previous =
+            std::atomic_exchange(&front_, std::shared_ptr<const MapSnapshot>(next));
+        back_ = std::const_pointer_cast<MapSnapshot>(previous);
+    }
+
+}  // namespace ar_slam
@@ -3,8 +3,28 @@
 
 namespace ar_slam {
 
-    TrackingResult FeatureTracker::track_features(Frame::Ptr current_frame) {
-        TrackingResult result;
+    namespace {
+
+        // Header over a pre-sized pmr vector, so OpenCV writes into the arena
+        // in place (its create() is a no-op on a matching size and type).
+        template <typename T>
+        cv::Mat as_mat(std::pmr::vector<T>& v) {
+            return cv::Mat(static_cast<int>(v.size()), 1, cv::traits::Type<T>::value, v.data());
+        }
+
+        template <typename T>
+        cv::Mat as_mat(const std::pmr::vector<T>& v) {
+            return as_mat(const_cast<std::pmr::vector<T>&>(v));
+        }
+
+    }  // namespace
+
+    TrackingResult FeatureTracker::track_features(Frame::Ptr current_frame,
+                                                  std::pmr::memory_resource* scratch) {
+        if (scratch == nullptr) {
+            scratch = std::pmr::get_default_resource();
+        }
+        TrackingResult result(scratch);
         result.tracking_quality = 0.0f;
 
         if (!prev_frame_) {
@@ -13,42 +33,44 @@ namespace ar_slam {
             prev_frame_ = current_frame;
 
             // Initialize tracking points
-            prev_points_.clear();
-            track_ids_.clear();
-
-            for (const auto& feat : current_frame->get_features()) {
-                prev_points_.push_back(feat.pixel);
-                track_ids_.push_back(next_track_id_++);
-            }
+            start_tracks(current_frame, result);
 
             result.num_tracked = prev_points_.size();
             result.tracking_quality = 1.0f;
             AR_LOG("Initialized tracker with " << result.num_tracked << " features");
 
             // Set result points for consistency
-            result.curr_points = prev_points_;
-            result.track_ids = track_ids_;
+            result.curr_points.assign(prev_points_.begin(), prev_points_.end());
+            result.track_ids.assign(track_ids_.begin(), track_ids_.end());
 
         } else {
             // Track using optical flow
             if (prev_points_.empty()) {
                 AR_LOG("No previous points to track, re-initializing...");
                 prev_frame_.reset();
-                return track_features(current_frame);  // Recursive call to re-initialize
+                return track_features(current_frame, scratch);  // Recursive re-initialization
             }
 
-            std::vector<cv::Point2f> curr_points;
-            std::vector<uchar> status;
-            std::vector<float> err;
+            const size_t n = prev_points_.size();
+            std::pmr::vector<cv::Point2f> curr_points(n, scratch);
+            std::pmr::vector<uchar> status(n, scratch);
+            std::pmr::vector<float> err(n, scratch);
 
             // Optical flow
+            cv::Mat curr_mat = as_mat(curr_points);
+            cv::Mat status_mat = as_mat(status);
+            cv::Mat err_mat = as_mat(err);
             cv::calcOpticalFlowPyrLK(prev_frame_->get_image(), current_frame->get_image(),
-                                     prev_points_, curr_points, status, err, win_size_, max_level_);
+                                     prev_points_, curr_mat, status_mat, err_mat, win_size_,
+                                     max_level_);
 
             // Collect valid tracks
-            std::vector<cv::Point2f> good_prev_points;
-            std::vector<cv::Point2f> good_curr_points;
-            std::vector<int> good_track_ids;
+            std::pmr::vector<cv::Point2f> good_prev_points(scratch);
+            std::pmr::vector<cv::Point2f> good_curr_points(scratch);
+            std::pmr::vector<int> good_track_ids(scratch);
+            good_prev_points.reserve(n);
+            good_curr_points.reserve(n);
+            good_track_ids.reserve(n);
 
             for (size_t i = 0; i < status.size(); ++i) {
                 if (status[i] && err[i] < 30.0f) {  // Add error threshold
@@ -67,13 +89,16 @@ namespace ar_slam {
 
             // Apply RANSAC with Fundamental Matrix to remove outliers
             if (good_curr_points.size() >= 8) {
-                std::vector<uchar> mask;
-                cv::findFundamentalMat(good_prev_points, good_curr_points, cv::FM_RANSAC, 3.0, 0.99,
-                                       mask);
+                // Zero-initialised: if RANSAC finds no model, no point is an inlier
+                // and the sanity check below keeps the unfiltered tracks.
+                std::pmr::vector<uchar> mask(good_curr_points.size(), scratch);
+                cv::Mat mask_mat = as_mat(mask);
+                cv::findFundamentalMat(as_mat(good_prev_points), as_mat(good_curr_points),
+                                       cv::FM_RANSAC, 3.0, 0.99, mask_mat);
 
-                std::vector<cv::Point2f> ransac_prev_points;
-                std::vector<cv::Point2f> ransac_curr_points;
-                std::vector<int> ransac_track_ids;
+                std::pmr::vector<cv::Point2f> ransac_prev_points(scratch);
+                std::pmr::vector<cv::Point2f> ransac_curr_points(scratch);
+                std::pmr::vector<int> ransac_track_ids(scratch);
 
                 for (size_t i = 0; i < mask.size(); ++i) {
                     if (mask[i]) {
@@ -85,9 +110,9 @@ namespace ar_slam {
 
                 // Only update if we didn't lose too many points (sanity check)
                 if (ransac_curr_points.size() > good_curr_points.size() * 0.5) {
-                    good_prev_points = ransac_prev_points;
-                    good_curr_points = ransac_curr_points;
-                    good_track_ids = ransac_track_ids;
+                    good_prev_points = std::move(ransac_prev_points);
+                    good_curr_points = std::move(ransac_curr_points);
+                    good_track_ids = std::move(ransac_track_ids);
                 }
             }
 
@@ -111,28 +136,20 @@ namespace ar_slam {
                 // Re-extract features completely
                 current_frame->extract_features();
 
-                // Reset tracking
-                prev_points_.clear();
-                track_ids_.clear();
-
-                for (const auto& feat : current_frame->get_features()) {
-                    prev_points_.push_back(feat.pixel);
-                    track_ids_.push_back(next_track_id_++);
-                }
+                // Reset tracking (known landmarks keep their ids if relocalized)
+                start_tracks(current_frame, result);
 
                 prev_frame_ = current_frame;
 
                 // Set result
                 result.prev_points.clear();
-                result.curr_points = prev_points_;
-                result.track_ids = track_ids_;
+                result.curr_points.assign(prev_points_.begin(), prev_points_.end());
+                result.track_ids.assign(track_ids_.begin(), track_ids_.end());
                 result.num_tracked = prev_points_.size();
                 result.num_inliers = result.num_tracked;
                 result.tracking_quality = 1.0f;
 
-                for (int i = 0; i < result.num_tracked; ++i) {
-                    result.inliers.push_back(true);
-                }
+                result.inliers.assign(result.num_tracked, true);
 
                 AR_LOG("Re-initialized with " << result.num_tracked << " features");
 
@@ -143,10 +160,7 @@ namespace ar_slam {
                 result.track_ids = good_track_ids;
                 result.num_tracked = good_curr_points.size();
                 result.num_inliers = result.num_tracked;
-
-                for (int i = 0; i < result.num_tracked; ++i) {
-                    result.inliers.push_back(true);
-                }
+                result.inliers.assign(result.num_tracked, true);
 
                 // Check if we need to add more features
                 if (good_curr_points.size() < TARGET_FEATURES) {
@@ -188,16 +202,42 @@ namespace ar_slam {
                     result.num_tracked = good_curr_points.size();
                 }
 
-                // Update for next frame
+                // Update for next frame (copied out of the scratch resource)
                 prev_frame_ = current_frame;
-                prev_points_ = result.curr_points;
-                track_ids_ = result.track_ids;
+                prev_points_.assign(result.curr_points.begin(), result.curr_points.end());
+                track_ids_.assign(result.track_ids.begin(), result.track_ids.end());
             }
         }
 
         return result;
     }
 
+    void FeatureTracker::start_tracks(const Frame::Ptr& frame, TrackingResult& result) {
+        prev_points_.clear();
+        track_ids_.clear();
+
+        RelocalizationResult reloc;
+        if (relocalizer_ && relocalizer_->has_map()) {
+            reloc = relocalizer_->relocalize(frame->keypoints_, frame->descriptors_);
+            AR_LOG("Relocalization " << (reloc.success ? "succeeded" : "failed") << ": "
+                                     << reloc.inliers << "/" << reloc.matches << " inliers in "
+                                     << reloc.time_ms << " ms");
+        }
+
+        // Features and keypoints share one order (see Frame::extract_features)
+        const auto& features = frame->get_features();
+        for (size_t i = 0; i < features.size(); ++i) {
+            prev_points_.push_back(features[i].pixel);
+            if (reloc.success && reloc.track_ids[i] >= 0) {
+                track_ids_.push_back(reloc.track_ids[i]);
+                result.relocalized_tracks++;
+            } else {
+                track_ids_.push_back(next_track_id_++);
+            }
+        }
+        result.relocalized = reloc.success;
+    }
+
     void FeatureTracker::reset() {
         prev_frame_.reset();
         prev_points_.clear();
@@ -9,15 +9,128 @@ namespace ar_slam {
     Feature::Feature(const cv::KeyPoint& kp, const cv::Mat& desc)
         : pixel(kp.pt), descriptor(desc.clone()), response(kp.response), octave(kp.octave) {}
 
+    namespace {
+
+        /// Channels of the cv::Mat that carries an image in @p format.
+        int channels_of(Frame::PixelFormat format) {
+            switch (format) {
+                case Frame::PixelFormat::kBGR:
+                    return 3;
+                case Frame::PixelFormat::kBGRA:
+                    return 4;
+                case Frame::PixelFormat::kYUYV:
+                case Frame::PixelFormat::kUYVY:
+                    return 2;
+                default:
+                    return 1;
+            }
+        }
+
+        /// Format implied by the channel count alone; two channels imply none.
+        Frame::PixelFormat format_of(const cv::Mat& image) {
+            return image.channels() == 4   ? Frame::PixelFormat::kBGRA
+                   : image.channels() == 1 ? Frame::PixelFormat::kGray
+                                           : Frame::PixelFormat::kBGR;
+        }
+
+    }  // namespace
+
     Frame::Frame(const cv::Mat& image, const Timestamp& timestamp)
         : id_(next_id_++), timestamp_(timestamp) {
         if (image.channels() == 3) {
+            format_ = PixelFormat::kBGR;
             cv::cvtColor(image, image_gray_, cv::COLOR_BGR2GRAY);
             image_rgb_ = image.clone();
+        } else if (image.channels() == 4) {
+            format_ = PixelFormat::kBGRA;
+            cv::cvtColor(image, image_gray_, cv::COLOR_BGRA2GRAY);
+            source_ = image.clone();
+        } else if (image.channels() == 1) {
+            image_gray_ = image.clone();  // Colour, if wanted, is made from this.
         } else {
-            image_gray_ = image.clone();
-            cv::cvtColor(image, image_rgb_, cv::COLOR_GRAY2BGR);
+            AR_LOG("Frame: a " << image.channels() << "-channel image needs a PixelFormat");
+        }
+    }
+
+    Frame::Frame(const cv::Mat& image, std::shared_ptr<const void> buffer,
+                 const Timestamp& timestamp)
+        : Frame(image, format_of(image), std::move(buffer), timestamp) {}
+
+    Frame::Frame(const cv::Mat& image, PixelFormat format, std::shared_ptr<const void> buffer,
+                 const Timestamp& timestamp)
+        : id_(next_id_++), timestamp_(timestamp), format_(format), buffer_(std::move(buffer)) {
+        if (image.channels() != channels_of(format)) {
+            AR_LOG("Frame: a " << image.channels() << "-channel image does not fit its format");
+            buffer_.reset();  // Nothing borrowed: hand the buffer back now.
+            return;
         }
+        switch (format) {
+            case PixelFormat::kGray:
+                image_gray_ = image;  // A header only: the pixels stay in the buffer.
+                break;
+            case PixelFormat::kBGR:
+                cv::cvtColor(image, image_gray_, cv::COLOR_BGR2GRAY);
+                image_rgb_ = image;
+                break;
+            case PixelFormat::kBGRA:
+                cv::cvtColor(image, image_gray_, cv::COLOR_BGRA2GRAY);
+                source_ = image;
+                break;
+            case PixelFormat::kYUYV:
+            case PixelFormat::kUYVY:
+                // Y is channel 0 of Y0 U / Y1 V pairs, channel 1 of U Y0 / V Y1.
+                cv::extractChannel(image, image_gray_, format == PixelFormat::kYUYV ? 0 : 1);
+                source_ = image;
+                break;
+            case PixelFormat::kNV12:
+            case PixelFormat::kI420:
+                image_gray_ = image.rowRange(0, image.rows * 2 / 3);  // The Y plane, in place.
+                source_ = image;
+                break;
+        }
+    }
+
+    Frame::Ptr Frame::create(SharedPool<Frame>& pool, const cv::Mat& image,
+                             const Timestamp& timestamp) {
+        return pool.make(image, timestamp);
+    }
+
+    Frame::Ptr Frame::create(SharedPool<Frame>& pool, const cv::Mat& image,
+                             std::shared_ptr<const void> buffer, const Timestamp& timestamp) {
+        return pool.make(image, std::move(buffer), timestamp);
+    }
+
+    Frame::Ptr Frame::create(SharedPool<Frame>& pool, const cv::Mat& image, PixelFormat format,
+                             std::shared_ptr<const void> buffer, const Timestamp& timestamp) {
+        return pool.make(image, format, std::move(buffer), timestamp);
+    }
+
+    const cv::Mat& Frame::get_color_image() const {
+        std::call_once(color_once_, [this] {
+            switch (format_) {
+                case PixelFormat::kGray:
+                    cv::cvtColor(image_gray_, image_rgb_, cv::COLOR_GRAY2BGR);
+                    break;
+                case PixelFormat::kBGR:
+                    break;  // Kept from construction.
+                case PixelFormat::kBGRA:
+                    cv::cvtColor(source_, image_rgb_, cv::COLOR_BGRA2BGR);
+                    break;
+                case PixelFormat::kYUYV:
+                    cv::cvtColor(source_, image_rgb_, cv::COLOR_YUV2BGR_YUYV);
+                    break;
+                case PixelFormat::kUYVY:
+                    cv::cvtColor(source_, image_rgb_, cv::COLOR_YUV2BGR_UYVY);
+                    break;
+                case PixelFormat::kNV12:
+                    cv::cvtColor(source_, image_rgb_, cv::COLOR_YUV2BGR_NV12);
+                    break;
+                case PixelFormat::kI420:
+                    cv::cvtColor(source_, image_rgb_, cv::COLOR_YUV2BGR_I420);
+                    break;
+            }
+        });
+        return image_rgb_;
     }
 
     void Frame::extract_features(int max_features) {
@@ -2,96 +2,408 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 
 namespace ar_slam {
 
+    namespace {
+
+        geometry::Mat3 to_geom_mat3(const cv::Matx33d& m) {
+            geometry::Mat3 out;
+            for (int i = 0; i < 3; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                    out.m[i][j] = m(i, j);
+                }
+            }
+            return out;
+        }
+
+        cv::Point3f to_cv_point(const geometry::Vec3& p) {
+            return cv::Point3f(static_cast<float>(p[0]), static_cast<float>(p[1]),
+                               static_cast<float>(p[2]));
+        }
+
+    }  // namespace
+
     IncrementalMapper::IncrementalMapper(const cv::Matx33d& K) : IncrementalMapper(K, Config{}) {}
 
     IncrementalMapper::IncrementalMapper(const cv::Matx33d& K, const Config& config)
-        : K_(K), config_(config), reconstructor_(K) {}
+        : K_(K),
+          config_(config),
+          reconstructor_(K, config.reconstruction),
+          map_(config.landmark_index) {
+        if (config_.local_ba) {
+            ba_ = std::make_unique<LocalBundleAdjuster>(to_geom_mat3(K_), config_.ba);
+        }
+        if (config_.vocabulary && !config_.vocabulary->empty()) {
+            loop_ = std::make_unique<LoopCloser>(config_.vocabulary, config_.loop);
+        }
+        if (loop_ || config_.relocalization) {
+            // Same extractor settings as Frame, so descriptors match the vocabulary
+            // and the features the tracker re-detects.
+            orb_ = cv::ORB::create(500, 1.2f, 8, 31, 0, 2, cv::ORB::HARRIS_SCORE, 31, 20);
+        }
+    }
 
     void IncrementalMapper::set_reference(const std::vector<int>& ids,
-                                          const std::vector<cv::Point2f>& pts) {
-        reference_.clear();
-        reference_.reserve(ids.size());
+                                          const std::vector<cv::Point2f>& pts,
+                                          const cv::Mat& image) {
+        // Copied: it is read again frames later, long after the caller's buffer
+        // (a recycled packet, a driver buffer) may have been reused.
+        image.copyTo(reference_image_);
+        reference_.assign(ids, pts);
+        has_reference_ = !reference_.empty();
+        retry_parallax_ = 0.0;
+        reference_keyframe_ = -1;
+    }
+
+    void IncrementalMapper::describe(const cv::Mat& image,
+                                     const std::vector<cv::Point2f>& pts,
+                                     const std::vector<int>& indices,
+                                     std::vector<uint8_t>& out) {
+        // One row per point; points ORB cannot describe (too close to the border,
+        // or no image) keep an all-zero row, which the loop closer and the
+        // relocalizer skip.
+        out.assign(indices.size() * kDescriptorBytes, 0);
+        if (!orb_ || image.empty()) {
+            return;
+        }
+        std::vector<cv::KeyPoint> keypoints;
+        keypoints.reserve(indices.size());
+        for (size_t k = 0; k < indices.size(); ++k) {
+            keypoints.emplace_back(pts[indices[k]], 31.0f, -1.0f, 0.0f, 0, static_cast<int>(k));
+        }
+        cv::Mat descriptors;
+        orb_->compute(image, keypoints, descriptors);
+        if (descriptors.cols != static_cast<int>(kDescriptorBytes)) {
+            return;
+        }
+        for (size_t r = 0; r < keypoints.size(); ++r) {
+            std::memcpy(&out[keypoints[r].class_id * kDescriptorBytes],
+                        descriptors.ptr<uint8_t>(static_cast<int>(r)), kDescriptorBytes);
+        }
+    }
+
+    void IncrementalMapper::integrate(const ReconstructionResult& result,
+                                      const std::vector<int>& ids,
+                                      const std::vector<cv::Point2f>& ref_pts,
+                                      const std::vector<cv::Point2f>& cur_pts,
+                                      const cv::Mat& image) {
+        std::vector<int> point_ids;
+        std::vector<geometry::Vec3> ref_points;
+        point_ids.reserve(result.points.size());
+        ref_points.reserve(result.points.size());
+        for (size_t k = 0; k < result.points.size(); ++k) {
+            const cv::Point3f& p = result.points[k];
+            point_ids.push_back(ids[result.point_indices[k]]);
+            ref_points.push_back({p.x, p.y, p.z});
+        }
+
+        // Tie the unit-baseline pair to the map scale through shared landmarks. With
+        // no overlap (first pair, or after the tracks were re-detected) reuse the
+        // last scale so consecutive baselines stay comparable.
+        const double scale = map_.relative_scale(reference_pose_, point_ids, ref_points,
+                                                 config_.min_scale_matches, last_scale_);
+        last_scale_ = scale;
+
+        const bool new_reference = reference_keyframe_ < 0;
+        if (new_reference) {
+            // The reference was anchored without a reconstruction (first pair or a
+            // stale re-anchor): register it at its best-known pose.
+            reference_keyframe_ = map_.add_keyframe(reference_pose_, {}, {}).keyframe.id;
+        }
+
+        // Record the pixel observations that bundle adjustment will need, and that
+        // link both keyframes in the covisibility graph. The reference may already
+        // hold some of these landmarks (it was the previous pair's second view);
+        // the keyframe database ignores such repeats.
+        const int current_keyframe = map_.next_keyframe_id();
+        std::vector<MapObservation> observations;
+        observations.reserve(2 * point_ids.size());
+        for (size_t k = 0; k < point_ids.size(); ++k) {
+            const int i = result.point_indices[k];
+            observations.push_back({current_keyframe, point_ids[k], cur_pts[i].x, cur_pts[i].y});
+            observations.push_back({reference_keyframe_, point_ids[k], ref_pts[i].x, ref_pts[i].y});
+        }
+
+        // Describe both views of every observation (same order as observations).
+        std::vector<uint8_t> descriptors;
+        if (orb_) {
+            std::vector<uint8_t> cur_rows;
+            std::vector<uint8_t> ref_rows;
+            describe(image, cur_pts, result.point_indices, cur_rows);
+            describe(reference_image_, ref_pts, result.point_indices, ref_rows);
+            descriptors.reserve(cur_rows.size() + ref_rows.size());
+            for (size_t k = 0; k < point_ids.size(); ++k) {
+                const size_t at = k * kDescriptorBytes;
+                descriptors.insert(descriptors.end(), cur_rows.begin() + at,
+                                   cur_rows.begin() + at + kDescriptorBytes);
+                descriptors.insert(descriptors.end(), ref_rows.begin() + at,
+                                   ref_rows.begin() + at + kDescriptorBytes);
+            }
+        }
+
+        geometry::Pose relative;
+        relative.R = to_geom_mat3(result.R);
+        relative.t = {result.t(0) * scale, result.t(1) * scale, result.t(2) * scale};
+        const geometry::Pose current = geometry::compose(relative, reference_pose_);
+        const geometry::Pose ref_to_world = reference_pose_.inverse();
+
+        std::vector<geometry::Vec3> world_points;
+        world_points.reserve(ref_points.size());
+        for (const geometry::Vec3& p : ref_points) {
+            const geometry::Vec3 scaled{p[0] * scale, p[1] * scale, p[2] * scale};
+            world_points.push_back(ref_to_world.transform(scaled));
+        }
+
+        last_delta_ =
+            map_.add_keyframe(current, point_ids, world_points, observations, descriptors);
+
+        // Mirror the delta into the display cloud: appends land at the end (map
+        // insertion order), updates are patched in place.
+        for (const LandmarkUpdate& u : last_delta_.added) {
+            cloud_changes_.push_back(cloud_.size());
+            cloud_.push_back(to_cv_point(u.position));
+        }
+        for (const LandmarkUpdate& u : last_delta_.updated) {
+            const std::size_t index = static_cast<std::size_t>(map_.index_of(u.id));
+            cloud_[index] = to_cv_point(u.position);
+            cloud_changes_.push_back(index);
+        }
+
+        reference_pose_ = current;
+
+        // Index the new keyframe(s) for place recognition. Verification runs here
+        // on the mapping thread; only the pose-graph optimisation is deferred.
+        if (loop_) {
+            if (new_reference) {
+                loop_->add_keyframe(map_, reference_keyframe_);
+            }
+            loop_->add_keyframe(map_, last_delta_.keyframe.id);
+        }
+    }
+
+    bool IncrementalMapper::apply_refinement() {
+        MapRefinement refinement;
+        if (!ba_ || !ba_->poll(refinement)) {
+            return false;
+        }
+        for (const LandmarkUpdate& u : map_.refine(refinement)) {
+            const std::size_t index = static_cast<std::size_t>(map_.index_of(u.id));
+            cloud_[index] = to_cv_point(u.position);
+            cloud_changes_.push_back(index);
+        }
+        if (reference_keyframe_ >= 0) {
+            reference_pose_ = map_.keyframes()[reference_keyframe_].pose;
+        }
+        return true;
+    }
+
+    bool IncrementalMapper::apply_correction() {
+        MapCorrection correction;
+        if (!loop_ || !loop_->poll(correction)) {
+            return false;
+        }
+        map_.correct(correction);
+        const std::vector<Landmark>& landmarks = map_.landmarks();
+        for (size_t i = 0; i < landmarks.size(); ++i) {
+            cloud_[i] = to_cv_point(landmarks[i].position);
+            cloud_changes_.push_back(i);
+        }
+        // The reference follows its keyframe (or, unregistered, the newest one),
+        // and the fallback scale follows the map scale around it.
+        const auto& keyframes = map_.keyframes();
+        if (!keyframes.empty()) {
+            const int anchor = reference_keyframe_ >= 0 ? reference_keyframe_
+                                                         : static_cast<int>(keyframes.size()) - 1;
+            reference_pose_ = keyframes[anchor].pose;
+        }
+        if (!correction.keyframes.empty()) {
+            last_scale_ /= correction.keyframes.back().after.s;
+        }
+        ++loop_closures_;
+        return true;
+    }
+
+    bool IncrementalMapper::relocalize_reference(const std::vector<int>& ids,
+                                                 const std::vector<cv::Point2f>& pts) {
+        // Tracks the tracker re-attached to landmarks pin the new reference's pose.
+        std::vector<cv::Point3f> points;
+        std::vector<cv::Point2f> pixels;
         for (size_t i = 0; i < ids.size(); ++i) {
-            reference_[ids[i]] = pts[i];
+            if (const Landmark* lm = map_.find(ids[i])) {
+                points.push_back(to_cv_point(lm->position));
+                pixels.push_back(pts[i]);
+            }
+        }
+        geometry::Pose pose;
+        std::vector<int> inliers;
+        if (!Relocalizer::solve_pnp(K_, points, pixels, config_.relocalization_config, pose,
+                                    inliers)) {
+            return false;
+        }
+        reference_pose_ = pose;
+        ++relocalizations_;
+        return true;
+    }
+
+    void IncrementalMapper::capture_places() {
+        if (config_.relocalization) {
+            places_ = Relocalizer::capture(map_, config_.relocalization_config.recent_keyframes);
         }
-        has_reference_ = !reference_.empty();
     }
 
     bool IncrementalMapper::update(const std::vector<int>& track_ids,
-                                   const std::vector<cv::Point2f>& points) {
+                                   const std::vector<cv::Point2f>& points,
+                                   const cv::Mat& image) {
         last_parallax_ = 0.0;
+        const bool corrected = apply_correction();
+        const bool refined = apply_refinement() || corrected;
+        if (refined) {
+            capture_places();
+        }
         if (track_ids.size() != points.size()) {
-            return false;
+            return refined;
         }
 
         if (!has_reference_) {
-            set_reference(track_ids, points);
-            return false;
+            set_reference(track_ids, points, image);
+            if (config_.relocalization && !map_.empty()) {
+                relocalize_reference(track_ids, points);  // Resuming a loaded map.
+            }
+            return refined;
         }
 
-        // Match current observations to the reference keyframe by track id.
-        std::vector<cv::Point2f> ref_pts;
-        std::vector<cv::Point2f> cur_pts;
-        std::vector<double> displacements;
-        ref_pts.reserve(track_ids.size());
-        cur_pts.reserve(track_ids.size());
-        displacements.reserve(track_ids.size());
-
-        for (size_t i = 0; i < track_ids.size(); ++i) {
-            auto it = reference_.find(track_ids[i]);
-            if (it == reference_.end()) {
-                continue;
-            }
-            ref_pts.push_back(it->second);
-            cur_pts.push_back(points[i]);
-            cv::Point2f d = points[i] - it->second;
-            displacements.push_back(std::sqrt(static_cast<double>(d.x * d.x + d.y * d.y)));
+        // Match current observations to the reference keyframe by track id, in
+        // one pass over reused buffers: every track is written to the next slot
+        // and the slot is kept only if the reference had the id.
+        const size_t n = track_ids.size();
+        ref_pts_.resize(n);
+        cur_pts_.resize(n);
+        matched_ids_.resize(n);
+        parallax2_.resize(n);
+        size_t matched = 0;
+        const cv::Point2f unmatched;
+        for (size_t i = 0; i < n; ++i) {
+            const cv::Point2f* ref = reference_.find(track_ids[i]);
+            const cv::Point2f& r = ref != nullptr ? *ref : unmatched;
+            const cv::Point2f d = points[i] - r;
+            ref_pts_[matched] = r;
+            cur_pts_[matched] = points[i];
+            matched_ids_[matched] = track_ids[i];
+            parallax2_[matched] = d.x * d.x + d.y * d.y;
+            matched += ref != nullptr ? 1 : 0;
         }
+        ref_pts_.resize(matched);
+        cur_pts_.resize(matched);
+        matched_ids_.resize(matched);
+        parallax2_.resize(matched);
 
         // Too little overlap with the reference (e.g. after a re-detection): the
-        // reference is stale, so anchor a fresh one on the current frame.
-        if (static_cast<int>(ref_pts.size()) < config_.min_shared_to_keep) {
-            set_reference(track_ids, points);
-            return false;
+        // reference is stale, so anchor a fresh one on the current frame. If the
+        // tracker relocalized, its pose comes from the re-attached landmarks;
+        // otherwise it keeps the last known pose.
+        if (static_cast<int>(matched) < config_.min_shared_to_keep) {
+            set_reference(track_ids, points, image);
+            if (config_.relocalization) {
+                relocalize_reference(track_ids, points);
+            }
+            return refined;
         }
 
-        // Median parallax against the reference.
-        std::vector<double> sorted = displacements;
-        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
-        last_parallax_ = sorted[sorted.size() / 2];
+        // Median parallax against the reference, selected in place on the
+        // squared displacements (the buffer is rebuilt next frame).
+        std::nth_element(parallax2_.begin(), parallax2_.begin() + matched / 2, parallax2_.end());
+        last_parallax_ = std::sqrt(static_cast<double>(parallax2_[matched / 2]));
 
-        if (static_cast<int>(ref_pts.size()) < config_.min_correspondences ||
+        if (static_cast<int>(matched) < config_.min_correspondences ||
             last_parallax_ < config_.min_parallax_px) {
-            return false;  // Keep accumulating baseline.
+            return refined;  // Keep accumulating baseline.
+        }
+        if (last_parallax_ < retry_parallax_) {
+            // The last attempt on this reference failed; fitting again with
+            // barely more baseline would fail the same way.
+            if (last_parallax_ > config_.force_keyframe_px) {
+                set_reference(track_ids, points, image);
+            }
+            return refined;
         }
 
-        ReconstructionResult result = reconstructor_.reconstruct(ref_pts, cur_pts);
+        scratch_.reset();
+        ReconstructionResult result = reconstructor_.reconstruct(ref_pts_, cur_pts_, &scratch_);
         last_result_ = result;
 
         if (result.success) {
-            cloud_ = result.points;
-            has_cloud_ = true;
-            set_reference(track_ids, points);  // Promote current frame to keyframe.
+            integrate(result, matched_ids_, ref_pts_, cur_pts_, image);
+            has_cloud_ = !cloud_.empty();
+            capture_places();
+            const int keyframe = last_delta_.keyframe.id;
+            set_reference(track_ids, points, image);  // Promote current frame to keyframe.
+            reference_keyframe_ = keyframe;
+            if (ba_) {
+                ba_->submit(map_);  // Rejected (skipped) if the last window is still running.
+            }
             return true;
         }
 
-        // Reconstruction failed despite parallax (degenerate motion). If the
-        // baseline is already very wide, advance the keyframe anyway to recover.
+        // Reconstruction failed despite parallax (degenerate motion, e.g. a
+        // rotation the homography explained). Back off until the baseline grows.
+        // If it is already very wide, advance the keyframe anyway to recover;
+        // the new reference keeps the last known pose until it is chained again.
+        retry_parallax_ = last_parallax_ * config_.retry_parallax_growth;
         if (last_parallax_ > config_.force_keyframe_px) {
-            set_reference(track_ids, points);
+            set_reference(track_ids, points, image);
         }
-        return false;
+        return refined;
+    }
+
+    void IncrementalMapper::wait_for_refinement() {
+        if (ba_) {
+            ba_->wait_idle();
+        }
+    }
+
+    bool IncrementalMapper::load_map(const MapFile& file) {
+        reset();
+        if (!file.restore(map_)) {
+            return false;
+        }
+        for (const Landmark& lm : map_.landmarks()) {
+            cloud_changes_.push_back(cloud_.size());
+            cloud_.push_back(to_cv_point(lm.position));
+        }
+        has_cloud_ = !cloud_.empty();
+        capture_places();
+        return true;
     }
 
     void IncrementalMapper::reset() {
+        // Drain any in-flight refinement so a stale result never lands on the new map.
+        if (ba_) {
+            MapRefinement stale;
+            ba_->wait_idle();
+            ba_->poll(stale);
+        }
+        if (loop_) {
+            // A fresh closer: its place index and loops belong to the old map.
+            loop_ = std::make_unique<LoopCloser>(config_.vocabulary, config_.loop);
+        }
         reference_.clear();
+        reference_image_.release();
         has_reference_ = false;
+        reference_pose_ = geometry::Pose{};
+        reference_keyframe_ = -1;
+        last_scale_ = 1.0;
+        loop_closures_ = 0;
+        relocalizations_ = 0;
+        places_.reset();
+        map_.clear();
+        last_delta_ = MapDelta{};
         cloud_.clear();
+        cloud_changes_.clear();
         has_cloud_ = false;
         last_parallax_ = 0.0;
+        retry_parallax_ = 0.0;
         last_result_ = ReconstructionResult{};
     }
 
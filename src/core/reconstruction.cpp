@@ -1,6 +1,11 @@
 #include "core/reconstruction.h"
 
 #include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "core/geometry.h"
 
@@ -18,17 +23,174 @@ namespace ar_slam {
             return out;
         }
 
+        cv::Matx33d to_matx33(const cv::Mat& m) {
+            cv::Matx33d out;
+            for (int i = 0; i < 3; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                    out(i, j) = m.at<double>(i, j);
+                }
+            }
+            return out;
+        }
+
+        // 95% chi-square bounds for one and two degrees of freedom.
+        constexpr double kChi2Dof1 = 3.841;
+        constexpr double kChi2Dof2 = 5.991;
+
+        // Squared distance from b to the transfer of a through H.
+        double transfer_error(const cv::Matx33d& H, const cv::Point2f& a, const cv::Point2f& b) {
+            const double w = H(2, 0) * a.x + H(2, 1) * a.y + H(2, 2);
+            if (std::fabs(w) < 1e-12) {
+                return 1e12;
+            }
+            const double du = (H(0, 0) * a.x + H(0, 1) * a.y + H(0, 2)) / w - b.x;
+            const double dv = (H(1, 0) * a.x + H(1, 1) * a.y + H(1, 2)) / w - b.y;
+            return du * du + dv * dv;
+        }
+
+        // Model scores in the style of ORB-SLAM's initializer: every error under
+        // the chi-square bound earns its margin, so both inlier count and fit
+        // quality count. H is scored on the transfer error in both images.
+        double score_homography(const cv::Matx33d& H,
+                                const std::vector<cv::Point2f>& pts1,
+                                const std::vector<cv::Point2f>& pts2,
+                                double sigma) {
+            const cv::Matx33d H_inv = H.inv();
+            const double inv_var = 1.0 / (sigma * sigma);
+            double score = 0.0;
+            for (size_t i = 0; i < pts1.size(); ++i) {
+                const double c1 = transfer_error(H, pts1[i], pts2[i]) * inv_var;
+                const double c2 = transfer_error(H_inv, pts2[i], pts1[i]) * inv_var;
+                score += std::max(0.0, kChi2Dof2 - c1) + std::max(0.0, kChi2Dof2 - c2);
+            }
+            return score;
+        }
+
+        // E is scored on the Sampson error of F = K^-T E K^-1. It has one degree
+        // of freedom, so it is gated at the 1-dof bound, and the margin is
+        // counted for both images so a point earns as much under E as under H.
+        double score_essential(const cv::Matx33d& F,
+                               const std::vector<cv::Point2f>& pts1,
+                               const std::vector<cv::Point2f>& pts2,
+                               double sigma) {
+            const double inv_var = 1.0 / (sigma * sigma);
+            double score = 0.0;
+            for (size_t i = 0; i < pts1.size(); ++i) {
+                const double u1 = pts1[i].x, v1 = pts1[i].y;
+                const double u2 = pts2[i].x, v2 = pts2[i].y;
+                const double l0 = F(0, 0) * u1 + F(0, 1) * v1 + F(0, 2);  // F x1
+                const double l1 = F(1, 0) * u1 + F(1, 1) * v1 + F(1, 2);
+                const double l2 = F(2, 0) * u1 + F(2, 1) * v1 + F(2, 2);
+                const double m0 = F(0, 0) * u2 + F(1, 0) * v2 + F(2, 0);  // F^T x2
+                const double m1 = F(0, 1) * u2 + F(1, 1) * v2 + F(2, 1);
+                const double e = u2 * l0 + v2 * l1 + l2;
+                const double den = l0 * l0 + l1 * l1 + m0 * m0 + m1 * m1;
+                const double chi = den > 1e-18 ? e * e / den * inv_var : 1e12;
+                score += chi < kChi2Dof1 ? 2.0 * (kChi2Dof2 - chi) : 0.0;
+            }
+            return score;
+        }
+
     }  // namespace
 
+    /**
+     * @brief Fits reconstruct()'s homography on one long-lived thread.
+     *
+     * Starting a thread per call cost more than the RANSAC it overlapped on
+     * small inputs. A job only points at the caller's buffers, which stay alive
+     * until wait() returns.
+     */
+    class TwoViewReconstruction::HomographyWorker {
+    public:
+        struct Job {
+            const std::vector<cv::Point2f>* pts1 = nullptr;
+            const std::vector<cv::Point2f>* pts2 = nullptr;
+            double threshold = 0.0;
+            double confidence = 0.0;
+            cv::Mat* H = nullptr;
+            std::vector<unsigned char>* mask = nullptr;
+        };
+
+        HomographyWorker() : thread_([this] { run(); }) {}
+
+        ~HomographyWorker() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            thread_.join();
+        }
+
+        /// Hand @p job to the worker; false if it is busy with another caller's.
+        bool start(const Job& job) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (busy_) {
+                    return false;
+                }
+                job_ = job;
+                busy_ = true;
+            }
+            cv_.notify_all();
+            return true;
+        }
+
+        /// Block until the job handed to start() has finished.
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return !busy_; });
+        }
+
+        static void fit(const Job& job) {
+            *job.H = cv::findHomography(*job.pts1, *job.pts2, cv::RANSAC, job.threshold,
+                                        *job.mask, 2000, job.confidence);
+        }
+
+    private:
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                cv_.wait(lock, [this] { return stop_ || busy_; });
+                if (stop_) {
+                    return;
+                }
+                // The job is only touched by this thread until busy_ is cleared.
+                lock.unlock();
+                fit(job_);
+                lock.lock();
+                busy_ = false;
+                cv_.notify_all();
+            }
+        }
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        Job job_;
+        bool busy_ = false;
+        bool stop_ = false;
+        std::thread thread_;  // Last: starts once the state above exists.
+    };
+
     TwoViewReconstruction::TwoViewReconstruction(const cv::Matx33d& K)
         : TwoViewReconstruction(K, Config{}) {}
 
     TwoViewReconstruction::TwoViewReconstruction(const cv::Matx33d& K, const Config& config)
-        : K_(K), config_(config) {}
+        : K_(K), config_(config) {
+        if (config_.fit_homography && std::thread::hardware_concurrency() > 1) {
+            worker_ = std::make_unique<HomographyWorker>();
+        }
+    }
+
+    TwoViewReconstruction::~TwoViewReconstruction() = default;
 
     ReconstructionResult TwoViewReconstruction::reconstruct(
-        const std::vector<cv::Point2f>& pts1, const std::vector<cv::Point2f>& pts2) const {
+        const std::vector<cv::Point2f>& pts1, const std::vector<cv::Point2f>& pts2,
+        std::pmr::memory_resource* scratch) const {
         ReconstructionResult result;
+        if (scratch == nullptr) {
+            scratch = std::pmr::get_default_resource();
+        }
 
         if (pts1.size() != pts2.size() ||
             static_cast<int>(pts1.size()) < config_.min_correspondences) {
@@ -37,28 +199,74 @@ namespace ar_slam {
 
         const cv::Mat K = cv::Mat(K_);
 
-        // 1. Robustly estimate the essential matrix.
+        // 1. Fit a homography on the worker while the essential matrix is fitted
+        //    and decomposed (cheirality) on this thread. With one core, or while
+        //    another caller holds the worker, H is fitted here afterwards.
+        cv::Mat H;
+        std::vector<unsigned char> h_mask;
+        HomographyWorker::Job homography;
+        homography.pts1 = &pts1;
+        homography.pts2 = &pts2;
+        homography.threshold = config_.ransac_threshold * std::sqrt(kChi2Dof2);
+        homography.confidence = config_.ransac_prob;
+        homography.H = &H;
+        homography.mask = &h_mask;
+        const bool h_on_worker = config_.fit_homography && worker_ && worker_->start(homography);
         cv::Mat inlier_mask;
         cv::Mat E = cv::findEssentialMat(pts1, pts2, K, cv::RANSAC, config_.ransac_prob,
                                          config_.ransac_threshold, inlier_mask);
-        if (E.rows != 3 || E.cols != 3) {
-            return result;  // Degenerate configuration (e.g. pure rotation, no parallax).
-        }
-
-        // 2. Decompose into relative pose using the cheirality constraint.
         cv::Mat R, t;
-        int pose_inliers = cv::recoverPose(E, pts1, pts2, K, R, t, inlier_mask);
-        if (pose_inliers <= 0) {
+        int pose_inliers = 0;
+        if (E.rows == 3 && E.cols == 3) {  // Else degenerate (e.g. pure rotation, no parallax).
+            pose_inliers = cv::recoverPose(E, pts1, pts2, K, R, t, inlier_mask);
+        }
+        if (h_on_worker) {
+            worker_->wait();
+        } else if (config_.fit_homography) {
+            HomographyWorker::fit(homography);
+        }
+        const bool have_e = pose_inliers > 0;
+        const bool have_h = H.rows == 3 && H.cols == 3;
+        if (!have_e && !have_h) {
             return result;
         }
 
-        cv::Matx33d Rx;
-        cv::Vec3d tx;
-        for (int i = 0; i < 3; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                Rx(i, j) = R.at<double>(i, j);
+        // 2. Select the model: H wins when it explains the correspondences about
+        //    as well as E, i.e. the scene is planar or the motion is a rotation.
+        cv::Matx33d Rx = cv::Matx33d::eye();
+        cv::Vec3d tx(0, 0, 0);
+        if (have_e) {
+            Rx = to_matx33(R);
+            for (int i = 0; i < 3; ++i) {
+                tx(i) = t.at<double>(i, 0);
+            }
+        }
+        double score_h = 0.0;
+        double score_e = 0.0;
+        if (have_h) {
+            score_h = score_homography(to_matx33(H), pts1, pts2, config_.ransac_threshold);
+        }
+        if (have_e) {
+            const cv::Matx33d K_inv = K_.inv();
+            const cv::Matx33d F = K_inv.t() * to_matx33(E) * K_inv;
+            score_e = score_essential(F, pts1, pts2, config_.ransac_threshold);
+        }
+        result.homography_score_ratio =
+            score_h + score_e > 0.0 ? score_h / (score_h + score_e) : 0.0;
+
+        std::pmr::vector<unsigned char> mask(pts1.size(), 1, scratch);
+        if (have_h && (!have_e || result.homography_score_ratio > config_.homography_ratio)) {
+            result.model = TwoViewModel::kHomography;
+            const cv::Matx33d R_e = Rx;
+            if (!pose_from_homography(H, pts1, pts2, h_mask, have_e ? &R_e : nullptr, Rx, tx, mask,
+                                      result.low_parallax)) {
+                return result;
+            }
+        } else {
+            result.model = TwoViewModel::kEssential;
+            for (size_t i = 0; i < mask.size() && !inlier_mask.empty(); ++i) {
+                mask[i] = inlier_mask.at<uchar>(static_cast<int>(i)) != 0 ? 1 : 0;
             }
-            tx(i) = t.at<double>(i, 0);
         }
 
         // 3. Build projection matrices and triangulate the surviving inliers.
@@ -69,31 +277,65 @@ namespace ar_slam {
             geometry::make_projection(Kg, geometry::Mat3::identity(), {0, 0, 0});
         const geometry::Mat34 P2 = geometry::make_projection(Kg, Rg, tg);
 
-        result.points.reserve(pose_inliers);
-        result.point_indices.reserve(pose_inliers);
-
+        // DLT gives a starting point per inlier; all of them are then refined
+        // together on reprojection error before the depth checks.
+        std::pmr::vector<int> indices(scratch);
+        std::pmr::vector<geometry::Vec3> points(scratch);
+        std::pmr::vector<double> u(scratch), v(scratch);
+        indices.reserve(pts1.size());
+        points.reserve(pts1.size());
         for (size_t i = 0; i < pts1.size(); ++i) {
-            if (!inlier_mask.empty() && inlier_mask.at<uchar>(static_cast<int>(i)) == 0) {
+            if (mask[i] == 0) {
                 continue;
             }
-
             auto tri = geometry::triangulate(P1, P2, pts1[i].x, pts1[i].y, pts2[i].x, pts2[i].y);
             if (!tri.valid) {
                 continue;
             }
+            indices.push_back(static_cast<int>(i));
+            points.push_back(tri.point);
+        }
+
+        const size_t n = points.size();
+        std::pmr::vector<geometry::PointRefinement> refined(n, scratch);
+        if (config_.refine_iterations > 0 && n > 0) {
+            u.resize(2 * n);
+            v.resize(2 * n);
+            for (size_t k = 0; k < n; ++k) {
+                u[k] = pts1[indices[k]].x;
+                v[k] = pts1[indices[k]].y;
+                u[n + k] = pts2[indices[k]].x;
+                v[n + k] = pts2[indices[k]].y;
+            }
+            const geometry::Mat34 cameras[2] = {P1, P2};
+            geometry::PointRefineOptions options;
+            options.iterations = config_.refine_iterations;
+            geometry::refine_points(cameras, 2, u.data(), v.data(), n, points.data(),
+                                    refined.data(), options);
+        }
+
+        result.points.reserve(n);
+        result.point_indices.reserve(n);
+        for (size_t k = 0; k < n; ++k) {
+            const geometry::Vec3& X = points[k];
 
             // Cheirality: the point must lie in front of both cameras.
-            const double z1 = tri.point[2];
-            const double z2 =
-                Rx(2, 0) * tri.point[0] + Rx(2, 1) * tri.point[1] + Rx(2, 2) * tri.point[2] + tx(2);
+            const double z1 = X[2];
+            const double z2 = Rx(2, 0) * X[0] + Rx(2, 1) * X[1] + Rx(2, 2) * X[2] + tx(2);
             if (z1 <= 0.0 || z2 <= 0.0 || z1 > config_.max_depth) {
                 continue;
             }
+            // Refined points are kept by how well they are determined, not by
+            // depth alone: a far point seen with enough parallax stays.
+            if (config_.refine_iterations > 0 &&
+                (!refined[k].valid || refined[k].rms > config_.max_reprojection_rms ||
+                 std::sqrt(refined[k].covariance[2][2]) > config_.max_depth_sigma * z1)) {
+                continue;
+            }
 
-            result.points.emplace_back(static_cast<float>(tri.point[0]),
-                                       static_cast<float>(tri.point[1]),
-                                       static_cast<float>(tri.point[2]));
-            result.point_indices.push_back(static_cast<int>(i));
+            result.points.emplace_back(static_cast<float>(X[0]), static_cast<float>(X[1]),
+                                       static_cast<float>(X[2]));
+            result.point_indices.push_back(indices[k]);
         }
 
         result.R = Rx;
@@ -105,4 +347,126 @@ namespace ar_slam {
         return result;
     }
 
+    bool TwoViewReconstruction::pose_from_homography(const cv::Mat& H,
+                                                     const std::vector<cv::Point2f>& pts1,
+                                                     const std::vector<cv::Point2f>& pts2,
+                                                     const std::vector<unsigned char>& inliers,
+                                                     const cv::Matx33d* essential_R,
+                                                     cv::Matx33d& R,
+                                                     cv::Vec3d& t,
+                                                     std::pmr::vector<unsigned char>& good,
+                                                     bool& low_parallax) const {
+        std::pmr::memory_resource* scratch = good.get_allocator().resource();
+        std::vector<cv::Mat> rotations, translations, normals;
+        const int solutions =
+            cv::decomposeHomographyMat(H, cv::Mat(K_), rotations, translations, normals);
+
+        // Triangulate the inliers under every decomposition and keep the points
+        // in front of both cameras, with the angle between their two rays.
+        const geometry::Mat3 Kg = to_geom_mat3(K_);
+        const geometry::Mat34 P1 =
+            geometry::make_projection(Kg, geometry::Mat3::identity(), {0, 0, 0});
+        struct Candidate {
+            cv::Matx33d R;
+            cv::Vec3d t;
+            std::pmr::vector<unsigned char> good;
+            std::pmr::vector<double> angles;
+        };
+        std::pmr::vector<Candidate> candidates(scratch);
+        size_t best = 0;
+        for (int s = 0; s < solutions; ++s) {
+            Candidate c{cv::Matx33d::eye(), cv::Vec3d(0, 0, 0),
+                        std::pmr::vector<unsigned char>(scratch),
+                        std::pmr::vector<double>(scratch)};
+            c.R = to_matx33(rotations[s]);
+            double norm = 0.0;
+            for (int i = 0; i < 3; ++i) {
+                c.t(i) = translations[s].at<double>(i, 0);
+                norm += c.t(i) * c.t(i);
+            }
+            norm = std::sqrt(norm);
+            if (norm < 1e-9) {
+                low_parallax = true;  // An exact rotation: H = K R K^-1.
+                return false;
+            }
+            c.t = c.t * (1.0 / norm);  // t/d from the decomposition; only its direction is known.
+
+            const geometry::Mat3 Rg = to_geom_mat3(c.R);
+            const geometry::Vec3 tg{c.t(0), c.t(1), c.t(2)};
+            const geometry::Mat34 P2 = geometry::make_projection(Kg, Rg, tg);
+            geometry::Pose pose;
+            pose.R = Rg;
+            pose.t = tg;
+            const geometry::Vec3 C2 = pose.center();
+            c.good.assign(pts1.size(), 0);
+            for (size_t i = 0; i < pts1.size(); ++i) {
+                if (i < inliers.size() && inliers[i] == 0) {
+                    continue;
+                }
+                const auto tri =
+                    geometry::triangulate(P1, P2, pts1[i].x, pts1[i].y, pts2[i].x, pts2[i].y);
+                const geometry::Vec3& X = tri.point;
+                if (!tri.valid || X[2] <= 0.0 || pose.transform(X)[2] <= 0.0) {
+                    continue;
+                }
+                const geometry::Vec3 r2{X[0] - C2[0], X[1] - C2[1], X[2] - C2[2]};
+                const double dot = X[0] * r2[0] + X[1] * r2[1] + X[2] * r2[2];
+                const double len = std::sqrt((X[0] * X[0] + X[1] * X[1] + X[2] * X[2]) *
+                                             (r2[0] * r2[0] + r2[1] * r2[1] + r2[2] * r2[2]));
+                c.good[i] = 1;
+                c.angles.push_back(std::acos(std::min(1.0, dot / len)) * 180.0 / CV_PI);
+            }
+            if (candidates.empty() || c.angles.size() > candidates[best].angles.size()) {
+                best = candidates.size();
+            }
+            candidates.push_back(std::move(c));
+        }
+        if (candidates.empty() ||
+            static_cast<int>(candidates[best].angles.size()) < config_.min_correspondences / 2) {
+            return false;
+        }
+
+        // A planar scene usually leaves two decompositions that place every
+        // point in front; the essential matrix, fitted alongside, breaks the tie
+        // by rotation. Without it the pose is ambiguous.
+        const size_t count = candidates[best].angles.size();
+        int tied = 0;
+        double best_agreement = -1e9;
+        for (size_t s = 0; s < candidates.size(); ++s) {
+            if (candidates[s].angles.size() < 0.9 * count) {
+                continue;
+            }
+            ++tied;
+            if (essential_R != nullptr) {
+                const cv::Matx33d& Ra = candidates[s].R;
+                double agreement = 0.0;  // trace(R_e^T R): 3 when identical.
+                for (int i = 0; i < 3; ++i) {
+                    for (int j = 0; j < 3; ++j) {
+                        agreement += (*essential_R)(i, j) * Ra(i, j);
+                    }
+                }
+                if (agreement > best_agreement) {
+                    best_agreement = agreement;
+                    best = s;
+                }
+            }
+        }
+        if (tied > 1 && essential_R == nullptr) {
+            return false;
+        }
+
+        // Rays that barely diverge mean the camera mostly rotated: no usable
+        // structure yet, whatever the decomposition.
+        std::pmr::vector<double>& angles = candidates[best].angles;
+        std::nth_element(angles.begin(), angles.begin() + angles.size() / 2, angles.end());
+        if (angles[angles.size() / 2] < config_.min_triangulation_deg) {
+            low_parallax = true;
+            return false;
+        }
+        R = candidates[best].R;
+        t = candidates[best].t;
+        good = std::move(candidates[best].good);
+        return true;
+    }
+
 }  // namespace ar_slam
@@ -0,0 +1,157 @@
+#include "core/relocalizer.h"
+
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+#include "core/vocabulary.h"
+
+namespace ar_slam {
+
+    Relocalizer::Relocalizer(const cv::Matx33d& K) : Relocalizer(K, Config{}) {}
+
+    Relocalizer::Relocalizer(const cv::Matx33d& K, const Config& config) : K_(K), config_(config) {}
+
+    std::shared_ptr<const RelocalizationMap> Relocalizer::capture(const LandmarkMap& map,
+                                                                  std::size_t recent) {
+        auto out = std::make_shared<RelocalizationMap>();
+        const std::vector<MapKeyframe>& keyframes = map.keyframes();
+        std::vector<uint8_t> rows;
+        for (auto it = keyframes.rbegin(); it != keyframes.rend() && out->keyframes.size() < recent;
+             ++it) {
+            if (it->descriptors.empty()) {
+                continue;
+            }
+            out->keyframes.push_back(it->id);
+            for (std::size_t i = 0; i < it->observations.size(); ++i) {
+                const uint8_t* d = it->descriptor(i);
+                const Landmark* lm = map.find(it->observations[i].landmark);
+                if (d == nullptr || lm == nullptr ||
+                    std::all_of(d, d + kDescriptorBytes, [](uint8_t b) { return b == 0; })) {
+                    continue;  // Padding row: no descriptor for this observation.
+                }
+                out->landmarks.push_back(lm->id);
+                out->points.emplace_back(static_cast<float>(lm->position[0]),
+                                         static_cast<float>(lm->position[1]),
+                                         static_cast<float>(lm->position[2]));
+                rows.insert(rows.end(), d, d + kDescriptorBytes);
+            }
+        }
+        if (out->landmarks.empty()) {
+            return nullptr;
+        }
+        out->descriptors.create(static_cast<int>(out->landmarks.size()),
+                                static_cast<int>(kDescriptorBytes), CV_8U);
+        for (int r = 0; r < out->descriptors.rows; ++r) {
+            std::memcpy(out->descriptors.ptr<uint8_t>(r), rows.data() + r * kDescriptorBytes,
+                        kDescriptorBytes);
+        }
+        return out;
+    }
+
+    bool Relocalizer::solve_pnp(const cv::Matx33d& K,
+                                const std::vector<cv::Point3f>& points,
+                                const std::vector<cv::Point2f>& pixels,
+                                const Config& config,
+                                geometry::Pose& pose,
+                                std::vector<int>& inliers) {
+        inliers.clear();
+        if (points.size() != pixels.size() || static_cast<int>(points.size()) < 4 ||
+            static_cast<int>(points.size()) < config.min_inliers) {
+            return false;
+        }
+        cv::Mat rvec, tvec;
+        const bool ok = cv::solvePnPRansac(points, pixels, cv::Mat(K), cv::noArray(), rvec, tvec,
+                                           false, config.ransac_iterations, config.reprojection_px,
+                                           0.99, inliers, cv::SOLVEPNP_EPNP);
+        if (!ok || static_cast<int>(inliers.size()) < config.min_inliers) {
+            return false;
+        }
+        cv::Mat R;
+        cv::Rodrigues(rvec, R);
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                pose.R.m[i][j] = R.at<double>(i, j);
+            }
+            pose.t[i] = tvec.at<double>(i);
+        }
+        return true;
+    }
+
+    RelocalizationResult Relocalizer::relocalize(const std::vector<cv::KeyPoint>& keypoints,
+                                                 const cv::Mat& descriptors) const {
+        const auto start = std::chrono::steady_clock::now();
+        RelocalizationResult result;
+        result.track_ids.assign(keypoints.size(), -1);
+        if (!has_map() || descriptors.rows != static_cast<int>(keypoints.size()) ||
+            descriptors.cols != static_cast<int>(kDescriptorBytes)) {
+            return result;
+        }
+
+        // Best row per keypoint; the ratio test compares against the best row of a
+        // *different* landmark, since a landmark seen by several keyframes has
+        // several near-identical rows. Each landmark keeps its closest keypoint.
+        struct Match {
+            int keypoint;
+            int row;
+            int distance;
+        };
+        std::unordered_map<int, Match> by_landmark;
+        const RelocalizationMap& map = *map_;
+        for (int k = 0; k < descriptors.rows; ++k) {
+            const uint8_t* d = descriptors.ptr<uint8_t>(k);
+            int best = 256, second = 256, best_row = -1;
+            for (int r = 0; r < map.descriptors.rows; ++r) {
+                const int dist = bow_detail::hamming(d, map.descriptors.ptr<uint8_t>(r));
+                if (dist < best) {
+                    if (best_row < 0 || map.landmarks[r] != map.landmarks[best_row]) {
+                        second = best;
+                    }
+                    best = dist;
+                    best_row = r;
+                } else if (dist < second && map.landmarks[r] != map.landmarks[best_row]) {
+                    second = dist;
+                }
+            }
+            if (best_row < 0 || best > config_.max_hamming || best >= config_.ratio_test * second) {
+                continue;
+            }
+            auto it = by_landmark.find(map.landmarks[best_row]);
+            if (it == by_landmark.end()) {
+                by_landmark.emplace(map.landmarks[best_row], Match{k, best_row, best});
+            } else if (best < it->second.distance) {
+                it->second = Match{k, best_row, best};
+            }
+        }
+
+        std::vector<cv::Point3f> points;
+        std::vector<cv::Point2f> pixels;
+        std::vector<Match> matches;
+        points.reserve(by_landmark.size());
+        pixels.reserve(by_landmark.size());
+        matches.reserve(by_landmark.size());
+        for (const auto& entry : by_landmark) {
+            matches.push_back(entry.second);
+            points.push_back(map.points[entry.second.row]);
+            pixels.push_back(keypoints[entry.second.keypoint].pt);
+        }
+        result.matches = static_cast<int>(matches.size());
+
+        std::vector<int> inliers;
+        if (result.matches >= config_.min_matches &&
+            solve_pnp(K_, points, pixels, config_, result.pose, inliers)) {
+            result.success = true;
+            result.inliers = static_cast<int>(inliers.size());
+            for (int i : inliers) {
+                result.track_ids[matches[i].keypoint] = map.landmarks[matches[i].row];
+            }
+        }
+        result.time_ms = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        return result;
+    }
+
+}  // namespace ar_slam
@@ -0,0 +1,141 @@
+// Offline trainer for the bag-of-words vocabulary used by place recognition.
+//
+// Extracts ORB descriptors from a set of training images (files and/or
+// directories) and writes a k-majority vocabulary tree in the mmap-able binary
+// format read by ar_slam::Vocabulary::load().
+//
+//   train_vocabulary [--k 10] [--depth 6] [--features 1000] out.arbv images...
+
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "core/vocabulary.h"
+
+namespace {
+
+    void usage() {
+        std::cerr << "Usage: train_vocabulary [--k N] [--depth N] [--features N] "
+                     "<output.arbv> <image|directory>..."
+                  << std::endl;
+    }
+
+    // Expand directories into the images they contain.
+    std::vector<std::string> collect_images(const std::vector<std::string>& inputs) {
+        std::vector<std::string> images;
+        for (const auto& input : inputs) {
+            if (std::filesystem::is_directory(input)) {
+                for (const char* pattern : {"*.png", "*.jpg", "*.jpeg", "*.pgm", "*.bmp"}) {
+                    std::vector<std::string> found;
+                    cv::glob(input + "/" + pattern, found, false);
+                    images.insert(images.end(), found.begin(), found.end());
+                }
+            } else {
+                images.push_back(input);
+            }
+        }
+        return images;
+    }
+
+    // Parse a whole decimal int; false on anything else (or out of range).
+    bool parse_int(const char* text, int& value) {
+        char* end = nullptr;
+        errno = 0;
+        const long parsed = std::strtol(text, &end, 10);
+        if (end == text || *end != '\0' || errno == ERANGE || parsed < INT_MIN ||
+            parsed > INT_MAX) {
+            return false;
+        }
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int k = 10;
+    int depth = 6;
+    int features = 1000;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "--k" || arg == "--depth" || arg == "--features") && i + 1 < argc) {
+            int& value = arg == "--k" ? k : arg == "--depth" ? depth : features;
+            if (!parse_int(argv[++i], value)) {
+                std::cerr << "Not a number for " << arg << ": " << argv[i] << std::endl;
+                usage();
+                return 1;
+            }
+        } else if (arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() < 2 || k < 2 || depth < 1 || features < 1) {
+        usage();
+        return 1;
+    }
+
+    const std::string output = positional.front();
+    const std::vector<std::string> images =
+        collect_images(std::vector<std::string>(positional.begin() + 1, positional.end()));
+
+    // Same detector settings as Frame::extract_features, so training and runtime
+    // descriptors come from the same distribution.
+    cv::Ptr<cv::ORB> orb = cv::ORB::create(features, 1.2f, 8, 31, 0, 2, cv::ORB::HARRIS_SCORE);
+    std::vector<std::vector<uint8_t>> training;
+    std::size_t total = 0;
+    for (const auto& path : images) {
+        cv::Mat gray = cv::imread(path, cv::IMREAD_GRAYSCALE);
+        if (gray.empty()) {
+            std::cerr << "Skipping unreadable image: " << path << std::endl;
+            continue;
+        }
+        std::vector<cv::KeyPoint> keypoints;
+        cv::Mat descriptors;
+        orb->detectAndCompute(gray, cv::noArray(), keypoints, descriptors);
+        if (descriptors.empty()) {
+            continue;
+        }
+        if (descriptors.type() != CV_8U ||
+            descriptors.cols != static_cast<int>(ar_slam::kDescriptorBytes)) {
+            std::cerr << "Unexpected descriptor layout in " << path << std::endl;
+            return 1;
+        }
+        std::vector<uint8_t> rows(descriptors.rows * ar_slam::kDescriptorBytes);
+        for (int r = 0; r < descriptors.rows; ++r) {
+            std::memcpy(rows.data() + r * ar_slam::kDescriptorBytes, descriptors.ptr<uint8_t>(r),
+                        ar_slam::kDescriptorBytes);
+        }
+        training.push_back(std::move(rows));
+        total += descriptors.rows;
+    }
+    if (training.empty()) {
+        std::cerr << "No descriptors extracted from " << images.size() << " input(s)" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Training k=" << k << " depth=" << depth << " on " << total
+              << " descriptors from " << training.size() << " images..." << std::endl;
+    auto start = std::chrono::high_resolution_clock::now();
+    const ar_slam::Vocabulary vocabulary = ar_slam::Vocabulary::train(training, k, depth);
+    double seconds =
+        std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Built " << vocabulary.word_count() << " words (" << vocabulary.node_count()
+              << " nodes) in " << seconds << " s" << std::endl;
+
+    if (!vocabulary.save(output)) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << output << std::endl;
+    return 0;
+}
@@ -5,6 +5,8 @@
 #include <iomanip>
 #include <cmath>
 #include <opencv2/opencv.hpp>
+#include "camera/dataset_camera.h"
+#include "camera/raw_replay_camera.h"
 #include "core/frame.h"
 #include "core/feature_tracker.h"
 #include "core/memory_pool.h"
@@ -312,7 +314,103 @@ void benchmark_full_pipeline() {
     std::cout << "Note: 70-80% is excellent for continuous tracking" << std::endl;
 }
 
-int main() {
+// Whole-sequence tracking on recorded imagery (TUM or EuRoC layout), replayed
+// as fast as it is consumed. Decoding runs ahead on the camera's threads, so
+// the throughput is the pipeline's; the time spent waiting on decode is shown.
+void benchmark_dataset(const std::string& path) {
+    std::cout << "=== Dataset Replay Benchmark ===" << std::endl;
+
+    ar_slam::DatasetCamera::Options options;
+    options.pacing = ar_slam::DatasetCamera::Pacing::kAsFastAsPossible;
+    options.imread_flags = cv::IMREAD_GRAYSCALE;  // What the tracker reads.
+    ar_slam::DatasetCamera camera(options);
+    ar_slam::CameraConfig config;
+    config.device_path = path;
+    if (!camera.open(config)) {
+        std::cerr << "Cannot read a TUM or EuRoC sequence at " << path << std::endl;
+        return;
+    }
+    std::cout << "Sequence: " << camera.frame_count() << " frames, recorded at "
+              << camera.get_fps() << " fps" << std::endl;
+
+    ar_slam::FeatureTracker tracker;
+    std::vector<double> pipeline_times;
+    double quality_sum = 0;
+    cv::Mat image;
+    ar_slam::Frame::Timestamp timestamp;
+
+    auto start = high_resolution_clock::now();
+    while (camera.grab_frame(image, timestamp)) {
+        BenchmarkTimer timer("pipeline", pipeline_times);
+        auto frame = std::make_shared<ar_slam::Frame>(image, timestamp);
+        quality_sum += tracker.track_features(frame).tracking_quality;
+    }
+    double seconds = duration<double>(high_resolution_clock::now() - start).count();
+
+    print_statistics("Per-frame pipeline", pipeline_times);
+    std::cout << "End-to-end: " << pipeline_times.size() / seconds << " fps over "
+              << pipeline_times.size() << " frames" << std::endl;
+    std::cout << "Waited on decode: " << camera.decode_wait_ms() << " ms";
+    if (camera.decode_failures() > 0) {
+        std::cout << " (" << camera.decode_failures() << " frames unreadable)";
+    }
+    std::cout << std::endl;
+    if (!pipeline_times.empty()) {
+        std::cout << "Average tracking quality: " << (quality_sum / pipeline_times.size() * 100)
+                  << "%" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void benchmark_recording(const std::string& path) {
+    std::cout << "=== Raw Recording Replay Benchmark ===" << std::endl;
+
+    // Frames come straight out of the mapped file: the loop times the SLAM core alone.
+    ar_slam::RawReplayCamera camera;
+    ar_slam::CameraConfig config;
+    config.device_path = path;
+    if (!camera.open(config)) {
+        std::cerr << "Cannot replay " << path << std::endl;
+        return;
+    }
+    std::cout << "Recording: " << camera.frame_count() << " frames, captured at "
+              << camera.get_fps() << " fps" << std::endl;
+
+    ar_slam::FeatureTracker tracker;
+    std::vector<double> pipeline_times;
+    double quality_sum = 0;
+
+    auto start = high_resolution_clock::now();
+    for (std::size_t i = 0; i < camera.frame_count(); ++i) {
+        BenchmarkTimer timer("pipeline", pipeline_times);
+        ar_slam::Frame::Ptr frame = camera.next_frame();
+        quality_sum += tracker.track_features(frame).tracking_quality;
+    }
+    double seconds = duration<double>(high_resolution_clock::now() - start).count();
+
+    print_statistics("Per-frame pipeline", pipeline_times);
+    std::cout << "End-to-end: " << pipeline_times.size() / seconds << " fps over "
+              << pipeline_times.size() << " frames" << std::endl;
+    if (!pipeline_times.empty()) {
+        std::cout << "Average tracking quality: " << (quality_sum / pipeline_times.size() * 100)
+                  << "%" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+    // With a path, measure on that recording alone: repeatable, real imagery. A raw
+    // recording (see RecordingCamera) replays with no decoding; anything else is
+    // read as a TUM or EuRoC sequence.
+    if (argc > 1) {
+        if (ar_slam::RawRecording().open(argv[1])) {
+            benchmark_recording(argv[1]);
+        } else {
+            benchmark_dataset(argv[1]);
+        }
+        return 0;
+    }
+
     std::cout << "=====================================" << std::endl;
     std::cout << "    AR SLAM System Benchmarks" << std::endl;
     std::cout << "    (Realistic Test Conditions)" << std::endl;
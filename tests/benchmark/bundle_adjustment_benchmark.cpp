@@ -0,0 +1,94 @@
+// Scaling benchmark for the sparse bundle adjuster.
+// Builds synthetic windows of a fixed number of cameras with a growing number of
+// points, perturbs them, and reports the cost per LM iteration. With the camera
+// count fixed, the per-observation column should stay flat: building the normal
+// equations, the Schur complement and back-substitution are all linear in the
+// number of observations.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "core/bundle_adjustment.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+
+namespace {
+
+    using artest::Lcg;
+
+    BAProblem make_window(int cams, int points, unsigned seed) {
+        Lcg rng{seed};
+        BAProblem problem;
+        problem.K = geometry::Mat3::identity();
+        problem.K.m[0][0] = problem.K.m[1][1] = 500.0;
+        problem.K.m[0][2] = 320.0;
+        problem.K.m[1][2] = 240.0;
+
+        for (int c = 0; c < cams; ++c) {
+            geometry::Pose pose;
+            pose.t = {-0.2 * c, 0.0, 0.0};
+            problem.cameras.push_back(pose);
+            problem.fixed.push_back(c < 2);
+        }
+        for (int p = 0; p < points; ++p) {
+            const double x = 3.0 * rng.uniform() + 0.1 * cams;
+            const double y = 2.0 * rng.uniform();
+            problem.points.push_back({x, y, 5.0 + 3.0 * rng.uniform()});
+        }
+        for (int c = 0; c < cams; ++c) {
+            for (int p = 0; p < points; ++p) {
+                geometry::Vec3 X = problem.cameras[c].transform(problem.points[p]);
+                problem.observations.push_back({c, p, 500.0 * X[0] / X[2] + 320.0 + rng.uniform(),
+                                                500.0 * X[1] / X[2] + 240.0 + rng.uniform()});
+            }
+        }
+        // Start away from the optimum so every iteration does real work.
+        for (int c = 2; c < cams; ++c) {
+            problem.cameras[c].t[0] += 0.02 * rng.uniform();
+        }
+        for (auto& X : problem.points) {
+            X[2] += 0.2 * rng.uniform();
+        }
+        return problem;
+    }
+
+}  // namespace
+
+int main() {
+    const int kCameras = 10;
+    const int kIterations = 5;
+    std::cout << "=== Sparse Bundle Adjustment Scaling ===" << std::endl;
+    std::cout << "Cameras per window: " << kCameras << ", LM iterations: " << kIterations
+              << std::endl
+              << std::endl;
+    std::cout << std::setw(10) << "points" << std::setw(14) << "observations" << std::setw(14)
+              << "ms/iter" << std::setw(18) << "ns/obs/iter" << std::setw(14) << "rms before"
+              << std::setw(14) << "rms after" << std::endl;
+
+    BAConfig config;
+    config.max_iterations = kIterations;
+    config.function_tolerance = 0.0;  // Always run every iteration.
+
+    for (int points = 250; points <= 16000; points *= 2) {
+        BAProblem problem = make_window(kCameras, points, 1234u + points);
+        const double num_obs = static_cast<double>(problem.observations.size());
+
+        auto start = std::chrono::high_resolution_clock::now();
+        BASummary summary = bundle_adjust(problem, config);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        const double per_iter = ms / std::max(1, summary.iterations);
+        std::cout << std::fixed << std::setprecision(2) << std::setw(10) << points
+                  << std::setw(14) << static_cast<long>(num_obs) << std::setw(14) << per_iter
+                  << std::setw(18) << per_iter * 1e6 / num_obs << std::setw(14)
+                  << std::sqrt(summary.initial_cost / num_obs) << std::setw(14)
+                  << std::sqrt(summary.final_cost / num_obs) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Save/load benchmark for the memory-mapped map file.
+// Builds synthetic maps of 100k and 1M landmarks (100 new landmarks per
+// keyframe, each keyframe re-observing 100 of the previous one's, with a
+// descriptor per observation), then times writing a snapshot, opening it with
+// and without checksum verification, reading every landmark position in
+// place, restoring an editable LandmarkMap, and streaming keyframes as
+// appended segments.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "core/map_file.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+
+namespace {
+
+    using artest::Lcg;
+
+    using Clock = std::chrono::steady_clock;
+
+    double ms_since(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void add_keyframe(LandmarkMap& map, Lcg& rng) {
+        const int kf = map.next_keyframe_id();
+        geometry::Pose pose;
+        pose.t = {0.01 * kf, 0.0, 0.0};
+        std::vector<int> ids;
+        std::vector<geometry::Vec3> points;
+        for (int j = 0; j < 100; ++j) {
+            ids.push_back(kf * 100 + j);
+            points.push_back({rng.uniform(-20.0, 20.0), rng.uniform(-2.0, 2.0),
+                              rng.uniform(-20.0, 20.0)});
+        }
+        for (int j = 0; j < 100 && kf > 0; ++j) {
+            const int id = (kf - 1) * 100 + j;
+            ids.push_back(id);
+            points.push_back(map.find(id)->position);
+        }
+        std::vector<MapObservation> observations;
+        std::vector<uint8_t> descriptors;
+        for (int id : ids) {
+            observations.push_back({kf, id, rng.uniform(0.0, 640.0), rng.uniform(0.0, 480.0)});
+            for (std::size_t b = 0; b < kDescriptorBytes; ++b) {
+                descriptors.push_back(static_cast<uint8_t>(rng.next()));
+            }
+        }
+        map.add_keyframe(pose, ids, points, observations, descriptors);
+    }
+
+    void run(int landmarks) {
+        const std::string path = "map_file_benchmark.armp";
+        Lcg rng{static_cast<uint32_t>(landmarks)};
+        LandmarkMap map;
+        while (static_cast<int>(map.size()) < landmarks) {
+            add_keyframe(map, rng);
+        }
+
+        auto start = Clock::now();
+        MapWriter writer;
+        writer.create(path);
+        writer.append(map);
+        const double save_ms = ms_since(start);
+        const double megabytes = writer.size() / 1e6;
+
+        MapFile file;
+        start = Clock::now();
+        file.open(path, false);
+        const double open_ms = ms_since(start);
+        start = Clock::now();
+        double sum = 0.0;
+        for (const geometry::Vec3& p : file.snapshot()->positions) {
+            sum += p[0];
+        }
+        const double read_ms = ms_since(start);
+        file.close();
+
+        start = Clock::now();
+        file.open(path, true);
+        const double verify_ms = ms_since(start);
+        LandmarkMap restored;
+        start = Clock::now();
+        file.restore(restored);
+        const double restore_ms = ms_since(start);
+        file.close();
+
+        const int kAppends = 20;
+        const uint64_t before = writer.size();
+        start = Clock::now();
+        for (int i = 0; i < kAppends; ++i) {
+            add_keyframe(map, rng);
+            writer.append(map);
+        }
+        const double append_ms = ms_since(start) / kAppends;
+        const double append_kb = (writer.size() - before) / 1e3 / kAppends;
+        writer.close();
+        std::remove(path.c_str());
+
+        std::cout << std::setw(9) << landmarks << std::setw(7) << map.keyframes().size()
+                  << std::fixed << std::setprecision(1) << std::setw(9) << megabytes
+                  << std::setw(9) << save_ms << std::setw(8) << std::setprecision(2) << open_ms
+                  << std::setw(9) << std::setprecision(1) << read_ms << std::setw(9) << verify_ms
+                  << std::setw(10) << restore_ms << std::setw(9) << append_ms << std::setw(9)
+                  << append_kb << (sum == 0.0 ? " (empty)" : "") << std::endl;
+    }
+
+}  // namespace
+
+int main() {
+    std::cout << "=== Map File Save/Load ===" << std::endl;
+    std::cout << "Times in ms; open maps without checksums, read sums every position in place,"
+              << std::endl
+              << "verify opens with checksums, append is one keyframe per segment" << std::endl
+              << std::endl;
+    std::cout << std::setw(9) << "landmks" << std::setw(7) << "kfs" << std::setw(9) << "MB"
+              << std::setw(9) << "save" << std::setw(8) << "open" << std::setw(9) << "read"
+              << std::setw(9) << "verify" << std::setw(10) << "restore" << std::setw(9)
+              << "append" << std::setw(9) << "KB/app" << std::endl;
+    for (int n : {100000, 1000000}) {
+        run(n);
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+// Multi-threaded allocation benchmark for the object pools.
+// Every thread repeatedly allocates a burst of 16 landmark-sized (64-byte)
+// objects, touches them and frees them again, with 1 to 32 threads sharing one
+// allocator: global new/delete, a MemoryPool behind a std::mutex, the
+// lock-free ConcurrentMemoryPool, and the same with per-thread magazines
+// (MagazinePool). Reported is the wall time per allocate + free pair,
+// averaged over all threads' operations; flat means it scales. A last,
+// single-threaded table compares a fixed 256 MiB MemoryPool with a growable one
+// (1 MiB slabs, same ceiling) holding a 5 MiB working set: construction time,
+// bytes reserved and time per allocate + free. The final table fills a 256 MiB
+// fixed pool under each slab backing (base pages, transparent or explicit huge
+// pages, locked) and times dependent reads at random slots, a TLB-bound walk.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/concurrent_memory_pool.h"
+#include "core/magazine_pool.h"
+#include "core/memory_pool.h"
+#include "core/pool_stats.h"
+
+using namespace ar_slam;
+
+namespace {
+
+    struct Object {
+        double position[3];
+        double normal[3];
+        int64_t id;
+        int64_t observations;
+    };
+    static_assert(sizeof(Object) == 64, "landmark-sized payload");
+
+    constexpr int kBurst = 16;
+    constexpr int kOpsPerThread = 1 << 20;
+
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<int64_t> g_sink{0};  // Keeps the object writes observable.
+
+    struct HeapAllocator {
+        Object* allocate() { return new Object; }
+        void deallocate(Object* p) { delete p; }
+    };
+
+    struct LockedPool {
+        explicit LockedPool(std::size_t bytes) : pool(bytes) {}
+        Object* allocate() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return pool.allocate();
+        }
+        void deallocate(Object* p) {
+            std::lock_guard<std::mutex> lock(mutex);
+            pool.deallocate(p);
+        }
+        std::mutex mutex;
+        MemoryPool<Object> pool;
+    };
+
+    struct LockFreePool {
+        explicit LockFreePool(std::size_t bytes) : pool(bytes) {}
+        Object* allocate() { return pool.allocate(); }
+        void deallocate(Object* p) { pool.deallocate(p); }
+        ConcurrentMemoryPool<Object> pool;
+    };
+
+    struct CachedPool {
+        explicit CachedPool(std::size_t bytes) : pool(bytes, 2 * kBurst) {}
+        Object* allocate() { return pool.allocate(); }
+        void deallocate(Object* p) { pool.deallocate(p); }
+        MagazinePool<Object> pool;
+    };
+
+    /// Nanoseconds per allocate + free pair, as seen by the whole process.
+    template <typename Allocator>
+    double run(Allocator& allocator, int threads) {
+        std::vector<std::thread> workers;
+        const auto start = Clock::now();
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&allocator] {
+                Object* burst[kBurst];
+                int64_t sum = 0;
+                for (int op = 0; op < kOpsPerThread; op += kBurst) {
+                    for (int k = 0; k < kBurst; ++k) {
+                        burst[k] = allocator.allocate();
+                        burst[k]->id = op + k;
+                    }
+                    for (int k = kBurst - 1; k >= 0; --k) {
+                        sum += burst[k]->id;
+                        allocator.deallocate(burst[k]);
+                    }
+                }
+                g_sink += sum;
+            });
+        }
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        return ns / (static_cast<double>(kOpsPerThread) * threads);
+    }
+
+    template <typename Pool>
+    void run_working_set(const char* name, Pool& pool, double construct_ms) {
+        const int kLive = 5 * 1024 * 1024 / static_cast<int>(sizeof(Object));
+        std::vector<Object*> live;
+        live.reserve(kLive);
+        for (int i = 0; i < kLive; ++i) {
+            live.push_back(pool.allocate());
+            live.back()->id = i;
+        }
+        // Churn: free and reallocate a strided subset of the working set.
+        const int kChurn = 1 << 22;
+        const auto start = Clock::now();
+        for (int i = 0; i < kChurn; ++i) {
+            const int k = static_cast<int>((static_cast<int64_t>(i) * 7919) % kLive);
+            pool.deallocate(live[k]);
+            live[k] = pool.allocate();
+            live[k]->id = i;
+        }
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        std::cout << std::setw(10) << name << std::fixed << std::setprecision(1)
+                  << std::setw(14) << construct_ms << std::setw(14)
+                  << pool.capacity_bytes() / (1024.0 * 1024.0) << std::setw(12) << ns / kChurn
+                  << std::endl;
+        dump_pool_stats(std::cout);  // Only with AR_SLAM_POOL_STATS.
+        for (Object* p : live) {
+            g_sink += p->id;
+            pool.deallocate(p);
+        }
+    }
+
+    void run_backing(const char* name, const SlabBacking& backing) {
+        const auto start = Clock::now();
+        MemoryPool<Object> pool(256ull * 1024 * 1024, backing);
+        const double construct_ms =
+            std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::vector<Object*> objects;
+        objects.reserve(pool.capacity());
+        while (Object* p = pool.allocate()) {
+            objects.push_back(p);
+        }
+        // Each object names a random successor; chase the chain so every read waits
+        // on the previous one and the page walk is not hidden.
+        uint64_t rng = 88172645463325252ull;
+        for (Object* p : objects) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            p->id = static_cast<int64_t>(rng % objects.size());
+        }
+        const int kReads = 1 << 22;
+        int64_t at = 0;
+        const auto walk = Clock::now();
+        for (int i = 0; i < kReads; ++i) {
+            at = objects[static_cast<std::size_t>(at)]->id;
+        }
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - walk).count();
+        g_sink += at;
+        const uint32_t flags = pool.backing_flags();
+        std::cout << std::setw(12) << name << std::fixed << std::setprecision(1)
+                  << std::setw(14) << construct_ms << std::setw(12) << ns / kReads << "   "
+                  << ((flags & SlabBacking::kHugeTlb) != 0           ? "hugetlb "
+                      : (flags & SlabBacking::kTransparentHuge) != 0 ? "thp "
+                                                                      : "")
+                  << ((flags & SlabBacking::kLocked) != 0 ? "locked" : "") << std::endl;
+        for (Object* p : objects) {
+            pool.deallocate(p);
+        }
+    }
+
+}  // namespace
+
+int main() {
+    std::cout << "=== Object Pools Under Contention ===" << std::endl;
+    std::cout << "ns per allocate + free of a 64-byte object (bursts of " << kBurst << ", "
+              << kOpsPerThread << " per thread); hardware threads: "
+              << std::thread::hardware_concurrency() << std::endl
+              << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "new/delete" << std::setw(12)
+              << "mutex pool" << std::setw(12) << "lock-free" << std::setw(12) << "magazines"
+              << std::endl;
+
+    for (int threads : {1, 2, 4, 8, 16, 32}) {
+        // Room for every thread's burst plus a full magazine each.
+        const std::size_t bytes = static_cast<std::size_t>(threads) * kBurst * 4 * 128;
+        HeapAllocator heap;
+        LockedPool locked(bytes);
+        LockFreePool lock_free(bytes);
+        CachedPool cached(bytes);
+        const double heap_ns = run(heap, threads);
+        const double locked_ns = run(locked, threads);
+        const double lock_free_ns = run(lock_free, threads);
+        const double cached_ns = run(cached, threads);
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(1)
+                  << std::setw(12) << heap_ns << std::setw(12) << locked_ns << std::setw(12)
+                  << lock_free_ns << std::setw(12) << cached_ns << std::endl;
+    }
+
+    std::cout << std::endl
+              << "Single thread, 5 MiB working set, 256 MiB budget" << std::endl
+              << std::setw(10) << "pool" << std::setw(14) << "construct ms" << std::setw(14)
+              << "reserved MiB" << std::setw(12) << "ns/op" << std::endl;
+    {
+        auto start = Clock::now();
+        MemoryPool<Object> fixed;
+        fixed.set_name("fixed");
+        const double ms =
+            std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        run_working_set("fixed", fixed, ms);
+    }
+    {
+        auto start = Clock::now();
+        MemoryPool<Object> growable(256ull * 1024 * 1024, MemoryPool<Object>::Growth{});
+        growable.set_name("growable");
+        const double ms =
+            std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        run_working_set("growable", growable, ms);
+    }
+
+    std::cout << std::endl
+              << "Random dependent reads over a full 256 MiB pool, by slab backing" << std::endl
+              << std::setw(12) << "backing" << std::setw(14) << "construct ms" << std::setw(12)
+              << "ns/read" << "   obtained" << std::endl;
+    SlabBacking backing;
+    run_backing("operator new", backing);
+    backing.pages = SlabBacking::Pages::kTransparentHuge;
+    run_backing("thp", backing);
+    backing.pages = SlabBacking::Pages::kHuge;
+    run_backing("hugetlb", backing);
+    backing.lock = true;
+    run_backing("+ mlock", backing);
+    return 0;
+}
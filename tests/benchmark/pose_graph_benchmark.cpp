@@ -0,0 +1,128 @@
+// Scaling benchmark for Sim(3) pose-graph optimisation.
+// Builds looped trajectories of 1k to 50k keyframes (laps of a circuit with
+// drifting odometry, and loop edges to the previous lap every few keyframes),
+// then optimises them and reports fill, time per iteration and the trajectory
+// error before and after. With minimum-degree ordering the factor stays
+// proportional to the trajectory, so time should grow linearly. The last run
+// repeats the largest graph under a 50 ms budget, which is checked between
+// iterations: it stops after the first.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "core/pose_graph.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+using geometry::Pose;
+using geometry::Sim3;
+using geometry::Vec3;
+
+namespace {
+
+    using artest::Lcg;
+
+    constexpr int kLap = 500;        // Keyframes per lap of the circuit.
+    constexpr int kLoopStride = 25;  // A loop edge every this many keyframes.
+
+    Sim3 true_node(int k) {
+        const double a = 2.0 * M_PI * (k % kLap) / kLap;
+        const double r = 50.0 + 0.5 * (k / kLap);  // Laps drift apart slightly.
+        Pose p;
+        p.R.m[0][0] = std::cos(a);
+        p.R.m[0][2] = -std::sin(a);
+        p.R.m[2][0] = std::sin(a);
+        p.R.m[2][2] = std::cos(a);
+        const Vec3 c{r * std::sin(a), 0.0, r * std::cos(a)};
+        const Vec3 rc = geometry::mul(p.R, c);
+        p.t = {-rc[0], -rc[1], -rc[2]};
+        return Sim3(p);
+    }
+
+    Sim3 noisy(const Sim3& S, Lcg& rng, double rot, double trans, double scale) {
+        const double w[3] = {rot * rng.uniform(), rot * rng.uniform(), rot * rng.uniform()};
+        Sim3 D;
+        D.R = ba_detail::exp_so3(w);
+        D.t = {trans * rng.uniform(), trans * rng.uniform(), trans * rng.uniform()};
+        D.s = 1.0 + scale * rng.uniform();
+        return geometry::compose(S, D);
+    }
+
+    PoseGraph make_graph(int n, std::vector<Sim3>& truth) {
+        Lcg rng{static_cast<uint32_t>(n)};
+        truth.resize(n);
+        for (int k = 0; k < n; ++k) {
+            truth[k] = true_node(k);
+        }
+        PoseGraph graph;
+        graph.fixed.assign(n, false);
+        graph.fixed[0] = true;
+        graph.nodes.push_back(truth[0]);
+        for (int k = 1; k < n; ++k) {
+            // Noisy odometry: drift accumulates in rotation, translation and scale.
+            const Sim3 rel = geometry::compose(truth[k - 1], truth[k].inverse());
+            const Sim3 measured = noisy(rel, rng, 0.002, 0.01, 0.002);
+            graph.edges.push_back({k - 1, k, measured, 1.0});
+            graph.nodes.push_back(geometry::compose(measured.inverse(), graph.nodes.back()));
+        }
+        for (int k = kLap; k < n; k += kLoopStride) {
+            const Sim3 rel = geometry::compose(truth[k - kLap], truth[k].inverse());
+            graph.edges.push_back({k - kLap, k, noisy(rel, rng, 0.001, 0.005, 0.001), 1.0});
+        }
+        return graph;
+    }
+
+    // RMS distance between estimated and true camera centres.
+    double rms_error(const PoseGraph& graph, const std::vector<Sim3>& truth) {
+        double sum = 0.0;
+        for (std::size_t k = 0; k < truth.size(); ++k) {
+            const Vec3 a = graph.nodes[k].inverse().t;
+            const Vec3 b = truth[k].inverse().t;
+            for (int i = 0; i < 3; ++i) {
+                sum += (a[i] - b[i]) * (a[i] - b[i]);
+            }
+        }
+        return std::sqrt(sum / truth.size());
+    }
+
+    void run(int n, double budget_ms) {
+        std::vector<Sim3> truth;
+        PoseGraph graph = make_graph(n, truth);
+        const double before = rms_error(graph, truth);
+
+        PoseGraphConfig config;
+        config.max_iterations = 10;
+        config.time_budget_ms = budget_ms;
+        const PoseGraphSummary s = optimise_pose_graph(graph, config);
+        const double after = rms_error(graph, truth);
+
+        std::cout << std::setw(10) << n << std::setw(10) << graph.edges.size() << std::setw(12)
+                  << s.factor_blocks << std::setw(8) << s.iterations << std::setw(14)
+                  << std::fixed << std::setprecision(1) << s.elapsed_ms << std::setw(14)
+                  << s.elapsed_ms / std::max(1, s.iterations) << std::setw(14)
+                  << std::setprecision(3) << before << std::setw(12) << after
+                  << (budget_ms > 0.0 ? "   (50 ms budget)" : "") << std::endl;
+    }
+
+}  // namespace
+
+int main() {
+    std::cout << "=== Sim(3) Pose-Graph Optimisation Scaling ===" << std::endl;
+    std::cout << "Laps of " << kLap << " keyframes, a loop edge every " << kLoopStride
+              << " keyframes from the second lap on" << std::endl
+              << std::endl;
+    std::cout << std::setw(10) << "keyframes" << std::setw(10) << "edges" << std::setw(12)
+              << "fill" << std::setw(8) << "iters" << std::setw(14) << "total (ms)"
+              << std::setw(14) << "per iter" << std::setw(14) << "rms before" << std::setw(12)
+              << "rms after" << std::endl;
+
+    for (int n : {1000, 5000, 10000, 20000, 50000}) {
+        run(n, 0.0);
+    }
+    run(50000, 50.0);
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Scaling benchmark for bag-of-words place recognition.
+// Trains a vocabulary on synthetic views of a world of noisy prototype
+// descriptors, then grows an inverted index from 1k to 50k keyframes and
+// reports transform and top-k query times. Query time should track the
+// posting-list lengths (words are rare in a large vocabulary), not the
+// keyframe count.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "core/bow_index.h"
+#include "core/vocabulary.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+
+namespace {
+
+    using artest::Lcg;
+
+    // A world of distinct places: slot s of place p holds a fixed pseudo-random
+    // descriptor (derived from a hash, so no storage), and each view sees a random
+    // subset of the place's slots with a few flipped bits.
+    struct World {
+        static constexpr int kSlots = 400;
+
+        static void descriptor(int place, int slot, uint8_t* out) {
+            uint64_t h = (static_cast<uint64_t>(place) << 20) ^ static_cast<uint64_t>(slot);
+            for (std::size_t i = 0; i < kDescriptorBytes; i += 8) {
+                h += 0x9e3779b97f4a7c15ull;  // splitmix64
+                uint64_t z = h;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+                z ^= z >> 31;
+                std::memcpy(out + i, &z, 8);
+            }
+        }
+
+        static std::vector<uint8_t> view(int place, int features, Lcg& rng) {
+            std::vector<uint8_t> rows(features * kDescriptorBytes);
+            for (int f = 0; f < features; ++f) {
+                uint8_t* d = rows.data() + f * kDescriptorBytes;
+                descriptor(place, static_cast<int>(rng.next() % kSlots), d);
+                for (int flip = 0; flip < 2; ++flip) {
+                    const uint32_t bit = rng.next() % (kDescriptorBytes * 8);
+                    d[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+                }
+            }
+            return rows;
+        }
+    };
+
+    double ms_since(std::chrono::high_resolution_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() -
+                                                         start)
+            .count();
+    }
+
+}  // namespace
+
+int main() {
+    const int kFeatures = 300;
+    const int kQueries = 200;
+    Lcg rng{42u};
+
+    std::cout << "=== Bag-of-Words Place Recognition Scaling ===" << std::endl;
+
+    std::vector<std::vector<uint8_t>> training;
+    for (int i = 0; i < 1000; ++i) {
+        training.push_back(World::view(1000000 + i, kFeatures, rng));  // Unrelated places.
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    const Vocabulary voc = Vocabulary::train(training, 10, 6);
+    std::cout << "Trained " << voc.word_count() << " words (k=10, depth=6) on "
+              << training.size() * kFeatures << " descriptors in " << std::fixed
+              << std::setprecision(0) << ms_since(start) << " ms" << std::endl
+              << std::endl;
+
+    std::cout << std::setw(12) << "keyframes" << std::setw(18) << "transform (us)"
+              << std::setw(16) << "query (us)" << std::setw(16) << "top-1 recall" << std::endl;
+
+    BowIndex index(voc.word_count());
+    BowVector bow;
+    std::vector<BowMatch> top;
+    double transform_ms = 0.0;
+    int added = 0;
+    for (int target : {1000, 5000, 10000, 20000, 50000}) {
+        start = std::chrono::high_resolution_clock::now();
+        const int before = added;
+        for (; added < target; ++added) {
+            const std::vector<uint8_t> rows = World::view(added, kFeatures, rng);
+            voc.transform(rows.data(), kFeatures, bow);
+            index.add(added, bow);
+        }
+        transform_ms = ms_since(start) / std::max(1, added - before);
+
+        // Revisit random places with fresh noise.
+        std::vector<BowVector> queries;
+        std::vector<int> truth;
+        for (int q = 0; q < kQueries; ++q) {
+            const int place = static_cast<int>(rng.next() % added);
+            queries.push_back(voc.transform(World::view(place, kFeatures, rng)));
+            truth.push_back(place);
+        }
+        int hits = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (int q = 0; q < kQueries; ++q) {
+            index.query(queries[q], 5, [](int) { return true; }, top);
+            hits += !top.empty() && top[0].keyframe == truth[q];
+        }
+        const double query_us = ms_since(start) * 1000.0 / kQueries;
+
+        std::cout << std::setw(12) << added << std::setw(18) << std::setprecision(1)
+                  << transform_ms * 1000.0 << std::setw(16) << query_us << std::setw(15)
+                  << std::setprecision(1) << 100.0 * hits / kQueries << "%" << std::endl;
+    }
+    return 0;
+}
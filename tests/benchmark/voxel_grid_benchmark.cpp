@@ -0,0 +1,151 @@
+// Query benchmark for the voxel hash grid against linear scans.
+// Fills a room-sized volume (20 x 4 x 20 m, 10 cm voxels) with 10k to 1M
+// random points, then times insertion and three query kinds, each against the
+// brute-force scan it replaces: a 20 cm radius query, an 8-nearest-neighbour
+// query and a camera frustum (640 x 480, 0.1 to 5 m). Grid query cost should
+// track the points near the query, while the scans grow with the cloud.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "core/voxel_grid.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+using geometry::Vec3;
+
+namespace {
+
+    using artest::Lcg;
+
+    using Clock = std::chrono::steady_clock;
+
+    double us_since(Clock::time_point start, int reps) {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / reps;
+    }
+
+    double dist2(const Vec3& a, const Vec3& b) {
+        return (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) +
+               (a[2] - b[2]) * (a[2] - b[2]);
+    }
+
+    void run(int n) {
+        Lcg rng{static_cast<uint32_t>(n)};
+        std::vector<Vec3> cloud(n);
+        for (Vec3& p : cloud) {
+            p = {rng.uniform(-10.0, 10.0), rng.uniform(-2.0, 2.0), rng.uniform(-10.0, 10.0)};
+        }
+        std::vector<Vec3> queries(200);
+        for (Vec3& q : queries) {
+            q = {rng.uniform(-10.0, 10.0), rng.uniform(-2.0, 2.0), rng.uniform(-10.0, 10.0)};
+        }
+
+        VoxelGrid::Config config;
+        config.voxel_size = 0.1;
+        VoxelGrid grid(config);
+        auto start = Clock::now();
+        for (int i = 0; i < n; ++i) {
+            grid.add(cloud[i], i);
+        }
+        const double insert_ns = us_since(start, n) * 1000.0;
+
+        std::vector<int> out;
+        std::size_t found = 0;
+        start = Clock::now();
+        for (const Vec3& q : queries) {
+            grid.radius_search(q, 0.2, out);
+            found += out.size();
+        }
+        const double radius_us = us_since(start, static_cast<int>(queries.size()));
+        start = Clock::now();
+        for (const Vec3& q : queries) {
+            for (const Vec3& p : cloud) {
+                found += dist2(p, q) <= 0.04 ? 1 : 0;
+            }
+        }
+        const double radius_scan_us = us_since(start, static_cast<int>(queries.size()));
+
+        start = Clock::now();
+        for (const Vec3& q : queries) {
+            grid.nearest(q, 8, out);
+            found += out.size();
+        }
+        const double knn_us = us_since(start, static_cast<int>(queries.size()));
+        std::vector<std::pair<double, int>> scan(n);
+        start = Clock::now();
+        for (const Vec3& q : queries) {
+            for (int i = 0; i < n; ++i) {
+                scan[i] = {dist2(cloud[i], q), i};
+            }
+            std::partial_sort(scan.begin(), scan.begin() + 8, scan.end());
+            found += scan[0].second >= 0 ? 1 : 0;
+        }
+        const double knn_scan_us = us_since(start, static_cast<int>(queries.size()));
+
+        geometry::Mat3 K;
+        K.m[0][0] = K.m[1][1] = 500.0;
+        K.m[0][2] = 320.0;
+        K.m[1][2] = 240.0;
+        K.m[2][2] = 1.0;
+        const int kViews = 50;
+        start = Clock::now();
+        for (int v = 0; v < kViews; ++v) {
+            geometry::Pose pose;
+            const double a = 2.0 * M_PI * v / kViews;
+            pose.R.m[0][0] = std::cos(a);
+            pose.R.m[0][2] = -std::sin(a);
+            pose.R.m[2][0] = std::sin(a);
+            pose.R.m[2][2] = std::cos(a);
+            grid.frustum(pose, K, 640, 480, 0.1, 5.0, out);
+            found += out.size();
+        }
+        const double frustum_us = us_since(start, kViews);
+        start = Clock::now();
+        for (int v = 0; v < kViews; ++v) {
+            geometry::Pose pose;
+            const double a = 2.0 * M_PI * v / kViews;
+            pose.R.m[0][0] = std::cos(a);
+            pose.R.m[0][2] = -std::sin(a);
+            pose.R.m[2][0] = std::sin(a);
+            pose.R.m[2][2] = std::cos(a);
+            for (const Vec3& p : cloud) {
+                const Vec3 X = pose.transform(p);
+                if (X[2] < 0.1 || X[2] > 5.0) {
+                    continue;
+                }
+                const double u = 500.0 * X[0] / X[2] + 320.0;
+                const double w = 500.0 * X[1] / X[2] + 240.0;
+                found += (u >= 0.0 && u < 640.0 && w >= 0.0 && w < 480.0) ? 1 : 0;
+            }
+        }
+        const double frustum_scan_us = us_since(start, kViews);
+
+        std::cout << std::setw(9) << n << std::setw(9) << grid.voxels() << std::fixed
+                  << std::setprecision(1) << std::setw(10) << insert_ns << std::setw(11)
+                  << radius_us << std::setw(11) << radius_scan_us << std::setw(10) << knn_us
+                  << std::setw(11) << knn_scan_us << std::setw(12) << frustum_us << std::setw(12)
+                  << frustum_scan_us << (found == 0 ? " (empty)" : "") << std::endl;
+    }
+
+}  // namespace
+
+int main() {
+    std::cout << "=== Voxel Hash Grid vs Linear Scan ===" << std::endl;
+    std::cout << "Insert in ns/point; queries in us/query (radius 0.2 m, k = 8, "
+              << "frustum 0.1-5 m)" << std::endl
+              << std::endl;
+    std::cout << std::setw(9) << "points" << std::setw(9) << "voxels" << std::setw(10) << "insert"
+              << std::setw(11) << "radius" << std::setw(11) << "(scan)" << std::setw(10) << "knn"
+              << std::setw(11) << "(scan)" << std::setw(12) << "frustum" << std::setw(12)
+              << "(scan)" << std::endl;
+    for (int n : {10000, 100000, 1000000}) {
+        run(n);
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
 // CTest (and the CI workflow) use to determine pass/fail.
 
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 
 namespace artest {
@@ -39,6 +40,22 @@ namespace artest {
         return 1;
     }
 
+    /// Deterministic pseudo-random numbers (Numerical Recipes LCG), seeded as Lcg{seed},
+    /// so every run of a test or benchmark sees the same data.
+    struct Lcg {
+        uint32_t state;
+
+        /// Next 24 random bits.
+        uint32_t next() {
+            state = state * 1664525u + 1013904223u;
+            return state >> 8;
+        }
+        /// Uniform in [lo, hi).
+        double uniform(double lo, double hi) { return lo + (hi - lo) * (next() / 16777216.0); }
+        /// Uniform in [-0.5, 0.5).
+        double uniform() { return (next() % 65536) / 65536.0 - 0.5; }
+    };
+
 }  // namespace artest
 
 #define CHECK(cond) ::artest::check((cond), #cond, __FILE__, __LINE__)
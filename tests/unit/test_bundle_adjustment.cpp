@@ -0,0 +1,274 @@
+// Unit tests for the sparse bundle adjuster and its background-thread wrapper.
+// Synthetic multi-camera scenes with known ground truth: perturbed poses and
+// points must converge back (around a point no camera can see), a few gross
+// outliers must not drag the solution (Huber kernel), and the threaded sliding
+// window must refine a LandmarkMap.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "core/bundle_adjustment.h"
+#include "core/local_bundle_adjuster.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+using geometry::Mat3;
+using geometry::Pose;
+using geometry::Vec3;
+
+namespace {
+
+    using artest::Lcg;
+
+    Mat3 intrinsics() {
+        Mat3 K = Mat3::identity();
+        K.m[0][0] = K.m[1][1] = 500.0;
+        K.m[0][2] = 320.0;
+        K.m[1][2] = 240.0;
+        return K;
+    }
+
+    // Cameras slide along x and yaw slightly, all looking down +z at the points.
+    Pose camera_pose(int i) {
+        const double yaw = 0.02 * i;
+        Pose p;
+        p.R.m[0][0] = std::cos(yaw);
+        p.R.m[0][2] = std::sin(yaw);
+        p.R.m[2][0] = -std::sin(yaw);
+        p.R.m[2][2] = std::cos(yaw);
+        p.t = {-0.25 * i, 0.01 * i, 0.0};
+        return p;
+    }
+
+    std::vector<Vec3> scene_points(int n, Lcg& rng) {
+        std::vector<Vec3> pts;
+        for (int i = 0; i < n; ++i) {
+            const double x = 2.0 * rng.uniform() + 0.5;
+            const double y = 1.5 * rng.uniform();
+            pts.push_back({x, y, 4.0 + 2.0 * rng.uniform()});
+        }
+        return pts;
+    }
+
+    void observe(const Mat3& K, const Pose& cam, const Vec3& X, double& u, double& v) {
+        Vec3 c = cam.transform(X);
+        u = K.m[0][0] * c[0] / c[2] + K.m[0][2];
+        v = K.m[1][1] * c[1] / c[2] + K.m[1][2];
+    }
+
+    double dist(const Vec3& a, const Vec3& b) {
+        return std::sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) +
+                         (a[2] - b[2]) * (a[2] - b[2]));
+    }
+
+    BAProblem make_scene(int cams,
+                         int points,
+                         std::vector<Pose>& gt_cams,
+                         std::vector<Vec3>& gt_pts) {
+        Lcg rng{7u};
+        BAProblem problem;
+        problem.K = intrinsics();
+        gt_pts = scene_points(points, rng);
+        gt_cams.clear();
+        for (int c = 0; c < cams; ++c) {
+            gt_cams.push_back(camera_pose(c));
+            problem.fixed.push_back(c < 2);  // Two fixed cameras pin gauge and scale.
+        }
+        for (int c = 0; c < cams; ++c) {
+            for (int p = 0; p < points; ++p) {
+                BAObservation o{c, p, 0.0, 0.0};
+                observe(problem.K, gt_cams[c], gt_pts[p], o.u, o.v);
+                problem.observations.push_back(o);
+            }
+        }
+
+        // Perturb the free cameras and every point.
+        problem.cameras = gt_cams;
+        for (int c = 2; c < cams; ++c) {
+            const double w[3] = {0.01 * rng.uniform(), 0.01 * rng.uniform(), 0.01 * rng.uniform()};
+            problem.cameras[c].R = geometry::mul(ba_detail::exp_so3(w), problem.cameras[c].R);
+            for (int k = 0; k < 3; ++k) {
+                problem.cameras[c].t[k] += 0.05 * rng.uniform();
+            }
+        }
+        problem.points = gt_pts;
+        for (Vec3& X : problem.points) {
+            for (int k = 0; k < 3; ++k) {
+                X[k] += 0.1 * rng.uniform();
+            }
+        }
+        return problem;
+    }
+
+    void test_converges_to_ground_truth() {
+        std::vector<Pose> gt_cams;
+        std::vector<Vec3> gt_pts;
+        BAProblem problem = make_scene(5, 120, gt_cams, gt_pts);
+
+        BAConfig config;
+        config.max_iterations = 30;
+        BASummary summary = bundle_adjust(problem, config);
+        CHECK(summary.accepted > 0);
+        CHECK(summary.final_cost < summary.initial_cost * 1e-6);
+
+        double max_pt = 0.0;
+        for (std::size_t p = 0; p < gt_pts.size(); ++p) {
+            max_pt = std::max(max_pt, dist(problem.points[p], gt_pts[p]));
+        }
+        CHECK(max_pt < 1e-4);
+        for (std::size_t c = 0; c < gt_cams.size(); ++c) {
+            CHECK(dist(problem.cameras[c].t, gt_cams[c].t) < 1e-4);
+        }
+        // Fixed cameras are untouched.
+        CHECK(dist(problem.cameras[1].t, gt_cams[1].t) == 0.0);
+    }
+
+    void test_unconstrained_point_held() {
+        // One point behind every camera has no usable observation, so its block
+        // is singular; the rest of the scene must still converge around it.
+        std::vector<Pose> gt_cams;
+        std::vector<Vec3> gt_pts;
+        BAProblem problem = make_scene(4, 80, gt_cams, gt_pts);
+        const Vec3 behind{0.5, 0.2, -5.0};
+        const int lost = static_cast<int>(problem.points.size());
+        problem.points.push_back(behind);
+        for (int c = 0; c < 4; ++c) {
+            problem.observations.push_back({c, lost, 320.0, 240.0});
+        }
+
+        BAConfig config;
+        config.max_iterations = 30;
+        BASummary summary = bundle_adjust(problem, config);
+        CHECK(summary.accepted > 0);
+        double max_pt = 0.0;
+        for (std::size_t p = 0; p < gt_pts.size(); ++p) {
+            max_pt = std::max(max_pt, dist(problem.points[p], gt_pts[p]));
+        }
+        CHECK(max_pt < 1e-4);
+        CHECK(dist(problem.points[lost], behind) == 0.0);
+    }
+
+    // Median point error after adjusting a scene with a few gross outliers.
+    double median_error_with_outliers(double huber_px) {
+        std::vector<Pose> gt_cams;
+        std::vector<Vec3> gt_pts;
+        BAProblem problem = make_scene(4, 80, gt_cams, gt_pts);
+        // Corrupt a handful of observations by tens of pixels.
+        for (std::size_t i = 0; i < problem.observations.size(); i += 37) {
+            problem.observations[i].u += 40.0;
+            problem.observations[i].v -= 25.0;
+        }
+        BAConfig config;
+        config.max_iterations = 30;
+        config.huber_px = huber_px;
+        bundle_adjust(problem, config);
+
+        std::vector<double> errs;
+        for (std::size_t p = 0; p < gt_pts.size(); ++p) {
+            errs.push_back(dist(problem.points[p], gt_pts[p]));
+        }
+        std::nth_element(errs.begin(), errs.begin() + errs.size() / 2, errs.end());
+        return errs[errs.size() / 2];
+    }
+
+    void test_huber_limits_outliers() {
+        const double robust = median_error_with_outliers(2.0);
+        const double least_squares = median_error_with_outliers(1e9);
+        CHECK(robust < 0.5 * least_squares);
+        CHECK(robust < 0.05);
+    }
+
+    void test_background_window() {
+        // Seven keyframes in a map; the window covers the newest five.
+        const Mat3 K = intrinsics();
+        Lcg rng{99u};
+        std::vector<Vec3> gt_pts = scene_points(60, rng);
+        LandmarkMap map;
+        for (int c = 0; c < 7; ++c) {
+            std::vector<int> ids;
+            std::vector<Vec3> noisy;
+            std::vector<MapObservation> obs;
+            for (int p = 0; p < static_cast<int>(gt_pts.size()); ++p) {
+                MapObservation o{c, p, 0.0, 0.0};
+                observe(K, camera_pose(c), gt_pts[p], o.u, o.v);
+                obs.push_back(o);
+                if (c == 0) {
+                    ids.push_back(p);
+                    noisy.push_back({gt_pts[p][0] + 0.05 * rng.uniform(),
+                                     gt_pts[p][1] + 0.05 * rng.uniform(), gt_pts[p][2]});
+                }
+            }
+            map.add_keyframe(camera_pose(c), ids, noisy, obs);
+        }
+
+        LocalBundleAdjuster::Config config;
+        config.solver.max_iterations = 20;
+        std::vector<int> kf_ids, lm_ids;
+        BAProblem window = LocalBundleAdjuster::make_problem(map, K, config, kf_ids, lm_ids);
+        CHECK(window.cameras.size() == 5);
+        CHECK(kf_ids.front() == 2 && kf_ids.back() == 6);
+        CHECK(window.points.size() == gt_pts.size());
+        CHECK(window.observations.size() == 5 * gt_pts.size());
+
+        LocalBundleAdjuster ba(K, config);
+        CHECK(ba.submit(map));
+        ba.wait_idle();
+        CHECK(!ba.busy());
+        MapRefinement refinement;
+        CHECK(ba.poll(refinement));
+        CHECK(!ba.poll(refinement));  // Consumed.
+        CHECK(refinement.newest_keyframe == 6);
+        CHECK(refinement.keyframes.size() == 3);  // Two of five are fixed.
+
+        double before = 0.0, after = 0.0;
+        for (const Landmark& lm : map.landmarks()) {
+            before += dist(lm.position, gt_pts[lm.id]);
+        }
+        CHECK(map.refine(refinement).size() == gt_pts.size());
+        for (const Landmark& lm : map.landmarks()) {
+            after += dist(lm.position, gt_pts[lm.id]);
+        }
+        CHECK(after < before * 0.01);
+    }
+
+    void test_window_skips_points_behind() {
+        const Mat3 K = intrinsics();
+        Lcg rng{5u};
+        std::vector<Vec3> pts = scene_points(20, rng);
+        pts.push_back({0.5, 0.2, -5.0});  // Id 20: behind every camera.
+        LandmarkMap map;
+        for (int c = 0; c < 4; ++c) {
+            std::vector<int> ids;
+            std::vector<MapObservation> obs;
+            for (int p = 0; p < static_cast<int>(pts.size()); ++p) {
+                MapObservation o{c, p, 320.0, 240.0};
+                if (pts[p][2] > 0.0) {
+                    observe(K, camera_pose(c), pts[p], o.u, o.v);
+                }
+                obs.push_back(o);
+                if (c == 0) {
+                    ids.push_back(p);
+                }
+            }
+            map.add_keyframe(camera_pose(c), ids, c == 0 ? pts : std::vector<Vec3>{}, obs);
+        }
+
+        LocalBundleAdjuster::Config config;
+        std::vector<int> kf_ids, lm_ids;
+        BAProblem window = LocalBundleAdjuster::make_problem(map, K, config, kf_ids, lm_ids);
+        CHECK(window.points.size() == 20);
+        CHECK(std::find(lm_ids.begin(), lm_ids.end(), 20) == lm_ids.end());
+        CHECK(window.observations.size() == 4 * 20);
+    }
+
+}  // namespace
+
+int main() {
+    test_converges_to_ground_truth();
+    test_unconstrained_point_held();
+    test_huber_limits_outliers();
+    test_background_window();
+    test_window_skips_points_behind();
+    return artest::report("test_bundle_adjustment");
+}
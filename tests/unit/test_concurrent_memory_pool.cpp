@@ -0,0 +1,198 @@
+// Unit tests for the lock-free, thread-safe object pool.
+// Verifies the single-threaded MemoryPool contract (capacity, exhaustion,
+// reuse, construction, move) and batch transfers, then hammers one pool from
+// many threads that allocate, hand objects to each other and free them,
+// checking that no slot is ever handed out twice and that every slot comes back.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/concurrent_memory_pool.h"
+#include "test_util.h"
+
+namespace {
+
+    struct Tracked {
+        static std::atomic<int> live;
+        int value;
+        explicit Tracked(int v) : value(v) { ++live; }
+        ~Tracked() { --live; }
+    };
+    std::atomic<int> Tracked::live{0};
+
+    std::size_t budget_for(std::size_t objects) {
+        // Each slot costs its storage plus a 4-byte free-list link.
+        return (sizeof(Tracked) + sizeof(uint32_t)) * objects;
+    }
+
+    void test_capacity_and_exhaustion() {
+        ar_slam::ConcurrentMemoryPool<Tracked> pool(budget_for(4));
+        CHECK(pool.capacity() == 4);
+        CHECK(pool.used() == 0);
+        CHECK(pool.available() == 4);
+        CHECK(!pool.full());
+
+        std::vector<Tracked*> objs;
+        for (int i = 0; i < 4; ++i) {
+            Tracked* t = pool.create(i * 10);
+            CHECK(t != nullptr);
+            CHECK(pool.owns(t));
+            CHECK(t->value == i * 10);
+            objs.push_back(t);
+        }
+        CHECK(pool.full());
+        CHECK(Tracked::live == 4);
+        CHECK(pool.create(99) == nullptr);
+        CHECK(pool.allocate() == nullptr);
+        CHECK(pool.get_usage() == 4 * sizeof(Tracked));
+
+        for (Tracked* t : objs) {
+            pool.destroy(t);
+        }
+        CHECK(Tracked::live == 0);
+        CHECK(pool.used() == 0);
+
+        ar_slam::ConcurrentMemoryPool<Tracked> tiny(1);
+        CHECK(tiny.capacity() == 1);
+    }
+
+    void test_reuse_and_move() {
+        ar_slam::ConcurrentMemoryPool<Tracked> pool(budget_for(2));
+        Tracked* a = pool.create(1);
+        Tracked* b = pool.create(2);
+        pool.destroy(a);
+        Tracked* c = pool.create(3);
+        CHECK(c == a);  // LIFO: the slot just freed is handed out next.
+        CHECK(pool.full());
+
+        ar_slam::ConcurrentMemoryPool<Tracked> moved(std::move(pool));
+        CHECK(moved.owns(b) && moved.owns(c));
+        CHECK(moved.full());
+        CHECK(pool.capacity() == 0 && pool.allocate() == nullptr);
+        moved.destroy(b);
+        moved.destroy(c);
+        CHECK(moved.used() == 0);
+        CHECK(Tracked::live == 0);
+    }
+
+    void test_batches() {
+        ar_slam::ConcurrentMemoryPool<uint64_t> pool((sizeof(uint64_t) + 4) * 10);
+        uint64_t* out[16];
+        CHECK(pool.allocate_batch(out, 4) == 4);
+        CHECK(pool.used() == 4);
+        CHECK(pool.allocate_batch(out + 4, 16) == 6);  // Short: only 6 left.
+        CHECK(pool.allocate_batch(out + 10, 1) == 0);
+        std::vector<uint64_t*> all(out, out + 10);
+        std::sort(all.begin(), all.end());
+        CHECK(std::adjacent_find(all.begin(), all.end()) == all.end());
+
+        pool.deallocate_batch(out + 2, 5);
+        CHECK(pool.used() == 5);
+        CHECK(pool.allocate() == out[2]);  // The batch's first slot is the new top.
+        pool.deallocate(out[2]);
+        pool.deallocate_batch(out, 2);
+        pool.deallocate_batch(out + 7, 3);
+        CHECK(pool.used() == 0);
+        CHECK(pool.allocate_batch(out, 16) == 10);
+        pool.deallocate_batch(out, 10);
+    }
+
+    // Every thread allocates in bursts, stamps each slot with its own id, frees
+    // half of its objects itself and passes the rest to a shared bin that any
+    // thread may free from. Two threads ever holding the same slot would
+    // overwrite each other's stamp.
+    void test_mpmc_stress() {
+        const int kThreads = 8;
+        const int kRounds = 20000;
+        const std::size_t kCapacity = 256;  // Small, so the list runs empty often.
+        ar_slam::ConcurrentMemoryPool<uint64_t> pool((sizeof(uint64_t) + 4) * kCapacity);
+        CHECK(pool.capacity() == kCapacity);
+
+        std::mutex bin_mutex;
+        std::vector<uint64_t*> bin;
+        std::atomic<int> corrupted{0};
+        std::atomic<long> exhausted{0};
+
+        auto worker = [&](int id) {
+            std::vector<uint64_t*> held;
+            uint32_t rng = 2654435761u * static_cast<uint32_t>(id + 1);
+            for (int round = 0; round < kRounds; ++round) {
+                rng = rng * 1664525u + 1013904223u;
+                const int burst = 1 + static_cast<int>((rng >> 24) % 16);
+                for (int k = 0; k < burst; ++k) {
+                    uint64_t* p = pool.allocate();
+                    if (p == nullptr) {
+                        ++exhausted;
+                        break;
+                    }
+                    *p = (static_cast<uint64_t>(id) << 32) | static_cast<uint32_t>(round);
+                    held.push_back(p);
+                }
+                for (std::size_t k = 0; k < held.size(); ++k) {
+                    const uint64_t stamp = *held[k];
+                    if (stamp >> 32 != static_cast<uint64_t>(id)) {
+                        ++corrupted;
+                    }
+                    if (k % 2 == 0) {
+                        pool.deallocate(held[k]);
+                    } else {
+                        std::lock_guard<std::mutex> lock(bin_mutex);
+                        bin.push_back(held[k]);
+                    }
+                }
+                held.clear();
+                // Free someone else's objects.
+                std::vector<uint64_t*> taken;
+                {
+                    std::lock_guard<std::mutex> lock(bin_mutex);
+                    const std::size_t n = std::min<std::size_t>(bin.size(), 8);
+                    taken.assign(bin.end() - n, bin.end());
+                    bin.resize(bin.size() - n);
+                }
+                for (uint64_t* p : taken) {
+                    pool.deallocate(p);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back(worker, t);
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        for (uint64_t* p : bin) {
+            pool.deallocate(p);
+        }
+
+        CHECK(corrupted == 0);
+        CHECK(pool.used() == 0);
+        // The free-list still holds every slot exactly once.
+        std::vector<uint64_t*> all;
+        while (uint64_t* p = pool.allocate()) {
+            all.push_back(p);
+        }
+        CHECK(all.size() == kCapacity);
+        std::sort(all.begin(), all.end());
+        CHECK(std::adjacent_find(all.begin(), all.end()) == all.end());
+        for (uint64_t* p : all) {
+            CHECK(pool.owns(p));
+            pool.deallocate(p);
+        }
+    }
+
+}  // namespace
+
+int main() {
+    test_capacity_and_exhaustion();
+    test_reuse_and_move();
+    test_batches();
+    test_mpmc_stress();
+    return artest::report("test_concurrent_memory_pool");
+}
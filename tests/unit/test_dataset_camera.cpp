@@ -0,0 +1,222 @@
+// Tests for dataset replay: TUM and EuRoC index parsing, prefetched frames
+// served in order with their timestamps, seeking, real-time pacing and
+// skipped undecodable frames, on small sequences written to a temp directory.
+
+#include <opencv2/opencv.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera/dataset_camera.h"
+#include "test_util.h"
+
+namespace {
+
+    namespace fs = std::filesystem;
+    using ar_slam::DatasetCamera;
+
+    constexpr int kFrames = 12;
+
+    /// A scratch directory removed when the test is done.
+    struct TempDir {
+        fs::path path;
+        TempDir() {
+            path = fs::temp_directory_path() /
+                   ("ar_slam_dataset_" + std::to_string(std::chrono::steady_clock::now()
+                                                            .time_since_epoch()
+                                                            .count()));
+            fs::create_directories(path);
+        }
+        ~TempDir() { fs::remove_all(path); }
+    };
+
+    void write_image(const fs::path& file, int value) {
+        fs::create_directories(file.parent_path());
+        cv::Mat image(12, 16, CV_8UC1, cv::Scalar(value));
+        cv::imwrite(file.string(), image);
+    }
+
+    /// TUM layout: frames 20 ms apart from t = 1305031102.0, listed out of order.
+    fs::path make_tum(const fs::path& root) {
+        std::ofstream list(root / "rgb.txt");
+        list << "# color images\n# timestamp filename\n";
+        for (int i = kFrames - 1; i >= 0; --i) {
+            const std::string file = "rgb/" + std::to_string(i) + ".png";
+            write_image(root / file, i * 10);
+            list << std::fixed << 1305031102.0 + i * 0.02 << " " << file << "\n";
+        }
+        list << "not a frame\n";
+        return root;
+    }
+
+    /// EuRoC layout: nanosecond stamps 50 ms apart, CRLF line ends.
+    fs::path make_euroc(const fs::path& root) {
+        const fs::path cam = root / "mav0" / "cam0";
+        fs::create_directories(cam / "data");
+        std::ofstream csv(cam / "data.csv");
+        csv << "#timestamp [ns],filename\r\n";
+        for (int i = 0; i < 4; ++i) {
+            const std::string stamp = std::to_string(1403636579763555584ULL + i * 50000000ULL);
+            write_image(cam / "data" / (stamp + ".png"), 200 + i);
+            csv << stamp << "," << stamp << ".png\r\n";
+        }
+        return root;
+    }
+
+    ar_slam::CameraConfig at(const fs::path& path) {
+        ar_slam::CameraConfig config;
+        config.device_path = path.string();
+        return config;
+    }
+
+    DatasetCamera::Options fast(unsigned threads = 2, std::size_t prefetch = 4) {
+        DatasetCamera::Options options;
+        options.pacing = DatasetCamera::Pacing::kAsFastAsPossible;
+        options.decode_threads = threads;
+        options.prefetch = prefetch;
+        return options;
+    }
+
+    void test_index_formats() {
+        TempDir dir;
+        std::vector<DatasetCamera::Entry> entries;
+        CHECK(DatasetCamera::load_index(make_tum(dir.path).string(), entries));
+        CHECK(entries.size() == kFrames);
+        CHECK(entries.front().path == (dir.path / "rgb/0.png").string());
+        CHECK(std::abs(entries[3].timestamp - (1305031102.0 + 0.06)) < 1e-6);  // Sorted.
+
+        TempDir euroc;
+        CHECK(DatasetCamera::load_index(make_euroc(euroc.path).string(), entries));
+        CHECK(entries.size() == 4);
+        CHECK(std::abs(entries[1].timestamp - 1403636579.813555584) < 1e-6);
+        CHECK(fs::exists(entries[1].path));
+        CHECK(DatasetCamera::load_index((euroc.path / "mav0/cam0/data.csv").string(), entries));
+
+        TempDir empty;
+        CHECK(!DatasetCamera::load_index(empty.path.string(), entries));
+        CHECK(entries.empty());
+        CHECK(!DatasetCamera::load_index((empty.path / "missing.txt").string(), entries));
+    }
+
+    void test_replay_in_order() {
+        TempDir dir;
+        make_tum(dir.path);
+        // Many decoders racing over a small ring still hand frames out in order.
+        DatasetCamera camera(fast(4, 2));
+        CHECK(camera.open(at(dir.path)));
+        CHECK(camera.is_open() && camera.frame_count() == kFrames);
+        CHECK(std::abs(camera.get_fps() - 50.0) < 1e-3);
+
+        cv::Mat frame;
+        ar_slam::Frame::Timestamp timestamp;
+        int served = 0;
+        while (camera.grab_frame(frame, timestamp)) {
+            CHECK(frame.rows == 12 && frame.cols == 16);
+            CHECK(frame.at<uint8_t>(0, 0) == served * 10);
+            const std::chrono::duration<double> seconds = timestamp.time_since_epoch();
+            CHECK(std::abs(seconds.count() - (1305031102.0 + served * 0.02)) < 1e-6);
+            ++served;
+        }
+        CHECK(served == kFrames);
+        CHECK(camera.position() == kFrames);
+        CHECK(camera.decode_failures() == 0);
+    }
+
+    void test_undecodable_frames_skipped() {
+        TempDir dir;
+        make_tum(dir.path);
+        fs::remove(dir.path / "rgb/4.png");
+        std::ofstream(dir.path / "rgb/5.png") << "not an image";
+
+        DatasetCamera camera(fast());
+        CHECK(camera.open(at(dir.path)));
+        cv::Mat frame;
+        std::vector<int> values;
+        while (camera.grab_frame(frame)) {
+            values.push_back(frame.at<uint8_t>(0, 0));
+        }
+        CHECK(values.size() == kFrames - 2);
+        CHECK(values[3] == 30 && values[4] == 60);
+        CHECK(camera.decode_failures() == 2);
+    }
+
+    void test_seek() {
+        TempDir dir;
+        make_tum(dir.path);
+        DatasetCamera camera(fast(2, 3));
+        CHECK(camera.open(at(dir.path)));
+
+        cv::Mat frame;
+        CHECK(camera.grab_frame(frame) && frame.at<uint8_t>(0, 0) == 0);
+        CHECK(camera.seek(7));
+        CHECK(camera.grab_frame(frame) && frame.at<uint8_t>(0, 0) == 70);
+        CHECK(camera.grab_frame(frame) && frame.at<uint8_t>(0, 0) == 80);
+
+        // Back to the start, and by time: 50 ms lands on the frame at 60 ms.
+        CHECK(camera.seek(0));
+        CHECK(camera.grab_frame(frame) && frame.at<uint8_t>(0, 0) == 0);
+        CHECK(camera.seek_time(1305031102.05));
+        CHECK(camera.position() == 3);
+        CHECK(camera.grab_frame(frame) && frame.at<uint8_t>(0, 0) == 30);
+
+        CHECK(!camera.seek(kFrames));
+        CHECK(!camera.seek_time(1305031200.0));
+        CHECK(camera.position() == 4);  // A failed seek leaves the position alone.
+
+        CHECK(camera.seek(kFrames - 1));
+        CHECK(camera.grab_frame(frame) && !camera.grab_frame(frame));
+    }
+
+    void test_real_time_pacing() {
+        TempDir dir;
+        make_tum(dir.path);
+        DatasetCamera::Options options;
+        options.speed = 2.0;  // 20 ms apart in the data, 10 ms apart on the wall.
+        DatasetCamera camera(options);
+        CHECK(camera.open(at(dir.path)));
+
+        cv::Mat frame;
+        CHECK(camera.grab_frame(frame));
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 1; i < 6; ++i) {
+            CHECK(camera.grab_frame(frame));
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        CHECK(elapsed >= std::chrono::milliseconds(45));
+        CHECK(elapsed < std::chrono::milliseconds(500));
+    }
+
+    void test_decode_ahead_of_consumer() {
+        TempDir dir;
+        make_tum(dir.path);
+        DatasetCamera camera(fast(2, 4));
+        CHECK(camera.open(at(dir.path)));
+
+        // Given time, the decoders fill the ring: the next frames cost no wait.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cv::Mat frame;
+        for (int i = 0; i < 4; ++i) {
+            CHECK(camera.grab_frame(frame));
+        }
+        CHECK(camera.decode_wait_ms() == 0.0);
+
+        camera.close();
+        CHECK(!camera.is_open() && !camera.grab_frame(frame));
+    }
+
+}  // namespace
+
+int main() {
+    test_index_formats();
+    test_replay_in_order();
+    test_undecodable_frames_skipped();
+    test_seek();
+    test_real_time_pacing();
+    test_decode_ahead_of_consumer();
+    return artest::report("test_dataset_camera");
+}
@@ -0,0 +1,214 @@
+// Tests for Frame ingestion from camera-native YUV layouts: luma taken
+// straight from packed 4:2:2 and borrowed from the Y plane of NV12/I420, and
+// colour converted only when it is asked for.
+
+#include <opencv2/opencv.hpp>
+
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "core/frame.h"
+#include "test_util.h"
+
+namespace {
+
+    using ar_slam::Frame;
+    using PixelFormat = ar_slam::Frame::PixelFormat;
+
+    constexpr int kWidth = 64;
+    constexpr int kHeight = 48;
+
+    uchar luma_at(int r, int c) { return static_cast<uchar>((r * 7 + c * 3) & 0xff); }
+
+    bool same_pixels(const cv::Mat& a, const cv::Mat& b) {
+        if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type()) return false;
+        const size_t row_bytes = a.cols * a.elemSize();
+        for (int r = 0; r < a.rows; ++r) {
+            if (std::memcmp(a.ptr<uchar>(r), b.ptr<uchar>(r), row_bytes) != 0) return false;
+        }
+        return true;
+    }
+
+    bool luma_matches(const cv::Mat& gray) {
+        if (gray.rows != kHeight || gray.cols != kWidth || gray.type() != CV_8UC1) return false;
+        for (int r = 0; r < kHeight; ++r) {
+            for (int c = 0; c < kWidth; ++c) {
+                if (gray.ptr<uchar>(r)[c] != luma_at(r, c)) return false;
+            }
+        }
+        return true;
+    }
+
+    // Packed 4:2:2 in rows padded to @p stride bytes, luma at byte @p offset of
+    // each pixel pair and chroma varying across the row.
+    cv::Mat make_packed(std::vector<uchar>& storage, size_t stride, int offset) {
+        storage.assign(stride * kHeight, 0);
+        for (int r = 0; r < kHeight; ++r) {
+            uchar* row = storage.data() + r * stride;
+            for (int c = 0; c < kWidth; ++c) {
+                row[2 * c + offset] = luma_at(r, c);
+                row[2 * c + 1 - offset] = static_cast<uchar>(96 + (c & 0x3f));
+            }
+        }
+        return cv::Mat(kHeight, kWidth, CV_8UC2, storage.data(), stride);
+    }
+
+    // 4:2:0 with the Y plane first; NV12 interleaves the chroma, I420 splits it.
+    cv::Mat make_planar(std::vector<uchar>& storage, size_t stride) {
+        storage.assign(stride * kHeight * 3 / 2, 0);
+        for (int r = 0; r < kHeight; ++r) {
+            for (int c = 0; c < kWidth; ++c) storage[r * stride + c] = luma_at(r, c);
+        }
+        for (size_t i = stride * kHeight; i < storage.size(); ++i) {
+            storage[i] = static_cast<uchar>(100 + i % 56);
+        }
+        return cv::Mat(kHeight * 3 / 2, kWidth, CV_8UC1, storage.data(), stride);
+    }
+
+    void test_packed_luma() {
+        for (int offset : {0, 1}) {
+            const PixelFormat format = offset == 0 ? PixelFormat::kYUYV : PixelFormat::kUYVY;
+            std::vector<uchar> storage;
+            cv::Mat packed = make_packed(storage, kWidth * 2 + 32, offset);
+
+            Frame frame(packed, format);
+            CHECK(frame.get_source_format() == format);
+            CHECK(luma_matches(frame.get_image()));
+            // The luma is extracted; the source stays referenced for colour.
+            CHECK(frame.get_image().data != packed.data);
+        }
+    }
+
+    void test_planar_luma_is_borrowed() {
+        for (PixelFormat format : {PixelFormat::kNV12, PixelFormat::kI420}) {
+            std::vector<uchar> storage;
+            const size_t stride = format == PixelFormat::kNV12 ? kWidth + 16 : kWidth;
+            cv::Mat planar = make_planar(storage, stride);
+
+            Frame frame(planar, format);
+            const cv::Mat& gray = frame.get_image();
+            CHECK(luma_matches(gray));
+            CHECK(gray.data == storage.data());
+            CHECK(gray.step[0] == stride);
+        }
+    }
+
+    void test_colour_is_lazy_and_matches_opencv() {
+        struct Case {
+            PixelFormat format;
+            int code;
+        };
+        const Case cases[] = {
+                {PixelFormat::kYUYV, cv::COLOR_YUV2BGR_YUYV},
+                {PixelFormat::kUYVY, cv::COLOR_YUV2BGR_UYVY},
+                {PixelFormat::kNV12, cv::COLOR_YUV2BGR_NV12},
+                {PixelFormat::kI420, cv::COLOR_YUV2BGR_I420},
+        };
+        for (const Case& c : cases) {
+            std::vector<uchar> storage;
+            cv::Mat source = c.format == PixelFormat::kYUYV   ? make_packed(storage, kWidth * 2, 0)
+                             : c.format == PixelFormat::kUYVY ? make_packed(storage, kWidth * 2, 1)
+                                                              : make_planar(storage, kWidth);
+
+            Frame frame(source, c.format);
+            const size_t before = frame.get_memory_usage();
+            const cv::Mat& colour = frame.get_color_image();
+            CHECK(frame.get_memory_usage() == before + kWidth * kHeight * 3);
+
+            cv::Mat expected;
+            cv::cvtColor(source, expected, c.code);
+            CHECK(same_pixels(colour, expected));
+            // Converted once: later calls return the same image.
+            CHECK(frame.get_color_image().data == colour.data);
+        }
+    }
+
+    void test_gray_colour_on_demand() {
+        cv::Mat gray(kHeight, kWidth, CV_8UC1);
+        for (int r = 0; r < kHeight; ++r) {
+            for (int c = 0; c < kWidth; ++c) gray.ptr<uchar>(r)[c] = luma_at(r, c);
+        }
+
+        Frame frame(gray);
+        CHECK(frame.get_memory_usage() < sizeof(Frame) + kWidth * kHeight * 2);
+        const cv::Mat& colour = frame.get_color_image();
+        CHECK(colour.type() == CV_8UC3);
+        CHECK(colour.ptr<uchar>(5)[3 * 7 + 1] == luma_at(5, 7));
+    }
+
+    void test_colour_converted_once_across_threads() {
+        std::vector<uchar> storage;
+        cv::Mat source = make_planar(storage, kWidth);
+        Frame frame(source, PixelFormat::kNV12);
+
+        std::vector<const uchar*> seen(4, nullptr);
+        std::vector<std::thread> readers;
+        for (size_t i = 0; i < seen.size(); ++i) {
+            readers.emplace_back([&, i] { seen[i] = frame.get_color_image().data; });
+        }
+        for (auto& t : readers) t.join();
+        for (const uchar* data : seen) CHECK(data != nullptr && data == seen[0]);
+    }
+
+    void test_buffer_held_for_colour() {
+        auto storage = std::make_shared<std::vector<uchar>>();
+        cv::Mat packed = make_packed(*storage, kWidth * 2, 0);
+        std::weak_ptr<std::vector<uchar>> watch = storage;
+
+        auto frame = std::make_shared<Frame>(packed, PixelFormat::kYUYV, storage);
+        storage.reset();
+        CHECK(frame->borrows_image());
+        CHECK(!watch.expired());
+
+        // Colour can still be made from the borrowed source, long after capture.
+        CHECK(frame->get_color_image().rows == kHeight);
+        frame.reset();
+        CHECK(watch.expired());
+    }
+
+    void test_channels_pick_the_format() {
+        std::vector<uchar> storage(kWidth * kHeight * 4);
+        for (size_t i = 0; i < storage.size(); ++i) storage[i] = static_cast<uchar>(i * 13);
+        cv::Mat bgra(kHeight, kWidth, CV_8UC4, storage.data());
+        auto buffer = std::make_shared<int>(0);
+
+        // Four channels are BGRA, whether borrowed or copied.
+        cv::Mat gray, bgr;
+        cv::cvtColor(bgra, gray, cv::COLOR_BGRA2GRAY);
+        cv::cvtColor(bgra, bgr, cv::COLOR_BGRA2BGR);
+        const Frame borrowed(bgra, buffer);
+        const Frame copied(bgra);
+        for (const Frame* frame : {&borrowed, &copied}) {
+            CHECK(frame->get_source_format() == PixelFormat::kBGRA);
+            CHECK(same_pixels(frame->get_image(), gray));
+            CHECK(same_pixels(frame->get_color_image(), bgr));
+        }
+        CHECK(borrowed.borrows_image());
+
+        // Two channels could be YUYV or UYVY: without a format nothing is guessed,
+        // and the buffer is not held.
+        std::vector<uchar> packed_storage;
+        cv::Mat packed = make_packed(packed_storage, kWidth * 2, 0);
+        auto held = std::make_shared<int>(0);
+        std::weak_ptr<int> watch = held;
+        Frame unknown(packed, std::move(held));
+        CHECK(unknown.get_image().empty());
+        CHECK(!unknown.borrows_image() && watch.expired());
+        CHECK(Frame(packed).get_image().empty());
+        CHECK(Frame(packed, PixelFormat::kBGR).get_image().empty());
+    }
+
+}  // namespace
+
+int main() {
+    test_packed_luma();
+    test_planar_luma_is_borrowed();
+    test_colour_is_lazy_and_matches_opencv();
+    test_gray_colour_on_demand();
+    test_colour_converted_once_across_threads();
+    test_buffer_held_for_colour();
+    test_channels_pick_the_format();
+    return artest::report("test_frame");
+}
@@ -0,0 +1,123 @@
+// Unit tests for the per-frame bump arena.
+// Verifies that pmr containers allocate from the arena's single block with the
+// requested alignment, that reset() recycles the block wholesale, and that a
+// frame overflowing the block is served from upstream chunks, after which the
+// block grows so that the next such frame fits without touching upstream.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "core/frame_arena.h"
+#include "test_util.h"
+
+namespace {
+
+    /// Upstream that counts what passes through it.
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        int allocations = 0;
+        int live = 0;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++allocations;
+            ++live;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+            --live;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    bool aligned(const void* p, std::size_t alignment) {
+        return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+    }
+
+    void test_bump_and_reset() {
+        CountingResource upstream;
+        {
+            ar_slam::FrameArena arena(64 * 1024, &upstream);
+            CHECK(upstream.allocations == 1);
+            CHECK(arena.capacity() == 64 * 1024);
+
+            const void* first = nullptr;
+            for (int frame = 0; frame < 3; ++frame) {
+                arena.reset();
+                std::pmr::vector<float> err(&arena);
+                err.resize(1000);
+                std::pmr::vector<unsigned char> status(500, 1, &arena);
+                std::pmr::vector<int> ids(&arena);
+                for (int i = 0; i < 300; ++i) {
+                    ids.push_back(i);  // Regrowth: the old buffers are simply abandoned.
+                }
+                if (frame == 0) {
+                    first = err.data();
+                }
+                CHECK(err.data() == first);  // Same addresses every frame.
+                CHECK(aligned(err.data(), alignof(float)));
+                CHECK(aligned(ids.data(), alignof(int)));
+                CHECK(arena.used() >= 1000 * sizeof(float) + 500 + 300 * sizeof(int));
+                CHECK(arena.overflows() == 0);
+            }
+            CHECK(upstream.allocations == 1);  // Three frames, one block.
+
+            arena.reset();
+            CHECK(arena.used() == 0);
+            void* big = arena.allocate(100, 256);
+            CHECK(aligned(big, 256));
+            void* small = arena.allocate(1, 1);
+            CHECK(static_cast<unsigned char*>(small) == static_cast<unsigned char*>(big) + 100);
+
+            ar_slam::FrameArena other(0, &upstream);
+            CHECK(arena.is_equal(arena));
+            CHECK(!arena.is_equal(other));
+        }
+        CHECK(upstream.live == 0);
+    }
+
+    void test_overflow_and_growth() {
+        CountingResource upstream;
+        {
+            ar_slam::FrameArena arena(4096, &upstream);
+            std::vector<void*> blocks;
+            for (int i = 0; i < 20; ++i) {
+                blocks.push_back(arena.allocate(1000, 8));
+            }
+            CHECK(arena.overflows() > 0);
+            CHECK(upstream.live > 1);
+            CHECK(arena.high_water() >= 20000);
+
+            // The chunks go back and the block is sized for the frame just seen.
+            arena.reset();
+            CHECK(upstream.live == 1);
+            CHECK(arena.capacity() >= 20000);
+            const int before = upstream.allocations;
+            for (int i = 0; i < 20; ++i) {
+                blocks[i] = arena.allocate(1000, 8);
+            }
+            CHECK(arena.overflows() == 0);
+            CHECK(upstream.allocations == before);
+
+            // An arena with no initial block sizes itself from its first frame.
+            ar_slam::FrameArena lazy(0, &upstream);
+            CHECK(lazy.capacity() == 0);
+            CHECK(lazy.allocate(5000, 16) != nullptr);
+            lazy.reset();
+            CHECK(lazy.capacity() >= 5000);
+        }
+        CHECK(upstream.live == 0);
+    }
+
+}  // namespace
+
+int main() {
+    test_bump_and_reset();
+    test_overflow_and_growth();
+    return artest::report("test_frame_arena");
+}
@@ -0,0 +1,113 @@
+// Unit tests for the keyframe database and its covisibility graph.
+// Checks edge weights from shared landmarks, the weight ordering behind
+// best_covisible(), two-ring neighbourhoods, duplicate observations and
+// descriptor storage.
+
+#include <cstdint>
+#include <vector>
+
+#include "core/keyframe_database.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+
+namespace {
+
+    // Register keyframe @p id observing landmarks [first, last).
+    void add_range(KeyframeDatabase& db, int id, int first, int last) {
+        MapKeyframe kf;
+        kf.id = id;
+        for (int l = first; l < last; ++l) {
+            kf.observations.push_back({id, l, 1.0 * l, 2.0 * l});
+        }
+        db.insert(kf);
+    }
+
+    void test_weights_and_ordering() {
+        KeyframeDatabase db;
+        add_range(db, 0, 0, 40);   // 0..39
+        add_range(db, 1, 10, 50);  // shares 30 with 0
+        add_range(db, 2, 35, 45);  // shares 5 with 0, 10 with 1
+        add_range(db, 3, 100, 110);
+
+        CHECK(db.size() == 4);
+        CHECK(db.weight(0, 1) == 30 && db.weight(1, 0) == 30);
+        CHECK(db.weight(0, 2) == 5);
+        CHECK(db.weight(1, 2) == 10);
+        CHECK(db.weight(0, 3) == 0);
+        CHECK(db.observers(37).size() == 3);
+        CHECK(db.observers(999).empty());
+
+        const std::vector<int> best = db.best_covisible(2, 5);
+        CHECK(best.size() == 2 && best[0] == 1 && best[1] == 0);
+        CHECK(db.best_covisible(2, 1).size() == 1);
+        CHECK(db.best_covisible(2, 5, 6).size() == 1);  // Weight 5 edge filtered out.
+        CHECK(db.best_covisible(3, 5).empty());
+
+        // Later observations strengthen edges and re-order the neighbour lists.
+        for (int l = 0; l < 30; ++l) {
+            CHECK(db.add_observation({2, l, 0.0, 0.0}));
+        }
+        CHECK(db.weight(2, 0) == 35);
+        CHECK(db.best_covisible(2, 1)[0] == 0);
+        CHECK(db.neighbours(2).front().weight == 35);
+
+        // A keyframe observes each landmark once; unknown keyframes are rejected.
+        CHECK(!db.add_observation({2, 5, 0.0, 0.0}));
+        CHECK(!db.add_observation({9, 5, 0.0, 0.0}));
+        CHECK(db.weight(2, 0) == 35);
+    }
+
+    void test_neighbourhood() {
+        // A chain 0 - 1 - 2 - 3 - 4 where only neighbours share landmarks.
+        KeyframeDatabase db;
+        for (int k = 0; k < 5; ++k) {
+            add_range(db, k, 10 * k, 10 * k + 15);
+        }
+        std::vector<int> local = db.neighbourhood(2, 3);
+        CHECK(local.size() == 3 && local[0] == 2);
+        CHECK(db.weight(2, local[1]) == 5 && db.weight(2, local[2]) == 5);
+
+        // Asking for more pulls in the second ring through the first.
+        local = db.neighbourhood(4, 3);
+        CHECK(local.size() == 3);
+        CHECK(local[0] == 4 && local[1] == 3 && local[2] == 2);
+        CHECK(db.neighbourhood(4, 10).size() == 3);  // Two rings at most.
+        CHECK(db.neighbourhood(7, 3).empty());
+    }
+
+    void test_descriptors() {
+        KeyframeDatabase db;
+        MapKeyframe kf;
+        kf.id = 0;
+        for (int l = 0; l < 3; ++l) {
+            kf.observations.push_back({0, l, 0.0, 0.0});
+            for (std::size_t b = 0; b < kDescriptorBytes; ++b) {
+                kf.descriptors.push_back(static_cast<uint8_t>(l * 10 + b));
+            }
+        }
+        db.insert(kf);
+
+        const MapKeyframe* stored = db.find(0);
+        CHECK(stored != nullptr);
+        CHECK(stored->descriptors.size() == 3 * kDescriptorBytes);
+        CHECK(stored->descriptor(2)[1] == 21);
+
+        // An observation without a descriptor keeps the rows aligned.
+        CHECK(db.add_observation({0, 7, 0.0, 0.0}));
+        CHECK(stored->descriptors.size() == 4 * kDescriptorBytes);
+        CHECK(stored->descriptor(3)[0] == 0);
+        CHECK(stored->descriptor(4) == nullptr);
+
+        db.clear();
+        CHECK(db.empty() && db.find(0) == nullptr);
+    }
+
+}  // namespace
+
+int main() {
+    test_weights_and_ordering();
+    test_neighbourhood();
+    test_descriptors();
+    return artest::report("test_keyframe_database");
+}
@@ -0,0 +1,162 @@
+// Unit tests for the persistent landmark map.
+// Checks scale chaining against known landmarks, append/update deltas, running
+// average fusion, that a replica fed only deltas mirrors the source map, and
+// merging of duplicate track ids through the spatial index.
+
+#include <cmath>
+#include <vector>
+
+#include "core/landmark_map.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+using geometry::Pose;
+using geometry::Vec3;
+
+namespace {
+
+    Pose make_pose(double yaw_deg, const Vec3& t) {
+        double r = yaw_deg * 3.14159265358979323846 / 180.0;
+        Pose p;
+        p.R.m[0][0] = std::cos(r);
+        p.R.m[0][2] = std::sin(r);
+        p.R.m[2][0] = -std::sin(r);
+        p.R.m[2][2] = std::cos(r);
+        p.t = t;
+        return p;
+    }
+
+    void test_relative_scale() {
+        LandmarkMap map;
+        std::vector<int> ids;
+        std::vector<Vec3> world;
+        for (int i = 0; i < 20; ++i) {
+            ids.push_back(i);
+            world.push_back({0.1 * (i % 5) - 0.2, 0.05 * (i / 5), 3.0 + 0.1 * i});
+        }
+        map.add_keyframe(Pose{}, ids, world);
+
+        // A later reconstruction sees the same points from `ref`, but at a
+        // unit-baseline scale that is 1/2.5 of the map's.
+        const Pose ref = make_pose(5.0, {-0.3, 0.0, 0.1});
+        std::vector<Vec3> ref_points;
+        for (const Vec3& X : world) {
+            Vec3 c = ref.transform(X);
+            ref_points.push_back({c[0] / 2.5, c[1] / 2.5, c[2] / 2.5});
+        }
+        CHECK_NEAR(map.relative_scale(ref, ids, ref_points, 8, 1.0), 2.5, 1e-9);
+
+        // Too few shared landmarks: fall back to the supplied scale.
+        std::vector<int> few_ids(ids.begin(), ids.begin() + 3);
+        std::vector<Vec3> few_pts(ref_points.begin(), ref_points.begin() + 3);
+        CHECK_NEAR(map.relative_scale(ref, few_ids, few_pts, 8, 0.7), 0.7, 1e-12);
+    }
+
+    void test_deltas_and_fusion() {
+        LandmarkMap map;
+        MapDelta d0 = map.add_keyframe(Pose{}, {1, 2, 3}, {{0, 0, 1}, {1, 0, 2}, {0, 1, 3}});
+        CHECK(d0.keyframe.id == 0);
+        CHECK(d0.added.size() == 3);
+        CHECK(d0.updated.empty());
+        CHECK(map.size() == 3);
+
+        // Track 2 is re-triangulated, track 4 is new.
+        const Pose p1 = make_pose(3.0, {-0.2, 0, 0});
+        MapDelta d1 = map.add_keyframe(p1, {2, 4}, {{1.2, 0, 2.2}, {2, 2, 4}});
+        CHECK(d1.keyframe.id == 1);
+        CHECK(d1.added.size() == 1 && d1.added[0].id == 4);
+        CHECK(d1.updated.size() == 1 && d1.updated[0].id == 2);
+        CHECK(map.size() == 4);
+
+        const Landmark* lm = map.find(2);
+        CHECK(lm != nullptr);
+        CHECK_NEAR(lm->position[0], 1.1, 1e-12);  // mean of 1.0 and 1.2
+        CHECK_NEAR(lm->position[2], 2.1, 1e-12);
+        CHECK(lm->observations == 2);
+        CHECK(lm->first_keyframe == 0 && lm->last_keyframe == 1);
+        CHECK(map.index_of(4) == 3);  // appended in insertion order
+        CHECK(map.find(99) == nullptr);
+        CHECK(map.keyframes().size() == 2);
+        CHECK_NEAR(map.keyframes()[1].pose.t[0], -0.2, 1e-12);
+
+        // A replica that only sees the deltas ends up identical.
+        LandmarkMap replica;
+        replica.apply(d0);
+        replica.apply(d1);
+        CHECK(replica.size() == map.size());
+        for (std::size_t i = 0; i < map.size(); ++i) {
+            const Landmark& a = map.landmarks()[i];
+            const Landmark& b = replica.landmarks()[i];
+            CHECK(a.id == b.id);
+            CHECK(a.observations == b.observations);
+            CHECK_NEAR(a.position[0], b.position[0], 1e-12);
+            CHECK_NEAR(a.position[1], b.position[1], 1e-12);
+            CHECK_NEAR(a.position[2], b.position[2], 1e-12);
+        }
+
+        map.clear();
+        CHECK(map.empty() && map.keyframes().empty());
+    }
+
+    void test_duplicate_merging() {
+        VoxelGrid::Config spatial;
+        spatial.voxel_size = 0.1;
+        spatial.merge_radius = 0.05;
+        LandmarkMap map(spatial);
+        map.add_keyframe(Pose{}, {1, 2}, {Vec3{0.0, 0.0, 5.0}, Vec3{1.0, 0.0, 5.0}},
+                         {{0, 1, 320.0, 240.0}, {0, 2, 420.0, 240.0}});
+        CHECK(map.spatial_index().size() == 2);
+
+        // Track 7 re-triangulates landmark 1 (fresh id after a re-detection); track
+        // 8 lands next to landmark 2, which this keyframe also observes directly,
+        // so it stays a separate point.
+        const MapDelta d = map.add_keyframe(
+            Pose{}, {7, 2, 8},
+            {Vec3{0.02, 0.0, 5.0}, Vec3{1.0, 0.0, 5.0}, Vec3{1.03, 0.0, 5.0}},
+            {{1, 7, 322.0, 240.0}, {1, 2, 420.0, 240.0}, {1, 8, 423.0, 240.0}});
+        CHECK(d.merged.size() == 1);
+        CHECK(d.merged[0].id == 7 && d.merged[0].into == 1);
+        CHECK(d.added.size() == 1 && d.added[0].id == 8);
+        CHECK(map.size() == 3);
+        CHECK(map.find(7) == map.find(1));
+        CHECK(map.index_of(7) == 0);
+        CHECK_NEAR(map.find(1)->position[0], 0.01, 1e-12);
+        CHECK(map.find(1)->observations == 2);
+        // Observations are filed under the landmark's id, linking both keyframes.
+        CHECK(map.keyframes()[1].observations[0].landmark == 1);
+        CHECK(map.database().weight(0, 1) == 2);
+
+        // The index follows position updates and corrections.
+        std::vector<int> near;
+        map.spatial_index().radius_search({0.01, 0.0, 5.0}, 1e-6, near);
+        CHECK(near == std::vector<int>({0}));
+        MapRefinement r;
+        r.newest_keyframe = 1;
+        r.landmarks.push_back({8, {3.0, 0.0, 5.0}});
+        map.refine(r);
+        map.spatial_index().radius_search({3.0, 0.0, 5.0}, 1e-6, near);
+        CHECK(near == std::vector<int>({2}));
+
+        // A replica fed the deltas resolves the alias too.
+        LandmarkMap replica;
+        LandmarkMap source(spatial);
+        replica.apply(source.add_keyframe(Pose{}, {1}, {Vec3{0.0, 0.0, 5.0}}));
+        replica.apply(source.add_keyframe(Pose{}, {7}, {Vec3{0.01, 0.0, 5.0}}));
+        CHECK(replica.size() == 1);
+        CHECK(replica.find(7) != nullptr && replica.find(7)->id == 1);
+
+        // Without a merge radius every new id is a new landmark.
+        LandmarkMap plain;
+        plain.add_keyframe(Pose{}, {1}, {Vec3{0.0, 0.0, 5.0}});
+        plain.add_keyframe(Pose{}, {7}, {Vec3{0.0, 0.0, 5.0}});
+        CHECK(plain.size() == 2);
+    }
+
+}  // namespace
+
+int main() {
+    test_relative_scale();
+    test_deltas_and_fusion();
+    test_duplicate_merging();
+    return artest::report("test_landmark_map");
+}
@@ -0,0 +1,201 @@
+// Unit tests for the per-thread magazine layer over the lock-free pool.
+// Verifies batched refill and flush against the shared pool, the hard
+// capacity, that a thread's cached slots go back when it exits, that a thread
+// outliving its pool does not touch freed memory, and uniqueness of slots under
+// many threads allocating and freeing each other's objects.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/magazine_pool.h"
+#include "test_util.h"
+
+namespace {
+
+    std::size_t budget_for(std::size_t objects) {
+        return (sizeof(uint64_t) + sizeof(uint32_t)) * objects;
+    }
+
+    void test_refill_and_flush() {
+        ar_slam::MagazinePool<uint64_t> pool(budget_for(64), 8);
+        CHECK(pool.capacity() == 64);
+        CHECK(pool.magazine_size() == 8);
+
+        // The first allocation refills half a magazine in one batch.
+        uint64_t* a = pool.allocate();
+        CHECK(a != nullptr && pool.owns(a));
+        CHECK(pool.used() == 4);
+        CHECK(pool.cached() == 3);
+
+        std::vector<uint64_t*> held{a};
+        for (int i = 0; i < 11; ++i) {
+            held.push_back(pool.allocate());
+        }
+        CHECK(pool.used() == 12);
+        CHECK(pool.cached() == 0);
+
+        // Freeing fills the magazine; the next free sends the older half back.
+        for (int i = 0; i < 8; ++i) {
+            pool.deallocate(held.back());
+            held.pop_back();
+        }
+        CHECK(pool.cached() == 8);
+        CHECK(pool.used() == 12);
+        pool.deallocate(held.back());
+        held.pop_back();
+        CHECK(pool.cached() == 5);
+        CHECK(pool.used() == 8);
+
+        // Most recently freed comes back first.
+        uint64_t* last = held.back();
+        pool.deallocate(last);
+        held.pop_back();
+        CHECK(pool.allocate() == last);
+        pool.deallocate(last);
+
+        for (uint64_t* p : held) {
+            pool.deallocate(p);
+        }
+        pool.flush();
+        CHECK(pool.cached() == 0);
+        CHECK(pool.used() == 0);
+    }
+
+    void test_exhaustion() {
+        ar_slam::MagazinePool<uint64_t> pool(budget_for(6), 4);
+        std::vector<uint64_t*> held;
+        while (uint64_t* p = pool.allocate()) {
+            held.push_back(p);
+        }
+        CHECK(held.size() == 6);  // A short final batch is still handed out.
+        std::sort(held.begin(), held.end());
+        CHECK(std::adjacent_find(held.begin(), held.end()) == held.end());
+        for (uint64_t* p : held) {
+            pool.deallocate(p);
+        }
+        pool.flush();
+        CHECK(pool.available() == 6);
+    }
+
+    void test_thread_exit() {
+        ar_slam::MagazinePool<uint64_t> pool(budget_for(256), 16);
+        std::thread worker([&pool] {
+            std::vector<uint64_t*> held;
+            for (int i = 0; i < 40; ++i) {
+                held.push_back(pool.allocate());
+            }
+            for (uint64_t* p : held) {
+                pool.deallocate(p);
+            }
+        });
+        worker.join();
+        CHECK(pool.used() == 0);  // The exiting thread drained its magazine.
+
+        // A thread that outlives its pool must drop, not flush, its magazine.
+        auto doomed = std::make_unique<ar_slam::MagazinePool<uint64_t>>(budget_for(64), 8);
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool cached = false;
+        bool destroyed = false;
+        std::thread survivor([&] {
+            doomed->deallocate(doomed->allocate());
+            std::unique_lock<std::mutex> lock(mutex);
+            cached = true;
+            cv.notify_all();
+            cv.wait(lock, [&] { return destroyed; });
+        });
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return cached; });
+            doomed.reset();
+            destroyed = true;
+            cv.notify_all();
+        }
+        survivor.join();
+
+        // Its entry is reused by the next pool.
+        ar_slam::MagazinePool<uint64_t> next(budget_for(64), 8);
+        uint64_t* p = next.allocate();
+        CHECK(next.owns(p));
+        next.deallocate(p);
+    }
+
+    void test_many_threads() {
+        const int kThreads = 8;
+        const int kRounds = 20000;
+        ar_slam::MagazinePool<uint64_t> pool(budget_for(1024), 32);
+
+        std::mutex bin_mutex;
+        std::vector<uint64_t*> bin;
+        std::atomic<int> corrupted{0};
+
+        auto worker = [&](int id) {
+            std::vector<uint64_t*> held;
+            uint32_t rng = 2654435761u * static_cast<uint32_t>(id + 1);
+            for (int round = 0; round < kRounds; ++round) {
+                rng = rng * 1664525u + 1013904223u;
+                const int burst = 1 + static_cast<int>((rng >> 24) % 24);
+                for (int k = 0; k < burst; ++k) {
+                    uint64_t* p = pool.allocate();
+                    if (p == nullptr) {
+                        break;
+                    }
+                    *p = static_cast<uint64_t>(id);
+                    held.push_back(p);
+                }
+                for (std::size_t k = 0; k < held.size(); ++k) {
+                    if (*held[k] != static_cast<uint64_t>(id)) {
+                        ++corrupted;
+                    }
+                    if (k % 3 != 0) {
+                        pool.deallocate(held[k]);
+                    } else {
+                        std::lock_guard<std::mutex> lock(bin_mutex);
+                        bin.push_back(held[k]);
+                    }
+                }
+                held.clear();
+                std::vector<uint64_t*> taken;
+                {
+                    std::lock_guard<std::mutex> lock(bin_mutex);
+                    const std::size_t n = std::min<std::size_t>(bin.size(), 8);
+                    taken.assign(bin.end() - n, bin.end());
+                    bin.resize(bin.size() - n);
+                }
+                for (uint64_t* p : taken) {
+                    pool.deallocate(p);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back(worker, t);
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        for (uint64_t* p : bin) {
+            pool.deallocate(p);
+        }
+        pool.flush();
+
+        CHECK(corrupted == 0);
+        CHECK(pool.used() == 0);
+    }
+
+}  // namespace
+
+int main() {
+    test_refill_and_flush();
+    test_exhaustion();
+    test_thread_exit();
+    test_many_threads();
+    return artest::report("test_magazine_pool");
+}
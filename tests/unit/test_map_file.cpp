@@ -0,0 +1,281 @@
+// Unit tests for the memory-mapped map file.
+// Round-trips a map with descriptors, aliases and covisibility through a
+// snapshot, streams a growing (and refined) map as appended segments, and
+// checks that corruption is rejected while a torn last segment is dropped and
+// can be resumed from.
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "core/map_file.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+
+namespace {
+
+    using artest::Lcg;
+
+    // Add keyframe number @p n: ten new landmarks, five of the previous keyframe's
+    // re-observed, and three of the new ones also seen by the previous keyframe.
+    // Odd keyframes carry descriptors. Keyframe 3 re-detects landmark 101 under a
+    // fresh track id, which the map merges.
+    void grow(LandmarkMap& map, int n, Lcg& rng) {
+        const int kf = map.next_keyframe_id();
+        geometry::Pose pose;
+        pose.t = {0.1 * n, 0.0, 0.0};
+        std::vector<int> ids;
+        std::vector<geometry::Vec3> points;
+        std::vector<MapObservation> observations;
+        for (int j = 0; j < 10; ++j) {
+            ids.push_back(100 * (n + 1) + j);
+            points.push_back({rng.uniform(-1.0, 1.0) + n, rng.uniform(-1.0, 1.0), 4.0});
+        }
+        for (int j = 0; j < 5 && n > 0; ++j) {
+            const Landmark* lm = map.find(100 * n + j);
+            ids.push_back(lm->id);
+            points.push_back({lm->position[0] + 0.01, lm->position[1], lm->position[2]});
+        }
+        if (n == 3) {
+            ids.push_back(9999);
+            points.push_back(map.find(101)->position);
+        }
+        for (int id : ids) {
+            observations.push_back({kf, id, rng.uniform(0.0, 640.0), rng.uniform(0.0, 480.0)});
+        }
+        for (int j = 0; j < 3 && kf > 0; ++j) {
+            observations.push_back({kf - 1, ids[j], rng.uniform(0.0, 640.0), 240.0});
+        }
+        std::vector<uint8_t> descriptors;
+        if (n % 2 == 1) {
+            for (std::size_t i = 0; i < observations.size() * kDescriptorBytes; ++i) {
+                descriptors.push_back(static_cast<uint8_t>(rng.next()));
+            }
+        }
+        map.add_keyframe(pose, ids, points, observations, descriptors);
+    }
+
+    LandmarkMap make_map() { return LandmarkMap(VoxelGrid::Config{0.1, 0.05, 64}); }
+
+    bool same_pose(const geometry::Pose& a, const geometry::Pose& b) {
+        return std::memcmp(&a, &b, sizeof(a)) == 0;
+    }
+
+    void check_same(const LandmarkMap& a, const LandmarkMap& b) {
+        CHECK(a.keyframes().size() == b.keyframes().size());
+        for (std::size_t k = 0; k < a.keyframes().size() && k < b.keyframes().size(); ++k) {
+            const MapKeyframe& x = a.keyframes()[k];
+            const MapKeyframe& y = b.keyframes()[k];
+            CHECK(x.id == y.id && same_pose(x.pose, y.pose));
+            CHECK(x.observations.size() == y.observations.size());
+            for (std::size_t i = 0; i < x.observations.size() && i < y.observations.size(); ++i) {
+                const MapObservation& o = x.observations[i];
+                const MapObservation& p = y.observations[i];
+                CHECK(o.keyframe == p.keyframe && o.landmark == p.landmark && o.u == p.u &&
+                      o.v == p.v);
+            }
+            CHECK(x.descriptors == y.descriptors);
+            const std::vector<CovisibilityEdge>& ex = a.database().neighbours(x.id);
+            const std::vector<CovisibilityEdge>& ey = b.database().neighbours(y.id);
+            CHECK(ex.size() == ey.size());
+            for (const CovisibilityEdge& e : ex) {
+                CHECK(b.database().weight(y.id, e.keyframe) == e.weight);
+            }
+        }
+        CHECK(a.size() == b.size());
+        for (std::size_t i = 0; i < a.size() && i < b.size(); ++i) {
+            const Landmark& x = a.landmarks()[i];
+            const Landmark& y = b.landmarks()[i];
+            CHECK(x.id == y.id && x.position == y.position && x.observations == y.observations &&
+                  x.first_keyframe == y.first_keyframe && x.last_keyframe == y.last_keyframe);
+        }
+        CHECK(a.aliases().size() == b.aliases().size());
+        for (const LandmarkAlias& alias : a.aliases()) {
+            CHECK(b.find(alias.id) != nullptr && b.find(alias.id)->id == alias.into);
+        }
+        CHECK(a.spatial_index().size() == b.spatial_index().size());
+    }
+
+    void test_snapshot_round_trip() {
+        Lcg rng{1};
+        LandmarkMap map = make_map();
+        for (int n = 0; n < 6; ++n) {
+            grow(map, n, rng);
+        }
+        CHECK(map.aliases().size() == 1 && map.find(9999)->id == 101);
+
+        const std::string path = "test_map_file.armp";
+        CHECK(MapWriter::save(map, path));
+        MapFile file;
+        CHECK(file.open(path));
+        CHECK(!file.truncated());
+        CHECK(file.segments().size() == 1);
+        const MapSegment* s = file.snapshot();
+        CHECK(s != nullptr && s->kind == MapSegment::kSnapshot);
+
+        // The arrays are read in place, aligned to 64 bytes.
+        CHECK(s->keyframe_ids.size == map.keyframes().size());
+        CHECK(s->landmark_ids.size == map.size());
+        CHECK(reinterpret_cast<uintptr_t>(s->positions.data) % 64 == 0);
+        CHECK(reinterpret_cast<uintptr_t>(s->observations.data) % 64 == 0);
+        for (std::size_t i = 0; i < map.size(); ++i) {
+            CHECK(s->landmark_ids[i] == map.landmarks()[i].id);
+            CHECK(s->positions[i] == map.landmarks()[i].position);
+        }
+        CHECK(s->observations_of(2).size == map.keyframes()[2].observations.size());
+        CHECK(s->neighbours_of(2).size == map.database().neighbours(2).size());
+        CHECK(s->descriptor(0) != nullptr);
+
+        LandmarkMap restored = make_map();
+        CHECK(file.restore(restored));
+        check_same(map, restored);
+
+        // The restored map keeps mapping like the original.
+        Lcg a{9}, b{9};
+        grow(map, 6, a);
+        grow(restored, 6, b);
+        check_same(map, restored);
+        std::remove(path.c_str());
+    }
+
+    void test_streaming_append() {
+        const std::string path = "test_map_file_stream.armp";
+        Lcg rng{2};
+        LandmarkMap map = make_map();
+        MapWriter writer;
+        CHECK(writer.create(path));
+        for (int n = 0; n < 8; ++n) {
+            grow(map, n, rng);
+            CHECK(writer.append(map));
+        }
+        // Refine two poses and a landmark as bundle adjustment would.
+        MapRefinement refinement;
+        refinement.newest_keyframe = map.next_keyframe_id() - 1;
+        refinement.generation = map.generation();
+        geometry::Pose moved;
+        moved.t = {5.0, 5.0, 5.0};
+        refinement.keyframes = {{1, moved}, {4, moved}};
+        refinement.landmarks = {{203, {1.0, 2.0, 3.0}}};
+        map.refine(refinement);
+        CHECK(writer.append(map));
+        CHECK(writer.append(map));  // Nothing changed: an empty segment.
+        CHECK(writer.segments() == 10);
+        CHECK(writer.close());
+
+        MapFile file;
+        CHECK(file.open(path));
+        CHECK(file.segments().size() == 10);
+        CHECK(file.snapshot() == &file.segments()[0]);
+        const MapSegment& last_keyframe = file.segments()[7];
+        CHECK(last_keyframe.kind == MapSegment::kAppend);
+        CHECK(last_keyframe.keyframe_ids.size == 2);  // The new keyframe and its predecessor.
+        CHECK(last_keyframe.observations_of(0).size == 3);
+        CHECK(last_keyframe.landmark_ids.size == 15);  // Ten added, five fused.
+        CHECK(last_keyframe.covisibility_offsets.empty());
+        const MapSegment& refined = file.segments()[8];
+        CHECK(refined.keyframe_ids.size == 2 && refined.observations.empty());
+        CHECK(refined.landmark_ids.size == 1 && refined.landmark_ids[0] == 203);
+        CHECK(file.segments()[9].keyframe_ids.empty() && file.segments()[9].landmark_ids.empty());
+
+        LandmarkMap restored = make_map();
+        CHECK(file.restore(restored));
+        check_same(map, restored);
+        file.close();
+
+        // A checkpoint supersedes everything before it.
+        CHECK(writer.resume(path, restored));
+        grow(map, 8, rng);
+        CHECK(writer.checkpoint(map));
+        CHECK(writer.close());
+        CHECK(file.open(path));
+        CHECK(file.segments().size() == 11);
+        CHECK(file.snapshot() == &file.segments()[10]);
+        CHECK(file.restore(restored));
+        check_same(map, restored);
+        std::remove(path.c_str());
+    }
+
+    void test_corruption_and_torn_tail() {
+        const std::string path = "test_map_file_torn.armp";
+        Lcg rng{3};
+        LandmarkMap map = make_map();
+        MapWriter writer;
+        CHECK(writer.create(path));
+        for (int n = 0; n < 3; ++n) {
+            grow(map, n, rng);
+            CHECK(writer.append(map));
+        }
+        const LandmarkMap before = map;
+        const uint64_t good = writer.size();
+        grow(map, 3, rng);
+        CHECK(writer.append(map));
+        const uint64_t full = writer.size();
+        CHECK(writer.close());
+
+        // A crash mid-append: the torn segment is dropped, the rest still loads.
+        CHECK(::truncate(path.c_str(), static_cast<off_t>(full - 100)) == 0);
+        MapFile file;
+        CHECK(file.open(path));
+        CHECK(file.truncated());
+        CHECK(file.segments().size() == 3);
+        CHECK(file.valid_size() == good);
+        LandmarkMap restored = make_map();
+        CHECK(file.restore(restored));
+        check_same(before, restored);
+        file.close();
+
+        // Resuming cuts the tail off and carries on from the restored map.
+        CHECK(writer.resume(path, restored));
+        CHECK(writer.size() == good);
+        Lcg replay{77};
+        LandmarkMap expected = before;
+        grow(restored, 3, replay);
+        replay = Lcg{77};
+        grow(expected, 3, replay);
+        CHECK(writer.append(restored));
+        CHECK(writer.close());
+        CHECK(file.open(path));
+        CHECK(!file.truncated() && file.segments().size() == 4);
+        LandmarkMap again = make_map();
+        CHECK(file.restore(again));
+        check_same(expected, again);
+        file.close();
+
+        // A flipped byte inside a section fails the checksum; structure checks
+        // alone do not see it.
+        std::FILE* f = std::fopen(path.c_str(), "r+b");
+        std::fseek(f, 64 + 576 + 1, SEEK_SET);
+        const int c = std::fgetc(f);
+        std::fseek(f, 64 + 576 + 1, SEEK_SET);
+        std::fputc(c ^ 0x10, f);
+        std::fclose(f);
+        CHECK(!file.open(path));
+        CHECK(file.open(path, false));
+        file.close();
+
+        // Not a map file, or a newer version.
+        f = std::fopen(path.c_str(), "r+b");
+        std::fseek(f, 4, SEEK_SET);
+        const uint32_t version = map_file_detail::kFileVersion + 1;
+        std::fwrite(&version, sizeof(version), 1, f);
+        std::fclose(f);
+        CHECK(!file.open(path));
+        CHECK(!file.open("does_not_exist.armp"));
+        LandmarkMap untouched = make_map();
+        CHECK(file.restore(untouched) && untouched.empty());
+        std::remove(path.c_str());
+    }
+
+}  // namespace
+
+int main() {
+    test_snapshot_round_trip();
+    test_streaming_append();
+    test_corruption_and_torn_tail();
+    return artest::report("test_map_file");
+}
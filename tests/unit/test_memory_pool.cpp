@@ -1,7 +1,15 @@
 // Unit tests for the fixed-capacity object pool.
 // Verifies capacity derivation, O(1) reuse from a real slab, enforced
-// exhaustion, correct construction/destruction, and move semantics.
+// exhaustion, correct construction/destruction, and move semantics; for the
+// growable mode, on-demand slabs up to the ceiling, ownership through the slab
+// index, and emptied slabs going back to the system; for mmap'd slab backing,
+// alignment, pre-faulted residency, and graceful fallback of every option.
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
@@ -101,6 +109,172 @@ namespace {
         CHECK(Tracked::live == 0);
     }
 
+    void test_growable() {
+        ar_slam::MemoryPool<Tracked>::Growth growth;
+        growth.slab_bytes = 4096;
+        ar_slam::MemoryPool<Tracked> pool(16 * 4096, growth);
+        CHECK(pool.growable());
+        CHECK(pool.slabs() == 0);  // Nothing reserved until first use.
+        CHECK(pool.capacity_bytes() == 0);
+        const std::size_t per_slab = pool.capacity() / 16;
+        CHECK(per_slab > 100);
+
+        std::vector<Tracked*> objs;
+        for (std::size_t i = 0; i < per_slab; ++i) {
+            objs.push_back(pool.create(static_cast<int>(i)));
+        }
+        CHECK(pool.slabs() == 1);
+        objs.push_back(pool.create(-1));
+        CHECK(pool.slabs() == 2);
+        CHECK(pool.capacity_bytes() == 2 * 4096);
+
+        while (Tracked* t = pool.create(7)) {
+            objs.push_back(t);
+        }
+        CHECK(objs.size() == pool.capacity());
+        CHECK(pool.full());
+        CHECK(pool.slabs() == 16);
+        for (Tracked* t : objs) {
+            CHECK(pool.owns(t));
+        }
+        std::vector<Tracked*> sorted = objs;
+        std::sort(sorted.begin(), sorted.end());
+        CHECK(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+        {
+            Tracked outside(0);
+            CHECK(!pool.owns(&outside));
+        }
+
+        // Freed slots are reused before another slab would be needed.
+        pool.destroy(objs[5]);
+        objs[5] = pool.create(5);
+        CHECK(objs[5] != nullptr);
+
+        for (Tracked* t : objs) {
+            pool.destroy(t);
+        }
+        CHECK(pool.used() == 0);
+        CHECK(pool.slabs() == 16);  // Kept: release_free_slabs is off.
+        CHECK(Tracked::live == 0);
+
+        ar_slam::MemoryPool<Tracked> moved(std::move(pool));
+        CHECK(moved.slabs() == 16);
+        Tracked* t = moved.create(1);
+        CHECK(moved.owns(t));
+        moved.destroy(t);
+        CHECK(pool.allocate() == nullptr);
+    }
+
+    void test_growable_release() {
+        ar_slam::MemoryPool<Tracked>::Growth growth;
+        growth.slab_bytes = 4096;
+        growth.release_free_slabs = true;
+        ar_slam::MemoryPool<Tracked> pool(64 * 4096, growth);
+        const std::size_t per_slab = pool.capacity() / 64;
+
+        std::vector<Tracked*> objs;
+        for (std::size_t i = 0; i < 4 * per_slab; ++i) {
+            objs.push_back(pool.create(1));
+        }
+        CHECK(pool.slabs() == 4);
+
+        // Freeing every other object empties no slab.
+        for (std::size_t i = 0; i < objs.size(); i += 2) {
+            pool.destroy(objs[i]);
+            objs[i] = nullptr;
+        }
+        CHECK(pool.slabs() == 4);
+
+        // Emptying slabs releases all but one spare.
+        for (Tracked*& o : objs) {
+            pool.destroy(o);
+            o = nullptr;
+        }
+        CHECK(pool.used() == 0);
+        CHECK(pool.slabs() == 1);
+        CHECK(pool.capacity_bytes() == 4096);
+
+        // The spare is reused, then the pool grows again.
+        for (std::size_t i = 0; i < per_slab + 1; ++i) {
+            objs.push_back(pool.create(2));
+        }
+        CHECK(pool.slabs() == 2);
+        for (Tracked* o : objs) {
+            pool.destroy(o);
+        }
+        CHECK(Tracked::live == 0);
+    }
+
+    /// Pages of [data, data + bytes) currently resident in RAM.
+    std::size_t resident_pages(const void* data, std::size_t bytes) {
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::vector<unsigned char> status((bytes + page - 1) / page);
+        if (::mincore(const_cast<void*>(data), bytes, status.data()) != 0) {
+            return 0;
+        }
+        return static_cast<std::size_t>(
+            std::count_if(status.begin(), status.end(), [](unsigned char s) { return s & 1; }));
+    }
+
+    void test_slab_backing() {
+        using ar_slam::SlabBacking;
+        ar_slam::MemoryPool<Tracked> plain(budget_for(64));
+        CHECK(plain.backing_flags() == 0);  // Default: operator new, as before.
+
+        // Every option is best effort: whatever the system refuses, the pool works.
+        SlabBacking backing;
+        backing.pages = SlabBacking::Pages::kHuge;
+        backing.lock = true;
+        backing.numa_node = 0;
+        ar_slam::MemoryPool<Tracked> fixed(4 << 20, backing);
+        CHECK((fixed.backing_flags() & SlabBacking::kMapped) != 0);
+        std::vector<Tracked*> objs;
+        while (Tracked* t = fixed.create(3)) {
+            objs.push_back(t);
+        }
+        CHECK(objs.size() == fixed.capacity());
+        for (Tracked* t : objs) {
+            fixed.destroy(t);
+        }
+        ar_slam::MemoryPool<Tracked> moved(std::move(fixed));
+        CHECK((moved.backing_flags() & SlabBacking::kMapped) != 0);
+        CHECK(fixed.backing_flags() == 0);
+
+        SlabBacking unreachable;
+        unreachable.numa_node = 1000;
+        ar_slam::MemoryPool<Tracked> unbound(budget_for(64), unreachable);
+        CHECK((unbound.backing_flags() & SlabBacking::kNumaBound) == 0);
+        Tracked* t = unbound.create(1);
+        CHECK(t != nullptr);
+        unbound.destroy(t);
+
+        // A growable pool's mapped slabs stay aligned to their span, and a
+        // pre-faulted slab is entirely resident before its slots are touched.
+        ar_slam::MemoryPool<Tracked>::Growth growth;
+        growth.slab_bytes = 1 << 20;
+        growth.release_free_slabs = true;
+        growth.backing.pages = SlabBacking::Pages::kTransparentHuge;
+        growth.backing.prefault = true;
+        ar_slam::MemoryPool<Tracked> growable(8 << 20, growth);
+        Tracked* first = growable.create(1);
+        CHECK((growable.backing_flags() & SlabBacking::kPrefaulted) != 0);
+        const auto slab = reinterpret_cast<std::uintptr_t>(first) & ~((std::size_t{1} << 20) - 1);
+        CHECK(growable.owns(first));
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        CHECK(resident_pages(reinterpret_cast<void*>(slab), 1 << 20) == (1 << 20) / page);
+
+        objs.clear();
+        objs.push_back(first);
+        while (growable.slabs() < 3) {
+            objs.push_back(growable.create(2));
+        }
+        for (Tracked* t : objs) {
+            growable.destroy(t);
+        }
+        CHECK(growable.slabs() == 1);  // Released slabs were unmapped, one spare kept.
+        CHECK(Tracked::live == 0);
+    }
+
 }  // namespace
 
 int main() {
@@ -108,5 +282,8 @@ int main() {
     test_reuse();
     test_move();
     test_minimum_capacity();
+    test_growable();
+    test_growable_release();
+    test_slab_backing();
     return artest::report("test_memory_pool");
 }
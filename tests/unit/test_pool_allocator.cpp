@@ -0,0 +1,171 @@
+// Unit tests for the pool-backed memory resource and std allocator adapter.
+// Verifies size-class routing (pooled, too large, over-aligned), that node
+// containers through PoolAllocator draw every node from the pools and return
+// them on erase, rebind and equality, uses-allocator propagation through pmr
+// containers, and the fall back to upstream once a class reaches its ceiling.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory_resource>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "core/pool_allocator.h"
+#include "test_util.h"
+
+namespace {
+
+    using ar_slam::PoolAllocator;
+    using ar_slam::PoolResource;
+
+    /// Upstream that counts what passes through it.
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        int allocations = 0;
+        int live = 0;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++allocations;
+            ++live;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+            --live;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    void test_size_classes() {
+        CountingResource upstream;
+        {
+            PoolResource resource(1 << 20, 4096, &upstream);
+            CHECK(resource.reserved_bytes() == 0);  // No class touched yet.
+
+            void* a = resource.allocate(1, 1);
+            void* b = resource.allocate(16, 16);
+            void* c = resource.allocate(PoolResource::kMaxBlock, 8);
+            CHECK(resource.pooled_blocks() == 3);
+            CHECK(reinterpret_cast<std::uintptr_t>(b) % 16 == 0);
+            CHECK(resource.reserved_bytes() == 2 * 4096);  // Classes 16 and 256.
+            CHECK(upstream.allocations == 0);
+
+            void* big = resource.allocate(PoolResource::kMaxBlock + 1, 8);
+            void* wide = resource.allocate(64, 64);
+            CHECK(resource.upstream_allocations() == 2);
+            CHECK(upstream.live == 2);
+
+            resource.deallocate(a, 1, 1);
+            resource.deallocate(b, 16, 16);
+            resource.deallocate(c, PoolResource::kMaxBlock, 8);
+            resource.deallocate(big, PoolResource::kMaxBlock + 1, 8);
+            resource.deallocate(wide, 64, 64);
+            CHECK(resource.pooled_blocks() == 0);
+            CHECK(upstream.live == 0);
+
+            // Same size class: the slot just freed is handed out again.
+            void* d = resource.allocate(12, 4);
+            CHECK(d == b || d == a);
+            resource.deallocate(d, 12, 4);
+        }
+        CHECK(upstream.live == 0);
+    }
+
+    void test_node_containers() {
+        PoolResource resource;
+        {
+            PoolAllocator<int> alloc(&resource);
+            std::set<int, std::less<int>, PoolAllocator<int>> set(alloc);
+            std::list<int, PoolAllocator<int>> list(alloc);
+            std::map<int, double, std::less<int>, PoolAllocator<std::pair<const int, double>>>
+                map(alloc);
+            for (int i = 0; i < 10000; ++i) {
+                set.insert(i);
+                list.push_back(i);
+                map[i] = i * 0.5;
+            }
+            CHECK(resource.pooled_blocks() == 30000);
+            CHECK(resource.upstream_allocations() == 0);
+
+            for (int i = 0; i < 10000; i += 2) {
+                set.erase(i);
+                map.erase(i);
+            }
+            list.remove_if([](int v) { return v % 2 == 0; });
+            CHECK(resource.pooled_blocks() == 15000);
+            const std::size_t reserved = resource.reserved_bytes();
+            for (int i = 0; i < 10000; i += 2) {
+                set.insert(i);
+                map[i] = 0.0;
+            }
+            CHECK(resource.reserved_bytes() == reserved);  // Freed nodes were reused.
+            CHECK(set.size() == 10000 && map.size() == 10000 && *set.rbegin() == 9999);
+
+            // Rebound copies share the resource and compare equal.
+            PoolAllocator<double> rebound(set.get_allocator());
+            CHECK(rebound == alloc);
+            CHECK(rebound.resource() == &resource);
+            PoolResource other;
+            CHECK(PoolAllocator<int>(&other) != alloc);
+        }
+        CHECK(resource.pooled_blocks() == 0);
+    }
+
+    void test_pmr_containers() {
+        CountingResource upstream;
+        {
+            PoolResource resource(1 << 20, 4096, &upstream);
+            std::pmr::map<int, std::pmr::vector<int>> trails(&resource);
+            for (int i = 0; i < 100; ++i) {
+                trails[i].push_back(i);
+            }
+            // Uses-allocator construction hands the resource to the nested vectors.
+            CHECK(trails[7].get_allocator().resource() == &resource);
+            CHECK(resource.pooled_blocks() == 200);  // One node and one element each.
+
+            std::pmr::unordered_map<int, int> index(&resource);
+            for (int i = 0; i < 1000; ++i) {
+                index[i] = i;
+            }
+            CHECK(resource.pooled_blocks() >= 1200);
+            CHECK(resource.upstream_allocations() > 0);  // Bucket arrays outgrow the classes.
+        }
+        CHECK(upstream.live == 0);
+    }
+
+    void test_class_ceiling() {
+        CountingResource upstream;
+        {
+            // One 4 KiB slab per class: the 16-byte class holds a couple of hundred.
+            PoolResource resource(4096, 4096, &upstream);
+            std::vector<void*> blocks;
+            for (int i = 0; i < 1000; ++i) {
+                blocks.push_back(resource.allocate(16, 8));
+            }
+            CHECK(resource.pooled_blocks() > 0 && resource.pooled_blocks() < 1000);
+            CHECK(resource.upstream_allocations() == 1000 - resource.pooled_blocks());
+            // Both kinds go back to where they came from.
+            for (void* p : blocks) {
+                resource.deallocate(p, 16, 8);
+            }
+            CHECK(resource.pooled_blocks() == 0);
+        }
+        CHECK(upstream.live == 0);
+    }
+
+}  // namespace
+
+int main() {
+    test_size_classes();
+    test_node_containers();
+    test_pmr_containers();
+    test_class_ceiling();
+    return artest::report("test_pool_allocator");
+}
@@ -0,0 +1,130 @@
+// Unit tests for the compile-time pool instrumentation.
+// Built with AR_SLAM_POOL_STATS on regardless of the project setting. Verifies
+// the counters (allocations, failures, high-water mark, live objects) for fixed
+// and growable pools, that a moved pool keeps its history, registry membership
+// over a pool's lifetime, PoolResource's named size classes, and the table and
+// leak report formats.
+
+#define AR_SLAM_POOL_STATS 1
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/memory_pool.h"
+#include "core/pool_allocator.h"
+#include "test_util.h"
+
+namespace {
+
+    ar_slam::PoolStats find(const std::string& name) {
+        for (const ar_slam::PoolStats& s : ar_slam::pool_stats()) {
+            if (s.name == name) {
+                return s;
+            }
+        }
+        return ar_slam::PoolStats{};
+    }
+
+    bool registered(const std::string& name) { return !find(name).name.empty(); }
+
+    void test_counters() {
+        ar_slam::MemoryPool<uint64_t> pool(8 * sizeof(uint64_t));
+        pool.set_name("fixed");
+        std::vector<uint64_t*> held;
+        for (int i = 0; i < 10; ++i) {
+            if (uint64_t* p = pool.allocate()) {
+                held.push_back(p);
+            }
+        }
+        for (int i = 0; i < 5; ++i) {
+            pool.deallocate(held.back());
+            held.pop_back();
+        }
+        held.push_back(pool.allocate());
+
+        const ar_slam::PoolStats s = find("fixed");
+        CHECK(s.capacity == 8);
+        CHECK(s.object_size == sizeof(uint64_t));
+        CHECK(s.allocations == 9);
+        CHECK(s.deallocations == 5);
+        CHECK(s.failures == 2);
+        CHECK(s.used == 4 && s.used == pool.used());
+        CHECK(s.high_water == 8);
+        CHECK(s.lifetime_seconds >= 0.0);
+        for (uint64_t* p : held) {
+            pool.deallocate(p);
+        }
+
+        // Growable: failures once the ceiling is reached, peak across slabs.
+        ar_slam::MemoryPool<uint64_t>::Growth growth;
+        growth.slab_bytes = 4096;
+        ar_slam::MemoryPool<uint64_t> growable(2 * 4096, growth);
+        growable.set_name("growable");
+        held.clear();
+        while (uint64_t* p = growable.allocate()) {
+            held.push_back(p);
+        }
+        CHECK(find("growable").high_water == growable.capacity());
+        CHECK(find("growable").failures == 1);
+        for (uint64_t* p : held) {
+            growable.deallocate(p);
+        }
+        CHECK(find("growable").used == 0);
+    }
+
+    void test_move_and_registry() {
+        {
+            ar_slam::MemoryPool<uint64_t> pool(16 * sizeof(uint64_t));
+            pool.set_name("moved");
+            uint64_t* p = pool.allocate();
+            ar_slam::MemoryPool<uint64_t> target(std::move(pool));
+            const ar_slam::PoolStats s = find("moved");
+            CHECK(s.allocations == 1 && s.used == 1 && s.capacity == 16);
+            CHECK(find("unnamed").allocations == 0);  // The moved-from pool starts afresh.
+            target.deallocate(p);
+        }
+        CHECK(!registered("moved"));
+
+        ar_slam::PoolResource resource;
+        CHECK(registered("PoolResource 16 B"));
+        CHECK(registered("PoolResource 256 B"));
+        void* node = resource.allocate(40, 8);
+        CHECK(find("PoolResource 48 B").used == 1);
+        resource.deallocate(node, 40, 8);
+    }
+
+    void test_reports() {
+        ar_slam::MemoryPool<uint64_t> pool(4 * sizeof(uint64_t));
+        pool.set_name("reported");
+        uint64_t* p = pool.allocate();
+        std::ostringstream table;
+        ar_slam::dump_pool_stats(table);
+        CHECK(table.str().find("reported") != std::string::npos);
+        CHECK(table.str().find("peak") != std::string::npos);
+        CHECK(find("reported").recent_per_second >= 0.0);
+
+        // Destroying a pool with live objects names it on std::cerr.
+        std::ostringstream captured;
+        std::streambuf* old = std::cerr.rdbuf(captured.rdbuf());
+        {
+            ar_slam::MemoryPool<uint64_t> leaky(4 * sizeof(uint64_t));
+            leaky.set_name("leaky");
+            leaky.allocate();
+            leaky.allocate();
+        }
+        std::cerr.rdbuf(old);
+        CHECK(captured.str().find("'leaky' destroyed with 2 live object(s)") != std::string::npos);
+        pool.deallocate(p);
+    }
+
+}  // namespace
+
+int main() {
+    test_counters();
+    test_move_and_registry();
+    test_reports();
+    return artest::report("test_pool_stats");
+}
@@ -0,0 +1,412 @@
+// Unit tests for loop closure: closed-form Sim(3) alignment, the sparse
+// pose-graph solver, map correction, and the loop closer end to end on a
+// synthetic circuit whose second lap has drifted in rotation, translation and
+// scale.
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "core/landmark_map.h"
+#include "core/loop_closer.h"
+#include "core/pose_graph.h"
+#include "core/vocabulary.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+using geometry::Mat3;
+using geometry::Pose;
+using geometry::Sim3;
+using geometry::Vec3;
+
+namespace {
+
+    using artest::Lcg;
+
+    Mat3 rot_y(double a) {
+        Mat3 R = Mat3::identity();
+        R.m[0][0] = std::cos(a);
+        R.m[0][2] = std::sin(a);
+        R.m[2][0] = -std::sin(a);
+        R.m[2][2] = std::cos(a);
+        return R;
+    }
+
+    Sim3 make_sim3(const double w[3], const Vec3& t, double s) {
+        Sim3 S;
+        S.R = ba_detail::exp_so3(w);
+        S.t = t;
+        S.s = s;
+        return S;
+    }
+
+    Vec3 centre(const Pose& p) {
+        const Vec3 c = geometry::mul(geometry::transpose(p.R), p.t);
+        return {-c[0], -c[1], -c[2]};
+    }
+
+    double distance(const Vec3& a, const Vec3& b) {
+        return std::sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) +
+                         (a[2] - b[2]) * (a[2] - b[2]));
+    }
+
+    // World-to-camera similarity of a node as a rigid pose in its own units.
+    Vec3 node_centre(const Sim3& S) {
+        const Sim3 inv = S.inverse();
+        return inv.t;
+    }
+
+    void test_align_sim3() {
+        Lcg rng{7};
+        const double w[3] = {0.3, -0.5, 0.2};
+        const Sim3 truth = make_sim3(w, {1.0, -2.0, 0.5}, 1.7);
+        std::vector<Vec3> a, b;
+        for (int i = 0; i < 20; ++i) {
+            a.push_back({3 * rng.uniform(), 3 * rng.uniform(), 3 * rng.uniform() + 4});
+            b.push_back(truth.transform(a.back()));
+        }
+        Sim3 est;
+        CHECK(geometry::align_sim3(a.data(), b.data(), a.size(), est));
+        CHECK_NEAR(est.s, 1.7, 1e-9);
+        for (int i = 0; i < 3; ++i) {
+            CHECK_NEAR(est.t[i], truth.t[i], 1e-9);
+            for (int j = 0; j < 3; ++j) {
+                CHECK_NEAR(est.R.m[i][j], truth.R.m[i][j], 1e-9);
+            }
+        }
+        // Composition and inverse round-trip.
+        const Sim3 id = geometry::compose(est, est.inverse());
+        CHECK_NEAR(id.s, 1.0, 1e-12);
+        CHECK_NEAR(id.t[0], 0.0, 1e-9);
+        CHECK_NEAR(id.R.m[1][1], 1.0, 1e-9);
+
+        CHECK(!geometry::align_sim3(a.data(), b.data(), 2, est));
+        std::vector<Vec3> same(5, Vec3{1, 1, 1});
+        CHECK(!geometry::align_sim3(same.data(), b.data(), same.size(), est));
+    }
+
+    void test_log_so3() {
+        const double cases[][3] = {{0.0, 0.0, 0.0}, {1e-8, 0.0, -2e-8}, {0.3, -0.2, 0.9},
+                                   {0.0, 3.1, 0.0}, {1.8, 1.8, -0.5}};
+        for (const auto& w : cases) {
+            double back[3];
+            pg_detail::log_so3(ba_detail::exp_so3(w), back);
+            for (int k = 0; k < 3; ++k) {
+                CHECK_NEAR(back[k], w[k], 1e-6);
+            }
+        }
+    }
+
+    void test_sparse_cholesky() {
+        // Ring of 12 blocks plus one chord: fill-in is required.
+        const int n = 12;
+        std::vector<std::pair<int, int>> pairs;
+        for (int i = 0; i < n; ++i) {
+            pairs.push_back({i, (i + 1) % n});
+        }
+        pairs.push_back({2, 8});
+
+        Lcg rng{11};
+        std::vector<pg_detail::Block> off(pairs.size());
+        std::vector<pg_detail::Block> diag(n);
+        for (auto& B : off) {
+            for (double& x : B) {
+                x = rng.uniform();
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            diag[i].fill(0.0);
+            for (int k = 0; k < pg_detail::kDim; ++k) {
+                diag[i][k * pg_detail::kDim + k] = 10.0;  // Diagonally dominant.
+            }
+        }
+
+        pg_detail::SparseBlockCholesky chol;
+        chol.analyse(n, pairs);
+        chol.zero();
+        for (int i = 0; i < n; ++i) {
+            chol.add(i, i, diag[i]);
+        }
+        for (std::size_t e = 0; e < pairs.size(); ++e) {
+            chol.add(pairs[e].first, pairs[e].second, off[e]);
+        }
+        CHECK(chol.factor());
+
+        std::vector<double> b(n * pg_detail::kDim);
+        for (double& x : b) {
+            x = rng.uniform();
+        }
+        std::vector<double> x = b;
+        chol.solve(x);
+
+        // Multiply back with the symmetric block matrix.
+        const int d = pg_detail::kDim;
+        std::vector<double> Ax(n * d, 0.0);
+        auto gemv = [&](const pg_detail::Block& B, int row, int col, bool transpose) {
+            for (int i = 0; i < d; ++i) {
+                for (int j = 0; j < d; ++j) {
+                    Ax[row * d + i] += (transpose ? B[j * d + i] : B[i * d + j]) * x[col * d + j];
+                }
+            }
+        };
+        for (int i = 0; i < n; ++i) {
+            gemv(diag[i], i, i, false);
+        }
+        for (std::size_t e = 0; e < pairs.size(); ++e) {
+            gemv(off[e], pairs[e].first, pairs[e].second, false);
+            gemv(off[e], pairs[e].second, pairs[e].first, true);
+        }
+        for (int i = 0; i < n * d; ++i) {
+            CHECK_NEAR(Ax[i], b[i], 1e-9);
+        }
+    }
+
+    // Circle of `n` nodes; odometry edges carry the true relatives with a small
+    // bias (rotation, translation and scale drift); one loop edge is exact.
+    PoseGraph drifting_circle(int n) {
+        std::vector<Sim3> truth(n);
+        for (int k = 0; k < n; ++k) {
+            const double a = 2.0 * M_PI * k / n;
+            Pose p;
+            p.R = geometry::transpose(rot_y(a));
+            const Vec3 c{5.0 * std::sin(a), 0.0, 5.0 * std::cos(a)};
+            const Vec3 rc = geometry::mul(p.R, c);
+            p.t = {-rc[0], -rc[1], -rc[2]};
+            truth[k] = Sim3(p);
+        }
+        // Scaled so the accumulated drift is the same whatever the length.
+        const double f = 60.0 / n;
+        const double bias_w[3] = {0.002 * f, 0.004 * f, -0.001 * f};
+        const Sim3 bias = make_sim3(bias_w, {0.01 * f, -0.005 * f, 0.0}, std::pow(1.004, f));
+
+        PoseGraph graph;
+        graph.nodes.push_back(truth[0]);
+        for (int k = 1; k < n; ++k) {
+            const Sim3 rel = geometry::compose(truth[k - 1], truth[k].inverse());
+            const Sim3 measured = geometry::compose(rel, bias);
+            graph.edges.push_back({k - 1, k, measured, 1.0});
+            // Dead reckoning: S_k = measured^-1 * S_{k-1}.
+            graph.nodes.push_back(geometry::compose(measured.inverse(), graph.nodes.back()));
+        }
+        graph.edges.push_back(
+            {0, n - 1, geometry::compose(truth[0], truth[n - 1].inverse()), 1.0});
+        graph.fixed.assign(n, false);
+        graph.fixed[0] = true;
+        return graph;
+    }
+
+    void test_pose_graph_closes_loop() {
+        const int n = 60;
+        PoseGraph graph = drifting_circle(n);
+        // Node n-1 should sit next to node 0 (one step around the circle).
+        const double before = distance(node_centre(graph.nodes[n - 1]),
+                                       node_centre(graph.nodes[0]));
+        const PoseGraphSummary summary = optimise_pose_graph(graph);
+        const double after = distance(node_centre(graph.nodes[n - 1]),
+                                      node_centre(graph.nodes[0]));
+        const double step = 2.0 * 5.0 * std::sin(M_PI / n);
+
+        CHECK(summary.accepted > 0);
+        CHECK(summary.converged && !summary.stalled);
+        CHECK(summary.final_cost < 1e-3 * summary.initial_cost);
+        CHECK(std::fabs(before - step) > 0.5);
+        CHECK(std::fabs(after - step) < 0.05);
+        CHECK(graph.nodes[0].s == 1.0);  // Fixed node untouched.
+        // A cycle factors with O(n) fill.
+        CHECK(summary.factor_blocks < static_cast<std::size_t>(3 * n));
+    }
+
+    void test_pose_graph_time_budget() {
+        PoseGraph graph = drifting_circle(2000);
+        PoseGraphConfig config;
+        config.max_iterations = 50;
+        config.function_tolerance = 0.0;
+        config.time_budget_ms = 1e-6;  // Expires before the first factorisation.
+        const std::vector<Sim3> before = graph.nodes;
+        const PoseGraphSummary summary = optimise_pose_graph(graph, config);
+        CHECK(summary.accepted == 0);
+        CHECK(summary.final_cost == summary.initial_cost);
+        CHECK(!summary.converged && !summary.stalled);  // Out of time, not a solution.
+        CHECK(graph.nodes[1].t == before[1].t);
+
+        // A budget that allows a few iterations still returns the best state reached.
+        graph = drifting_circle(2000);
+        config.time_budget_ms = 1.0;
+        const PoseGraphSummary partial = optimise_pose_graph(graph, config);
+        CHECK(partial.final_cost <= partial.initial_cost);
+        CHECK_NEAR(partial.final_cost, pg_detail::total_cost(graph, graph.nodes), 1e-9 * partial.initial_cost);
+    }
+
+    void test_map_correct() {
+        LandmarkMap map;
+        Pose p1;
+        p1.t = {-1.0, 0.0, 0.0};
+        map.add_keyframe(Pose{}, {1, 2}, {{0, 0, 5}, {1, 0, 5}});
+        map.add_keyframe(p1, {3}, {{2, 0, 5}});
+        const int generation = map.generation();
+
+        // Keyframe 1 is really twice as far from keyframe 0, and sees its landmark
+        // twice as deep.
+        MapCorrection correction;
+        correction.newest_keyframe = 1;
+        correction.keyframes.push_back({0, Pose{}, Sim3(Pose{})});
+        Sim3 after;
+        after.t = {-1.0, 0.0, 0.0};
+        after.s = 0.5;
+        correction.keyframes.push_back({1, p1, after});
+        const std::vector<LandmarkUpdate> moved = map.correct(correction);
+
+        CHECK(moved.size() == 3);
+        CHECK(map.generation() == generation + 1);
+        CHECK_NEAR(map.find(1)->position[2], 5.0, 1e-12);  // Keyframe 0 unchanged.
+        CHECK_NEAR(map.find(3)->position[0], 4.0, 1e-9);
+        CHECK_NEAR(map.find(3)->position[2], 10.0, 1e-9);
+        CHECK_NEAR(map.keyframes()[1].pose.t[0], -2.0, 1e-9);
+
+        // A refinement from before the correction is stale and ignored.
+        MapRefinement stale;
+        stale.generation = generation;
+        stale.newest_keyframe = 1;
+        stale.landmarks.push_back({3, {0, 0, 0}});
+        CHECK(map.refine(stale).empty());
+        CHECK_NEAR(map.find(3)->position[2], 10.0, 1e-9);
+    }
+
+    // --- End-to-end loop closer on a two-lap circuit -------------------------
+
+    constexpr int kPlaces = 40;
+    constexpr int kPointsPerPlace = 20;
+
+    struct Circuit {
+        std::vector<Vec3> points;                // True world points.
+        std::vector<std::vector<uint8_t>> desc;  // One descriptor per point.
+    };
+
+    Pose true_pose(int k) {
+        const double a = 2.0 * M_PI * (k % kPlaces) / kPlaces;
+        Pose p;
+        p.R = geometry::transpose(rot_y(a));
+        const Vec3 c{5.0 * std::sin(a), 0.0, 5.0 * std::cos(a)};
+        const Vec3 rc = geometry::mul(p.R, c);
+        p.t = {-rc[0], -rc[1], -rc[2]};
+        return p;
+    }
+
+    Circuit make_circuit(Lcg& rng) {
+        Circuit c;
+        for (int place = 0; place < kPlaces; ++place) {
+            const Pose cam = true_pose(place).inverse();  // Camera to world.
+            for (int i = 0; i < kPointsPerPlace; ++i) {
+                const Vec3 local{3.0 * rng.uniform(), 2.0 * rng.uniform(), 4.0 + rng.uniform()};
+                c.points.push_back(cam.transform(local));
+                std::vector<uint8_t> d(kDescriptorBytes);
+                for (uint8_t& b : d) {
+                    b = static_cast<uint8_t>(rng.next());
+                }
+                c.desc.push_back(d);
+            }
+        }
+        return c;
+    }
+
+    // Estimation drift after k keyframes: the world seen by keyframe k is the
+    // true world mapped through D_k.
+    Sim3 drift(int k) {
+        const double w[3] = {0.0, 0.004 * k, 0.0};
+        return make_sim3(w, {0.01 * k, 0.0, 0.0}, 1.0 + 0.005 * k);
+    }
+
+    void test_loop_closer_circuit() {
+        Lcg rng{2024};
+        const Circuit circuit = make_circuit(rng);
+        const int keyframes = kPlaces + 6;
+
+        // Keyframe k sees places k and k + 1; a second-lap visit uses new track ids.
+        struct View {
+            std::vector<int> ids;
+            std::vector<Vec3> world;
+            std::vector<MapObservation> obs;
+            std::vector<uint8_t> desc;
+        };
+        std::vector<View> views(keyframes);
+        std::vector<std::vector<uint8_t>> training;
+        for (int k = 0; k < keyframes; ++k) {
+            const Sim3 D = drift(k);
+            for (int visit = k; visit <= k + 1; ++visit) {
+                const int place = visit % kPlaces;
+                const int lap = visit / kPlaces;
+                for (int i = 0; i < kPointsPerPlace; ++i) {
+                    const int j = place * kPointsPerPlace + i;
+                    const int id = j + 10000 * lap;
+                    views[k].ids.push_back(id);
+                    views[k].world.push_back(D.transform(circuit.points[j]));
+                    views[k].obs.push_back({k, id, 0.0, 0.0});
+                    const std::size_t at = views[k].desc.size();
+                    views[k].desc.insert(views[k].desc.end(), circuit.desc[j].begin(),
+                                         circuit.desc[j].end());
+                    for (int f = 0; f < 3; ++f) {
+                        const uint32_t bit = rng.next() % (kDescriptorBytes * 8);
+                        views[k].desc[at + bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+                    }
+                }
+            }
+            training.push_back(views[k].desc);
+        }
+        auto vocabulary = std::make_shared<Vocabulary>(Vocabulary::train(training, 8, 3, 1));
+
+        LandmarkMap map;
+        LoopCloser closer(vocabulary);
+        int detected_at = -1;
+        for (int k = 0; k < keyframes; ++k) {
+            // Pose of keyframe k in the drifted world: camera units grow with the
+            // drift scale, so s * T_k * D_k^-1 is rigid.
+            Sim3 units;
+            units.s = drift(k).s;
+            const Sim3 S = geometry::compose(
+                units, geometry::compose(Sim3(true_pose(k)), drift(k).inverse()));
+            Pose pose;
+            pose.R = S.R;
+            pose.t = S.t;
+            map.add_keyframe(pose, views[k].ids, views[k].world, views[k].obs, views[k].desc);
+            if (closer.add_keyframe(map, k) && detected_at < 0) {
+                detected_at = k;
+            }
+        }
+        // The last first-lap keyframe already sees place 0 again (with new tracks).
+        const int closing = kPlaces - 1;
+        CHECK(detected_at == closing);
+        CHECK(closer.loops().size() == 1);
+        CHECK(closer.loops()[0].match == 0);
+        CHECK(closer.loops()[0].inliers == kPointsPerPlace);
+        // Keyframe k is mapped drift(k).s times too large; the loop measures that.
+        CHECK_NEAR(closer.loops()[0].relative.s, 1.0 / drift(closing).s, 0.01);
+
+        const int probe = kPlaces + 3;  // Same place as keyframe 3.
+        const double before =
+            distance(centre(map.keyframes()[probe].pose), centre(map.keyframes()[3].pose));
+
+        closer.wait_idle();
+        MapCorrection correction;
+        CHECK(closer.poll(correction));
+        CHECK(correction.newest_keyframe == closing);
+        map.correct(correction);
+
+        const double after =
+            distance(centre(map.keyframes()[probe].pose), centre(map.keyframes()[3].pose));
+        CHECK(before > 1.0);
+        CHECK(after < 0.25 * before);
+        CHECK(closer.last_summary().final_cost < closer.last_summary().initial_cost);
+    }
+
+}  // namespace
+
+int main() {
+    test_align_sim3();
+    test_log_so3();
+    test_sparse_cholesky();
+    test_pose_graph_closes_loop();
+    test_pose_graph_time_budget();
+    test_map_correct();
+    test_loop_closer_circuit();
+    return artest::report("pose_graph");
+}
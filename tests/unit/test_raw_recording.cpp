@@ -0,0 +1,324 @@
+// Tests for raw capture recording and replay: frames recorded through the tee
+// decorator come back byte for byte with their formats and capture times, as
+// headers onto page-aligned records in the mapping; recordings cut short are
+// recovered by scanning; replayed Frames keep the mapping alive.
+
+#include <opencv2/opencv.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "camera/raw_recording.h"
+#include "camera/raw_replay_camera.h"
+#include "camera/recording_camera.h"
+#include "test_util.h"
+
+namespace {
+
+    namespace fs = std::filesystem;
+    using ar_slam::Frame;
+    using ar_slam::RawRecorder;
+    using ar_slam::RawRecording;
+    using ar_slam::RawReplayCamera;
+    using ar_slam::RecordingCamera;
+    using ar_slam::raw_recording_detail::kPageSize;
+
+    /// A recording file name, removed when the test is done.
+    struct TempFile {
+        fs::path path;
+        TempFile() {
+            path = fs::temp_directory_path() /
+                   ("ar_slam_raw_" +
+                    std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) +
+                    ".arrec");
+        }
+        ~TempFile() { fs::remove(path); }
+    };
+
+    /// A test image whose bytes depend on @p seed and their position.
+    cv::Mat pattern(int rows, int cols, int type, int seed) {
+        cv::Mat image(rows, cols, type);
+        for (int r = 0; r < rows; ++r) {
+            uint8_t* row = image.ptr<uint8_t>(r);
+            for (std::size_t c = 0; c < cols * image.elemSize(); ++c) {
+                row[c] = static_cast<uint8_t>(seed * 7 + r + c);
+            }
+        }
+        return image;
+    }
+
+    /// Delivers @c limit 40x30 frames of @c type, frame i a pattern(i).
+    class FakeSource : public ar_slam::CameraInterface {
+    public:
+        int type = CV_8UC1;
+        int limit = 10;
+
+        bool open(const ar_slam::CameraConfig& config) override {
+            config_ = config;
+            next_ = 0;
+            is_running_ = true;
+            return true;
+        }
+        void close() override { is_running_ = false; }
+        bool is_open() const override { return is_running_; }
+
+        bool grab_frame(cv::Mat& frame) override {
+            if (next_ >= limit) {
+                return false;
+            }
+            frame = pattern(30, 40, type, next_++);
+            return true;
+        }
+        double get_fps() const override { return 30.0; }
+
+    private:
+        int next_ = 0;
+    };
+
+    bool same_pixels(const cv::Mat& a, const cv::Mat& b) {
+        if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type()) {
+            return false;
+        }
+        for (int r = 0; r < a.rows; ++r) {
+            if (std::memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ar_slam::CameraConfig at(const fs::path& path) {
+        ar_slam::CameraConfig config;
+        config.device_path = path.string();
+        return config;
+    }
+
+    void test_record_and_replay() {
+        TempFile file;
+        auto source = std::make_shared<FakeSource>();
+        RecordingCamera recorder(source, file.path.string(), 16);  // Room for every frame.
+        CHECK(recorder.open(ar_slam::CameraConfig{}));
+
+        // The tee passes frames through untouched and stamps their capture.
+        std::vector<Frame::Timestamp> captured;
+        cv::Mat frame;
+        Frame::Timestamp timestamp;
+        while (recorder.grab_frame(frame, timestamp)) {
+            CHECK(same_pixels(frame, pattern(30, 40, CV_8UC1, captured.size())));
+            captured.push_back(timestamp);
+        }
+        recorder.close();
+        CHECK(captured.size() == 10);
+        CHECK(recorder.frames_recorded() == 10 && recorder.frames_dropped() == 0);
+        CHECK(!recorder.is_open() && !source->is_open());
+
+        RawReplayCamera replay;
+        CHECK(replay.open(at(file.path)));
+        CHECK(replay.frame_count() == 10 && replay.recording().indexed());
+        const auto* base = static_cast<const uint8_t*>(replay.recording().mapping().get());
+        for (std::size_t i = 0; i < 10; ++i) {
+            CHECK(replay.grab_frame(frame, timestamp));
+            CHECK(same_pixels(frame, pattern(30, 40, CV_8UC1, i)));
+            CHECK(timestamp == captured[i]);
+
+            // No copy: the image is the record's bytes, on a page-aligned record.
+            const ar_slam::RecordedFrame& recorded = replay.recording().frames()[i];
+            CHECK(recorded.offset % kPageSize == 0);
+            CHECK(frame.data == base + recorded.offset + 64);
+            CHECK(recorded.format == Frame::PixelFormat::kGray && recorded.sequence == i);
+        }
+        CHECK(!replay.grab_frame(frame));
+        CHECK(replay.position() == 10);
+        CHECK(replay.get_fps() > 0);
+    }
+
+    void test_formats_and_strides() {
+        TempFile file;
+        const cv::Mat bgr = pattern(30, 40, CV_8UC3, 1);
+        const cv::Mat padded = pattern(30, 48, CV_8UC1, 2)(cv::Rect(4, 0, 40, 30));
+        const cv::Mat yuyv = pattern(30, 40, CV_8UC2, 3);
+        const cv::Mat nv12 = pattern(45, 40, CV_8UC1, 4);
+        const Frame::Timestamp t0{std::chrono::milliseconds(1000)};
+        {
+            RawRecorder recorder;
+            CHECK(recorder.open(file.path.string()));
+            CHECK(recorder.write(bgr, Frame::PixelFormat::kBGR, t0));
+            CHECK(recorder.write(padded, Frame::PixelFormat::kGray, t0));
+            CHECK(recorder.write(yuyv, Frame::PixelFormat::kYUYV, t0));
+            CHECK(recorder.write(nv12, Frame::PixelFormat::kNV12, t0));
+            CHECK(!recorder.write(cv::Mat(), Frame::PixelFormat::kGray, t0));
+            CHECK(recorder.frames() == 4 && recorder.bytes_written() % kPageSize == 0);
+            CHECK(recorder.close());
+        }
+
+        RawRecording recording;
+        CHECK(recording.open(file.path.string()));
+        CHECK(recording.frames().size() == 4);
+        CHECK(same_pixels(recording.image(0), bgr));
+        CHECK(same_pixels(recording.image(1), padded));  // Stored packed.
+        CHECK(recording.image(1).isContinuous());
+        CHECK(same_pixels(recording.image(2), yuyv));
+        CHECK(same_pixels(recording.image(3), nv12));
+        CHECK(recording.frames()[2].format == Frame::PixelFormat::kYUYV);
+        CHECK(recording.frames()[3].format == Frame::PixelFormat::kNV12);
+        recording.prefetch(0, 100);  // Past the end is clamped.
+
+        CHECK(!recording.open((file.path.string() + ".missing")));
+        std::ofstream(file.path.string() + ".txt") << "not a recording";
+        CHECK(!recording.open(file.path.string() + ".txt"));
+        fs::remove(file.path.string() + ".txt");
+    }
+
+    void test_frames_outlive_replay() {
+        TempFile file;
+        const cv::Mat nv12 = pattern(45, 40, CV_8UC1, 5);
+        {
+            RawRecorder recorder;
+            CHECK(recorder.open(file.path.string()));
+            CHECK(recorder.write(nv12, Frame::PixelFormat::kNV12, Frame::Timestamp{}));
+        }  // Closed (and indexed) by the destructor.
+
+        RawReplayCamera replay;
+        CHECK(replay.open(at(file.path)));
+        Frame::Ptr frame = replay.next_frame();
+        CHECK(frame != nullptr && replay.next_frame() == nullptr);
+        replay.close();
+        CHECK(!replay.is_open());
+
+        // The NV12 luma is lent straight from the mapping, which the frame holds.
+        CHECK(frame->borrows_image());
+        CHECK(frame->get_source_format() == Frame::PixelFormat::kNV12);
+        CHECK(same_pixels(frame->get_image(), nv12.rowRange(0, 30)));
+
+        ar_slam::SharedPool<Frame> pool(2);
+        CHECK(replay.open(at(file.path)));
+        frame = replay.next_frame(&pool);
+        CHECK(frame != nullptr && frame->get_image().rows == 30);
+    }
+
+    void test_recovery_without_index() {
+        TempFile file;
+        const std::string crashed = file.path.string() + ".crashed";
+        const std::string torn = file.path.string() + ".torn";
+        {
+            RawRecorder recorder;
+            CHECK(recorder.open(file.path.string()));
+            for (int i = 0; i < 5; ++i) {
+                CHECK(recorder.write(pattern(30, 40, CV_8UC1, i), Frame::PixelFormat::kGray,
+                                     Frame::Timestamp{std::chrono::milliseconds(i * 33)}));
+            }
+            // A recorder killed here leaves records but no index.
+            fs::copy_file(file.path, crashed, fs::copy_options::overwrite_existing);
+            CHECK(recorder.write(pattern(30, 40, CV_8UC1, 5), Frame::PixelFormat::kGray,
+                                 Frame::Timestamp{}));
+            fs::copy_file(file.path, torn, fs::copy_options::overwrite_existing);
+            fs::resize_file(torn, fs::file_size(torn) - kPageSize + 600);  // Killed mid-write.
+        }
+
+        RawRecording recording;
+        CHECK(recording.open(crashed));
+        CHECK(!recording.indexed() && !recording.truncated());
+        CHECK(recording.frames().size() == 5);
+        CHECK(same_pixels(recording.image(4), pattern(30, 40, CV_8UC1, 4)));
+        CHECK(recording.frames()[3].timestamp ==
+              Frame::Timestamp{std::chrono::milliseconds(99)});
+
+        CHECK(recording.open(torn));
+        CHECK(!recording.indexed() && recording.truncated());
+        CHECK(recording.frames().size() == 5);
+
+        // A damaged index falls back to the scan too.
+        CHECK(recording.open(file.path.string()) && recording.indexed());
+        CHECK(recording.frames().size() == 6);
+        {
+            std::fstream damage(file.path, std::ios::in | std::ios::out | std::ios::binary);
+            damage.seekp(-20, std::ios::end);
+            damage.put('\x55');
+        }
+        CHECK(recording.open(file.path.string()));
+        CHECK(!recording.indexed() && recording.frames().size() == 6);
+
+        recording.close();
+        fs::remove(crashed);
+        fs::remove(torn);
+    }
+
+    void test_drops_accounted() {
+        TempFile file;
+        auto source = std::make_shared<FakeSource>();
+        source->limit = 200;
+        RecordingCamera recorder(source, file.path.string(), 1);
+        CHECK(recorder.open(ar_slam::CameraConfig{}));
+        cv::Mat frame;
+        while (recorder.grab_frame(frame)) {
+        }
+        recorder.close();
+        CHECK(recorder.frames_recorded() + recorder.frames_dropped() == 200);
+
+        // Whatever the writer kept is in the file, in capture order.
+        RawReplayCamera replay;
+        CHECK(replay.open(at(file.path)));
+        CHECK(replay.frame_count() == recorder.frames_recorded());
+        int seed = 0;
+        bool ordered = true;
+        while (replay.grab_frame(frame)) {
+            while (seed < 200 && !same_pixels(frame, pattern(30, 40, CV_8UC1, seed))) {
+                ++seed;
+            }
+            ordered = ordered && seed < 200;
+            ++seed;
+        }
+        CHECK(ordered);
+    }
+
+    void test_loop_and_seek() {
+        TempFile file;
+        auto source = std::make_shared<FakeSource>();
+        source->type = CV_8UC3;
+        source->limit = 4;
+        {
+            RecordingCamera recorder(source, file.path.string());
+            CHECK(recorder.open(ar_slam::CameraConfig{}));
+            cv::Mat frame;
+            while (recorder.grab_frame(frame)) {
+            }
+        }  // Finished by the destructor.
+
+        RawReplayCamera::Options options;
+        options.loop = true;
+        RawReplayCamera replay(options);
+        CHECK(replay.open(at(file.path)));
+        CHECK(replay.recording().frames()[0].format == Frame::PixelFormat::kBGR);
+        cv::Mat frame;
+        for (int i = 0; i < 6; ++i) {
+            CHECK(replay.grab_frame(frame));
+            CHECK(same_pixels(frame, pattern(30, 40, CV_8UC3, i % 4)));
+        }
+        CHECK(replay.seek(3));
+        CHECK(replay.grab_frame(frame) && same_pixels(frame, pattern(30, 40, CV_8UC3, 3)));
+        CHECK(!replay.seek(4));
+        CHECK(replay.position() == 4);
+
+        // Drawing on a replayed frame changes this process's copy, not the file.
+        frame.ptr<uint8_t>(0)[0] = 0xff;
+        RawRecording other;
+        CHECK(other.open(file.path.string()));
+        CHECK(same_pixels(other.image(3), pattern(30, 40, CV_8UC3, 3)));
+    }
+
+}  // namespace
+
+int main() {
+    test_record_and_replay();
+    test_formats_and_strides();
+    test_frames_outlive_replay();
+    test_recovery_without_index();
+    test_drops_accounted();
+    test_loop_and_seek();
+    return artest::report("test_raw_recording");
+}
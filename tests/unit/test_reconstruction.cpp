@@ -2,6 +2,9 @@
 // Builds a synthetic calibrated scene, projects it into two cameras with a
 // known relative pose, and verifies that TwoViewReconstruction recovers both
 // the motion (up to scale) and the 3D structure (up to the baseline scale).
+// Also checks model selection: a planar scene initialises from the homography,
+// a general one from the essential matrix, and a pure rotation is reported as
+// lacking parallax.
 // Headless and deterministic — no camera or image files required.
 
 #include <cmath>
@@ -30,6 +33,58 @@ namespace {
         return cv::Matx33d(c, 0, s, 0, 1, 0, -s, 0, c);
     }
 
+    // Deterministic sub-pixel jitter so RANSAC sees realistic residuals.
+    cv::Point2f jitter(const cv::Point2f& p, int i, double amplitude) {
+        return cv::Point2f(p.x + static_cast<float>(amplitude * std::sin(1.7 * i)),
+                           p.y + static_cast<float>(amplitude * std::cos(2.3 * i)));
+    }
+
+    void test_model_selection(const cv::Matx33d& K) {
+        ar_slam::TwoViewReconstruction recon(K);
+        const cv::Matx33d I = cv::Matx33d::eye();
+        const cv::Vec3d zero(0, 0, 0);
+
+        // A general scene: points scattered in depth, no dominant plane.
+        std::vector<cv::Point3f> scene;
+        artest::Lcg rng{7u};
+        for (int i = 0; i < 150; ++i) {
+            scene.emplace_back(static_cast<float>(rng.uniform(-2.0, 2.0)),
+                               static_cast<float>(rng.uniform(-1.5, 1.5)),
+                               static_cast<float>(rng.uniform(3.0, 9.0)));
+        }
+        const cv::Matx33d R = rot_y(4.0);
+        const cv::Vec3d t(-0.5, 0.02, 0.05);
+        std::vector<cv::Point2f> a, b;
+        for (size_t i = 0; i < scene.size(); ++i) {
+            a.push_back(jitter(project(K, I, zero, scene[i]), static_cast<int>(i), 0.3));
+            b.push_back(jitter(project(K, R, t, scene[i]), static_cast<int>(i) + 1000, 0.3));
+        }
+        ar_slam::ReconstructionResult general = recon.reconstruct(a, b);
+        CHECK(general.success);
+        CHECK(general.model == ar_slam::TwoViewModel::kEssential);
+        CHECK(general.homography_score_ratio < 0.45);
+        CHECK(cv::normalize(t).dot(cv::normalize(general.t)) > 0.99);
+
+        // The same scene seen after a pure rotation: the homography explains
+        // it, and there is no baseline to triangulate from.
+        b.clear();
+        for (size_t i = 0; i < scene.size(); ++i) {
+            b.push_back(jitter(project(K, R, zero, scene[i]), static_cast<int>(i) + 1000, 0.3));
+        }
+        ar_slam::ReconstructionResult rotation = recon.reconstruct(a, b);
+        CHECK(!rotation.success);
+        CHECK(rotation.model == ar_slam::TwoViewModel::kHomography);
+        CHECK(rotation.low_parallax);
+
+        // With homography fitting disabled, only E is tried.
+        ar_slam::TwoViewReconstruction::Config config;
+        config.fit_homography = false;
+        ar_slam::ReconstructionResult e_only =
+            ar_slam::TwoViewReconstruction(K, config).reconstruct(a, b);
+        CHECK(e_only.model != ar_slam::TwoViewModel::kHomography);
+        CHECK(e_only.homography_score_ratio == 0.0);
+    }
+
 }  // namespace
 
 int main() {
@@ -60,6 +115,9 @@ int main() {
 
     CHECK(result.success);
     CHECK(result.num_inliers >= 30);
+    // Depth is linear in x and y, so the grid is a plane: H wins the selection.
+    CHECK(result.model == ar_slam::TwoViewModel::kHomography);
+    CHECK(result.homography_score_ratio > 0.45);
 
     // Translation direction should match ground truth (both unit, sign resolved
     // by cheirality).
@@ -95,5 +153,6 @@ int main() {
     ar_slam::ReconstructionResult degenerate = recon.reconstruct(few1, few2);
     CHECK(!degenerate.success);
 
+    test_model_selection(K);
     return artest::report("test_reconstruction");
 }
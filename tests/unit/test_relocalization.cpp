@@ -0,0 +1,221 @@
+// Headless tests for relocalization after tracking loss: packing the newest
+// keyframes' descriptors, descriptor matching plus PnP against a synthetic map,
+// and the tracker re-attaching landmark ids to re-detected features.
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "core/feature_tracker.h"
+#include "core/frame.h"
+#include "core/landmark_map.h"
+#include "core/relocalizer.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+
+namespace {
+
+    const cv::Matx33d kK(500, 0, 320, 0, 500, 240, 0, 0, 1);
+
+    std::vector<uint8_t> random_descriptor(cv::RNG& rng) {
+        std::vector<uint8_t> d(kDescriptorBytes);
+        for (uint8_t& b : d) {
+            b = static_cast<uint8_t>(rng.uniform(0, 256));
+        }
+        return d;
+    }
+
+    cv::Point2f project(const geometry::Pose& pose, const geometry::Vec3& X) {
+        const geometry::Vec3 c = pose.transform(X);
+        return cv::Point2f(static_cast<float>(kK(0, 0) * c[0] / c[2] + kK(0, 2)),
+                           static_cast<float>(kK(1, 1) * c[1] / c[2] + kK(1, 2)));
+    }
+
+    // A map of @p n landmarks in front of the camera, observed by one keyframe
+    // at the origin with a random descriptor each.
+    LandmarkMap make_map(int n, cv::RNG& rng, std::vector<std::vector<uint8_t>>& descriptors) {
+        std::vector<int> ids;
+        std::vector<geometry::Vec3> points;
+        std::vector<MapObservation> observations;
+        std::vector<uint8_t> rows;
+        const geometry::Pose origin;
+        for (int i = 0; i < n; ++i) {
+            const geometry::Vec3 X{rng.uniform(-2.0, 2.0), rng.uniform(-1.5, 1.5),
+                                   rng.uniform(4.0, 8.0)};
+            const cv::Point2f px = project(origin, X);
+            ids.push_back(500 + i);
+            points.push_back(X);
+            observations.push_back({0, 500 + i, px.x, px.y});
+            descriptors.push_back(random_descriptor(rng));
+            rows.insert(rows.end(), descriptors.back().begin(), descriptors.back().end());
+        }
+        LandmarkMap map;
+        map.add_keyframe(origin, ids, points, observations, rows);
+        return map;
+    }
+
+    void test_capture() {
+        cv::RNG rng(1);
+        std::vector<std::vector<uint8_t>> descriptors;
+        LandmarkMap map = make_map(40, rng, descriptors);
+
+        // A keyframe without descriptors, then one whose second row is blank.
+        const geometry::Pose pose;
+        map.add_keyframe(pose, {}, {}, {{1, 500, 320.0, 240.0}});
+        std::vector<uint8_t> rows = descriptors[0];
+        rows.resize(2 * kDescriptorBytes, 0);
+        map.add_keyframe(pose, {}, {}, {{2, 500, 320.0, 240.0}, {2, 501, 330.0, 240.0}}, rows);
+
+        auto newest = Relocalizer::capture(map, 1);
+        CHECK(newest != nullptr);
+        CHECK(newest->keyframes == std::vector<int>({2}));
+        CHECK(newest->landmarks == std::vector<int>({500}));  // Blank row skipped.
+        CHECK(newest->descriptors.rows == 1);
+        CHECK(newest->descriptors.cols == static_cast<int>(kDescriptorBytes));
+
+        // Keyframes without descriptors do not count towards the limit.
+        auto all = Relocalizer::capture(map, 5);
+        CHECK(all->keyframes == std::vector<int>({2, 0}));
+        CHECK(all->landmarks.size() == 41u);
+        CHECK(all->points.size() == 41u);
+        const Landmark* lm = map.find(520);
+        CHECK_NEAR(all->points[21].z, lm->position[2], 1e-5);
+
+        CHECK(Relocalizer::capture(LandmarkMap(), 5) == nullptr);
+    }
+
+    void test_relocalize_synthetic() {
+        cv::RNG rng(7);
+        std::vector<std::vector<uint8_t>> descriptors;
+        const LandmarkMap map = make_map(150, rng, descriptors);
+        Relocalizer reloc(kK);
+        CHECK(!reloc.has_map());
+        reloc.set_map(Relocalizer::capture(map, 5));
+        CHECK(reloc.has_map());
+
+        // The camera has moved and turned; the features come back with a few
+        // flipped bits, in a different order, among unrelated distractors.
+        geometry::Pose truth;
+        const double a = 0.1;
+        truth.R.m[0][0] = std::cos(a);
+        truth.R.m[0][2] = std::sin(a);
+        truth.R.m[2][0] = -std::sin(a);
+        truth.R.m[2][2] = std::cos(a);
+        truth.t = {0.3, -0.1, 0.2};
+
+        std::vector<cv::KeyPoint> keypoints;
+        cv::Mat query(0, static_cast<int>(kDescriptorBytes), CV_8U);
+        std::vector<int> expected;
+        const std::vector<Landmark>& landmarks = map.landmarks();
+        for (int i = static_cast<int>(landmarks.size()) - 1; i >= 0; --i) {
+            std::vector<uint8_t> d = descriptors[i];
+            for (int flip = 0; flip < 4; ++flip) {
+                d[rng.uniform(0, 32)] ^= static_cast<uint8_t>(1u << rng.uniform(0, 8));
+            }
+            keypoints.emplace_back(project(truth, landmarks[i].position), 31.0f);
+            query.push_back(cv::Mat(1, static_cast<int>(kDescriptorBytes), CV_8U, d.data()));
+            expected.push_back(landmarks[i].id);
+        }
+        for (int i = 0; i < 60; ++i) {
+            std::vector<uint8_t> d = random_descriptor(rng);
+            keypoints.emplace_back(cv::Point2f(rng.uniform(0.f, 640.f), rng.uniform(0.f, 480.f)),
+                                   31.0f);
+            query.push_back(cv::Mat(1, static_cast<int>(kDescriptorBytes), CV_8U, d.data()));
+            expected.push_back(-1);
+        }
+
+        const RelocalizationResult r = reloc.relocalize(keypoints, query);
+        CHECK(r.success);
+        CHECK(r.matches >= 140);
+        CHECK(r.inliers >= 140);
+        CHECK(r.time_ms >= 0.0);
+        for (int i = 0; i < 3; ++i) {
+            CHECK_NEAR(r.pose.t[i], truth.t[i], 1e-2);
+            for (int j = 0; j < 3; ++j) {
+                CHECK_NEAR(r.pose.R.m[i][j], truth.R.m[i][j], 1e-3);
+            }
+        }
+        int wrong = 0;
+        for (size_t k = 0; k < keypoints.size(); ++k) {
+            if (r.track_ids[k] >= 0 && r.track_ids[k] != expected[k]) {
+                ++wrong;
+            }
+        }
+        CHECK(wrong == 0);
+        CHECK(r.track_ids.back() == -1);
+
+        // A frame of a different place matches nothing and keeps no ids.
+        cv::Mat unrelated(static_cast<int>(keypoints.size()), static_cast<int>(kDescriptorBytes),
+                          CV_8U);
+        rng.fill(unrelated, cv::RNG::UNIFORM, 0, 256);
+        const RelocalizationResult miss = reloc.relocalize(keypoints, unrelated);
+        CHECK(!miss.success);
+        CHECK(miss.track_ids.size() == keypoints.size());
+    }
+
+    cv::Mat make_textured_image(int seed) {
+        cv::RNG rng(seed);
+        cv::Mat img(480, 640, CV_8UC3);
+        rng.fill(img, cv::RNG::UNIFORM, 40, 120);
+        for (int i = 0; i < 200; ++i) {
+            cv::Point p(rng.uniform(10, 630), rng.uniform(10, 470));
+            cv::Scalar color(rng.uniform(150, 255), rng.uniform(150, 255), rng.uniform(150, 255));
+            if (rng.uniform(0, 2)) {
+                cv::rectangle(img, p, p + cv::Point(rng.uniform(8, 30), rng.uniform(8, 30)), color,
+                              -1);
+            } else {
+                cv::circle(img, p, rng.uniform(4, 14), color, -1);
+            }
+        }
+        return img;
+    }
+
+    void test_tracker_reattaches_ids() {
+        // Map the image's own ORB features at random depths, as if an earlier
+        // keyframe had triangulated them with track ids 100000 + i.
+        cv::Mat img = make_textured_image(5);
+        auto mapped = std::make_shared<Frame>(img);
+        mapped->extract_features();
+        cv::RNG rng(3);
+        auto places = std::make_shared<RelocalizationMap>();
+        places->keyframes = {0};
+        places->descriptors = mapped->descriptors_.clone();
+        for (size_t i = 0; i < mapped->keypoints_.size(); ++i) {
+            const cv::Point2f& px = mapped->keypoints_[i].pt;
+            const float z = static_cast<float>(rng.uniform(3.0, 6.0));
+            places->landmarks.push_back(100000 + static_cast<int>(i));
+            places->points.emplace_back(static_cast<float>((px.x - kK(0, 2)) / kK(0, 0) * z),
+                                        static_cast<float>((px.y - kK(1, 2)) / kK(1, 1) * z), z);
+        }
+        Relocalizer reloc(kK);
+        reloc.set_map(places);
+
+        // A tracker that lost everything re-detects the same view.
+        FeatureTracker tracker;
+        tracker.set_relocalizer(&reloc);
+        const TrackingResult r = tracker.track_features(std::make_shared<Frame>(img));
+        CHECK(r.relocalized);
+        CHECK(r.relocalized_tracks > 100);
+        CHECK(r.track_ids.size() == r.curr_points.size());
+        int reattached = 0;
+        for (int id : r.track_ids) {
+            reattached += id >= 100000 ? 1 : 0;
+        }
+        CHECK(reattached == r.relocalized_tracks);
+
+        // Without a relocalizer every track is fresh.
+        FeatureTracker cold;
+        const TrackingResult c = cold.track_features(std::make_shared<Frame>(img));
+        CHECK(!c.relocalized);
+        CHECK(c.relocalized_tracks == 0);
+    }
+
+}  // namespace
+
+int main() {
+    test_capture();
+    test_relocalize_synthetic();
+    test_tracker_reattaches_ids();
+    return artest::report("test_relocalization");
+}
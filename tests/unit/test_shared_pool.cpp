@@ -0,0 +1,155 @@
+// Unit tests for the pool-backed std::allocate_shared.
+// Verifies that objects and their control blocks come from the pool slots,
+// exhaustion (nullptr, then recovery once an object is released), that copies
+// and weak_ptr behave as with make_shared, that the slots outlive the
+// SharedPool while objects are alive, release on another thread, and that a
+// throwing constructor gives its slot back.
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "core/shared_pool.h"
+#include "test_util.h"
+
+namespace {
+
+    std::atomic<int> g_live{0};
+
+    struct Tracked {
+        explicit Tracked(int v, bool fail = false) : value(v) {
+            if (fail) {
+                throw std::runtime_error("constructor failed");
+            }
+            ++g_live;
+        }
+        ~Tracked() { --g_live; }
+        int value;
+        double payload[8] = {};
+    };
+
+    void test_make_and_release() {
+        ar_slam::SharedPool<Tracked> pool(4);
+        CHECK(pool.capacity() == 4);
+        CHECK(pool.used() == 0);
+        {
+            std::shared_ptr<Tracked> a = pool.make(1);
+            std::shared_ptr<Tracked> b = pool.make(2);
+            CHECK(a && b && a->value == 1 && b->value == 2);
+            CHECK(pool.used() == 2 && pool.available() == 2);
+            CHECK(pool.owns(a) && pool.owns(b));
+            CHECK(!pool.owns(std::make_shared<Tracked>(3)));
+            CHECK(g_live == 2);
+        }
+        CHECK(pool.used() == 0);
+        CHECK(g_live == 0);
+    }
+
+    void test_exhaustion() {
+        ar_slam::SharedPool<Tracked> pool(3);
+        std::vector<std::shared_ptr<Tracked>> held;
+        for (int i = 0; i < 3; ++i) {
+            held.push_back(pool.make(i));
+        }
+        CHECK(pool.used() == 3);
+        CHECK(pool.make(99) == nullptr);
+        CHECK(g_live == 3);  // The refused object was never constructed.
+
+        held.pop_back();
+        std::shared_ptr<Tracked> again = pool.make(7);
+        CHECK(again && again->value == 7);
+        CHECK(pool.used() == 3);
+    }
+
+    void test_copies_and_weak() {
+        ar_slam::SharedPool<Tracked> pool(2);
+        std::weak_ptr<Tracked> weak;
+        {
+            std::shared_ptr<Tracked> a = pool.make(5);
+            std::shared_ptr<Tracked> copy = a;
+            weak = a;
+            CHECK(a.use_count() == 2);
+            a.reset();
+            CHECK(pool.used() == 1);
+            CHECK(weak.lock()->value == 5);
+
+            // Aliasing shares the owner's slot.
+            std::shared_ptr<int> member(copy, &copy->value);
+            copy.reset();
+            CHECK(*member == 5 && pool.used() == 1);
+        }
+        CHECK(weak.expired());
+        CHECK(g_live == 0);
+        // A weak_ptr keeps the slot (it holds the control block) but not the object.
+        CHECK(pool.used() == 1);
+        weak.reset();
+        CHECK(pool.used() == 0);
+    }
+
+    void test_outlives_pool() {
+        std::shared_ptr<Tracked> survivor;
+        {
+            ar_slam::SharedPool<Tracked> pool(2);
+            survivor = pool.make(42);
+        }
+        CHECK(survivor->value == 42);
+        survivor.reset();  // Frees the slot, then the pool itself.
+        CHECK(g_live == 0);
+    }
+
+    void test_release_on_other_thread() {
+        ar_slam::SharedPool<Tracked> pool(64);
+        std::vector<std::shared_ptr<Tracked>> batch;
+        for (int i = 0; i < 64; ++i) {
+            batch.push_back(pool.make(i));
+        }
+        std::thread consumer([objects = std::move(batch)]() mutable { objects.clear(); });
+        consumer.join();
+        CHECK(pool.used() == 0);
+        CHECK(g_live == 0);
+
+        // Concurrent makers and releasers never exceed the capacity.
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 4; ++t) {
+            workers.emplace_back([&pool] {
+                for (int i = 0; i < 10000; ++i) {
+                    std::shared_ptr<Tracked> p = pool.make(i);
+                    if (p) {
+                        p->value += 1;
+                    }
+                }
+            });
+        }
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        CHECK(pool.used() == 0);
+        CHECK(g_live == 0);
+    }
+
+    void test_throwing_constructor() {
+        ar_slam::SharedPool<Tracked> pool(1);
+        bool threw = false;
+        try {
+            pool.make(1, true);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+        CHECK(pool.used() == 0);
+        CHECK(pool.make(2) != nullptr);
+    }
+
+}  // namespace
+
+int main() {
+    test_make_and_release();
+    test_exhaustion();
+    test_copies_and_weak();
+    test_outlives_pool();
+    test_release_on_other_thread();
+    test_throwing_constructor();
+    return artest::report("test_shared_pool");
+}
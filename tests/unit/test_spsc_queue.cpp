@@ -0,0 +1,104 @@
+// Unit tests for the lock-free single-producer/single-consumer queue.
+// Verifies capacity rounding, full/empty behaviour, buffer recycling through
+// the slots, and FIFO delivery under a concurrent producer and consumer.
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "core/spsc_queue.h"
+#include "test_util.h"
+
+namespace {
+
+    void test_capacity_and_bounds() {
+        ar_slam::SpscQueue<int> queue(5);
+        CHECK(queue.capacity() == 8);  // Rounded up to a power of two.
+        CHECK(queue.empty());
+
+        int out = -1;
+        CHECK(!queue.try_pop(out));
+
+        for (int i = 0; i < 8; ++i) {
+            CHECK(queue.writable());
+            int v = i;
+            CHECK(queue.try_push(v));
+        }
+        CHECK(!queue.writable());
+        int extra = 99;
+        CHECK(!queue.try_push(extra));  // Full: rejected, not overwritten.
+        CHECK(extra == 99);
+        CHECK(queue.size_approx() == 8);
+
+        for (int i = 0; i < 8; ++i) {
+            CHECK(queue.try_pop(out));
+            CHECK(out == i);
+            CHECK(queue.writable());
+        }
+        CHECK(queue.empty());
+
+        ar_slam::SpscQueue<int> tiny(0);
+        CHECK(tiny.capacity() == 2);
+    }
+
+    void test_buffers_are_recycled() {
+        ar_slam::SpscQueue<std::vector<int>> queue(2);
+        std::vector<int> first(1000, 1);
+        const int* first_data = first.data();
+        CHECK(queue.try_push(first));
+
+        // The consumer's old buffer is swapped into the slot it pops from...
+        std::vector<int> out;
+        out.reserve(64);
+        const int* consumer_data = out.data();
+        CHECK(queue.try_pop(out));
+        CHECK(out.size() == 1000);
+        CHECK(out.data() == first_data);  // Moved through, never copied.
+
+        // ...and handed to the producer when it wraps around to that slot.
+        std::vector<int> second;
+        std::vector<int> third;
+        CHECK(queue.try_push(second));  // Slot 1.
+        CHECK(queue.try_push(third));   // Slot 0 again.
+        CHECK(third.data() == consumer_data);
+        CHECK(third.capacity() >= 64);
+    }
+
+    void test_concurrent_fifo() {
+        constexpr int kCount = 200000;
+        ar_slam::SpscQueue<int> queue(64);
+
+        std::thread producer([&queue] {
+            for (int i = 0; i < kCount; ++i) {
+                int v = i;
+                while (!queue.try_push(v)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        int expected = 0;
+        bool in_order = true;
+        while (expected < kCount) {
+            int v = -1;
+            if (!queue.try_pop(v)) {
+                std::this_thread::yield();
+                continue;
+            }
+            in_order = in_order && v == expected;
+            ++expected;
+        }
+        producer.join();
+
+        CHECK(in_order);
+        CHECK(queue.empty());
+    }
+
+}  // namespace
+
+int main() {
+    test_capacity_and_bounds();
+    test_buffers_are_recycled();
+    test_concurrent_fifo();
+    return artest::report("test_spsc_queue");
+}
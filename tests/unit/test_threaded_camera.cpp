@@ -0,0 +1,169 @@
+// Tests for the threaded capture decorator, against an in-process source that
+// produces numbered frames at a set pace: newest-frame hand-over, drop and
+// latency accounting, end of stream, timeouts and image recycling.
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <thread>
+
+#include "camera/threaded_camera.h"
+#include "test_util.h"
+
+namespace {
+
+    using ar_slam::ThreadedCamera;
+    using Clock = std::chrono::steady_clock;
+
+    /// Delivers an 8x8 gray frame every @c period, each filled with its index
+    /// (mod 256), until @c limit frames have been sent.
+    class FakeSource : public ar_slam::CameraInterface {
+    public:
+        std::chrono::milliseconds period{2};
+        int limit = -1;  ///< Frames before the stream ends; -1 for endless.
+        bool openable = true;
+        std::atomic<int> opens{0}, closes{0};
+
+        bool open(const ar_slam::CameraConfig& config) override {
+            config_ = config;
+            if (!openable) {
+                return false;
+            }
+            ++opens;
+            next_ = 0;
+            is_running_ = true;
+            return true;
+        }
+        void close() override {
+            ++closes;
+            is_running_ = false;
+        }
+        bool is_open() const override { return is_running_; }
+
+        bool grab_frame(cv::Mat& frame) override {
+            std::this_thread::sleep_for(period);
+            if (limit >= 0 && next_ >= limit) {
+                return false;
+            }
+            frame.create(8, 8, CV_8UC1);  // Reuses the image's allocation.
+            for (int r = 0; r < 8; ++r) {
+                for (int c = 0; c < 8; ++c) frame.ptr<uint8_t>(r)[c] = next_ & 0xff;
+            }
+            ++next_;
+            return true;
+        }
+        double get_fps() const override { return 1000.0 / period.count(); }
+
+    private:
+        int next_ = 0;
+    };
+
+    int frame_index(const cv::Mat& frame) { return frame.ptr<uint8_t>(7)[7]; }
+
+    void test_newest_frame_wins() {
+        auto source = std::make_shared<FakeSource>();
+        ThreadedCamera camera(source);
+        CHECK(camera.open(ar_slam::CameraConfig{}));
+        CHECK(camera.is_open() && source->opens == 1);
+
+        // A consumer slower than the source gets fresh frames, not a backlog.
+        cv::Mat frame;
+        int last = -1;
+        bool skipped = false;
+        bool increasing = true;
+        for (int i = 0; i < 10; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(15));
+            Clock::time_point captured;
+            CHECK(camera.grab_frame(frame, captured));
+            CHECK(Clock::now() - captured < std::chrono::milliseconds(15));
+            const int index = frame_index(frame);
+            increasing = increasing && index > last;
+            skipped = skipped || index > last + 1;
+            last = index;
+        }
+        CHECK(increasing && skipped);
+        CHECK(camera.frames_delivered() == 10);
+        CHECK(camera.frames_dropped() > 0);
+        CHECK(camera.latency_ms() < 15.0 && camera.mean_latency_ms() < 15.0);
+        CHECK(camera.get_fps() > 0);
+
+        camera.close();
+        CHECK(!camera.is_open() && source->closes == 1);
+        // Every frame captured was either handed over, dropped or still waiting.
+        const uint64_t accounted = camera.frames_delivered() + camera.frames_dropped();
+        CHECK(camera.frames_captured() == accounted || camera.frames_captured() == accounted + 1);
+        CHECK(!camera.grab_frame(frame));
+    }
+
+    void test_end_of_stream() {
+        auto source = std::make_shared<FakeSource>();
+        source->limit = 5;
+        source->period = std::chrono::milliseconds(10);
+        ThreadedCamera camera(source);
+        CHECK(camera.open(ar_slam::CameraConfig{}));
+
+        // Consumed as fast as it arrives: every frame, in order, then a prompt end.
+        cv::Mat frame;
+        int expected = 0;
+        while (camera.grab_frame(frame)) {
+            CHECK(frame_index(frame) == expected);
+            ++expected;
+        }
+        CHECK(expected == 5);
+        CHECK(camera.frames_dropped() == 0);
+        CHECK(camera.is_open());  // Until close(), which the consumer owns.
+
+        // Reopening restarts the stream and the statistics.
+        CHECK(camera.open(ar_slam::CameraConfig{}));
+        CHECK(source->closes == 1 && source->opens == 2);
+        CHECK(camera.grab_frame(frame) && frame_index(frame) == 0);
+        CHECK(camera.frames_delivered() == 1);
+    }
+
+    void test_timeout_and_open_failure() {
+        auto source = std::make_shared<FakeSource>();
+        source->period = std::chrono::milliseconds(300);
+        ThreadedCamera::Options options;
+        options.timeout_ms = 20;
+        ThreadedCamera camera(source, options);
+        CHECK(camera.open(ar_slam::CameraConfig{}));
+        cv::Mat frame;
+        const auto start = Clock::now();
+        CHECK(!camera.grab_frame(frame));
+        CHECK(Clock::now() - start < std::chrono::milliseconds(250));
+        CHECK(camera.is_open());
+        camera.close();
+
+        source->openable = false;
+        CHECK(!camera.open(ar_slam::CameraConfig{}));
+        CHECK(!camera.is_open());
+    }
+
+    void test_images_recycled() {
+        auto source = std::make_shared<FakeSource>();
+        source->period = std::chrono::milliseconds(1);
+        ThreadedCamera camera(source);
+        CHECK(camera.open(ar_slam::CameraConfig{}));
+
+        // Three ring slots plus the caller's image, captured into again and again.
+        std::set<const uint8_t*> images;
+        cv::Mat frame;
+        for (int i = 0; i < 50; ++i) {
+            CHECK(camera.grab_frame(frame));
+            images.insert(frame.data);
+        }
+        CHECK(images.size() <= 4);
+    }
+
+}  // namespace
+
+int main() {
+    test_newest_frame_wins();
+    test_end_of_stream();
+    test_timeout_and_open_failure();
+    test_images_recycled();
+    return artest::report("test_threaded_camera");
+}
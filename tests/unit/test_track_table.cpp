@@ -0,0 +1,134 @@
+// Unit tests for the dense track id table.
+// Checks lookup against a reference map across many reassignments (so stale
+// entries from earlier generations never hit), repeated ids, ids far below the
+// window that fall back to the overflow list, ring growth and clearing.
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "core/track_table.h"
+#include "test_util.h"
+
+using ar_slam::TrackTable;
+
+namespace {
+
+    using artest::Lcg;
+
+    void test_lookup() {
+        TrackTable<int> table;
+        CHECK(table.empty() && table.find(0) == nullptr);
+        table.assign({5, 9, 7}, {50, 90, 70});
+        CHECK(table.size() == 3);
+        CHECK(table.find(5) != nullptr && *table.find(5) == 50);
+        CHECK(table.find(9) != nullptr && *table.find(9) == 90);
+        CHECK(table.find(7) != nullptr && *table.find(7) == 70);
+        CHECK(table.find(6) == nullptr);
+        CHECK(table.find(8 + static_cast<int>(table.capacity())) == nullptr);  // Past the window.
+        CHECK(table.find(-1) == nullptr);
+        CHECK(table.overflow() == 0);
+    }
+
+    void test_generations() {
+        // Sliding windows of track ids, as the tracker produces them: every
+        // lookup must match a freshly built std::map, including ids that were
+        // present one or more assignments ago.
+        Lcg rng{1};
+        TrackTable<int> table;
+        int next_id = 0;
+        std::vector<int> alive;
+        for (int round = 0; round < 200; ++round) {
+            std::vector<int> survivors;
+            for (int id : alive) {
+                if (rng.next() % 4 != 0) {
+                    survivors.push_back(id);
+                }
+            }
+            while (survivors.size() < 150) {
+                survivors.push_back(next_id++);
+            }
+            alive = survivors;
+
+            std::vector<int> values;
+            std::map<int, int> expected;
+            for (int id : alive) {
+                values.push_back(id * 3 + round);
+                expected[id] = id * 3 + round;
+            }
+            table.assign(alive, values);
+            CHECK(table.size() == expected.size());
+            for (int id = next_id - 400; id < next_id + 5; ++id) {
+                auto it = expected.find(id);
+                const int* found = table.find(id);
+                CHECK((found != nullptr) == (it != expected.end()));
+                if (found != nullptr && it != expected.end()) {
+                    CHECK(*found == it->second);
+                }
+            }
+        }
+        CHECK(table.capacity() < static_cast<std::size_t>(next_id));  // Sized by the window.
+        CHECK(table.overflow() == 0);
+    }
+
+    void test_duplicates() {
+        TrackTable<int> table;
+        table.assign({4, 4, 6}, {1, 2, 3});
+        CHECK(table.size() == 2);
+        CHECK(*table.find(4) == 2);  // The last value wins, like operator[].
+        table.assign({1, 1000000, 1, 1000000}, {1, 2, 3, 4});
+        CHECK(table.size() == 2 && table.overflow() == 1);
+        CHECK(*table.find(1) == 3 && *table.find(1000000) == 4);
+    }
+
+    void test_overflow() {
+        // Relocalization re-attaches very old landmark ids next to fresh tracks.
+        TrackTable<int> table;
+        std::vector<int> ids = {3, 17, 40000};
+        for (int id = 500000; id < 500300; ++id) {
+            ids.push_back(id);
+        }
+        std::vector<int> values(ids.size());
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            values[i] = -ids[i];
+        }
+        table.assign(ids, values);
+        CHECK(table.size() == ids.size());
+        CHECK(table.overflow() == 3);
+        CHECK(table.capacity() == 512);
+        for (int id : ids) {
+            CHECK(table.find(id) != nullptr && *table.find(id) == -id);
+        }
+        CHECK(table.find(4) == nullptr && table.find(39999) == nullptr);
+        CHECK(table.find(500300) == nullptr);
+
+        // The next keyframe drops the old ids; nothing of them remains.
+        table.assign({500100, 500400}, {1, 2});
+        CHECK(table.overflow() == 0 && table.size() == 2);
+        CHECK(table.find(3) == nullptr && table.find(500000) == nullptr);
+        CHECK(*table.find(500400) == 2);
+    }
+
+    void test_clear() {
+        TrackTable<float> table;
+        table.assign({10, 11, 12}, {1.0f, 2.0f, 3.0f});
+        const std::size_t capacity = table.capacity();
+        table.clear();
+        CHECK(table.empty() && table.find(10) == nullptr);
+        CHECK(table.capacity() == capacity);  // The ring is kept for reuse.
+        table.assign({}, {});
+        CHECK(table.empty() && table.find(0) == nullptr);
+        table.assign({12}, {4.0f});
+        CHECK(table.find(10) == nullptr && *table.find(12) == 4.0f);
+    }
+
+}  // namespace
+
+int main() {
+    test_lookup();
+    test_generations();
+    test_duplicates();
+    test_overflow();
+    test_clear();
+    return artest::report("test_track_table");
+}
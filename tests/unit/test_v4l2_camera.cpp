@@ -0,0 +1,460 @@
+// Headless tests for V4L2 capture.
+// Runs V4L2Camera against an in-process fake device (a V4L2Io that answers
+// the ioctls itself), so no /dev/video node is needed. Verifies format
+// negotiation and strides, that MMAP and USERPTR captures are headers over
+// the driver's buffers with nothing copied, that a buffer is requeued only
+// when the last Frame holding it is released (on any thread), that capture
+// fails fast once every buffer is held, and that buffers outlive close().
+
+#include <linux/videodev2.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "camera/v4l2_camera.h"
+#include "core/frame.h"
+#include "test_util.h"
+
+namespace {
+
+    using ar_slam::V4L2Camera;
+
+    constexpr int kFd = 7;
+
+    /// A capture device in memory. DQBUF fills the oldest queued buffer with a
+    /// pattern derived from its sequence number: row r, column c holds
+    /// (sequence + r + c) & 0xff in every byte of the pixel (in the Y plane
+    /// for NV12, whose chroma is neutral).
+    class FakeDevice : public ar_slam::V4L2Io {
+    public:
+        bool userptr_supported = true;
+        int max_width = 640, max_height = 480;
+        uint32_t row_alignment = 64;  ///< bytesperline is padded to this.
+
+        int closes = 0;
+        int unmaps = 0;
+        int streamoffs = 0;
+
+        std::size_t queued() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return queue_.size();
+        }
+
+        /// Storage the driver filled for buffer @p index (its own, or the user's).
+        const uint8_t* buffer_data(uint32_t index) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return slots_[index].data;
+        }
+
+        bool in_buffers(const void* p) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const Slot& s : slots_) {
+                const auto* b = static_cast<const uint8_t*>(p);
+                if (s.data != nullptr && b >= s.data && b < s.data + format_.sizeimage) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        int open(const char* path, int) override {
+            if (std::strcmp(path, "/dev/fake") != 0) {
+                errno = ENOENT;
+                return -1;
+            }
+            return kFd;
+        }
+
+        int close(int) override {
+            ++closes;
+            return 0;
+        }
+
+        void* mmap(std::size_t length, int, off_t offset) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto index = static_cast<std::size_t>(offset) / kOffsetUnit;
+            if (index >= slots_.size() || length != format_.sizeimage) {
+                errno = EINVAL;
+                return MAP_FAILED;
+            }
+            return slots_[index].data;
+        }
+
+        int munmap(void*, std::size_t) override {
+            ++unmaps;
+            return 0;
+        }
+
+        int poll(int, int) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return streaming_ && !queue_.empty() ? 1 : 0;
+        }
+
+        int ioctl(int fd, unsigned long request, void* arg) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (fd != kFd) {
+                return fail(EBADF);
+            }
+            switch (request) {
+                case VIDIOC_QUERYCAP: {
+                    auto* cap = static_cast<v4l2_capability*>(arg);
+                    *cap = v4l2_capability{};
+                    cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+                    cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+                    return 0;
+                }
+                case VIDIOC_S_FMT: {
+                    v4l2_pix_format& pix = static_cast<v4l2_format*>(arg)->fmt.pix;
+                    if (pix.pixelformat != V4L2_PIX_FMT_GREY &&
+                        pix.pixelformat != V4L2_PIX_FMT_YUYV &&
+                        pix.pixelformat != V4L2_PIX_FMT_NV12) {
+                        pix.pixelformat = V4L2_PIX_FMT_YUYV;  // Substitute, as drivers do.
+                    }
+                    pix.width = std::min<uint32_t>(pix.width, max_width);
+                    pix.height = std::min<uint32_t>(pix.height, max_height);
+                    const uint32_t bpp = pix.pixelformat == V4L2_PIX_FMT_YUYV ? 2 : 1;
+                    pix.bytesperline =
+                        (pix.width * bpp + row_alignment - 1) / row_alignment * row_alignment;
+                    pix.sizeimage = pix.bytesperline * pix.height;
+                    if (pix.pixelformat == V4L2_PIX_FMT_NV12) {
+                        pix.sizeimage = pix.sizeimage * 3 / 2;
+                    }
+                    format_ = pix;
+                    return 0;
+                }
+                case VIDIOC_S_PARM:
+                    return 0;
+                case VIDIOC_REQBUFS: {
+                    auto* req = static_cast<v4l2_requestbuffers*>(arg);
+                    if (req->memory == V4L2_MEMORY_USERPTR && !userptr_supported) {
+                        return fail(EINVAL);
+                    }
+                    memory_ = req->memory;
+                    req->count = std::min(req->count, 8u);
+                    storage_.assign(req->count, std::vector<uint8_t>());
+                    slots_.assign(req->count, Slot{});
+                    for (uint32_t i = 0; i < req->count; ++i) {
+                        if (memory_ == V4L2_MEMORY_MMAP) {
+                            storage_[i].resize(format_.sizeimage);
+                            slots_[i].data = storage_[i].data();
+                        }
+                    }
+                    queue_.clear();
+                    return 0;
+                }
+                case VIDIOC_QUERYBUF: {
+                    auto* buf = static_cast<v4l2_buffer*>(arg);
+                    if (buf->index >= slots_.size()) {
+                        return fail(EINVAL);
+                    }
+                    buf->length = format_.sizeimage;
+                    buf->m.offset = buf->index * kOffsetUnit;
+                    return 0;
+                }
+                case VIDIOC_QBUF: {
+                    auto* buf = static_cast<v4l2_buffer*>(arg);
+                    if (buf->index >= slots_.size() || slots_[buf->index].queued ||
+                        buf->memory != memory_) {
+                        return fail(EINVAL);
+                    }
+                    Slot& slot = slots_[buf->index];
+                    if (memory_ == V4L2_MEMORY_USERPTR) {
+                        if (buf->length < format_.sizeimage) {
+                            return fail(EINVAL);
+                        }
+                        slot.data = reinterpret_cast<uint8_t*>(buf->m.userptr);
+                    }
+                    slot.queued = true;
+                    queue_.push_back(buf->index);
+                    return 0;
+                }
+                case VIDIOC_DQBUF: {
+                    if (!streaming_ || queue_.empty()) {
+                        return fail(EAGAIN);
+                    }
+                    auto* buf = static_cast<v4l2_buffer*>(arg);
+                    const uint32_t index = queue_.front();
+                    queue_.pop_front();
+                    slots_[index].queued = false;
+                    fill(slots_[index].data, sequence_);
+                    buf->index = index;
+                    buf->bytesused = format_.sizeimage;
+                    buf->sequence = sequence_++;
+                    buf->flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+                    buf->timestamp.tv_sec = 100 + buf->sequence / 30;
+                    buf->timestamp.tv_usec = (buf->sequence % 30) * 33333;
+                    if (memory_ == V4L2_MEMORY_USERPTR) {
+                        buf->m.userptr = reinterpret_cast<unsigned long>(slots_[index].data);
+                    }
+                    return 0;
+                }
+                case VIDIOC_STREAMON:
+                    streaming_ = true;
+                    return 0;
+                case VIDIOC_STREAMOFF:
+                    streaming_ = false;
+                    ++streamoffs;
+                    for (Slot& s : slots_) {
+                        s.queued = false;
+                    }
+                    queue_.clear();
+                    return 0;
+                default:
+                    return fail(ENOTTY);
+            }
+        }
+
+    private:
+        static constexpr std::size_t kOffsetUnit = 1 << 20;
+
+        struct Slot {
+            uint8_t* data = nullptr;
+            bool queued = false;
+        };
+
+        static int fail(int error) {
+            errno = error;
+            return -1;
+        }
+
+        void fill(uint8_t* data, uint32_t sequence) const {
+            const uint32_t bpp = format_.pixelformat == V4L2_PIX_FMT_YUYV ? 2 : 1;
+            for (uint32_t r = 0; r < format_.height; ++r) {
+                uint8_t* row = data + r * format_.bytesperline;
+                for (uint32_t c = 0; c < format_.width; ++c) {
+                    std::memset(row + c * bpp, static_cast<int>((sequence + r + c) & 0xff), bpp);
+                }
+            }
+            if (format_.pixelformat == V4L2_PIX_FMT_NV12) {
+                const std::size_t luma = std::size_t(format_.bytesperline) * format_.height;
+                std::memset(data + luma, 128, format_.sizeimage - luma);
+            }
+        }
+
+        std::mutex mutex_;
+        v4l2_pix_format format_{};
+        uint32_t memory_ = V4L2_MEMORY_MMAP;
+        std::vector<std::vector<uint8_t>> storage_;
+        std::vector<Slot> slots_;
+        std::deque<uint32_t> queue_;
+        bool streaming_ = false;
+        uint32_t sequence_ = 0;
+    };
+
+    ar_slam::CameraConfig fake_config(int width = 640, int height = 480) {
+        ar_slam::CameraConfig config;
+        config.device_path = "/dev/fake";
+        config.width = width;
+        config.height = height;
+        return config;
+    }
+
+    void test_negotiation() {
+        auto device = std::make_shared<FakeDevice>();
+        V4L2Camera::Options options;
+        V4L2Camera camera(options, device);
+        CHECK(!camera.open([] {
+            ar_slam::CameraConfig c = fake_config();
+            c.device_path = "/dev/missing";
+            return c;
+        }()));
+        CHECK(!camera.is_open());
+
+        // The driver clamps the size and pads each row.
+        CHECK(camera.open(fake_config(1000, 300)));
+        CHECK(camera.is_open());
+        CHECK(camera.pixel_format() == V4L2_PIX_FMT_GREY);
+        CHECK(camera.width() == 640 && camera.height() == 300);
+        camera.close();
+        CHECK(camera.open(fake_config(630, 200)));
+        CHECK(camera.stride() == 640);
+        CHECK(camera.buffer_count() == 4);
+
+        V4L2Camera::Capture c;
+        CHECK(camera.capture(c));
+        CHECK(c.image.cols == 630 && c.image.rows == 200);
+        CHECK(c.image.step[0] == 640);  // The driver's stride, not a repacked copy.
+        CHECK(c.image.at<uint8_t>(10, 20) == ((c.sequence + 30) & 0xff));
+
+        // An unsupported request is substituted by the driver; the camera follows.
+        options.pixel_format = V4L2_PIX_FMT_MJPEG;
+        V4L2Camera yuyv(options, std::make_shared<FakeDevice>());
+        CHECK(yuyv.open(fake_config()));
+        CHECK(yuyv.pixel_format() == V4L2_PIX_FMT_YUYV);
+        CHECK(yuyv.capture(c));
+        CHECK(c.image.type() == CV_8UC2);
+    }
+
+    void test_zero_copy_mmap() {
+        auto device = std::make_shared<FakeDevice>();
+        V4L2Camera camera(V4L2Camera::Options{}, device);
+        CHECK(camera.open(fake_config()));
+        CHECK(device->queued() == 4);
+
+        V4L2Camera::Capture c;
+        CHECK(camera.capture(c));
+        CHECK(device->in_buffers(c.image.data));
+        CHECK(c.image.data == device->buffer_data(0));
+        CHECK(c.sequence == 0);
+        CHECK(camera.buffers_held() == 1);
+        c = V4L2Camera::Capture{};  // Last holder gone: back to the driver.
+        CHECK(camera.buffers_held() == 0);
+        CHECK(device->queued() == 4);
+
+        // A frame borrows the buffer and keeps it out of the queue until released.
+        ar_slam::SharedPool<ar_slam::Frame> frames(4);
+        ar_slam::Frame::Ptr frame = camera.capture_frame(&frames);
+        CHECK(frame != nullptr && frames.used() == 1);
+        CHECK(frame->borrows_image());
+        CHECK(device->in_buffers(frame->get_image().data));
+        CHECK(frame->get_image().at<uint8_t>(0, 0) == 1);  // Second frame: sequence 1.
+        CHECK(device->queued() == 3);
+        ar_slam::Frame::Ptr copy = frame;
+        frame.reset();
+        CHECK(device->queued() == 3);
+        copy.reset();
+        CHECK(device->queued() == 4);
+        CHECK(frames.used() == 0);
+
+        // Driver timestamps become steady_clock times.
+        CHECK(camera.capture(c));
+        CHECK(c.timestamp.time_since_epoch() > std::chrono::seconds(99));
+    }
+
+    void test_userptr() {
+        auto device = std::make_shared<FakeDevice>();
+        V4L2Camera::Options options;
+        options.io = V4L2Camera::IoMethod::kUserPtr;
+        options.buffer_count = 3;
+        {
+            V4L2Camera camera(options, device);
+            CHECK(camera.open(fake_config(320, 240)));
+            CHECK(camera.buffer_count() == 3);
+            V4L2Camera::Capture c;
+            CHECK(camera.capture(c));
+            CHECK(c.image.data == device->buffer_data(0));  // Our buffer, filled in place.
+            CHECK(reinterpret_cast<std::uintptr_t>(c.image.data) % 4096 == 0);
+            CHECK(c.image.at<uint8_t>(5, 7) == 12);
+        }
+        CHECK(device->unmaps == 0);  // Nothing mapped in this mode.
+
+        device->userptr_supported = false;
+        V4L2Camera refused(options, device);
+        CHECK(!refused.open(fake_config()));
+    }
+
+    void test_all_buffers_held() {
+        auto device = std::make_shared<FakeDevice>();
+        V4L2Camera::Options options;
+        options.buffer_count = 3;
+        V4L2Camera camera(options, device);
+        CHECK(camera.open(fake_config()));
+
+        std::vector<ar_slam::Frame::Ptr> held;
+        for (int i = 0; i < 3; ++i) {
+            held.push_back(camera.capture_frame());
+        }
+        CHECK(held.back() != nullptr);
+        CHECK(camera.buffers_held() == 3);
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(camera.capture_frame() == nullptr);  // Fails at once, no timeout.
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+
+        held.erase(held.begin());
+        ar_slam::Frame::Ptr next = camera.capture_frame();
+        CHECK(next != nullptr);
+        CHECK(next->get_image().at<uint8_t>(0, 0) == 3);
+    }
+
+    void test_yuv_frames() {
+        // NV12: the frame's grayscale image is the driver's Y plane, in place.
+        V4L2Camera::Options options;
+        options.pixel_format = V4L2_PIX_FMT_NV12;
+        auto device = std::make_shared<FakeDevice>();
+        V4L2Camera nv12(options, device);
+        CHECK(nv12.open(fake_config(630, 200)));
+        CHECK(nv12.pixel_format() == V4L2_PIX_FMT_NV12);
+        ar_slam::Frame::Ptr frame = nv12.capture_frame();
+        CHECK(frame != nullptr);
+        CHECK(frame->get_source_format() == ar_slam::Frame::PixelFormat::kNV12);
+        const cv::Mat& gray = frame->get_image();
+        CHECK(gray.data == device->buffer_data(0));
+        CHECK(gray.rows == 200 && gray.cols == 630 && gray.step[0] == 640);
+        CHECK(gray.at<uint8_t>(10, 20) == 30);
+        // Colour is converted from the held buffer only when asked for.
+        const cv::Mat& colour = frame->get_color_image();
+        CHECK(colour.type() == CV_8UC3 && colour.rows == 200);
+        const cv::Vec3b bgr = colour.at<cv::Vec3b>(10, 20);
+        CHECK(bgr[0] == bgr[1] && bgr[1] == bgr[2]);  // Neutral chroma: a shade of gray.
+        CHECK(device->queued() == 3);
+        frame.reset();
+        CHECK(device->queued() == 4);
+
+        // YUYV: one pass extracts the luma; the buffer stays held for colour.
+        options.pixel_format = V4L2_PIX_FMT_YUYV;
+        device = std::make_shared<FakeDevice>();
+        V4L2Camera yuyv(options, device);
+        CHECK(yuyv.open(fake_config()));
+        frame = yuyv.capture_frame();
+        CHECK(frame != nullptr && frame->borrows_image());
+        CHECK(frame->get_image().type() == CV_8UC1);
+        CHECK(!device->in_buffers(frame->get_image().data));
+        CHECK(frame->get_image().at<uint8_t>(3, 4) == 7);
+        CHECK(device->queued() == 3);
+    }
+
+    void test_release_after_close_and_on_other_thread() {
+        auto device = std::make_shared<FakeDevice>();
+        ar_slam::Frame::Ptr survivor;
+        {
+            V4L2Camera camera(V4L2Camera::Options{}, device);
+            CHECK(camera.open(fake_config()));
+            survivor = camera.capture_frame();
+            ar_slam::Frame::Ptr other = camera.capture_frame();
+            std::thread consumer([f = std::move(other)]() mutable { f.reset(); });
+            consumer.join();
+            CHECK(camera.buffers_held() == 1);
+        }
+        // Closed and destroyed, but the held buffer stays mapped and the device open.
+        CHECK(device->streamoffs == 1);
+        CHECK(device->unmaps == 0 && device->closes == 0);
+        CHECK(survivor->get_image().at<uint8_t>(2, 3) == 5);
+        survivor.reset();
+        CHECK(device->unmaps == 4 && device->closes == 1);
+    }
+
+    void test_grab_frame_copies() {
+        auto device = std::make_shared<FakeDevice>();
+        V4L2Camera camera(V4L2Camera::Options{}, device);
+        CHECK(camera.open(fake_config()));
+        cv::Mat image;
+        CHECK(camera.grab_frame(image));
+        CHECK(!device->in_buffers(image.data));
+        CHECK(image.at<uint8_t>(1, 1) == 2);
+        CHECK(device->queued() == 4);  // Requeued as soon as it was copied.
+        for (int i = 0; i < 10; ++i) {
+            CHECK(camera.grab_frame(image));
+        }
+        CHECK(camera.get_fps() > 29.0 && camera.get_fps() < 31.0);
+    }
+
+}  // namespace
+
+int main() {
+    test_negotiation();
+    test_zero_copy_mmap();
+    test_userptr();
+    test_all_buffers_held();
+    test_yuv_frames();
+    test_release_after_close_and_on_other_thread();
+    test_grab_frame_copies();
+    return artest::report("test_v4l2_camera");
+}
@@ -0,0 +1,204 @@
+// Unit tests for the bag-of-binary-words vocabulary and its inverted index.
+// Trains on synthetic "places" built from noisy copies of prototype
+// descriptors, then checks word assignment, tf-idf vectors and scoring, the
+// mmap-loaded file format, and that the inverted index retrieves the right
+// place for a fresh observation of it.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "core/bow_index.h"
+#include "core/vocabulary.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+
+namespace {
+
+    using artest::Lcg;
+
+    std::vector<std::vector<uint8_t>> make_prototypes(int count, Lcg& rng) {
+        std::vector<std::vector<uint8_t>> out(count, std::vector<uint8_t>(kDescriptorBytes));
+        for (auto& d : out) {
+            for (uint8_t& b : d) {
+                b = static_cast<uint8_t>(rng.next());
+            }
+        }
+        return out;
+    }
+
+    // Append a copy of `d` with `flips` random bits inverted.
+    void append_noisy(const std::vector<uint8_t>& d,
+                      int flips,
+                      Lcg& rng,
+                      std::vector<uint8_t>& rows) {
+        const std::size_t start = rows.size();
+        rows.insert(rows.end(), d.begin(), d.end());
+        for (int f = 0; f < flips; ++f) {
+            const uint32_t bit = rng.next() % (kDescriptorBytes * 8);
+            rows[start + bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+        }
+    }
+
+    // A place is a fixed set of prototypes; each view of it re-samples the noise.
+    std::vector<uint8_t> view_of(const std::vector<int>& place,
+                                 const std::vector<std::vector<uint8_t>>& prototypes,
+                                 Lcg& rng) {
+        std::vector<uint8_t> rows;
+        for (int p : place) {
+            for (int copy = 0; copy < 3; ++copy) {
+                append_noisy(prototypes[p], 6, rng, rows);
+            }
+        }
+        return rows;
+    }
+
+    struct Scene {
+        std::vector<std::vector<uint8_t>> prototypes;
+        std::vector<std::vector<int>> places;
+        std::vector<std::vector<uint8_t>> views;
+    };
+
+    Scene make_scene(Lcg& rng) {
+        Scene scene;
+        scene.prototypes = make_prototypes(64, rng);
+        for (int place = 0; place < 100; ++place) {
+            std::vector<int> members;
+            while (members.size() < 10) {
+                const int p = static_cast<int>(rng.next() % 64);
+                if (std::find(members.begin(), members.end(), p) == members.end()) {
+                    members.push_back(p);
+                }
+            }
+            scene.places.push_back(members);
+            scene.views.push_back(view_of(members, scene.prototypes, rng));
+        }
+        return scene;
+    }
+
+    void test_training_and_transform() {
+        Lcg rng{7u};
+        const Scene scene = make_scene(rng);
+        const Vocabulary voc = Vocabulary::train(scene.views, 8, 2);
+        CHECK(!voc.empty());
+        CHECK(voc.word_count() > 8 && voc.word_count() <= 64);
+        CHECK(!voc.mapped());
+
+        // Noisy copies of a prototype land in the prototype's word.
+        int stable = 0;
+        for (const auto& proto : scene.prototypes) {
+            std::vector<uint8_t> noisy;
+            append_noisy(proto, 6, rng, noisy);
+            stable += voc.word_of(proto.data()) == voc.word_of(noisy.data());
+        }
+        CHECK(stable >= 60);
+
+        const BowVector a = voc.transform(scene.views[0]);
+        CHECK(!a.empty());
+        double sum = 0.0;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            sum += a[i].weight;
+            CHECK(i == 0 || a[i - 1].word < a[i].word);
+        }
+        CHECK_NEAR(sum, 1.0, 1e-5);
+        CHECK_NEAR(Vocabulary::score(a, a), 1.0, 1e-5);
+        CHECK_NEAR(Vocabulary::score(a, BowVector{}), 0.0, 1e-12);
+
+        // Another view of the same place scores higher than a different place.
+        const BowVector again = voc.transform(view_of(scene.places[0], scene.prototypes, rng));
+        const BowVector other = voc.transform(scene.views[1]);
+        CHECK(Vocabulary::score(a, again) > Vocabulary::score(a, other));
+    }
+
+    void test_file_round_trip() {
+        Lcg rng{11u};
+        const Scene scene = make_scene(rng);
+        const Vocabulary trained = Vocabulary::train(scene.views, 8, 2);
+
+        const std::string path = "test_vocabulary.arbv";
+        CHECK(trained.save(path));
+        Vocabulary loaded;
+        CHECK(loaded.load(path));
+        CHECK(loaded.mapped());
+        CHECK(loaded.node_count() == trained.node_count());
+        CHECK(loaded.word_count() == trained.word_count());
+        CHECK(loaded.branching() == 8 && loaded.depth() == 2);
+        for (const auto& view : scene.views) {
+            const BowVector x = trained.transform(view);
+            const BowVector y = loaded.transform(view);
+            CHECK(x.size() == y.size());
+            CHECK_NEAR(Vocabulary::score(x, y), 1.0, 1e-6);
+        }
+
+        // A moved-to vocabulary keeps the mapping alive.
+        Vocabulary moved(std::move(loaded));
+        CHECK(moved.mapped() && loaded.empty());
+        CHECK(moved.word_of(scene.prototypes[0].data()) ==
+              trained.word_of(scene.prototypes[0].data()));
+
+        // A child range past the end is rejected, even when the count alone
+        // exceeds the node count (so node_count - child_count would wrap).
+        std::FILE* f = std::fopen(path.c_str(), "r+b");
+        const uint32_t oversized = 0xFFFFFFFFu;
+        std::fseek(f, static_cast<long>(bow_detail::kNodeOffset +
+                                        offsetof(VocabularyNode, child_count)),
+                   SEEK_SET);
+        std::fwrite(&oversized, sizeof(oversized), 1, f);
+        std::fclose(f);
+        Vocabulary corrupt;
+        CHECK(!corrupt.load(path));
+
+        // Truncated or foreign files are rejected.
+        f = std::fopen(path.c_str(), "wb");
+        std::fputs("not a vocabulary", f);
+        std::fclose(f);
+        Vocabulary bad;
+        CHECK(!bad.load(path));
+        CHECK(!bad.load("does_not_exist.arbv"));
+        std::remove(path.c_str());
+    }
+
+    void test_inverted_index() {
+        Lcg rng{23u};
+        const Scene scene = make_scene(rng);
+        const Vocabulary voc = Vocabulary::train(scene.views, 8, 2);
+
+        BowIndex index(voc.word_count());
+        for (std::size_t i = 0; i < scene.views.size(); ++i) {
+            index.add(static_cast<int>(1000 + i), voc.transform(scene.views[i]));
+        }
+        CHECK(index.size() == scene.views.size());
+        CHECK(index.vector(1000) != nullptr && index.vector(5) == nullptr);
+
+        // Revisit places: a fresh view retrieves the stored keyframe first, with
+        // the same score Vocabulary::score() gives.
+        int hits = 0;
+        for (int place : {3, 42, 77}) {
+            const BowVector q = voc.transform(view_of(scene.places[place], scene.prototypes, rng));
+            const std::vector<BowMatch> top = index.query(q, 5);
+            CHECK(top.size() == 5);
+            CHECK(top[0].score >= top[1].score);
+            hits += top[0].keyframe == 1000 + place;
+            CHECK_NEAR(top[0].score, Vocabulary::score(q, *index.vector(top[0].keyframe)), 1e-6);
+        }
+        CHECK(hits == 3);
+
+        // The filter excludes candidates (e.g. the query's own neighbourhood).
+        const BowVector q = voc.transform(scene.views[42]);
+        std::vector<BowMatch> filtered;
+        index.query(q, 3, [](int kf) { return kf != 1042; }, filtered);
+        CHECK(filtered.size() == 3 && filtered[0].keyframe != 1042);
+    }
+
+}  // namespace
+
+int main() {
+    test_training_and_transform();
+    test_file_round_trip();
+    test_inverted_index();
+    return artest::report("test_vocabulary");
+}
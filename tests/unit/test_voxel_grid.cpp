@@ -0,0 +1,229 @@
+// Unit tests for the voxel hash grid.
+// Checks Morton coding, merge-on-insert, move/remove bookkeeping and table
+// growth, and compares radius, k-nearest and frustum queries against brute
+// force on random clouds (including negative and far-out coordinates).
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "core/voxel_grid.h"
+#include "test_util.h"
+
+using namespace ar_slam;
+using geometry::Vec3;
+
+namespace {
+
+    using artest::Lcg;
+
+    double dist2(const Vec3& a, const Vec3& b) {
+        return (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) +
+               (a[2] - b[2]) * (a[2] - b[2]);
+    }
+
+    std::vector<Vec3> random_cloud(int n, uint32_t seed, double extent) {
+        Lcg rng{seed};
+        std::vector<Vec3> cloud;
+        for (int i = 0; i < n; ++i) {
+            cloud.push_back({rng.uniform(-extent, extent), rng.uniform(-extent, extent),
+                             rng.uniform(-extent, extent)});
+        }
+        return cloud;
+    }
+
+    void test_morton() {
+        using voxel_detail::Voxel;
+        const Voxel samples[] = {{0, 0, 0},
+                                 {1, 2, 3},
+                                 {-1, -1, -1},
+                                 {voxel_detail::kAxisMin, 0, voxel_detail::kAxisMax},
+                                 {12345, -67890, 424242}};
+        for (const Voxel& v : samples) {
+            const Voxel back = voxel_detail::demorton(voxel_detail::morton(v));
+            CHECK(back.x == v.x && back.y == v.y && back.z == v.z);
+            CHECK(voxel_detail::morton(v) != voxel_detail::kEmptyKey);
+        }
+        // Z-order: x occupies the lowest bit of each triple.
+        const uint64_t origin = voxel_detail::morton({0, 0, 0});
+        CHECK((voxel_detail::morton({1, 0, 0}) ^ origin) == 1u);
+        CHECK((voxel_detail::morton({0, 1, 0}) ^ origin) == 2u);
+        CHECK((voxel_detail::morton({0, 0, 1}) ^ origin) == 4u);
+    }
+
+    void test_merge_on_insert() {
+        VoxelGrid::Config config;
+        config.voxel_size = 0.1;
+        config.merge_radius = 0.05;
+        VoxelGrid grid(config);
+
+        const auto a = grid.insert({1.0, 1.0, 1.0}, 7);
+        CHECK(!a.merged && a.handle == 0);
+        // Within the radius (and across a voxel boundary): fused, keeps id 7.
+        const auto b = grid.insert({1.0, 1.0, 0.96}, 8);
+        CHECK(b.merged && b.handle == a.handle);
+        CHECK(grid.size() == 1);
+        CHECK(grid.point(a.handle).id == 7);
+        CHECK(grid.point(a.handle).weight == 2);
+        CHECK_NEAR(grid.point(a.handle).position[2], 0.98, 1e-12);
+        // Outside the radius: a new point.
+        const auto c = grid.insert({1.2, 1.0, 1.0}, 9);
+        CHECK(!c.merged && c.handle == 1);
+        CHECK(grid.size() == 2);
+
+        // add() never merges.
+        CHECK(grid.add({1.0, 1.0, 0.98}, 10) == 2);
+        CHECK(grid.size() == 3);
+    }
+
+    void test_move_remove_and_growth() {
+        VoxelGrid::Config config;
+        config.voxel_size = 0.5;
+        config.initial_slots = 16;
+        VoxelGrid grid(config);
+        const std::vector<Vec3> cloud = random_cloud(5000, 3, 40.0);
+        for (std::size_t i = 0; i < cloud.size(); ++i) {
+            CHECK(grid.add(cloud[i], static_cast<int>(i)) == static_cast<int>(i));
+        }
+        CHECK(grid.size() == cloud.size());
+        CHECK(grid.slots() >= 2 * grid.voxels());
+
+        std::vector<int> out;
+        grid.move(10, {100.0, 100.0, 100.0});
+        grid.radius_search({100.0, 100.0, 100.0}, 0.1, out);
+        CHECK(out == std::vector<int>({10}));
+        grid.radius_search(cloud[10], 1e-9, out);
+        CHECK(out.empty());
+
+        grid.remove(10);
+        CHECK(!grid.valid(10));
+        CHECK(grid.size() == cloud.size() - 1);
+        grid.radius_search({100.0, 100.0, 100.0}, 0.1, out);
+        CHECK(out.empty());
+        CHECK(grid.add({5.0, 5.0, 5.0}, 99) == 10);  // Freed handle is reused.
+
+        // Emptied voxels are dropped from the table when it is rebuilt.
+        for (std::size_t i = 0; i < cloud.size(); ++i) {
+            if (i != 10) {
+                grid.remove(static_cast<int>(i));
+            }
+        }
+        CHECK(grid.size() == 1);
+        CHECK(grid.voxels() == 1);
+        grid.clear();
+        CHECK(grid.size() == 0 && grid.voxels() == 0);
+    }
+
+    void test_radius_matches_brute_force() {
+        VoxelGrid grid;
+        const std::vector<Vec3> cloud = random_cloud(3000, 11, 2.0);
+        for (std::size_t i = 0; i < cloud.size(); ++i) {
+            grid.add(cloud[i], static_cast<int>(i));
+        }
+        const std::vector<Vec3> queries = random_cloud(50, 12, 2.5);
+        std::vector<int> out;
+        for (double radius : {0.05, 0.3, 1.0, 10.0}) {
+            for (const Vec3& q : queries) {
+                grid.radius_search(q, radius, out);
+                std::vector<int> expected;
+                for (std::size_t i = 0; i < cloud.size(); ++i) {
+                    if (dist2(cloud[i], q) <= radius * radius) {
+                        expected.push_back(static_cast<int>(i));
+                    }
+                }
+                std::sort(out.begin(), out.end());
+                CHECK(out == expected);
+            }
+        }
+    }
+
+    void test_nearest_matches_brute_force() {
+        VoxelGrid::Config config;
+        config.voxel_size = 0.25;
+        VoxelGrid grid(config);
+        // A sparse clump far from the queries forces many empty shells.
+        std::vector<Vec3> cloud = random_cloud(2000, 21, 3.0);
+        for (const Vec3& p : random_cloud(20, 22, 0.5)) {
+            cloud.push_back({p[0] + 50.0, p[1] - 60.0, p[2]});
+        }
+        for (std::size_t i = 0; i < cloud.size(); ++i) {
+            grid.add(cloud[i], static_cast<int>(i));
+        }
+        std::vector<Vec3> queries = random_cloud(40, 23, 4.0);
+        queries.push_back({50.0, -60.0, 0.0});
+        queries.push_back({-400.0, 300.0, 90.0});
+        std::vector<int> out;
+        for (std::size_t k : {std::size_t{1}, std::size_t{5}, std::size_t{32}}) {
+            for (const Vec3& q : queries) {
+                grid.nearest(q, k, out);
+                std::vector<std::pair<double, int>> all;
+                for (std::size_t i = 0; i < cloud.size(); ++i) {
+                    all.emplace_back(dist2(cloud[i], q), static_cast<int>(i));
+                }
+                std::sort(all.begin(), all.end());
+                CHECK(out.size() == k);
+                for (std::size_t j = 0; j < out.size() && j < k; ++j) {
+                    CHECK_NEAR(dist2(cloud[out[j]], q), all[j].first, 1e-12);
+                }
+            }
+        }
+        // The radius cap leaves fewer than k.
+        grid.nearest({50.0, -60.0, 0.0}, 100, out, 2.0);
+        CHECK(out.size() == 20);
+        grid.nearest({0.0, 0.0, 0.0}, 0, out);
+        CHECK(out.empty());
+    }
+
+    void test_frustum_matches_brute_force() {
+        VoxelGrid grid;
+        const std::vector<Vec3> cloud = random_cloud(4000, 31, 6.0);
+        for (std::size_t i = 0; i < cloud.size(); ++i) {
+            grid.add(cloud[i], static_cast<int>(i));
+        }
+        geometry::Mat3 K;
+        K.m[0][0] = 400.0;
+        K.m[1][1] = 420.0;
+        K.m[0][2] = 320.0;
+        K.m[1][2] = 240.0;
+        K.m[2][2] = 1.0;
+
+        geometry::Pose pose;  // Turned 30 degrees about y, off the origin.
+        const double a = 0.5236;
+        pose.R.m[0][0] = std::cos(a);
+        pose.R.m[0][2] = -std::sin(a);
+        pose.R.m[2][0] = std::sin(a);
+        pose.R.m[2][2] = std::cos(a);
+        pose.t = {0.5, -0.2, 1.0};
+
+        for (double far : {2.0, 5.0, 50.0}) {
+            std::vector<int> out;
+            grid.frustum(pose, K, 640, 480, 0.3, far, out);
+            std::vector<int> expected;
+            for (std::size_t i = 0; i < cloud.size(); ++i) {
+                const Vec3 X = pose.transform(cloud[i]);
+                if (X[2] < 0.3 || X[2] > far) {
+                    continue;
+                }
+                const double u = K.m[0][0] * X[0] / X[2] + K.m[0][2];
+                const double v = K.m[1][1] * X[1] / X[2] + K.m[1][2];
+                if (u >= 0.0 && u < 640.0 && v >= 0.0 && v < 480.0) {
+                    expected.push_back(static_cast<int>(i));
+                }
+            }
+            std::sort(out.begin(), out.end());
+            CHECK(!expected.empty());
+            CHECK(out == expected);
+        }
+    }
+
+}  // namespace
+
+int main() {
+    test_morton();
+    test_merge_on_insert();
+    test_move_remove_and_growth();
+    test_radius_matches_brute_force();
+    test_nearest_matches_brute_force();
+    test_frustum_matches_brute_force();
+    return artest::report("test_voxel_grid");
+}